@@ -0,0 +1,601 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __COLUMNAR_CODECS_HPP__
+#define __COLUMNAR_CODECS_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include "data_bundle.hpp"
+#include "scan.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// Encoders and decoders for the integer encodings used by columnar file
+// formats (Parquet, ORC, Arrow): delta, zigzag, LEB128 varint, fixed bit
+// width packing and run length encoding. BitPack and the RLE runs are the
+// two kinds of run of the Parquet RLE/bit-packed hybrid encoding.
+//
+// Values are streamed as DataBundle beats of N values, and bytes as
+// DataBundle beats of W bytes. Every kernel handles one beat per cycle.
+//
+namespace fpga_tools {
+
+//
+// Zigzag encoding maps signed integers to unsigned ones so that values of
+// small magnitude, positive or negative, have small encodings:
+// 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+//
+template <typename T>
+constexpr std::make_unsigned_t<T> ZigZagEncode(T x) {
+  using U = std::make_unsigned_t<T>;
+  return (U(x) << 1) ^ U(x >> (sizeof(T) * 8 - 1));
+}
+
+template <typename U>
+constexpr std::make_signed_t<U> ZigZagDecode(U x) {
+  using S = std::make_signed_t<U>;
+  return S((x >> 1) ^ (U(0) - (x & 1)));
+}
+
+// the maximum number of bytes of the LEB128 varint encoding of a T
+template <typename T>
+constexpr int VarintMaxBytes() {
+  return (sizeof(T) * 8 + 6) / 7;
+}
+
+//
+// Reads 'beats' beats of DataBundle<T, N> from InPipe and writes the
+// difference of each value from the one before it to OutPipe. The first
+// value is written as is. With 'zigzag' set the differences are zigzag
+// encoded and OutPipe carries DataBundle<std::make_unsigned_t<T>, N>,
+// otherwise it carries DataBundle<T, N>. Differences wrap around like
+// unsigned arithmetic.
+//
+template <typename InPipe, typename OutPipe, bool zigzag>
+void DeltaEncode(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename InBeat::ValType;
+  using U = std::make_unsigned_t<T>;
+  constexpr int kLanes = InBeat::size;
+  static_assert(OutBeat::size == kLanes);
+  static_assert(std::is_same_v<typename OutBeat::ValType,
+                               std::conditional_t<zigzag, U, T>>);
+
+  T prev = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    InBeat in = InPipe::read();
+    OutBeat out;
+    UnrolledLoop<kLanes>([&](auto i) {
+      T before;
+      if constexpr (i == 0) {
+        before = prev;
+      } else {
+        before = in[i - 1];
+      }
+      T delta = T(U(in[i]) - U(before));
+      if constexpr (zigzag) {
+        out[i] = ZigZagEncode(delta);
+      } else {
+        out[i] = delta;
+      }
+    });
+    prev = in[kLanes - 1];
+    OutPipe::write(out);
+  }
+}
+
+//
+// The inverse of DeltaEncode: a running sum of the differences, computed
+// N values per cycle with the in-beat scan from scan.hpp.
+//
+template <typename InPipe, typename OutPipe, bool zigzag>
+void DeltaDecode(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename OutBeat::ValType;
+  using U = std::make_unsigned_t<T>;
+  constexpr int kLanes = OutBeat::size;
+  static_assert(InBeat::size == kLanes);
+  static_assert(std::is_same_v<typename InBeat::ValType,
+                               std::conditional_t<zigzag, U, T>>);
+
+  U prev = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    InBeat in = InPipe::read();
+    DataBundle<U, kLanes> sum;
+    UnrolledLoop<kLanes>([&](auto i) {
+      if constexpr (zigzag) {
+        sum[i] = U(ZigZagDecode(in[i]));
+      } else {
+        sum[i] = U(in[i]);
+      }
+    });
+    InclusiveScanBeat(sum, std::plus<U>());
+
+    OutBeat out;
+    UnrolledLoop<kLanes>([&](auto i) { out[i] = T(prev + sum[i]); });
+    prev += sum[kLanes - 1];
+    OutPipe::write(out);
+  }
+}
+
+//
+// Reads 'beats' beats of DataBundle<T, N> from InPipe, with T unsigned, and
+// writes the LEB128 varint encoding of the values to OutPipe as dense
+// beats of DataBundle<uint8_t, W>. Only the last beat can be partial.
+// Returns the number of bytes written.
+//
+// The encoded length of each value is computed in parallel, and the
+// prefix sum of the lengths gives the offset of each value's bytes in a
+// byte buffer, which they are routed to through a crossbar. A beat is
+// written whenever the buffer holds W bytes. A new input beat is only read
+// when fewer than W bytes are waiting, so when N values encode to more
+// than W bytes the input is throttled to the output rate.
+//
+template <typename InPipe, typename OutPipe>
+size_t VarintEncode(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename InBeat::ValType;
+  constexpr int kLanes = InBeat::size;
+  constexpr int kWidth = OutBeat::size;
+  constexpr int kMaxBytes = VarintMaxBytes<T>();
+  constexpr int kBufSize = kWidth - 1 + kLanes * kMaxBytes;
+  static_assert(std::is_unsigned_v<T>);
+  static_assert(std::is_same_v<OutBeat, DataBundle<uint8_t, kWidth>>);
+
+  uint8_t buffer[kBufSize];
+  int fill = 0;
+  size_t b = 0;
+  size_t total = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  while (b < beats || fill >= kWidth) {
+    // append the encoding of the next beat of values
+    if (b < beats && fill < kWidth) {
+      InBeat in = InPipe::read();
+
+      uint8_t bytes[kLanes][kMaxBytes];
+      DataBundle<int, kLanes> len;
+      UnrolledLoop<kLanes>([&](auto i) {
+        len[i] = 1;
+        UnrolledLoop<kMaxBytes>([&](auto k) {
+          uint8_t group = (in[i] >> (7 * k)) & 0x7F;
+          bool more = false;
+          if constexpr (k + 1 < kMaxBytes) {
+            more = (in[i] >> (7 * (k + 1))) != 0;
+          }
+          bytes[i][k] = group | (more ? 0x80 : 0);
+          if (more) len[i] = k + 2;
+        });
+      });
+
+      DataBundle<int, kLanes> end = len;
+      InclusiveScanBeat(end, std::plus<int>());
+
+      UnrolledLoop<kBufSize>([&](auto p) {
+        UnrolledLoop<kLanes>([&](auto i) {
+          int k = (int)p - fill - (end[i] - len[i]);
+          if (k >= 0 && k < len[i]) {
+            buffer[p] = bytes[i][k];
+          }
+        });
+      });
+      fill += end[kLanes - 1];
+      total += end[kLanes - 1];
+      b++;
+    }
+
+    // write out a full beat
+    if (fill >= kWidth) {
+      OutBeat out;
+      UnrolledLoop<kWidth>([&](auto p) { out[p] = buffer[p]; });
+      UnrolledLoop<kBufSize - kWidth>(
+          [&](auto p) { buffer[p] = buffer[p + kWidth]; });
+      OutPipe::write(out);
+      fill -= kWidth;
+    }
+  }
+
+  // flush the last, partial, beat
+  if (fill > 0) {
+    OutBeat out;
+    UnrolledLoop<kWidth>([&](auto p) { out[p] = buffer[p]; });
+    OutPipe::write(out);
+  }
+
+  return total;
+}
+
+//
+// Reads 'in_beats' beats of DataBundle<uint8_t, W> of LEB128 varints from
+// InPipe and writes 'num_values' decoded values to OutPipe as dense beats
+// of DataBundle<T, N>, T unsigned. Only the last beat can be partial.
+// Returns the number of values decoded, which is less than 'num_values'
+// only if the input ran out.
+//
+// The bytes are kept in a buffer whose first N * VarintMaxBytes<T>()
+// bytes, the window, always hold N complete values unless the input is
+// exhausted. The terminating bytes (top bit clear) in the window are
+// counted with a scan, which assigns every byte to its value, and the
+// values are assembled and removed from the buffer N per cycle.
+//
+template <typename InPipe, typename OutPipe>
+size_t VarintDecode(size_t in_beats, size_t num_values) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename OutBeat::ValType;
+  constexpr int kLanes = OutBeat::size;
+  constexpr int kWidth = InBeat::size;
+  constexpr int kMaxBytes = VarintMaxBytes<T>();
+  constexpr int kWindow = kLanes * kMaxBytes;
+  constexpr int kBufSize = kWindow + kWidth;
+  static_assert(std::is_unsigned_v<T>);
+  static_assert(std::is_same_v<InBeat, DataBundle<uint8_t, kWidth>>);
+
+  uint8_t buffer[kBufSize];
+  int fill = 0;
+  size_t b = 0;
+  size_t remaining = num_values;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  while (remaining > 0) {
+    // number the terminating bytes in the window
+    DataBundle<bool, kWindow> last;
+    DataBundle<int, kWindow> count;
+    UnrolledLoop<kWindow>([&](auto p) {
+      last[p] = (int)p < fill && (buffer[p] & 0x80) == 0;
+      count[p] = last[p] ? 1 : 0;
+    });
+    InclusiveScanBeat(count, std::plus<int>());
+
+    const int n = remaining < kLanes ? (int)remaining : kLanes;
+    if (count[kWindow - 1] >= n) {
+      // the first byte of every value, and the end of the n'th value
+      int start[kLanes + 1];
+      start[0] = 0;
+      UnrolledLoop<kLanes>([&](auto k) {
+        start[k + 1] = 0;
+        UnrolledLoop<kWindow>([&](auto p) {
+          if (last[p] && count[p] == (int)k + 1) start[k + 1] = p + 1;
+        });
+      });
+      int consumed = 0;
+      UnrolledLoop<1, kLanes + 1>([&](auto k) {
+        if ((int)k == n) consumed = start[k];
+      });
+
+      OutBeat out;
+      UnrolledLoop<kLanes>([&](auto k) {
+        T val = 0;
+        UnrolledLoop<kWindow>([&](auto p) {
+          int shift = (int)p - start[k];
+          if (count[p] - (last[p] ? 1 : 0) == (int)k && shift >= 0 &&
+              shift < kMaxBytes) {
+            val |= T(buffer[p] & 0x7F) << (7 * shift);
+          }
+        });
+        out[k] = val;
+      });
+      OutPipe::write(out);
+      remaining -= n;
+
+      UnrolledLoop<kBufSize>([&](auto p) {
+        UnrolledLoop<kWindow + 1>([&](auto s) {
+          if constexpr (p + s < kBufSize) {
+            if (consumed == (int)s) buffer[p] = buffer[p + s];
+          }
+        });
+      });
+      fill -= consumed;
+    } else if (b == in_beats) {
+      // the input ended in the middle of a value
+      break;
+    }
+
+    // append the next beat of bytes
+    if (b < in_beats && fill <= kBufSize - kWidth) {
+      InBeat in = InPipe::read();
+      UnrolledLoop<kBufSize>([&](auto p) {
+        int k = (int)p - fill;
+        if (k >= 0 && k < kWidth) buffer[p] = in[k];
+      });
+      fill += kWidth;
+      b++;
+    }
+  }
+
+  return num_values - remaining;
+}
+
+//
+// Reads 'beats' beats of DataBundle<T, N> from InPipe and writes the low
+// 'bits' bits of each value, packed, to OutPipe as DataBundle<uint8_t,
+// N * bits / 8>. Values are packed from the least significant bit of the
+// first byte, which with N = 8 is a group of the Parquet bit-packed
+// encoding. The bit positions are compile-time constants, so the packing
+// is only wiring.
+//
+template <typename InPipe, typename OutPipe, int bits>
+void BitPack(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename InBeat::ValType;
+  constexpr int kLanes = InBeat::size;
+  constexpr int kBytes = kLanes * bits / 8;
+  static_assert(bits > 0 && bits <= (int)sizeof(T) * 8);
+  static_assert((kLanes * bits) % 8 == 0);
+  static_assert(std::is_same_v<OutBeat, DataBundle<uint8_t, kBytes>>);
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    InBeat in = InPipe::read();
+    OutBeat out;
+    UnrolledLoop<kBytes>([&](auto byte) {
+      uint8_t x = 0;
+      UnrolledLoop<8>([&](auto t) {
+        constexpr int kBit = byte * 8 + t;
+        x |= uint8_t((in[kBit / bits] >> (kBit % bits)) & 1) << t;
+      });
+      out[byte] = x;
+    });
+    OutPipe::write(out);
+  }
+}
+
+//
+// The inverse of BitPack.
+//
+template <typename InPipe, typename OutPipe, int bits>
+void BitUnpack(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename OutBeat::ValType;
+  constexpr int kLanes = OutBeat::size;
+  constexpr int kBytes = kLanes * bits / 8;
+  static_assert(bits > 0 && bits <= (int)sizeof(T) * 8);
+  static_assert((kLanes * bits) % 8 == 0);
+  static_assert(std::is_same_v<InBeat, DataBundle<uint8_t, kBytes>>);
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    InBeat in = InPipe::read();
+    OutBeat out;
+    UnrolledLoop<kLanes>([&](auto i) {
+      T x = 0;
+      UnrolledLoop<bits>([&](auto t) {
+        constexpr int kBit = i * bits + t;
+        x |= T((in[kBit / 8] >> (kBit % 8)) & 1) << t;
+      });
+      out[i] = x;
+    });
+    OutPipe::write(out);
+  }
+}
+
+//
+// A run of 'length' copies of 'value', as encoded by RleEncode. In the
+// Parquet RLE/bit-packed hybrid encoding, an RLE run is the varint of
+// length << 1 followed by the value.
+//
+template <typename T>
+struct RleRun {
+  T value;
+  uint32_t length;
+};
+
+//
+// Reads 'beats' beats of DataBundle<T, N> from InPipe and writes the runs
+// of equal values to OutPipe as dense beats of DataBundle<RleRun<T>, N>.
+// Only the last beat can be partial. Returns the number of runs. The
+// length of a run must fit a uint32_t.
+//
+// A lane starts a run if its value differs from the value before it, and
+// closes the run before it. A closed run starts at the last lane before it
+// that started one, or else it is the open run carried over from the
+// previous beats. The closed runs are placed in a buffer at the prefix sum
+// of the lanes that close one, and a beat is written whenever the buffer
+// holds N runs. At most N runs close per beat, so the input is never
+// throttled.
+//
+template <typename InPipe, typename OutPipe>
+size_t RleEncode(size_t beats) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename InBeat::ValType;
+  using Run = RleRun<T>;
+  constexpr int kLanes = InBeat::size;
+  constexpr int kBufSize = 2 * kLanes - 1;
+  static_assert(std::is_same_v<OutBeat, DataBundle<Run, kLanes>>);
+
+  Run buffer[kBufSize];
+  int fill = 0;
+  Run open{0, 0};  // the run that continues into the next beat
+  size_t total = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    InBeat in = InPipe::read();
+
+    // the lanes that start a run, and those that close one. The first
+    // value of the stream starts a run without closing one.
+    bool head[kLanes];
+    DataBundle<int, kLanes> close;
+    UnrolledLoop<kLanes>([&](auto i) {
+      if constexpr (i == 0) {
+        head[i] = open.length == 0 || in[i] != open.value;
+        close[i] = (open.length != 0 && in[i] != open.value) ? 1 : 0;
+      } else {
+        head[i] = in[i] != in[i - 1];
+        close[i] = head[i] ? 1 : 0;
+      }
+    });
+
+    // the run closed by each lane
+    Run closed[kLanes];
+    UnrolledLoop<kLanes>([&](auto i) {
+      closed[i] = {open.value, open.length + (uint32_t)i};
+      UnrolledLoop<i>([&](auto j) {
+        if (head[j]) closed[i] = {in[j], (uint32_t)(i - j)};
+      });
+    });
+
+    // the run left open starts at the last lane that started one, if any
+    bool any_head = false;
+    UnrolledLoop<kLanes>([&](auto j) {
+      if (head[j]) open = {in[j], (uint32_t)(kLanes - j)};
+      any_head |= head[j];
+    });
+    if (!any_head) open.length += kLanes;
+
+    DataBundle<int, kLanes> end = close;
+    InclusiveScanBeat(end, std::plus<int>());
+
+    UnrolledLoop<kBufSize>([&](auto p) {
+      UnrolledLoop<kLanes>([&](auto i) {
+        if (close[i] && (int)p == fill + end[i] - 1) buffer[p] = closed[i];
+      });
+    });
+    fill += end[kLanes - 1];
+    total += end[kLanes - 1];
+
+    // write out a full beat
+    if (fill >= kLanes) {
+      OutBeat out;
+      UnrolledLoop<kLanes>([&](auto p) { out[p] = buffer[p]; });
+      UnrolledLoop<kBufSize - kLanes>(
+          [&](auto p) { buffer[p] = buffer[p + kLanes]; });
+      OutPipe::write(out);
+      fill -= kLanes;
+    }
+  }
+
+  // close the open run and flush the buffer
+  if (open.length != 0) {
+    UnrolledLoop<kBufSize>([&](auto p) {
+      if ((int)p == fill) buffer[p] = open;
+    });
+    fill++;
+    total++;
+  }
+  if (fill > 0) {
+    OutBeat out;
+    UnrolledLoop<kLanes>([&](auto p) { out[p] = buffer[p]; });
+    OutPipe::write(out);
+  }
+
+  return total;
+}
+
+//
+// The inverse of RleEncode. Reads 'in_beats' dense beats of
+// DataBundle<RleRun<T>, N> from InPipe and writes 'num_values' values to
+// OutPipe as dense beats of DataBundle<T, N>. Only the last beat can be
+// partial. Returns the number of values decoded, which is less than
+// 'num_values' only if the input ran out. The runs must not be empty.
+//
+// The runs are kept in a buffer whose first N runs, the window, always
+// cover N values unless the input is exhausted. The ends of the runs in
+// the window are found with a scan of their lengths, and each output lane
+// takes the value of the first run that ends after it. The lengths are
+// capped at N + 1 for the scan, which keeps the sums small and still tells
+// a run that ends at lane N from one that goes on. The runs that are used
+// up are removed from the buffer, and the length of the next one is reduced
+// by what was used.
+//
+template <typename InPipe, typename OutPipe>
+size_t RleDecode(size_t in_beats, size_t num_values) {
+  using InBeat = decltype(InPipe::read());
+  using OutBeat = decltype(OutPipe::read());
+  using T = typename OutBeat::ValType;
+  using Run = RleRun<T>;
+  constexpr int kLanes = OutBeat::size;
+  constexpr int kBufSize = 2 * kLanes;
+  static_assert(std::is_same_v<InBeat, DataBundle<Run, kLanes>>);
+
+  // the lengths of the slots past 'fill' are read, but not used, by the
+  // scan, so they start out defined
+  Run buffer[kBufSize] = {};
+  int fill = 0;
+  size_t b = 0;
+  size_t remaining = num_values;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  while (remaining > 0) {
+    DataBundle<int, kLanes> end;
+    UnrolledLoop<kLanes>([&](auto k) {
+      uint32_t len = std::min(buffer[k].length, (uint32_t)kLanes + 1);
+      end[k] = (int)k < fill ? (int)len : 0;
+    });
+    InclusiveScanBeat(end, std::plus<int>());
+
+    const int n = remaining < kLanes ? (int)remaining : kLanes;
+    if (end[kLanes - 1] >= n) {
+      OutBeat out;
+      UnrolledLoop<kLanes>([&](auto i) {
+        int run = 0;
+        UnrolledLoop<kLanes>([&](auto k) {
+          if (end[k] <= (int)i) run = k + 1;
+        });
+        T val = 0;
+        UnrolledLoop<kLanes>([&](auto k) {
+          if (run == (int)k) val = buffer[k].value;
+        });
+        out[i] = val;
+      });
+      OutPipe::write(out);
+      remaining -= n;
+
+      // the runs used up, and the values used from the next one
+      int consumed = 0;
+      UnrolledLoop<kLanes>([&](auto k) {
+        if ((int)k < fill && end[k] <= n) consumed = k + 1;
+      });
+      int used = 0;
+      UnrolledLoop<1, kLanes + 1>([&](auto k) {
+        if (consumed == (int)k) used = end[k - 1];
+      });
+      UnrolledLoop<kLanes>([&](auto k) {
+        if (consumed == (int)k) buffer[k].length -= n - used;
+      });
+
+      UnrolledLoop<kBufSize>([&](auto p) {
+        UnrolledLoop<kLanes + 1>([&](auto s) {
+          if constexpr (p + s < kBufSize) {
+            if (consumed == (int)s) buffer[p] = buffer[p + s];
+          }
+        });
+      });
+      fill -= consumed;
+    } else if (b == in_beats) {
+      // the input ran out
+      break;
+    }
+
+    // append the next beat of runs
+    if (b < in_beats && fill <= kBufSize - kLanes) {
+      InBeat in = InPipe::read();
+      UnrolledLoop<kBufSize>([&](auto p) {
+        int k = (int)p - fill;
+        if (k >= 0 && k < kLanes) buffer[p] = in[k];
+      });
+      fill += kLanes;
+      b++;
+    }
+  }
+
+  return num_values - remaining;
+}
+
+}  // namespace fpga_tools
+
+#endif /* __COLUMNAR_CODECS_HPP__ */
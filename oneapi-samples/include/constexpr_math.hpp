@@ -137,6 +137,34 @@ constexpr double Exp(double x, unsigned taylor_terms=32) {
   return answer;
 }
 
+// the value of pi
+constexpr double kPi = 3.14159265358979323846;
+
+// estimates sin(x) using a taylor series expansion, after reducing x to the
+// range [-pi, pi]
+// https://en.wikipedia.org/wiki/Taylor_series
+constexpr double Sin(double x, unsigned taylor_terms=32) {
+  while (x > kPi) {
+    x -= 2 * kPi;
+  }
+  while (x < -kPi) {
+    x += 2 * kPi;
+  }
+
+  double term = x;
+  double answer = x;
+  for (unsigned i = 1; i < taylor_terms; i++) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    answer += term;
+  }
+  return answer;
+}
+
+// estimates cos(x), see Sin
+constexpr double Cos(double x, unsigned taylor_terms=32) {
+  return Sin(x + kPi / 2, taylor_terms);
+}
+
 // Scale significand using floating-point base exponent
 // see: http://www.cplusplus.com/reference/cmath/scalbn/
 constexpr float Scalbn(float value, int exponent) {
@@ -0,0 +1,60 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __DATA_BUNDLE_HPP__
+#define __DATA_BUNDLE_HPP__
+
+#include "unrolled_loop.hpp"
+
+namespace fpga_tools {
+
+//
+// A fixed size group of elements that is transferred together, for example
+// through a pipe. It can be indexed like an array and exposes its size as
+// the static member 'size', which is what the multi-element versions of
+// MemoryToPipe and PipeToMemory in memory_utils.hpp expect.
+//
+// TEMPLATE PARAMETERS
+//    T:            the datatype of the elements
+//    bundle_size:  the number of elements in the bundle
+//
+// EXAMPLE USAGE
+//    using MyBundle = DataBundle<float, 8>;
+//    using MyPipe = sycl::ext::intel::pipe<MyPipeID, MyBundle>;
+//    ...
+//    MyBundle b(0.0f);
+//    b[3] = 1.0f;
+//    MyPipe::write(b);
+//
+template <typename T, int bundle_size>
+struct DataBundle {
+  static_assert(bundle_size > 0);
+
+  // allows the number of elements in the bundle to be queried
+  static constexpr int size = bundle_size;
+
+  // allows the type of the elements to be queried
+  using ValType = T;
+
+  DataBundle() {}
+
+  // set every element to 'val'
+  DataBundle(const T &val) {
+    UnrolledLoop<bundle_size>([&](auto i) { data_[i] = val; });
+  }
+
+  T &operator[](int i) { return data_[i]; }
+  const T &operator[](int i) const { return data_[i]; }
+
+  // shift the elements down by one and insert 'val' at the top
+  void ShiftIn(const T &val) {
+    UnrolledLoop<bundle_size - 1>([&](auto i) { data_[i] = data_[i + 1]; });
+    data_[bundle_size - 1] = val;
+  }
+
+ private:
+  T data_[bundle_size];
+};
+
+}  // namespace fpga_tools
+
+#endif /* __DATA_BUNDLE_HPP__ */
@@ -0,0 +1,215 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __FEED_ARBITER_HPP__
+#define __FEED_ARBITER_HPP__
+
+#include <cstdint>
+
+#include "constexpr_math.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// Arbitration of A/B redundant feeds: the same sequenced messages arrive on
+// two channels, each of which can lose, repeat or locally reorder them, and
+// the arbiter forwards the first copy of every sequence number, in sequence
+// order, and reports the sequence numbers that neither feed delivered.
+//
+// Each feed is assumed to reorder its messages by less than the window of
+// the arbiter: a message never follows one with a sequence number that is
+// 'window' or more above its own on the same feed. A message that is
+// missing can then still arrive on a feed until that feed delivers one
+// 'window' above it, and once both feeds have done that, it is lost.
+//
+namespace fpga_tools {
+
+// a run of 'count' sequence numbers, from 'first', that were lost on both
+// feeds
+struct FeedGap {
+  uint32_t first;
+  uint32_t count;
+};
+
+struct FeedArbiterCounters {
+  uint64_t forwarded;   // messages written to the output
+  uint64_t duplicates;  // copies of forwarded or buffered messages
+  uint64_t gaps;        // gaps detected
+  uint64_t lost;        // sequence numbers in those gaps
+  uint64_t unreported;  // gaps the gap channel had no room for
+};
+
+// the commands the host sends to the arbiter
+constexpr uint8_t kFeedArbiterSetTimeout = 0;
+constexpr uint8_t kFeedArbiterReadCounters = 1;
+constexpr uint8_t kFeedArbiterStop = 2;
+
+struct FeedArbiterCommand {
+  uint8_t op;
+  uint32_t timeout;  // kFeedArbiterSetTimeout: the new timeout, in cycles
+};
+
+//
+// Reads messages from the 2 pipes of FeedPipes, a PipeArray, and writes the
+// first copy of every sequence number to OutPipe, starting at 'first_seq'.
+// 'seq_of' returns the sequence number of a message. Sequence numbers are
+// compared modulo 2^32, so they can wrap.
+//
+// The next expected message is forwarded in the cycle it arrives. A message
+// less than 'window' ahead of the next expected one waits in an on-chip
+// buffer, and a copy of a forwarded or buffered message is dropped. A
+// message 'window' or more ahead is held at the head of its feed, which
+// stops reading that feed, until the expected message moves up to it.
+//
+// The expected message is declared lost, and skipped, when both feeds are
+// held, or when the arbiter has waited for it for 'timeout' cycles with
+// messages behind it. The timeout covers a feed that has stopped, and is
+// off when 0. Gaps are reported to GapChannel, a side channel of FeedGap,
+// when the next message after them is forwarded, so a report covers the
+// whole run. The arbiter never waits for the host: if the channel is full,
+// the gap is only counted.
+//
+// The host sends FeedArbiterCommands through CommandChannel:
+//    kFeedArbiterSetTimeout:   change the timeout
+//    kFeedArbiterReadCounters: copy the counters to 'counters' and write the
+//                              next expected sequence number to AckChannel
+//    kFeedArbiterStop:         exit
+//
+// EXAMPLE USAGE
+//    using FeedPipes = PipeArray<MyFeedPipesID, Message, 16, 2>;
+//    q.single_task<MyArbiterKernel>([=] {
+//      auto seq_of = [](const Message &m) { return m.seq; };
+//      fpga_tools::FeedArbiter<64, FeedPipes, OutPipe, CommandChannel,
+//                              AckChannel, GapChannel>(0, 0, counters,
+//                                                      seq_of);
+//    });
+//
+template <int window, typename FeedPipes, typename OutPipe,
+          typename CommandChannel, typename AckChannel, typename GapChannel,
+          typename SeqFn>
+void FeedArbiter(uint32_t first_seq, uint32_t timeout,
+                 FeedArbiterCounters *counters, SeqFn seq_of) {
+  static_assert(window >= 2 && IsPow2(window));
+  using T = decltype(FeedPipes::template PipeAt<0>::read());
+
+  FeedArbiterCounters count{0, 0, 0, 0, 0};
+
+  // the out of order window, indexed by sequence number modulo 'window'
+  T buffer[window];
+  bool present[window];
+  UnrolledLoop<window>([&](auto i) { present[i] = false; });
+  int buffered = 0;
+
+  // the message at the head of each feed
+  T head[2];
+  bool have[2] = {false, false};
+
+  uint32_t expected = first_seq;
+  uint32_t waited = 0;
+  FeedGap gap{0, 0};
+  bool stop = false;
+
+  while (!stop) {
+    // read a message from each feed that is not held
+    UnrolledLoop<2>([&](auto f) {
+      if (!have[f]) {
+        bool valid;
+        head[f] = FeedPipes::template PipeAt<f>::read(valid);
+        have[f] = valid;
+      }
+    });
+
+    // the buffered copy of the expected message goes first, since it
+    // arrived first
+    const int slot = expected % window;
+    bool out_valid = present[slot];
+    T out = buffer[slot];
+    if (out_valid) {
+      present[slot] = false;
+      buffered--;
+    }
+
+    // forward, drop or buffer the heads of the feeds, and hold the ones
+    // that are too far ahead. 'ahead' is how far the nearest held one is
+    // ahead of the expected message.
+    uint32_t ahead = 0xFFFFFFFF;
+    UnrolledLoop<2>([&](auto f) {
+      if (have[f]) {
+        const uint32_t seq = seq_of(head[f]);
+        const int32_t distance = int32_t(seq - expected);
+        if (distance == 0 && !out_valid) {
+          out = head[f];
+          out_valid = true;
+          have[f] = false;
+        } else if (distance <= 0) {
+          count.duplicates++;
+          have[f] = false;
+        } else if (distance < window) {
+          const int s = seq % window;
+          if (present[s]) {
+            count.duplicates++;
+          } else {
+            buffer[s] = head[f];
+            present[s] = true;
+            buffered++;
+          }
+          have[f] = false;
+        } else if (uint32_t(distance) < ahead) {
+          ahead = distance;
+        }
+      }
+    });
+
+    if (out_valid) {
+      // report the gap before this message, if there is one
+      if (gap.count != 0) {
+        bool reported;
+        GapChannel::write(gap, reported);
+        if (!reported) count.unreported++;
+        gap.count = 0;
+      }
+      OutPipe::write(out);
+      count.forwarded++;
+      expected++;
+      waited = 0;
+    } else {
+      // nothing to forward: wait for the expected message while anything
+      // is queued behind it, or give up on it
+      const bool waiting = buffered != 0 || have[0] || have[1];
+      const bool timed_out = timeout != 0 && waited >= timeout;
+      if (waiting && ((have[0] && have[1]) || timed_out)) {
+        // skip it, or, if nothing is buffered, skip to where the nearest
+        // held feed can go on
+        const uint32_t skip = buffered != 0 ? 1 : ahead - window + 1;
+        if (gap.count == 0) {
+          gap.first = expected;
+          count.gaps++;
+        }
+        gap.count += skip;
+        count.lost += skip;
+        expected += skip;
+      }
+      if (!waiting) {
+        waited = 0;
+      } else if (!timed_out) {
+        waited++;
+      }
+    }
+
+    // a command from the host
+    bool valid_command;
+    FeedArbiterCommand command = CommandChannel::read(valid_command);
+    if (valid_command) {
+      if (command.op == kFeedArbiterSetTimeout) {
+        timeout = command.timeout;
+      } else if (command.op == kFeedArbiterReadCounters) {
+        *counters = count;
+        AckChannel::write(expected);
+      } else if (command.op == kFeedArbiterStop) {
+        stop = true;
+      }
+    }
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __FEED_ARBITER_HPP__ */
@@ -0,0 +1,297 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __PACKET_PARSER_HPP__
+#define __PACKET_PARSER_HPP__
+
+#include <cstdint>
+
+#include "data_bundle.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// A line rate parser for the Ethernet, VLAN, IPv4, UDP and TCP headers of
+// a stream of packets.
+//
+// Packets arrive as beats of 'beat_bytes' bytes, in the style of an Avalon
+// streaming interface: every packet starts in a new beat and the last beat
+// of a packet may be partially filled. The headers of a packet can span any
+// number of beats and, since their lengths depend on the number of VLAN
+// tags and on the IPv4 options, the L3 and L4 headers can start at any
+// byte of a beat.
+//
+namespace fpga_tools {
+
+// a beat of a packet stream
+template <int beat_bytes>
+struct PacketBeat {
+  static constexpr int bytes = beat_bytes;
+
+  DataBundle<uint8_t, beat_bytes> data;
+  bool sop;       // the first beat of a packet
+  bool eop;       // the last beat of a packet
+  uint8_t empty;  // the number of unused bytes at the end of an 'eop' beat
+};
+
+constexpr uint16_t kEtherTypeIPv4 = 0x0800;
+constexpr uint16_t kEtherTypeVlan = 0x8100;
+constexpr uint16_t kEtherTypeQinQ = 0x88A8;
+constexpr uint16_t kEtherTypeQinQLegacy = 0x9100;
+constexpr uint8_t kIpProtocolTcp = 6;
+constexpr uint8_t kIpProtocolUdp = 17;
+
+// the number of stacked VLAN tags the parser looks through
+constexpr int kMaxVlanTags = 2;
+
+// the largest packet, as limited by the 16-bit IPv4 total length
+constexpr int kMaxPacketBytes = 0xFFFF;
+
+// the number of bytes at the start of a packet that can hold the parsed
+// headers: Ethernet and VLAN tags, IPv4 with options, and TCP with options.
+// TCP options are not parsed, only skipped, but the window covers them so
+// that a packet that ends inside them is known to be truncated.
+constexpr int kPacketHeaderWindowBytes = 14 + 4 * kMaxVlanTags + 60 + 60;
+
+//
+// The parsed headers of a packet. The fields of a layer are only meaningful
+// if the flag of that layer ('ipv4' or 'l4') is set. The offsets are in
+// bytes from the start of the packet.
+//
+struct PacketMetadata {
+  uint64_t dst_mac;
+  uint64_t src_mac;
+  uint8_t vlan_tags;
+  uint16_t vlan_tci[kMaxVlanTags];  // the outer tag first
+  uint16_t ether_type;              // the EtherType after the VLAN tags
+
+  bool ipv4;
+  bool ipv4_checksum_ok;
+  bool ip_fragment;  // more fragments follow, or this is not the first one
+  uint8_t dscp_ecn;
+  uint8_t ttl;
+  uint8_t ip_protocol;
+  uint16_t ip_total_length;
+  uint32_t src_ip;
+  uint32_t dst_ip;
+
+  bool l4;  // a UDP or TCP header is present
+  uint16_t src_port;
+  uint16_t dst_port;
+
+  uint16_t l3_offset;
+  uint16_t l4_offset;
+  uint16_t payload_offset;
+
+  // the packet ends before a header it announces
+  bool truncated;
+};
+
+namespace detail {
+
+inline uint16_t PacketBe16(const uint8_t *p) {
+  return (uint16_t(p[0]) << 8) | p[1];
+}
+
+inline uint32_t PacketBe32(const uint8_t *p) {
+  return (uint32_t(PacketBe16(p)) << 16) | PacketBe16(p + 2);
+}
+
+inline bool IsVlanEtherType(uint16_t ether_type) {
+  return ether_type == kEtherTypeVlan || ether_type == kEtherTypeQinQ ||
+         ether_type == kEtherTypeQinQLegacy;
+}
+
+}  // namespace detail
+
+//
+// Parses the headers in the first 'window_bytes' bytes of a packet, of
+// which the first 'avail' belong to the packet. If the packet goes on past
+// the window, 'avail' can be any larger number.
+//
+// The variable offsets of the L3 and L4 headers are resolved with two
+// levels of narrow multiplexers: one that aligns the L3 header on the
+// number of VLAN tags, and one that aligns the L4 header on the IPv4
+// header length. Every field is then read at a constant offset.
+//
+template <int window_bytes>
+PacketMetadata ParsePacketHeaders(const uint8_t (&w)[window_bytes],
+                                  int avail) {
+  static_assert(window_bytes >= kPacketHeaderWindowBytes);
+  // the L3 bytes reach as far as the parsed part of the L4 header after
+  // the longest IPv4 header
+  constexpr int kL4Bytes = 20;
+  constexpr int kL3Bytes = 60 + kL4Bytes;
+
+  PacketMetadata m{};
+  m.dst_mac = (uint64_t(detail::PacketBe16(w)) << 32) |
+              detail::PacketBe32(w + 2);
+  m.src_mac = (uint64_t(detail::PacketBe16(w + 6)) << 32) |
+              detail::PacketBe32(w + 8);
+
+  // look through the VLAN tags
+  uint16_t ether_type = detail::PacketBe16(w + 12);
+  int tags = 0;
+  UnrolledLoop<kMaxVlanTags>([&](auto t) {
+    if (tags == int(t) && detail::IsVlanEtherType(ether_type)) {
+      m.vlan_tci[t] = detail::PacketBe16(w + 14 + 4 * t);
+      ether_type = detail::PacketBe16(w + 16 + 4 * t);
+      tags++;
+    }
+  });
+  m.vlan_tags = tags;
+  m.ether_type = ether_type;
+  m.l3_offset = 14 + 4 * tags;
+
+  // align the L3 header
+  uint8_t l3[kL3Bytes];
+  UnrolledLoop<kL3Bytes>([&](auto i) {
+    l3[i] = w[14 + i];
+    UnrolledLoop<1, kMaxVlanTags + 1>([&](auto t) {
+      if (tags == int(t)) l3[i] = w[14 + 4 * t + i];
+    });
+  });
+
+  const int ihl = l3[0] & 0xF;
+  const int ip_header_bytes = 4 * ihl;
+  const bool eth_short = avail < m.l3_offset;
+  const bool ipv4_type = !eth_short && ether_type == kEtherTypeIPv4;
+  const bool ipv4_header = (l3[0] >> 4) == 4 && ihl >= 5;
+  const bool ip_short =
+      ipv4_type && (avail < m.l3_offset + 20 ||
+                    (ipv4_header && avail < m.l3_offset + ip_header_bytes));
+  m.ipv4 = ipv4_type && ipv4_header && !ip_short;
+  m.dscp_ecn = l3[1];
+  m.ip_total_length = detail::PacketBe16(l3 + 2);
+  const uint16_t flags_fragment = detail::PacketBe16(l3 + 6);
+  m.ip_fragment = (flags_fragment & 0x3FFF) != 0;
+  m.ttl = l3[8];
+  m.ip_protocol = l3[9];
+  m.src_ip = detail::PacketBe32(l3 + 12);
+  m.dst_ip = detail::PacketBe32(l3 + 16);
+
+  // the header checksum, over the 16-bit words of the header
+  uint32_t sum = 0;
+  UnrolledLoop<kL3Bytes / 2>([&](auto k) {
+    if (int(k) < 2 * ihl) sum += detail::PacketBe16(l3 + 2 * k);
+  });
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  m.ipv4_checksum_ok = sum == 0xFFFF;
+
+  // align the L4 header
+  uint8_t l4[kL4Bytes];
+  UnrolledLoop<kL4Bytes>([&](auto i) {
+    l4[i] = l3[20 + i];
+    UnrolledLoop<6, 16>([&](auto h) {
+      if (ihl == int(h)) l4[i] = l3[4 * h + i];
+    });
+  });
+
+  const bool udp = m.ip_protocol == kIpProtocolUdp;
+  const bool tcp = m.ip_protocol == kIpProtocolTcp;
+  const bool first_fragment = (flags_fragment & 0x1FFF) == 0;
+  const int tcp_header_bytes = 4 * (l4[12] >> 4);
+  const bool tcp_header = tcp_header_bytes >= 20;
+  const int l4_header_bytes = udp ? 8 : tcp_header_bytes;
+  m.l4_offset = m.l3_offset + ip_header_bytes;
+  const bool l4_type = m.ipv4 && first_fragment && (udp || tcp);
+  const bool l4_short =
+      l4_type &&
+      (avail < m.l4_offset + (udp ? 8 : 20) ||
+       (tcp && tcp_header && avail < m.l4_offset + l4_header_bytes));
+  m.l4 = l4_type && (udp || tcp_header) && !l4_short;
+  m.src_port = detail::PacketBe16(l4);
+  m.dst_port = detail::PacketBe16(l4 + 2);
+  m.payload_offset = m.l4 ? m.l4_offset + l4_header_bytes
+                          : (m.ipv4 ? m.l4_offset : m.l3_offset);
+
+  m.truncated = eth_short || ip_short || l4_short;
+
+  return m;
+}
+
+//
+// Reads 'beats' beats of packets from InPipe and writes them unchanged to
+// PayloadPipe. For every packet, the PacketMetadata of its headers is
+// written to MetadataPipe just before its first beat, so a downstream
+// kernel can read the metadata and then the packet, in lock step.
+//
+// The beats pass through a delay line long enough to hold the headers, so
+// the headers of the packet that is leaving the delay line are all in it.
+// This costs a latency of a few beats, but lets the kernel take a beat
+// every cycle, whatever the size and alignment of the headers. Bytes in the
+// delay line after the end of the packet are ignored.
+//
+// InPipe is read without blocking. The delay line moves on with every beat
+// that arrives and, while no beat arrives, with a bubble whenever the beat
+// it last took ends a packet. So a packet drains out of the delay line
+// when the link goes idle after it, but the beats of a packet are never
+// split by bubbles, which would hide the end of its headers.
+//
+// EXAMPLE USAGE
+//    using Beat = PacketBeat<8>;
+//    q.single_task<MyParserKernel>([=] {
+//      fpga_tools::PacketParser<InPipe, MetadataPipe, PayloadPipe>(beats);
+//    });
+//
+template <typename InPipe, typename MetadataPipe, typename PayloadPipe>
+void PacketParser(size_t beats) {
+  using BeatT = decltype(InPipe::read());
+  constexpr int kBeatBytes = BeatT::bytes;
+  constexpr int kWindowBeats =
+      (kPacketHeaderWindowBytes + kBeatBytes - 1) / kBeatBytes;
+
+  BeatT line[kWindowBeats];
+  bool line_valid[kWindowBeats];
+  UnrolledLoop<kWindowBeats>([&](auto b) { line_valid[b] = false; });
+
+  size_t read_beats = 0;
+  size_t written_beats = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  while (written_beats < beats) {
+    bool read = false;
+    BeatT in{};
+    if (read_beats < beats) in = InPipe::read(read);
+
+    // a bubble must not split a packet, unless the stream is over
+    const bool packet_open = line_valid[kWindowBeats - 1] &&
+                             !line[kWindowBeats - 1].eop &&
+                             read_beats < beats;
+    if (!read && packet_open) continue;
+
+    if (line_valid[0]) {
+      if (line[0].sop) {
+        // gather the headers of the packet from the delay line
+        uint8_t window[kWindowBeats * kBeatBytes];
+        int avail = 0;
+        bool ended = false;
+        UnrolledLoop<kWindowBeats>([&](auto b) {
+          ended |= !line_valid[b] || (b != 0 && line[b].sop);
+          if (!ended) {
+            avail += kBeatBytes - (line[b].eop ? line[b].empty : 0);
+          }
+          ended |= line[b].eop;
+          UnrolledLoop<kBeatBytes>(
+              [&](auto j) { window[b * kBeatBytes + j] = line[b].data[j]; });
+        });
+        if (!ended) avail = kMaxPacketBytes;
+        MetadataPipe::write(ParsePacketHeaders(window, avail));
+      }
+      PayloadPipe::write(line[0]);
+      written_beats++;
+    }
+
+    // shift the delay line, taking the new beat or a bubble
+    UnrolledLoop<kWindowBeats - 1>([&](auto b) {
+      line[b] = line[b + 1];
+      line_valid[b] = line_valid[b + 1];
+    });
+    line[kWindowBeats - 1] = in;
+    line_valid[kWindowBeats - 1] = read;
+    if (read) read_beats++;
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __PACKET_PARSER_HPP__ */
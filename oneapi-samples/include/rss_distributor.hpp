@@ -0,0 +1,207 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __RSS_DISTRIBUTOR_HPP__
+#define __RSS_DISTRIBUTOR_HPP__
+
+#include <cstdint>
+
+#include "packet_parser.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// Receive side scaling (RSS): spreads the packets of one stream across
+// replicated processing kernels, keeping the packets of each flow in order.
+//
+// The flow hash is the Toeplitz hash of the RSS specification, which NICs
+// implement, so with the same key, hash types and indirection table the
+// FPGA sends a flow to the same queue as the NIC would. The low bits of the
+// hash index an indirection table, and the table entry is the output.
+//
+namespace fpga_tools {
+
+constexpr int kRssKeyBytes = 40;
+constexpr int kRssIndirectionTableSize = 128;
+
+// the key of the RSS specification, which is also the default of many NIC
+// drivers
+constexpr uint8_t kRssDefaultKey[kRssKeyBytes] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+    0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+    0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+    0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa};
+
+//
+// The hash key and hash types. IPv4 packets are hashed on their addresses
+// and, if enabled for their protocol, on their ports (the 'sdfn' hash types
+// of ethtool). Fragments are hashed on their addresses only, since only the
+// first one has the ports, and other packets hash to 0.
+//
+struct RssConfig {
+  uint8_t key[kRssKeyBytes];
+  bool hash_tcp_ports;
+  bool hash_udp_ports;
+};
+
+// the commands the host sends to the distributor
+constexpr uint8_t kRssSetEntry = 0;
+constexpr uint8_t kRssStop = 1;
+
+struct RssCommand {
+  uint8_t op;
+  uint8_t queue;   // kRssSetEntry: the new output of the entry
+  uint16_t index;  // kRssSetEntry: the entry of the indirection table
+};
+
+// the parsed headers of a packet, with its flow hash
+struct RssMetadata {
+  PacketMetadata packet;
+  uint32_t hash;
+};
+
+//
+// The Toeplitz hash input of a packet: the source and destination IPv4
+// addresses and ports, in network order. Fields that are not hashed are 0,
+// which is the same as leaving them out, since a 0 bit adds nothing to the
+// hash.
+//
+inline void RssHashInput(const PacketMetadata &m, const RssConfig &config,
+                         uint8_t (&in)[12]) {
+  const bool addresses = m.ipv4;
+  const bool ports =
+      m.l4 && !m.ip_fragment &&
+      ((m.ip_protocol == kIpProtocolTcp && config.hash_tcp_ports) ||
+       (m.ip_protocol == kIpProtocolUdp && config.hash_udp_ports));
+  UnrolledLoop<4>([&](auto i) {
+    in[i] = addresses ? uint8_t(m.src_ip >> (24 - 8 * i)) : 0;
+    in[4 + i] = addresses ? uint8_t(m.dst_ip >> (24 - 8 * i)) : 0;
+  });
+  UnrolledLoop<2>([&](auto i) {
+    in[8 + i] = ports ? uint8_t(m.src_port >> (8 - 8 * i)) : 0;
+    in[10 + i] = ports ? uint8_t(m.dst_port >> (8 - 8 * i)) : 0;
+  });
+}
+
+//
+// The 32-bit window of the key that each bit of the hash input selects:
+// window 'i' is bits i to i + 31 of the key.
+//
+template <int bits>
+void ToeplitzKeyWindows(const uint8_t (&key)[kRssKeyBytes],
+                        uint32_t (&windows)[bits]) {
+  static_assert(bits + 32 <= 8 * kRssKeyBytes);
+  for (int i = 0; i < bits; i++) {
+    const int byte = i / 8;
+    uint64_t v = 0;
+    for (int j = 0; j < 5; j++) {
+      v = (v << 8) | (byte + j < kRssKeyBytes ? key[byte + j] : 0);
+    }
+    windows[i] = uint32_t(v >> (8 - i % 8));
+  }
+}
+
+//
+// The Toeplitz hash of 'in': the XOR of the key windows of its set bits.
+// This is a single level of AND gates and an XOR tree, so a hash is
+// computed every cycle.
+//
+template <int bytes>
+uint32_t ToeplitzHash(const uint8_t (&in)[bytes],
+                      const uint32_t (&windows)[8 * bytes]) {
+  uint32_t hash = 0;
+  UnrolledLoop<8 * bytes>([&](auto i) {
+    if ((in[i / 8] >> (7 - i % 8)) & 1) hash ^= windows[i];
+  });
+  return hash;
+}
+
+//
+// Reads packets, as the metadata and payload beats written by
+// PacketParser, and sends each one to output 'indirection[hash % 128]' of
+// the 'lanes' outputs of MetadataOutPipes and PayloadOutPipes, which are
+// PipeArrays. The metadata goes out as RssMetadata, with the hash.
+//
+// The indirection table starts out round robin over the outputs. The host
+// changes it through CommandChannel, a side channel of RssCommand: every
+// kRssSetEntry is acknowledged by writing the index of the entry to
+// AckChannel, so the host knows which packets see the new entry. Packets
+// of a flow that are in different outputs before and after an update can
+// be processed out of order, as with a NIC. kRssStop ends the kernel.
+//
+// EXAMPLE USAGE
+//    using MetadataPipes = PipeArray<MyMetadataPipesID, RssMetadata, 16, 4>;
+//    using PayloadPipes = PipeArray<MyPayloadPipesID, PacketBeat<8>, 64, 4>;
+//    q.single_task<MyRssKernel>([=] {
+//      fpga_tools::RssDistributor<4, MetadataInPipe, PayloadInPipe,
+//                                 MetadataPipes, PayloadPipes,
+//                                 CommandChannel, AckChannel>(config);
+//    });
+//
+template <int lanes, typename MetadataInPipe, typename PayloadInPipe,
+          typename MetadataOutPipes, typename PayloadOutPipes,
+          typename CommandChannel, typename AckChannel>
+void RssDistributor(RssConfig config) {
+  static_assert(lanes > 0 && lanes <= 256);
+  constexpr int kHashInputBytes = 12;
+
+  uint32_t windows[8 * kHashInputBytes];
+  ToeplitzKeyWindows(config.key, windows);
+
+  uint8_t table[kRssIndirectionTableSize];
+  for (int i = 0; i < kRssIndirectionTableSize; i++) {
+    table[i] = i % lanes;
+  }
+
+  bool in_packet = false;
+  int lane = 0;
+  bool stop = false;
+
+  while (!stop) {
+    // the metadata of a new packet: hash it and pick its output
+    if (!in_packet) {
+      bool valid;
+      PacketMetadata m = MetadataInPipe::read(valid);
+      if (valid) {
+        uint8_t in[kHashInputBytes];
+        RssHashInput(m, config, in);
+        RssMetadata out{m, ToeplitzHash(in, windows)};
+        lane = table[out.hash % kRssIndirectionTableSize];
+        UnrolledLoop<lanes>([&](auto l) {
+          if (lane == int(l)) {
+            MetadataOutPipes::template PipeAt<l>::write(out);
+          }
+        });
+        in_packet = true;
+      }
+    }
+
+    // a beat of the current packet, which can be its first
+    if (in_packet) {
+      bool valid;
+      auto beat = PayloadInPipe::read(valid);
+      if (valid) {
+        UnrolledLoop<lanes>([&](auto l) {
+          if (lane == int(l)) PayloadOutPipes::template PipeAt<l>::write(beat);
+        });
+        in_packet = !beat.eop;
+      }
+    }
+
+    // a command from the host
+    bool valid_command;
+    RssCommand command = CommandChannel::read(valid_command);
+    if (valid_command) {
+      if (command.op == kRssSetEntry) {
+        if (command.queue < lanes) {
+          table[command.index % kRssIndirectionTableSize] = command.queue;
+        }
+        AckChannel::write(command.index);
+      } else if (command.op == kRssStop) {
+        stop = true;
+      }
+    }
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __RSS_DISTRIBUTOR_HPP__ */
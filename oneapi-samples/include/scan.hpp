@@ -0,0 +1,172 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __SCAN_HPP__
+#define __SCAN_HPP__
+
+#include <cstddef>
+#include <type_traits>
+
+#include "constexpr_math.hpp"
+#include "data_bundle.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// Multi-lane prefix sums (scans).
+//
+// The scans in this file are generic over an associative binary operator
+// 'op' with identity 'identity' (for example std::plus<T>() and 0, or a max
+// and the smallest value of T). A beat of 'lanes' elements is scanned with
+// a log-depth (Hillis-Steele) network of CeilLog2(lanes) stages, and the
+// carry from the previous beats is folded in with one more stage, so a
+// stream is scanned at 'lanes' elements per cycle.
+//
+// The carry is the only loop-carried dependency: one application of 'op'.
+// For integer operators this keeps the streaming loops at II=1. Operators
+// with a long latency, such as a floating point add, will raise the II.
+//
+namespace fpga_tools {
+
+//
+// A beat for the segmented scans: 'data' holds the elements and 'head'
+// marks the elements that start a new segment.
+//
+template <typename T, int lanes>
+struct SegmentedScanBeat {
+  static constexpr int size = lanes;
+  DataBundle<T, lanes> data;
+  DataBundle<bool, lanes> head;
+};
+
+//
+// Inclusive scan of the elements of 'beat', in place.
+//
+template <typename T, int lanes, typename BinaryOp>
+void InclusiveScanBeat(DataBundle<T, lanes> &beat, BinaryOp op) {
+  constexpr int kStages = CeilLog2(lanes);
+  UnrolledLoop<kStages>([&](auto s) {
+    constexpr int kDist = 1 << s;
+    DataBundle<T, lanes> next;
+    UnrolledLoop<lanes>([&](auto i) {
+      if constexpr (int(i) >= kDist) {
+        next[i] = op(beat[i - kDist], beat[i]);
+      } else {
+        next[i] = beat[i];
+      }
+    });
+    beat = next;
+  });
+}
+
+//
+// Segmented inclusive scan of the elements of 'beat', in place. The scan
+// restarts at every element whose 'head' flag is set. On return, head[i]
+// is set if any of head[0..i] was set, that is, if element i does not
+// depend on the elements before the beat.
+//
+template <typename T, int lanes, typename BinaryOp>
+void SegmentedInclusiveScanBeat(DataBundle<T, lanes> &beat,
+                                DataBundle<bool, lanes> &head, BinaryOp op) {
+  constexpr int kStages = CeilLog2(lanes);
+  UnrolledLoop<kStages>([&](auto s) {
+    constexpr int kDist = 1 << s;
+    DataBundle<T, lanes> next;
+    DataBundle<bool, lanes> next_head;
+    UnrolledLoop<lanes>([&](auto i) {
+      if constexpr (int(i) >= kDist) {
+        next[i] = head[i] ? beat[i] : op(beat[i - kDist], beat[i]);
+        next_head[i] = head[i] || head[i - kDist];
+      } else {
+        next[i] = beat[i];
+        next_head[i] = head[i];
+      }
+    });
+    beat = next;
+    head = next_head;
+  });
+}
+
+//
+// Reads 'beats' beats of DataBundle<T, lanes> from InPipe and writes their
+// scan to OutPipe. With 'exclusive' set, element i of the output excludes
+// element i of the input and the first output element is 'identity'.
+//
+// EXAMPLE USAGE
+//    q.single_task<MyScanKernel>([=] {
+//      fpga_tools::StreamingScan<InPipe, OutPipe, false>(
+//          beats, 0, std::plus<int>());
+//    });
+//
+template <typename InPipe, typename OutPipe, bool exclusive, typename T,
+          typename BinaryOp>
+void StreamingScan(size_t beats, T identity, BinaryOp op) {
+  using BeatT = decltype(InPipe::read());
+  constexpr int kLanes = BeatT::size;
+  static_assert(std::is_same_v<BeatT, DataBundle<T, kLanes>>);
+
+  T carry = identity;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    BeatT beat = InPipe::read();
+    InclusiveScanBeat(beat, op);
+
+    BeatT out;
+    if constexpr (exclusive) {
+      out[0] = carry;
+      UnrolledLoop<1, kLanes>(
+          [&](auto i) { out[i] = op(carry, beat[i - 1]); });
+    } else {
+      UnrolledLoop<kLanes>([&](auto i) { out[i] = op(carry, beat[i]); });
+    }
+    carry = op(carry, beat[kLanes - 1]);
+
+    OutPipe::write(out);
+  }
+}
+
+//
+// Reads 'beats' SegmentedScanBeat<T, lanes> beats from InPipe and writes
+// the scan of each segment to OutPipe, as DataBundle<T, lanes>. Segments
+// may span beats. With 'exclusive' set, the first element of each segment
+// is 'identity'.
+//
+template <typename InPipe, typename OutPipe, bool exclusive, typename T,
+          typename BinaryOp>
+void StreamingSegmentedScan(size_t beats, T identity, BinaryOp op) {
+  using BeatT = decltype(InPipe::read());
+  constexpr int kLanes = BeatT::size;
+  static_assert(std::is_same_v<BeatT, SegmentedScanBeat<T, kLanes>>);
+  using OutT = DataBundle<T, kLanes>;
+
+  T carry = identity;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    BeatT beat = InPipe::read();
+    DataBundle<bool, kLanes> head = beat.head;
+    DataBundle<bool, kLanes> covered = beat.head;
+    SegmentedInclusiveScanBeat(beat.data, covered, op);
+
+    // fold in the carry for the elements still in the previous segment
+    OutT inclusive;
+    UnrolledLoop<kLanes>([&](auto i) {
+      inclusive[i] = covered[i] ? beat.data[i] : op(carry, beat.data[i]);
+    });
+
+    OutT out;
+    if constexpr (exclusive) {
+      out[0] = head[0] ? identity : carry;
+      UnrolledLoop<1, kLanes>(
+          [&](auto i) { out[i] = head[i] ? identity : inclusive[i - 1]; });
+    } else {
+      out = inclusive;
+    }
+    carry = inclusive[kLanes - 1];
+
+    OutPipe::write(out);
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __SCAN_HPP__ */
@@ -0,0 +1,100 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __STREAM_COMPACTION_HPP__
+#define __STREAM_COMPACTION_HPP__
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+#include "data_bundle.hpp"
+#include "scan.hpp"
+#include "unrolled_loop.hpp"
+
+namespace fpga_tools {
+
+//
+// Reads 'beats' beats of DataBundle<T, lanes> from InPipe, keeps the
+// elements for which 'pred' returns true and writes them, in order, to
+// OutPipe as dense beats of the same type. Every beat written is full
+// except the last one, which holds the remaining survivors followed by
+// unspecified values and is only written if there is at least one.
+// Returns the number of elements kept, which tells the consumer how many
+// elements of the last beat are valid.
+//
+// The output slot of each survivor is the exclusive prefix count of the
+// survivors before it in the beat (a multi-lane scan, see scan.hpp) plus
+// the number of survivors already waiting to be written. The survivors are
+// routed to their slots through a crossbar into a buffer of 2 * lanes
+// elements, and whenever the buffer holds a full beat it is written out
+// and the rest is shifted down. This keeps the output pipe at full width
+// however selective the predicate is, so the kernels downstream of a
+// filter that passes a few percent of the rows see dense beats.
+//
+// EXAMPLE USAGE
+//    q.single_task<MyFilterKernel>([=] {
+//      *kept = fpga_tools::StreamCompaction<InPipe, OutPipe>(
+//          beats, [](int x) { return x < 100; });
+//    });
+//
+template <typename InPipe, typename OutPipe, typename Predicate>
+size_t StreamCompaction(size_t beats, Predicate pred) {
+  using BeatT = decltype(InPipe::read());
+  constexpr int kLanes = BeatT::size;
+  using T = typename BeatT::ValType;
+  static_assert(std::is_same_v<BeatT, DataBundle<T, kLanes>>);
+
+  // survivors waiting to be written: buffer[0, fill)
+  T buffer[2 * kLanes];
+  int fill = 0;
+  size_t kept = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (size_t b = 0; b < beats; b++) {
+    BeatT beat = InPipe::read();
+
+    // the inclusive count of the survivors in each lane
+    DataBundle<bool, kLanes> keep;
+    DataBundle<int, kLanes> position;
+    UnrolledLoop<kLanes>([&](auto i) {
+      keep[i] = pred(beat[i]);
+      position[i] = keep[i] ? 1 : 0;
+    });
+    InclusiveScanBeat(position, std::plus<int>());
+
+    // route the survivors to their slots in the buffer
+    UnrolledLoop<2 * kLanes>([&](auto j) {
+      UnrolledLoop<kLanes>([&](auto i) {
+        if (keep[i] && fill + position[i] - 1 == (int)j) {
+          buffer[j] = beat[i];
+        }
+      });
+    });
+    fill += position[kLanes - 1];
+    kept += position[kLanes - 1];
+
+    // write out a full beat
+    if (fill >= kLanes) {
+      BeatT out;
+      UnrolledLoop<kLanes>([&](auto j) {
+        out[j] = buffer[j];
+        buffer[j] = buffer[j + kLanes];
+      });
+      OutPipe::write(out);
+      fill -= kLanes;
+    }
+  }
+
+  // flush the last, partial, beat
+  if (fill > 0) {
+    BeatT out;
+    UnrolledLoop<kLanes>([&](auto j) { out[j] = buffer[j]; });
+    OutPipe::write(out);
+  }
+
+  return kept;
+}
+
+}  // namespace fpga_tools
+
+#endif /* __STREAM_COMPACTION_HPP__ */
@@ -0,0 +1,309 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __STREAMING_FFT_HPP__
+#define __STREAMING_FFT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <sycl/ext/intel/ac_types/ac_fixed.hpp>
+
+#include "constexpr_math.hpp"
+#include "data_bundle.hpp"
+#include "rom_base.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// A streaming FFT of 'size' complex samples that takes and produces
+// 'lanes' samples per cycle, in natural order.
+//
+// The frame is viewed as R = size / lanes rows of 'lanes' samples, one row
+// per beat, and transformed in four steps:
+//    1. an R-point FFT down each lane, over time, with a radix-2 single
+//       path delay feedback (SDF) pipeline per lane. Its output is in bit
+//       reversed order.
+//    2. a multiplication by the twiddle factors between the two FFTs
+//    3. a 'lanes'-point FFT across each beat, which is only wiring and
+//       butterflies. Its trivial twiddles (1 and -i) are not multiplied,
+//       so with 4 lanes this step is a radix-4 butterfly.
+//    4. a reorder buffer, which undoes the bit reversal and the transpose of
+//       the four step decomposition. It is double buffered, so one frame is
+//       written while the previous one is read out. Its banks are skewed so
+//       that the beat written and the beat read each hit every bank once.
+//
+// All twiddle factors are computed at compile time with the Sin and Cos of
+// constexpr_math.hpp and stored in ROMs. 'T' is float, double or a signed
+// ac_fixed. The transform is not scaled, so an ac_fixed needs log2(size)
+// bits of integer headroom above the input samples.
+//
+namespace fpga_tools {
+
+template <typename T>
+struct FftComplex {
+  T re;
+  T im;
+
+  constexpr FftComplex() : re(0), im(0) {}
+  constexpr FftComplex(T r, T i) : re(r), im(i) {}
+
+  FftComplex operator+(const FftComplex &o) const {
+    return FftComplex(re + o.re, im + o.im);
+  }
+  FftComplex operator-(const FftComplex &o) const {
+    return FftComplex(re - o.re, im - o.im);
+  }
+  FftComplex operator*(const FftComplex &o) const {
+    return FftComplex(re * o.re - im * o.im, re * o.im + im * o.re);
+  }
+};
+
+//
+// How the twiddle factors of an FFT on 'T' are stored in the ROMs. They are
+// built in constant expressions, which the ac_fixed constructors can't be
+// used in, so an ac_fixed twiddle factor is stored as its raw bits and
+// turned back into an ac_fixed, which costs no logic, where it is used.
+//
+template <typename T>
+struct FftTwiddleStorage {
+  using Type = T;
+  static constexpr Type FromDouble(double x) { return T(x); }
+  static T ToValue(Type x) { return x; }
+};
+
+template <int W, int I, bool S, ac_q_mode Q, ac_o_mode O>
+struct FftTwiddleStorage<ac_fixed<W, I, S, Q, O>> {
+  static_assert(S, "the twiddle factors need a signed ac_fixed");
+  static_assert(W <= 64 && W - I >= 0 && W - I < 63);
+  using Type = std::conditional_t<(W <= 32), int32_t, int64_t>;
+
+  // rounded to the nearest value, and saturated, since 1 is out of range
+  // when I is 1
+  static constexpr Type FromDouble(double x) {
+    const double scaled = x * double(int64_t(1) << (W - I));
+    const double max = double((int64_t(1) << (W - 1)) - 1);
+    const double rounded = scaled < 0 ? scaled - 0.5 : scaled + 0.5;
+    return Type(rounded > max ? max : (rounded < -max - 1 ? -max - 1
+                                                          : rounded));
+  }
+  static ac_fixed<W, I, S, Q, O> ToValue(Type x) {
+    ac_fixed<W, I, S, Q, O> value;
+    value.set_slc(0, ac_int<W, true>(x));
+    return value;
+  }
+};
+
+template <typename T>
+using FftTwiddleComplex = FftComplex<typename FftTwiddleStorage<T>::Type>;
+
+// e^(-2 * pi * i * k / n), as stored in a ROM
+template <typename T>
+constexpr FftTwiddleComplex<T> FftTwiddle(int k, int n) {
+  using Storage = FftTwiddleStorage<T>;
+  return FftTwiddleComplex<T>(Storage::FromDouble(Cos(2 * kPi * k / n)),
+                              Storage::FromDouble(-Sin(2 * kPi * k / n)));
+}
+
+// a twiddle factor from a ROM, as a complex 'T'
+template <typename T>
+FftComplex<T> FftTwiddleValue(const FftTwiddleComplex<T> &w) {
+  using Storage = FftTwiddleStorage<T>;
+  return FftComplex<T>(Storage::ToValue(w.re), Storage::ToValue(w.im));
+}
+
+// reverses the low 'bits' bits of 'x'
+constexpr int BitReverse(int x, int bits) {
+  int ret = 0;
+  for (int i = 0; i < bits; i++) {
+    ret = (ret << 1) | ((x >> i) & 1);
+  }
+  return ret;
+}
+
+namespace detail {
+
+// the twiddle factors of an SDF stage with a delay of 'delay' samples
+template <typename T, int delay>
+struct FftSdfTwiddles : ROMBase<FftTwiddleComplex<T>, delay> {
+  constexpr FftSdfTwiddles()
+      : ROMBase<FftTwiddleComplex<T>, delay>(
+            [](int j) { return FftTwiddle<T>(j, 2 * delay); }) {}
+};
+
+// the twiddle factors between the two FFTs for lane 'lane', indexed by the
+// bit reversed position of the row
+template <typename T, int size, int rows, int lane>
+struct FftLaneTwiddles : ROMBase<FftTwiddleComplex<T>, rows> {
+  constexpr FftLaneTwiddles()
+      : ROMBase<FftTwiddleComplex<T>, rows>([](int p) {
+          return FftTwiddle<T>(lane * BitReverse(p, Log2(rows)), size);
+        }) {}
+};
+
+//
+// The SDF stages with delays delay, delay / 2, ... 1. Each stage computes
+// the butterflies of a decimation in frequency FFT between samples that
+// are 'delay' apart: during the first 'delay' cycles of every 2 * 'delay'
+// the input is stored in the delay line and the differences of the
+// previous butterflies come out of it; during the second half the sums go
+// on to the next stage and the differences go into the delay line.
+//
+template <typename T, int lanes, int delay>
+struct FftSdfStages {
+  FftComplex<T> fifo[lanes][delay];
+  FftSdfStages<T, lanes, delay / 2> next;
+
+  void Process(FftComplex<T> (&x)[lanes], size_t t) {
+    constexpr FftSdfTwiddles<T, delay> twiddles;
+    const int j = t % delay;
+    const bool butterfly = (t / delay) % 2 == 1;
+
+    UnrolledLoop<lanes>([&](auto l) {
+      FftComplex<T> delayed = fifo[l][j];
+      if (butterfly) {
+        fifo[l][j] = (delayed - x[l]) * FftTwiddleValue<T>(twiddles[j]);
+        x[l] = delayed + x[l];
+      } else {
+        fifo[l][j] = x[l];
+        x[l] = delayed;
+      }
+    });
+
+    next.Process(x, t);
+  }
+};
+
+template <typename T, int lanes>
+struct FftSdfStages<T, lanes, 0> {
+  void Process(FftComplex<T> (&)[lanes], size_t) {}
+};
+
+// an unrolled radix-2 decimation in time FFT across the lanes
+template <typename T, int lanes>
+void FftAcrossLanes(FftComplex<T> (&x)[lanes]) {
+  constexpr int kBits = Log2(lanes);
+  FftComplex<T> a[lanes];
+  UnrolledLoop<lanes>([&](auto l) { a[l] = x[BitReverse(l, kBits)]; });
+
+  UnrolledLoop<kBits>([&](auto s) {
+    constexpr int kSpan = 2 << s;
+    constexpr int kHalf = kSpan / 2;
+    UnrolledLoop<lanes / 2>([&](auto b) {
+      constexpr int kTop = (b / kHalf) * kSpan + b % kHalf;
+      constexpr int kBottom = kTop + kHalf;
+      constexpr int kJ = b % kHalf;
+
+      FftComplex<T> v = a[kBottom];
+      if constexpr (kJ == 0) {
+        // multiply by 1
+      } else if constexpr (4 * kJ == kSpan) {
+        // multiply by -i
+        v = FftComplex<T>(v.im, T(0) - v.re);
+      } else {
+        constexpr FftTwiddleComplex<T> kW = FftTwiddle<T>(kJ, kSpan);
+        v = v * FftTwiddleValue<T>(kW);
+      }
+      FftComplex<T> u = a[kTop];
+      a[kTop] = u + v;
+      a[kBottom] = u - v;
+    });
+  });
+
+  UnrolledLoop<lanes>([&](auto l) { x[l] = a[l]; });
+}
+
+}  // namespace detail
+
+//
+// Reads 'frames' frames of 'size' samples from InPipe, as beats of
+// DataBundle<FftComplex<T>, lanes>, and writes their FFTs to OutPipe in the
+// same format. 'size' and 'lanes' must be powers of 2 with
+// size >= lanes * lanes.
+//
+// The latency is about two frames: the pipeline is flushed with zeros
+// after the last frame, so the loop runs for frames + 2 frame times.
+//
+// EXAMPLE USAGE
+//    using Beat = DataBundle<FftComplex<float>, 4>;
+//    q.single_task<MyFftKernel>([=] {
+//      fpga_tools::StreamingFFT<InPipe, OutPipe, 1024>(frames);
+//    });
+//
+template <typename InPipe, typename OutPipe, int size>
+void StreamingFFT(size_t frames) {
+  using BeatT = decltype(InPipe::read());
+  using ComplexT = typename BeatT::ValType;
+  using T = decltype(ComplexT::re);
+  constexpr int kLanes = BeatT::size;
+  constexpr int kRows = size / kLanes;
+  constexpr int kRowBits = Log2(kRows);
+  static_assert(std::is_same_v<ComplexT, FftComplex<T>>);
+  static_assert(IsPow2(size) && IsPow2(kLanes));
+  static_assert(kRows >= kLanes);
+
+  detail::FftSdfStages<T, kLanes, kRows / 2> sdf;
+
+  // the reorder buffer: bank b holds, for each row position k1, the output
+  // sample k1 + kRows * k2 with (k1 + k2) % kLanes == b
+  ComplexT reorder[kLanes][2 * kRows];
+
+  const size_t in_beats = frames * kRows;
+  const size_t total = in_beats + 2 * kRows - 1;
+
+  for (size_t t = 0; t < total; t++) {
+    ComplexT x[kLanes];
+    if (t < in_beats) {
+      BeatT beat = InPipe::read();
+      UnrolledLoop<kLanes>([&](auto l) { x[l] = beat[l]; });
+    } else {
+      UnrolledLoop<kLanes>([&](auto l) { x[l] = ComplexT(); });
+    }
+
+    // step 1: the FFTs down the lanes, with a latency of kRows - 1
+    sdf.Process(x, t);
+
+    // steps 2 and 3, then write the row to the reorder buffer
+    if (t >= kRows - 1 && t < in_beats + kRows - 1) {
+      const size_t u = t - (kRows - 1);
+      const int p = u % kRows;
+      const int parity = (u / kRows) % 2;
+
+      UnrolledLoop<kLanes>([&](auto l) {
+        constexpr detail::FftLaneTwiddles<T, size, kRows, l> twiddles;
+        x[l] = x[l] * FftTwiddleValue<T>(twiddles[p]);
+      });
+      detail::FftAcrossLanes(x);
+
+      int k1 = 0;
+      UnrolledLoop<kRowBits>(
+          [&](auto i) { k1 |= ((p >> i) & 1) << (kRowBits - 1 - i); });
+      UnrolledLoop<kLanes>([&](auto b) {
+        reorder[b][parity * kRows + k1] = x[(b - k1) & (kLanes - 1)];
+      });
+    }
+
+    // step 4: read out the previous frame in natural order
+    if (t >= 2 * kRows - 1) {
+      const size_t u = t - (2 * kRows - 1);
+      const int r = u % kRows;
+      const int parity = (u / kRows) % 2;
+      const int k2 = (r * kLanes) / kRows;
+      const int base = r * kLanes - k2 * kRows;
+
+      ComplexT banks[kLanes];
+      UnrolledLoop<kLanes>([&](auto b) {
+        int j = (b - base - k2) & (kLanes - 1);
+        banks[b] = reorder[b][parity * kRows + base + j];
+      });
+      BeatT out;
+      UnrolledLoop<kLanes>([&](auto j) {
+        out[j] = banks[(base + j + k2) & (kLanes - 1)];
+      });
+      OutPipe::write(out);
+    }
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __STREAMING_FFT_HPP__ */
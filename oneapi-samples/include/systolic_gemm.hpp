@@ -0,0 +1,117 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __SYSTOLIC_GEMM_HPP__
+#define __SYSTOLIC_GEMM_HPP__
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "data_bundle.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// A systolic array that computes C = A * B one rows x cols tile at a time.
+//
+// TEMPLATE PARAMETERS
+//    TIn:    the type of the elements of A and B (float, ac_int, ac_fixed...)
+//    TAcc:   the type of the accumulators and of C, wide enough to hold a
+//            sum of k_depth products of TIn
+//    rows:   the number of rows of processing elements (PEs)
+//    cols:   the number of columns of PEs
+//    APipe:  the columns of the A tile, DataBundle<TIn, rows>
+//    BPipe:  the rows of the B tile, DataBundle<TIn, cols>
+//    CPipe:  the rows of the C tile, DataBundle<TAcc, cols>
+//
+// For each of 'num_tiles' tiles, 'k_depth' pairs of an A column and a B
+// row are read from the pipes. PE (i, j) multiplies element i of the A
+// column by element j of the B row and accumulates the product, so the
+// array does rows x cols multiply-accumulates per cycle. The A elements
+// travel along the rows of the array and the B elements down the columns,
+// one PE per cycle (fpga_reg), which keeps the fan-out of each value to a
+// single PE.
+//
+// When a tile is complete its accumulators are copied to a drain buffer
+// and written to CPipe, one row per cycle, while the next tile is being
+// computed. 'k_depth' must therefore be at least 'rows'.
+//
+// EXAMPLE USAGE
+//    q.single_task<MyGemmKernel>([=] {
+//      fpga_tools::SystolicGemm<float, float, 8, 8, APipe, BPipe, CPipe>(
+//          num_tiles, k_depth);
+//    });
+//
+namespace fpga_tools {
+
+template <typename TIn, typename TAcc, int rows, int cols, typename APipe,
+          typename BPipe, typename CPipe>
+void SystolicGemm(int num_tiles, int k_depth) {
+  using ABundle = DataBundle<TIn, rows>;
+  using BBundle = DataBundle<TIn, cols>;
+  using CBundle = DataBundle<TAcc, cols>;
+
+  TAcc acc[rows][cols];
+  TAcc drain[rows][cols];
+  int drain_rows = 0;
+
+  const int iterations = num_tiles * k_depth + rows;
+  int k = 0;
+  int tile = 0;
+
+  [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+  for (int it = 0; it < iterations; it++) {
+    // drain one row of the previous tile
+    if (drain_rows > 0) {
+      CBundle c;
+      UnrolledLoop<cols>([&](auto j) { c[j] = drain[0][j]; });
+      CPipe::write(c);
+
+      UnrolledLoop<rows - 1>([&](auto i) {
+        UnrolledLoop<cols>([&](auto j) { drain[i][j] = drain[i + 1][j]; });
+      });
+      drain_rows--;
+    }
+
+    // compute
+    if (tile < num_tiles) {
+      ABundle a = APipe::read();
+      BBundle b = BPipe::read();
+
+      // the operands entering each PE
+      TIn a_in[rows][cols];
+      TIn b_in[rows][cols];
+      UnrolledLoop<rows>([&](auto i) {
+        UnrolledLoop<cols>([&](auto j) {
+          if constexpr (j == 0) {
+            a_in[i][j] = a[i];
+          } else {
+            a_in[i][j] = sycl::ext::intel::fpga_reg(a_in[i][j - 1]);
+          }
+          if constexpr (i == 0) {
+            b_in[i][j] = b[j];
+          } else {
+            b_in[i][j] = sycl::ext::intel::fpga_reg(b_in[i - 1][j]);
+          }
+
+          TAcc prod = TAcc(a_in[i][j]) * TAcc(b_in[i][j]);
+          acc[i][j] = (k == 0) ? prod : TAcc(acc[i][j] + prod);
+        });
+      });
+
+      // the tile is complete: hand it to the drain buffer
+      if (k == k_depth - 1) {
+        UnrolledLoop<rows>([&](auto i) {
+          UnrolledLoop<cols>([&](auto j) { drain[i][j] = acc[i][j]; });
+        });
+        drain_rows = rows;
+        k = 0;
+        tile++;
+      } else {
+        k++;
+      }
+    }
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __SYSTOLIC_GEMM_HPP__ */
@@ -0,0 +1,229 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+#ifndef __TRAFFIC_SHAPER_HPP__
+#define __TRAFFIC_SHAPER_HPP__
+
+#include <cstdint>
+
+#include "onchip_memory_with_cache.hpp"
+#include "unrolled_loop.hpp"
+
+//
+// A token bucket shaper and policer for a stream of packets, as metadata
+// and payload beats (see packet_parser.hpp).
+//
+// Every packet belongs to a traffic class, and every class has a token
+// bucket that fills at the rate of the class, up to its burst size. A
+// packet conforms if the bucket of its class is not in debt when the packet
+// starts, and its length is taken from the bucket when it ends. Checking
+// for debt rather than for the full length lets a packet go out before its
+// length is known, so a class can exceed its burst size by at most one
+// packet. Non-conforming packets are dropped (policing) or held until the
+// bucket pays off its debt (shaping).
+//
+namespace fpga_tools {
+
+// what a class does with non-conforming packets
+constexpr uint8_t kShaperUnlimited = 0;  // every packet conforms
+constexpr uint8_t kShaperPolice = 1;     // drop them
+constexpr uint8_t kShaperShape = 2;      // delay them
+
+// the number of fraction bits of rates and tokens
+constexpr int kShaperTokenFractionBits = 16;
+
+struct ShaperClassConfig {
+  uint8_t action;
+  uint32_t rate;   // bytes per cycle, with kShaperTokenFractionBits fraction
+                   // bits, which must not be 0 for a shaped class
+  uint32_t burst;  // the size of the bucket, in bytes
+};
+
+// the number of packets of a class that conformed, were dropped, and were
+// delayed
+struct ShaperCounters {
+  uint64_t conforming;
+  uint64_t dropped;
+  uint64_t delayed;
+};
+
+// the commands the host sends to the shaper
+constexpr uint8_t kShaperConfigure = 0;
+constexpr uint8_t kShaperReadCounters = 1;
+constexpr uint8_t kShaperStop = 2;
+
+struct ShaperCommand {
+  uint8_t op;
+  uint8_t traffic_class;     // kShaperConfigure: the class to configure
+  ShaperClassConfig config;  // kShaperConfigure: its new configuration
+};
+
+namespace detail {
+
+struct ShaperBucket {
+  int64_t tokens;  // with kShaperTokenFractionBits fraction bits
+  uint64_t last;   // the cycle 'tokens' was last brought up to date
+};
+
+// bring the tokens of a bucket up to date at cycle 'now', saturating at the
+// burst size
+inline int64_t ShaperRefill(const ShaperBucket &bucket,
+                            const ShaperClassConfig &config, uint64_t now) {
+  const int64_t full = int64_t(config.burst) << kShaperTokenFractionBits;
+  const uint64_t elapsed = now - bucket.last;
+  const uint64_t room = full - bucket.tokens;
+  if ((elapsed >> 32) != 0) return full;
+  const uint64_t added = uint64_t(config.rate) * elapsed;
+  return added >= room ? full : bucket.tokens + int64_t(added);
+}
+
+}  // namespace detail
+
+//
+// Reads packets from MetadataInPipe and PayloadInPipe, and writes the ones
+// that are not dropped to MetadataOutPipe and PayloadOutPipe, in order.
+// 'class_of' maps the metadata of a packet to its class, which must be less
+// than 'classes'.
+//
+// The loop runs every cycle whether or not there is a packet to read, so
+// its iteration count is a cycle counter, and the buckets are refilled to
+// the exact cycle a packet arrives. A delayed packet holds back the packets
+// behind it, like the single queue of an egress port.
+//
+// Every class starts out unlimited. The host sends ShaperCommands through
+// CommandChannel:
+//    kShaperConfigure:    set the configuration of a class, and fill its
+//                         bucket
+//    kShaperReadCounters: copy the counters of every class to 'counters'
+//                         and write the cycle counter to AckChannel. The
+//                         commands are handled in order, so this also tells
+//                         the host that the commands before it are done.
+//    kShaperStop:         exit
+//
+// EXAMPLE USAGE
+//    q.single_task<MyShaperKernel>([=] {
+//      auto class_of = [](const PacketMetadata &m) { return m.dscp_ecn >> 5; };
+//      fpga_tools::TrafficShaper<8, MetadataIn, PayloadIn, MetadataOut,
+//                                PayloadOut, CommandChannel, AckChannel>(
+//          counters, class_of);
+//    });
+//
+template <int classes, typename MetadataInPipe, typename PayloadInPipe,
+          typename MetadataOutPipe, typename PayloadOutPipe,
+          typename CommandChannel, typename AckChannel, typename ClassFn>
+void TrafficShaper(ShaperCounters *counters, ClassFn class_of) {
+  static_assert(classes >= 2);
+  using MetadataT = decltype(MetadataInPipe::read());
+  using BeatT = decltype(PayloadInPipe::read());
+  constexpr int kCacheDepth = 4;
+
+  ShaperClassConfig config[classes];
+  ShaperCounters count[classes];
+  for (int c = 0; c < classes; c++) {
+    config[c] = {kShaperUnlimited, 0, 0};
+    count[c] = {0, 0, 0};
+  }
+  OnchipMemoryWithCache<detail::ShaperBucket, classes, kCacheDepth> buckets(
+      detail::ShaperBucket{0, 0});
+
+  uint64_t now = 0;
+  bool stop = false;
+
+  // the packet in flight
+  bool in_packet = false;
+  bool waiting = false;
+  bool forward = false;
+  int cls = 0;
+  int64_t tokens = 0;
+  uint64_t tokens_time = 0;
+  uint32_t bytes = 0;
+  MetadataT held;
+
+  while (!stop) {
+    bool bucket_written = false;
+
+    if (!in_packet && !waiting) {
+      // a new packet: check its class's bucket
+      bool valid;
+      MetadataT m = MetadataInPipe::read(valid);
+      if (valid) {
+        cls = class_of(m);
+        const ShaperClassConfig c = config[cls];
+        tokens = detail::ShaperRefill(buckets.read(cls), c, now);
+        tokens_time = now;
+        bytes = 0;
+
+        if (c.action == kShaperUnlimited || tokens >= 0) {
+          count[cls].conforming++;
+          MetadataOutPipe::write(m);
+          forward = true;
+          in_packet = true;
+        } else if (c.action == kShaperPolice) {
+          count[cls].dropped++;
+          forward = false;
+          in_packet = true;
+        } else {
+          count[cls].delayed++;
+          held = m;
+          waiting = true;
+        }
+      }
+    } else if (waiting) {
+      // a delayed packet: one more cycle of tokens
+      tokens += config[cls].rate;
+      if (tokens >= 0) {
+        tokens_time = now;
+        MetadataOutPipe::write(held);
+        forward = true;
+        in_packet = true;
+        waiting = false;
+      }
+    }
+
+    if (in_packet) {
+      bool valid;
+      BeatT beat = PayloadInPipe::read(valid);
+      if (valid) {
+        if (forward) PayloadOutPipe::write(beat);
+        bytes += BeatT::bytes - (beat.eop ? beat.empty : 0);
+        if (beat.eop) {
+          // charge the bucket for the packet
+          if (forward && config[cls].action != kShaperUnlimited) {
+            buckets.write(
+                cls, {tokens - (int64_t(bytes) << kShaperTokenFractionBits),
+                      tokens_time});
+            bucket_written = true;
+          }
+          in_packet = false;
+        }
+      }
+    }
+
+    // a command from the host, on a cycle the buckets are not written
+    if (!bucket_written) {
+      bool valid_command;
+      ShaperCommand command = CommandChannel::read(valid_command);
+      if (valid_command) {
+        if (command.op == kShaperConfigure) {
+          const int c = command.traffic_class;
+          config[c] = command.config;
+          buckets.write(c, {int64_t(command.config.burst)
+                                << kShaperTokenFractionBits,
+                            now});
+        } else if (command.op == kShaperReadCounters) {
+          for (int c = 0; c < classes; c++) {
+            counters[c] = count[c];
+          }
+          AckChannel::write(now);
+        } else if (command.op == kShaperStop) {
+          stop = true;
+        }
+      }
+    }
+
+    now++;
+  }
+}
+
+}  // namespace fpga_tools
+
+#endif /* __TRAFFIC_SHAPER_HPP__ */
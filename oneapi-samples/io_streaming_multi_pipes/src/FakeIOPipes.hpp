@@ -5,12 +5,15 @@
 #define __FAKEIOPIPES_HPP__
 
 #include <iostream>
+#include <optional>
 #include <type_traits>
 #include <utility>
 
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
+#include "UsmPool.hpp"
+
 // the "detail" namespace is commonly used in C++ as an internal namespace
 // (to a file) that is not meant to be visible to the public and should be
 // ignored by external users. That is to say, you should never have the line:
@@ -30,6 +33,12 @@ class ProducerConsumerBaseImpl {
   static inline size_t count_{};
   static inline bool initialized_{false};
 
+  // the dedicated in-order queue and the executable kernel that Launch()
+  // uses, set up by PrepareLaunch()
+  static inline std::optional<queue> launch_q_{};
+  static inline std::optional<kernel_bundle<bundle_state::executable>>
+      launch_bundle_{};
+
   // use some fancy C++ metaprogramming to get the correct pointer type
   // based on the template variable
   typedef
@@ -50,6 +59,19 @@ class ProducerConsumerBaseImpl {
     }
   }
 
+  static void launch_check(size_t count) {
+    initialized_check();
+    if (!launch_q_) {
+      std::cerr << "ERROR: PrepareLaunch() has not been called\n";
+      std::terminate();
+    }
+    if (count > count_) {
+      std::cerr << "ERROR: Launch() called with count=" << count
+                << " but allocated size is " << count_ << "\n";
+      std::terminate();
+    }
+  }
+
  public:
   // disable copy constructor and operator=
   ProducerConsumerBaseImpl(const ProducerConsumerBaseImpl &) = delete;
@@ -81,12 +103,14 @@ class ProducerConsumerBaseImpl {
       std::terminate();
     }
 
-    // Allocate the space the user requested. Calling a different malloc
-    // based on whether the user wants to use USM host allocations or not.
+    // Allocate the space the user requested from the queue's pool (see
+    // UsmPool.hpp), using a different arena based on whether the user wants
+    // to use USM host allocations or not.
+    UsmPool &pool = UsmPool::Get(q);
     if (use_host_alloc) {
-      host_data_ = malloc_host<T>(count_, q);
+      host_data_ = pool.Allocate<T>(UsmPool::kHostArena, count_);
     } else {
-      host_data_ = new T[count_];
+      host_data_ = pool.Allocate<T>(UsmPool::kSystemArena, count_);
     }
 
     if (host_data_ == nullptr) {
@@ -96,7 +120,7 @@ class ProducerConsumerBaseImpl {
 
     // if not using host allocations, allocate device memory
     if (!use_host_alloc) {
-      device_data_ = malloc_device<T>(count_, q);
+      device_data_ = pool.Allocate<T>(UsmPool::kDeviceArena, count_);
       if (device_data_ == nullptr) {
         std::cerr << "ERROR: failed to allocate space for"
                   << "device_data_\n";
@@ -107,19 +131,38 @@ class ProducerConsumerBaseImpl {
     initialized_ = true;
   }
 
+  //
+  // Set up the low latency launch path, Launch(), which the side channels
+  // use. Start() submits to the user's queue, which tracks the dependencies
+  // of every command group and can hold the launch behind other work, and
+  // looks up the kernel on every call. Launch() instead submits to a
+  // dedicated in-order queue on the same device, where each command simply
+  // follows the one before it, with the executable kernel looked up once
+  // here.
+  //
+  static void PrepareLaunch(queue &q) {
+    initialized_check();
+    launch_q_.emplace(q.get_context(), q.get_device(),
+                      property_list{property::queue::in_order()});
+    launch_bundle_.emplace(get_kernel_bundle<bundle_state::executable>(
+        q.get_context(), {q.get_device()}, {get_kernel_id<ID>()}));
+  }
+
   static void Destroy(queue &q) {
     initialized_check();
 
-    // free memory depending on 'use_host_alloc' flag
-    if (use_host_alloc) {
-      // free USM host allocation
-      sycl::free(host_data_, q);
-    } else {
-      // free C++ allocated memory
-      delete[] host_data_;
+    // let the launches finish before the memory goes away
+    if (launch_q_) {
+      launch_q_->wait();
+      launch_q_.reset();
+      launch_bundle_.reset();
+    }
 
-      // free USM device allocation
-      sycl::free(device_data_, q);
+    // return the memory to the pool, which keeps it for the next Init()
+    UsmPool &pool = UsmPool::Get(q);
+    pool.Free(host_data_);
+    if (!use_host_alloc) {
+      pool.Free(device_data_);
     }
 
     initialized_ = false;
@@ -180,14 +223,42 @@ class ProducerImpl : public ProducerConsumerBaseImpl<Id, T, use_host_alloc> {
                            BaseImpl::count_ * sizeof(T));
     }
 
+    // launch the kernel (use event.depends_on to wait on the memcpy)
+    auto kernel_event = SubmitKernel(q, count, dma_event, false);
+
+    return std::make_pair(dma_event, kernel_event);
+  }
+
+  // Start() on the low latency launch path (see PrepareLaunch()). Only the
+  // first 'count' elements are transferred to the device.
+  static std::pair<event, event> Launch(size_t count = BaseImpl::count_) {
+    BaseImpl::launch_check(count);
+    queue &q = *BaseImpl::launch_q_;
+
+    // the queue is in-order, so the kernel follows the memcpy without an
+    // explicit dependency
+    event dma_event;
+    if (!use_host_alloc) {
+      dma_event = q.memcpy(BaseImpl::device_data_, BaseImpl::host_data_,
+                           count * sizeof(T));
+    }
+    auto kernel_event = SubmitKernel(q, count, event{}, true);
+
+    return std::make_pair(dma_event, kernel_event);
+  }
+
+ private:
+  // submit the producing kernel to 'q', after 'dep'
+  static event SubmitKernel(queue &q, size_t count, event dep,
+                            bool use_launch_bundle) {
     // pick the right pointer to pass to the kernel
     auto kernel_ptr = BaseImpl::get_kernel_ptr();
 
-    // launch the kernel (use event.depends_on to wait on the memcpy)
-    auto kernel_event = q.submit([&](handler &h) {
+    return q.submit([&](handler &h) {
       // the kernel must wait until the DMA transfer is done before launching
       // this will only take affect it we actually performed the DMA above
-      h.depends_on(dma_event);
+      h.depends_on(dep);
+      if (use_launch_bundle) h.use_kernel_bundle(*BaseImpl::launch_bundle_);
 
       // the producing kernel
       // NO-FORMAT comments are for clang-format
@@ -200,8 +271,6 @@ class ProducerImpl : public ProducerConsumerBaseImpl<Id, T, use_host_alloc> {
         }
       });
     });
-
-    return std::make_pair(dma_event, kernel_event);
   }
 };
 ////////////////////////////////////////////////////////////////////////////////
@@ -242,21 +311,8 @@ class ConsumerImpl : public ProducerConsumerBaseImpl<Id, T, use_host_alloc> {
       std::terminate();
     }
 
-    // pick the right pointer to pass to the kernel
-    auto kernel_ptr = BaseImpl::get_kernel_ptr();
-
     // launch the kernel to read the output into device side global memory
-    auto kernel_event = q.submit([&](handler &h) {
-      // NO-FORMAT comments are for clang-format
-      h.single_task<Id>([=
-      ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
-        kernel_ptr_type ptr(kernel_ptr);
-        for (size_t i = 0; i < count; i++) {
-          auto d = Pipe::read();
-          *(ptr + i) = d;
-        }
-      });
-    });
+    auto kernel_event = SubmitKernel(q, count, false);
 
     // if the user wanted to use board memory, copy the data back to the host
     event dma_event;
@@ -272,6 +328,45 @@ class ConsumerImpl : public ProducerConsumerBaseImpl<Id, T, use_host_alloc> {
 
     return std::make_pair(dma_event, kernel_event);
   }
+
+  // Start() on the low latency launch path (see PrepareLaunch()). Only the
+  // first 'count' elements are transferred back to the host.
+  static std::pair<event, event> Launch(size_t count = BaseImpl::count_) {
+    BaseImpl::launch_check(count);
+    queue &q = *BaseImpl::launch_q_;
+
+    // the queue is in-order, so the memcpy follows the kernel without an
+    // explicit dependency
+    auto kernel_event = SubmitKernel(q, count, true);
+    event dma_event;
+    if (!use_host_alloc) {
+      dma_event = q.memcpy(BaseImpl::host_data_, BaseImpl::device_data_,
+                           count * sizeof(T));
+    }
+
+    return std::make_pair(dma_event, kernel_event);
+  }
+
+ private:
+  // submit the consuming kernel to 'q'
+  static event SubmitKernel(queue &q, size_t count, bool use_launch_bundle) {
+    // pick the right pointer to pass to the kernel
+    auto kernel_ptr = BaseImpl::get_kernel_ptr();
+
+    return q.submit([&](handler &h) {
+      if (use_launch_bundle) h.use_kernel_bundle(*BaseImpl::launch_bundle_);
+
+      // NO-FORMAT comments are for clang-format
+      h.single_task<Id>([=
+      ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+        kernel_ptr_type ptr(kernel_ptr);
+        for (size_t i = 0; i < count; i++) {
+          auto d = Pipe::read();
+          *(ptr + i) = d;
+        }
+      });
+    });
+  }
 };
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -8,6 +8,8 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "FakeIOPipes.hpp"
+#include "HostCompletionQueue.hpp"
+#include "TestData.hpp"
 
 // If the 'USE_REAL_IO_PIPE' macro is defined, this test will use real IO pipes.
 // To use this, ensure you have a BSP that supports IO pipes.
@@ -34,6 +36,9 @@ struct LoopBackWriteIOPipeID_2 { static constexpr unsigned id = 2; };
 struct LoopBackWriteIOPipeID_3 { static constexpr unsigned id = 4; };
 struct LoopBackWriteIOPipeID_4 { static constexpr unsigned id = 6; };
 
+// the seed of the random input data of the fake IO pipes
+constexpr uint64_t kLoopbackDataSeed = 1;
+
 //
 // The simplest processing kernel. Streams data in 'IOPipeIn' and streams
 // it out 'IOPipeOut'. The developer of this kernel uses this abstraction
@@ -47,10 +52,11 @@ event SubmitLoopbackKernel(queue& q, size_t count, bool& passed) {
   std::cout << "inside SubmitLoopbackKernel \n"; 
   unsigned long int *datain_host = (unsigned long int *)malloc(PIPE_COUNT * OUTER_LOOP_COUNT * INNER_LOOP_COUNT * sizeof(unsigned long int));
 
+  // the input of each pipe is the sequence 0, 1, 2, ... (see TestData.hpp)
+  auto input_data = TestDataGenerator<unsigned long int>::Sequential(0);
   for(int pipe_count = 0; pipe_count < PIPE_COUNT; pipe_count++){
-    for(size_t count = 0; count < (OUTER_LOOP_COUNT * INNER_LOOP_COUNT); count++){
-      datain_host[pipe_count * OUTER_LOOP_COUNT * INNER_LOOP_COUNT + count] = count;
-    }
+    input_data.Fill(datain_host + pipe_count * OUTER_LOOP_COUNT * INNER_LOOP_COUNT,
+                    OUTER_LOOP_COUNT * INNER_LOOP_COUNT);
   }
   unsigned long int *dataout_host = (unsigned long int *)malloc(PIPE_COUNT * OUTER_LOOP_COUNT * INNER_LOOP_COUNT * sizeof(unsigned long int));
 
@@ -79,13 +85,13 @@ event SubmitLoopbackKernel(queue& q, size_t count, bool& passed) {
 
   buf_out.get_access<access::mode::read>();
 
-  for (size_t i = 0; i < (PIPE_COUNT*OUTER_LOOP_COUNT*INNER_LOOP_COUNT); i++) {
-    if (dataout_host[i] != datain_host[i]) {
-      std::cerr << "ERROR: output mismatch in dataout_host at entry " << i << ": "
-                << dataout_host[i] << " != " << datain_host[i]
-                << " (out != in)\n";
-      passed &= false;
-    }
+  // check the output of each pipe against its input, generated again
+  for(int pipe_count = 0; pipe_count < PIPE_COUNT; pipe_count++){
+    auto report =
+      input_data.Check(dataout_host + pipe_count * OUTER_LOOP_COUNT * INNER_LOOP_COUNT,
+                       OUTER_LOOP_COUNT * INNER_LOOP_COUNT);
+    report.Print(std::cerr, "pipe " + std::to_string(pipe_count) + " output");
+    passed &= report.Passed();
   }
 
   std::cout << "passed = " << passed << "\n"; 
@@ -151,8 +157,10 @@ bool RunLoopbackSystem(queue& q, size_t count) {
   // get the pointer to the fake input data
   auto i_stream_data = FakeIOPipeInProducer::Data();
 
-  // create some random input data for the fake IO pipe
-  std::generate_n(i_stream_data, count, [&] { return rand() % 100; } );
+  // create some random input data for the fake IO pipe, in parallel.
+  // It is generated again to check the output (see TestData.hpp).
+  auto input_data = TestDataGenerator<T>::Uniform(kLoopbackDataSeed, 100);
+  input_data.Fill(i_stream_data, count);
 #endif
 
   //submit the main processing kernel
@@ -169,12 +177,17 @@ bool RunLoopbackSystem(queue& q, size_t count) {
   std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
   std::tie(consume_dma_e, consume_kernel_e) = FakeIOPipeOutConsumer::Start(q);
 
-  // wait for producer and consumer to finish including the DMA events.
+  // validate the output on a completion thread once the producer and
+  // consumer finish, including the DMA events, instead of blocking on each
+  // of them (see HostCompletionQueue.hpp).
   // NOTE: if USM host allocations are used, the dma events are noops.
-  produce_dma_e.wait();
-  produce_kernel_e.wait();
-  consume_dma_e.wait();
-  consume_kernel_e.wait();
+  HostCompletionQueue completions;
+  completions.OnComplete({produce_dma_e, produce_kernel_e,
+                          consume_dma_e, consume_kernel_e}, [&] {
+    auto report = input_data.Check(FakeIOPipeOutConsumer::Data(), count);
+    report.Print(std::cerr, "output");
+    passed &= report.Passed();
+  });
 #endif
 
   // Wait for main kernel to finish.
@@ -187,18 +200,8 @@ bool RunLoopbackSystem(queue& q, size_t count) {
 
   // FAKE IO PIPES ONLY
 #ifndef USE_REAL_IO_PIPES
-  // get the pointer to the fake input data
-  auto o_stream_data = FakeIOPipeOutConsumer::Data();
-
-  // validate the output
-  for (size_t i = 0; i < count; i++) {
-    if (o_stream_data[i] != i_stream_data[i]) {
-      std::cerr << "ERROR: output mismatch at entry " << i << ": "
-                << o_stream_data[i] << " != " << i_stream_data[i]
-                << " (out != in)\n";
-      passed &= false;
-    }
-  }
+  // wait for the validation
+  completions.Drain();
 #endif
 
   std::cout << " exit loopback function";
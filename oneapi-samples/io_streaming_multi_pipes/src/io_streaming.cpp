@@ -72,10 +72,14 @@ int main() {
 
     // run the side channel example system
     // see 'SideChannelTest.hpp'
-    /*std::cout << "Running side channel test\n";
-    passed &= 
+    std::cout << "Running side channel test\n";
+    passed &=
       RunSideChannelsSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
-    */
+
+    // report how much of the fake IO pipe memory was reused, and return it
+    // to the runtime. See 'UsmPool.hpp'.
+    UsmPool::Get(q).PrintStats(std::cout);
+    UsmPool::Release(q);
   } catch (exception const &e) {
     // Catches exceptions in the host code
     std::cerr << "Caught a SYCL host exception:\n" << e.what() << "\n";
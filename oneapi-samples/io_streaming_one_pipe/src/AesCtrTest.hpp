@@ -0,0 +1,417 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __AESCTRTEST_HPP__
+#define __AESCTRTEST_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "rom_base.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// They are templated on the key size so that AES-128 and AES-256 can be
+// built into the same design.
+template <int kKeyBits> struct AesCtrKernel;
+template <int kKeyBits>
+struct AesCtrReadIOPipeID { static constexpr unsigned id = 0; };
+template <int kKeyBits>
+struct AesCtrWriteIOPipeID { static constexpr unsigned id = 1; };
+template <int kKeyBits> struct AesCtrKeyID;
+
+//
+// AES constants
+//
+constexpr int kAesBlockBytes = 16;
+
+constexpr int AesRounds(int key_bits) { return key_bits / 32 + 6; }
+
+// the number of 32-bit words of the key schedule and initial counter block
+// that the kernel loads
+constexpr int AesCtrKeyWords(int key_bits) {
+  return (AesRounds(key_bits) + 2) * kAesBlockBytes / 4;
+}
+
+namespace aes_detail {
+
+// multiply by x in GF(2^8) with the AES polynomial x^8 + x^4 + x^3 + x + 1
+constexpr uint8_t XTime(uint8_t a) {
+  return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1B : 0x00));
+}
+
+constexpr uint8_t GFMul(uint8_t a, uint8_t b) {
+  uint8_t p = 0;
+  for (int i = 0; i < 8; i++) {
+    if (b & 1) p ^= a;
+    a = XTime(a);
+    b >>= 1;
+  }
+  return p;
+}
+
+// the S-box is the multiplicative inverse followed by an affine transform
+constexpr uint8_t SBoxValue(int x) {
+  uint8_t inv = 0;
+  if (x != 0) {
+    // x^254 == x^-1
+    uint8_t p = (uint8_t)x;
+    inv = 1;
+    for (int e = 254; e > 0; e >>= 1) {
+      if (e & 1) inv = GFMul(inv, p);
+      p = GFMul(p, p);
+    }
+  }
+
+  uint8_t s = inv;
+  for (int i = 1; i <= 4; i++) {
+    s ^= (uint8_t)((inv << i) | (inv >> (8 - i)));
+  }
+  return s ^ 0x63;
+}
+
+}  // namespace aes_detail
+
+//
+// The AES S-box as a ROM, computed at compile time
+//
+struct AesSBox : fpga_tools::ROMBase<uint8_t, 256> {
+  constexpr AesSBox()
+      : fpga_tools::ROMBase<uint8_t, 256>(
+            [](int x) { return aes_detail::SBoxValue(x); }) {}
+};
+
+//
+// Host side AES. Expands the key schedule that is loaded into the kernel
+// and provides a reference implementation of CTR mode.
+//
+template <int kKeyBits>
+class AesHost {
+  static_assert(kKeyBits == 128 || kKeyBits == 256);
+
+ public:
+  static constexpr int kRounds = AesRounds(kKeyBits);
+  static constexpr int kRoundKeyBytes = (kRounds + 1) * kAesBlockBytes;
+
+  explicit AesHost(const uint8_t *key) {
+    constexpr int nk = kKeyBits / 32;
+    constexpr AesSBox sbox;
+    uint8_t rcon = 1;
+
+    std::copy(key, key + 4 * nk, round_keys_);
+    for (int i = nk; i < 4 * (kRounds + 1); i++) {
+      uint8_t t[4];
+      std::copy(round_keys_ + 4 * (i - 1), round_keys_ + 4 * i, t);
+      if (i % nk == 0) {
+        uint8_t t0 = t[0];
+        t[0] = sbox[t[1]] ^ rcon;
+        t[1] = sbox[t[2]];
+        t[2] = sbox[t[3]];
+        t[3] = sbox[t0];
+        rcon = aes_detail::XTime(rcon);
+      } else if (nk > 6 && i % nk == 4) {
+        for (auto &b : t) b = sbox[b];
+      }
+      for (int j = 0; j < 4; j++) {
+        round_keys_[4 * i + j] = round_keys_[4 * (i - nk) + j] ^ t[j];
+      }
+    }
+  }
+
+  const uint8_t *RoundKeys() const { return round_keys_; }
+
+  void EncryptBlock(const uint8_t *in, uint8_t *out) const {
+    constexpr AesSBox sbox;
+    uint8_t s[kAesBlockBytes];
+    for (int i = 0; i < kAesBlockBytes; i++) s[i] = in[i] ^ round_keys_[i];
+
+    for (int r = 1; r <= kRounds; r++) {
+      // SubBytes and ShiftRows. Byte i is row i % 4 of column i / 4.
+      uint8_t t[kAesBlockBytes];
+      for (int i = 0; i < kAesBlockBytes; i++) {
+        t[i] = sbox[s[(i + 4 * (i % 4)) % kAesBlockBytes]];
+      }
+      // MixColumns, skipped in the last round
+      for (int c = 0; c < 4; c++) {
+        uint8_t *col = t + 4 * c;
+        if (r != kRounds) {
+          uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+          col[0] = aes_detail::GFMul(a0, 2) ^ aes_detail::GFMul(a1, 3) ^ a2 ^ a3;
+          col[1] = a0 ^ aes_detail::GFMul(a1, 2) ^ aes_detail::GFMul(a2, 3) ^ a3;
+          col[2] = a0 ^ a1 ^ aes_detail::GFMul(a2, 2) ^ aes_detail::GFMul(a3, 3);
+          col[3] = aes_detail::GFMul(a0, 3) ^ a1 ^ a2 ^ aes_detail::GFMul(a3, 2);
+        }
+      }
+      for (int i = 0; i < kAesBlockBytes; i++) {
+        s[i] = t[i] ^ round_keys_[r * kAesBlockBytes + i];
+      }
+    }
+    std::copy(s, s + kAesBlockBytes, out);
+  }
+
+  // CTR mode. The counter is the low 64 bits of the counter block, big
+  // endian, so a block of 'iv' is the nonce and the initial counter.
+  void Ctr(const uint8_t *iv, const uint8_t *in, uint8_t *out,
+           size_t bytes) const {
+    uint8_t ctr[kAesBlockBytes], ks[kAesBlockBytes];
+    std::copy(iv, iv + kAesBlockBytes, ctr);
+    for (size_t i = 0; i < bytes; i += kAesBlockBytes) {
+      EncryptBlock(ctr, ks);
+      for (size_t j = 0; j < kAesBlockBytes && i + j < bytes; j++) {
+        out[i + j] = in[i + j] ^ ks[j];
+      }
+      for (int j = kAesBlockBytes - 1; j >= 8 && ++ctr[j] == 0; j--) {
+      }
+    }
+  }
+
+ private:
+  uint8_t round_keys_[kRoundKeyBytes];
+};
+
+//
+// Submit the AES-CTR kernel.
+//
+// The kernel first reads the expanded key schedule and the initial counter
+// block from 'KeyPipe', as AesCtrKeyWords(kKeyBits) 32-bit little endian
+// words. It then encrypts (or, equivalently, decrypts) 'count' elements from
+// IOPipeIn to IOPipeOut.
+//
+// Each iteration reads one beat and generates the 128-bit keystream blocks
+// that cover it, one per lane, so the kernel streams one beat per cycle.
+// There are sizeof(T) / 16 lanes for a beat of whole blocks. For a beat
+// narrower than a block there is one lane, and a block is generated again
+// for each of its beats. The round function is fully unrolled, so each lane
+// is a pipeline of kRounds rounds that accepts a new counter block every
+// cycle. The S-box lookups are ROM reads: 16 per round per lane.
+//
+template <class IOPipeIn, class IOPipeOut, class KeyPipe, typename T,
+          int kKeyBits>
+event SubmitAesCtrKernel(queue &q, size_t count) {
+  constexpr int kRounds = AesRounds(kKeyBits);
+  constexpr int kRoundKeyBytes = (kRounds + 1) * kAesBlockBytes;
+  constexpr int kBeatBytes = sizeof(T);
+  static_assert(kBeatBytes % kAesBlockBytes == 0 ||
+                    kAesBlockBytes % kBeatBytes == 0,
+                "the beat must be a multiple or a divisor of the block size");
+  constexpr int kLanes = std::max(1, kBeatBytes / kAesBlockBytes);
+  constexpr int kBeatsPerBlock = std::max(1, kAesBlockBytes / kBeatBytes);
+
+  return q.single_task<AesCtrKernel<kKeyBits>>([=] {
+    constexpr AesSBox sbox;
+
+    // read the key schedule and initial counter block
+    uint8_t round_keys[kRoundKeyBytes];
+    uint8_t iv[kAesBlockBytes];
+    for (int i = 0; i < kRoundKeyBytes / 4; i++) {
+      uint32_t w = KeyPipe::read();
+      fpga_tools::UnrolledLoop<4>(
+          [&](auto j) { round_keys[4 * i + j] = w >> (8 * j); });
+    }
+    for (int i = 0; i < kAesBlockBytes / 4; i++) {
+      uint32_t w = KeyPipe::read();
+      fpga_tools::UnrolledLoop<4>([&](auto j) { iv[4 * i + j] = w >> (8 * j); });
+    }
+
+    // the low 64 bits of the counter block are the counter, big endian
+    uint64_t ctr = 0;
+    fpga_tools::UnrolledLoop<8>(
+        [&](auto j) { ctr = (ctr << 8) | iv[8 + j]; });
+
+    [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+    for (size_t beat_idx = 0; beat_idx < count; beat_idx++) {
+      // the first block of the beat, and the position of the beat in it
+      const uint64_t first_block = (beat_idx / kBeatsPerBlock) * kLanes;
+      const int beat_offset = (beat_idx % kBeatsPerBlock) * kBeatBytes;
+
+      // generate the keystream for this beat
+      uint8_t keystream[kLanes][kAesBlockBytes];
+
+      fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+        const uint64_t block_ctr = ctr + first_block + l;
+
+        uint8_t s[kAesBlockBytes];
+        fpga_tools::UnrolledLoop<kAesBlockBytes>([&](auto i) {
+          uint8_t b = (i < 8) ? iv[i] : (uint8_t)(block_ctr >> (8 * (15 - i)));
+          s[i] = b ^ round_keys[i];
+        });
+
+        fpga_tools::UnrolledLoop<1, kRounds + 1>([&](auto r) {
+          // SubBytes and ShiftRows
+          uint8_t t[kAesBlockBytes];
+          fpga_tools::UnrolledLoop<kAesBlockBytes>([&](auto i) {
+            t[i] = sbox[s[(i + 4 * (i % 4)) % kAesBlockBytes]];
+          });
+
+          // MixColumns, skipped in the last round
+          if constexpr (r != kRounds) {
+            fpga_tools::UnrolledLoop<4>([&](auto c) {
+              uint8_t a0 = t[4 * c], a1 = t[4 * c + 1];
+              uint8_t a2 = t[4 * c + 2], a3 = t[4 * c + 3];
+              uint8_t x = a0 ^ a1 ^ a2 ^ a3;
+              t[4 * c] = a0 ^ x ^ aes_detail::XTime(a0 ^ a1);
+              t[4 * c + 1] = a1 ^ x ^ aes_detail::XTime(a1 ^ a2);
+              t[4 * c + 2] = a2 ^ x ^ aes_detail::XTime(a2 ^ a3);
+              t[4 * c + 3] = a3 ^ x ^ aes_detail::XTime(a3 ^ a0);
+            });
+          }
+
+          // AddRoundKey
+          fpga_tools::UnrolledLoop<kAesBlockBytes>([&](auto i) {
+            s[i] = t[i] ^ round_keys[r * kAesBlockBytes + i];
+          });
+        });
+
+        fpga_tools::UnrolledLoop<kAesBlockBytes>(
+            [&](auto i) { keystream[l][i] = s[i]; });
+      });
+
+      // apply the keystream to the data
+      T data = IOPipeIn::read();
+      T ks = 0;
+      fpga_tools::UnrolledLoop<kBeatBytes>([&](auto i) {
+        const int byte = beat_offset + i;
+        ks |= (T)keystream[byte / kAesBlockBytes][byte % kAesBlockBytes]
+              << (8 * i);
+      });
+      IOPipeOut::write(data ^ ks);
+    }
+  });
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It checks the host reference against the FIPS-197 example vector, then
+// encrypts random data in the kernel and compares it bit for bit with the
+// host reference.
+//
+template <typename T, bool use_usm_host_alloc, int kKeyBits>
+bool RunAesCtrSystem(queue &q, size_t count) {
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<AesCtrReadIOPipeID<kKeyBits>, T, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<AesCtrWriteIOPipeID<kKeyBits>, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, count);
+  FakeIOPipeOutConsumer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  //////////////////////////////////////////////////////////////////////////////
+  // the key schedule and initial counter block, loaded in one transfer
+  using KeyProducer =
+      Producer<AesCtrKeyID<kKeyBits>, uint32_t, use_usm_host_alloc>;
+
+  KeyProducer::Init(q, AesCtrKeyWords(kKeyBits));
+  //////////////////////////////////////////////////////////////////////////////
+
+  bool passed = true;
+
+  // check the host reference against the FIPS-197 appendix C vectors
+  uint8_t key[kKeyBits / 8];
+  uint8_t pt[kAesBlockBytes], ct[kAesBlockBytes];
+  for (int i = 0; i < kKeyBits / 8; i++) key[i] = i;
+  for (int i = 0; i < kAesBlockBytes; i++) pt[i] = (i << 4) | i;
+  const uint8_t fips_ct[2][kAesBlockBytes] = {
+      {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80,
+       0x70, 0xb4, 0xc5, 0x5a},
+      {0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90,
+       0x4b, 0x49, 0x60, 0x89}};
+  AesHost<kKeyBits>(key).EncryptBlock(pt, ct);
+  if (!std::equal(ct, ct + kAesBlockBytes, fips_ct[kKeyBits == 256])) {
+    std::cerr << "ERROR: AES-" << kKeyBits
+              << " host reference failed the FIPS-197 test vector\n";
+    passed &= false;
+  }
+
+  // random key, nonce and data
+  for (auto &b : key) b = rand();
+  uint8_t iv[kAesBlockBytes];
+  for (auto &b : iv) b = rand();
+  // start close to a carry out of the low counter bytes
+  std::fill(iv + 8, iv + 13, 0xFF);
+
+  AesHost<kKeyBits> aes(key);
+  const size_t num_bytes = count * sizeof(T);
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  for (size_t i = 0; i < count; i++) {
+    i_stream_data[i] = ((T)rand() << 32) ^ rand();
+  }
+  std::vector<uint8_t> expected(num_bytes);
+  aes.Ctr(iv, (const uint8_t *)i_stream_data, expected.data(), num_bytes);
+
+  // launch the kernel and load the key schedule and counter block
+  auto kernel_event =
+      SubmitAesCtrKernel<ReadIOPipe, WriteIOPipe, typename KeyProducer::Pipe,
+                         T, kKeyBits>(q, count);
+
+  auto key_words = (uint8_t *)KeyProducer::Data();
+  std::memcpy(key_words, aes.RoundKeys(), AesHost<kKeyBits>::kRoundKeyBytes);
+  std::memcpy(key_words + AesHost<kKeyBits>::kRoundKeyBytes, iv,
+              kAesBlockBytes);
+  event key_dma_event, key_kernel_event;
+  std::tie(key_dma_event, key_kernel_event) = KeyProducer::Start(q);
+
+  // stream the data
+  event producer_dma_event, producer_kernel_event;
+  event consumer_dma_event, consumer_kernel_event;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(producer_dma_event, producer_kernel_event) =
+      FakeIOPipeInProducer::Start(q);
+  std::tie(consumer_dma_event, consumer_kernel_event) =
+      FakeIOPipeOutConsumer::Start(q);
+
+  key_dma_event.wait();
+  key_kernel_event.wait();
+  producer_dma_event.wait();
+  producer_kernel_event.wait();
+  consumer_dma_event.wait();
+  consumer_kernel_event.wait();
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "AES-" << kKeyBits << "-CTR: " << num_bytes << " bytes in "
+            << diff.count() << " ms\n";
+
+  // validate the results bit for bit
+  auto o_stream_data = (const uint8_t *)FakeIOPipeOutConsumer::Data();
+  for (size_t i = 0; i < num_bytes; i++) {
+    if (o_stream_data[i] != expected[i]) {
+      std::cerr << "ERROR: AES-" << kKeyBits << "-CTR mismatch at byte " << i
+                << ": " << (int)o_stream_data[i] << " != " << (int)expected[i]
+                << " (out != expected)\n";
+      passed &= false;
+      break;
+    }
+  }
+
+  // CTR decryption is the same operation
+  std::vector<uint8_t> decrypted(num_bytes);
+  aes.Ctr(iv, o_stream_data, decrypted.data(), num_bytes);
+  if (!std::equal(decrypted.begin(), decrypted.end(),
+                  (const uint8_t *)i_stream_data)) {
+    std::cerr << "ERROR: AES-" << kKeyBits << "-CTR round trip failed\n";
+    passed &= false;
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+  KeyProducer::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __AESCTRTEST_HPP__ */
@@ -0,0 +1,459 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __COLUMNARCODECTEST_HPP__
+#define __COLUMNARCODECTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "columnar_codecs.hpp"
+#include "data_bundle.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct ColumnarDeltaEncodeKernel;
+struct ColumnarVarintEncodeKernel;
+struct ColumnarVarintDecodeKernel;
+struct ColumnarDeltaDecodeKernel;
+struct ColumnarBitPackKernel;
+struct ColumnarBitUnpackKernel;
+struct ColumnarRleEncodeKernel;
+struct ColumnarRleDecodeKernel;
+struct ColumnarEncodePipeID;
+struct ColumnarDecodePipeID;
+struct ColumnarEncodeReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarEncodeWriteIOPipeID { static constexpr unsigned id = 1; };
+struct ColumnarDecodeReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarDecodeWriteIOPipeID { static constexpr unsigned id = 1; };
+struct ColumnarBitPackReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarBitPackWriteIOPipeID { static constexpr unsigned id = 1; };
+struct ColumnarBitUnpackReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarBitUnpackWriteIOPipeID { static constexpr unsigned id = 1; };
+struct ColumnarRleEncodeReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarRleEncodeWriteIOPipeID { static constexpr unsigned id = 1; };
+struct ColumnarRleDecodeReadIOPipeID { static constexpr unsigned id = 0; };
+struct ColumnarRleDecodeWriteIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// Host reference encoders
+//
+template <typename U>
+void HostVarintEncode(U val, std::vector<uint8_t> &out) {
+  while (val >= 0x80) {
+    out.push_back(uint8_t(val) | 0x80);
+    val >>= 7;
+  }
+  out.push_back(uint8_t(val));
+}
+
+template <typename T>
+void HostBitPack(const T *vals, size_t count, int bits,
+                 std::vector<uint8_t> &out) {
+  out.assign((count * bits + 7) / 8, 0);
+  for (size_t i = 0; i < count; i++) {
+    for (int t = 0; t < bits; t++) {
+      size_t bit = i * bits + t;
+      out[bit / 8] |= ((vals[i] >> t) & 1) << (bit % 8);
+    }
+  }
+}
+
+//
+// Delta + zigzag + varint encoding of a column, like the integer columns
+// of ORC and the delta encodings of Parquet, and the matching decoder.
+// The encoder is checked byte for byte against the host encoder, and the
+// decoder must reproduce the column.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes, int kWidth>
+bool RunVarintCodec(queue &q, size_t count) {
+  using S = std::make_signed_t<T>;
+  using U = std::make_unsigned_t<T>;
+  using ValueBeat = fpga_tools::DataBundle<S, kLanes>;
+  using CodeBeat = fpga_tools::DataBundle<U, kLanes>;
+  using ByteBeat = fpga_tools::DataBundle<uint8_t, kWidth>;
+  using EncodePipe = sycl::ext::intel::pipe<ColumnarEncodePipeID, CodeBeat>;
+  using DecodePipe = sycl::ext::intel::pipe<ColumnarDecodePipeID, CodeBeat>;
+
+  const size_t beats = count / kLanes;
+  const size_t num_values = beats * kLanes;
+
+  // a column of timestamp-like values: a random walk with mostly small
+  // steps, and the occasional large jump
+  std::vector<S> column(num_values);
+  S val = 1000000;
+  for (auto &c : column) {
+    val += (rand() % 64 == 0) ? S(rand()) * 4096 : S(rand() % 201 - 100);
+    c = val;
+  }
+  std::vector<uint8_t> encoded;
+  S prev = 0;
+  for (auto c : column) {
+    HostVarintEncode(fpga_tools::ZigZagEncode(S(U(c) - U(prev))), encoded);
+    prev = c;
+  }
+  const size_t byte_beats = (encoded.size() + kWidth - 1) / kWidth;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using EncodeProducer =
+      Producer<ColumnarEncodeReadIOPipeID, ValueBeat, use_usm_host_alloc>;
+  using EncodeConsumer =
+      Consumer<ColumnarEncodeWriteIOPipeID, ByteBeat, use_usm_host_alloc>;
+  using DecodeProducer =
+      Producer<ColumnarDecodeReadIOPipeID, ByteBeat, use_usm_host_alloc>;
+  using DecodeConsumer =
+      Consumer<ColumnarDecodeWriteIOPipeID, ValueBeat, use_usm_host_alloc>;
+
+  EncodeProducer::Init(q, beats);
+  EncodeConsumer::Init(q, byte_beats);
+  DecodeProducer::Init(q, byte_beats);
+  DecodeConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  auto encode_in = EncodeProducer::Data();
+  for (size_t i = 0; i < num_values; i++) {
+    encode_in[i / kLanes][i % kLanes] = column[i];
+  }
+  auto decode_in = DecodeProducer::Data();
+  for (size_t i = 0; i < byte_beats * kWidth; i++) {
+    decode_in[i / kWidth][i % kWidth] = i < encoded.size() ? encoded[i] : 0;
+  }
+
+  size_t *sizes = malloc_host<size_t>(2, q);
+  if (sizes == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the sizes\n";
+    std::terminate();
+  }
+
+  // the encoder
+  auto delta_encode_event = q.single_task<ColumnarDeltaEncodeKernel>([=] {
+    fpga_tools::DeltaEncode<typename EncodeProducer::Pipe, EncodePipe, true>(
+        beats);
+  });
+  auto varint_encode_event = q.single_task<ColumnarVarintEncodeKernel>([=] {
+    sizes[0] = fpga_tools::VarintEncode<EncodePipe,
+                                        typename EncodeConsumer::Pipe>(beats);
+  });
+
+  // the decoder
+  auto varint_decode_event = q.single_task<ColumnarVarintDecodeKernel>([=] {
+    sizes[1] = fpga_tools::VarintDecode<typename DecodeProducer::Pipe,
+                                        DecodePipe>(byte_beats, num_values);
+  });
+  auto delta_decode_event = q.single_task<ColumnarDeltaDecodeKernel>([=] {
+    fpga_tools::DeltaDecode<DecodePipe, typename DecodeConsumer::Pipe, true>(
+        beats);
+  });
+
+  event dma_e[4], kernel_e[4];
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(dma_e[0], kernel_e[0]) = EncodeProducer::Start(q);
+  std::tie(dma_e[1], kernel_e[1]) = EncodeConsumer::Start(q);
+  std::tie(dma_e[2], kernel_e[2]) = DecodeProducer::Start(q);
+  std::tie(dma_e[3], kernel_e[3]) = DecodeConsumer::Start(q);
+  for (int i = 0; i < 4; i++) {
+    dma_e[i].wait();
+    kernel_e[i].wait();
+  }
+  delta_encode_event.wait();
+  varint_encode_event.wait();
+  varint_decode_event.wait();
+  delta_decode_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Delta/zigzag/varint codec: " << num_values << " values, "
+            << encoded.size() << " bytes encoded, in " << diff.count()
+            << " ms\n";
+
+  // validate the results
+  bool passed = true;
+  if (sizes[0] != encoded.size()) {
+    std::cerr << "ERROR: encoder wrote " << sizes[0] << " bytes, expected "
+              << encoded.size() << "\n";
+    passed &= false;
+  }
+  auto encode_out = EncodeConsumer::Data();
+  for (size_t i = 0; i < encoded.size() && passed; i++) {
+    if (encode_out[i / kWidth][i % kWidth] != encoded[i]) {
+      std::cerr << "ERROR: encoded byte " << i << " mismatch\n";
+      passed &= false;
+    }
+  }
+  if (sizes[1] != num_values) {
+    std::cerr << "ERROR: decoder produced " << sizes[1] << " values, expected "
+              << num_values << "\n";
+    passed &= false;
+  }
+  auto decode_out = DecodeConsumer::Data();
+  for (size_t i = 0; i < num_values && passed; i++) {
+    if (decode_out[i / kLanes][i % kLanes] != column[i]) {
+      std::cerr << "ERROR: decoded value " << i << " is "
+                << decode_out[i / kLanes][i % kLanes] << ", expected "
+                << column[i] << "\n";
+      passed &= false;
+    }
+  }
+
+  free(sizes, q);
+  EncodeProducer::Destroy(q);
+  EncodeConsumer::Destroy(q);
+  DecodeProducer::Destroy(q);
+  DecodeConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// Fixed bit width packing of a column, checked against the host packer,
+// and unpacking of the packed column.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes, int kBits>
+bool RunBitPackCodec(queue &q, size_t count) {
+  using ValueBeat = fpga_tools::DataBundle<T, kLanes>;
+  using PackedBeat = fpga_tools::DataBundle<uint8_t, kLanes * kBits / 8>;
+  constexpr int kPackedBytes = PackedBeat::size;
+
+  const size_t beats = count / kLanes;
+  const size_t num_values = beats * kLanes;
+
+  std::vector<T> column(num_values);
+  for (auto &c : column) {
+    c = T(rand()) & ((T(1) << kBits) - 1);
+  }
+  std::vector<uint8_t> packed;
+  HostBitPack(column.data(), num_values, kBits, packed);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using PackProducer =
+      Producer<ColumnarBitPackReadIOPipeID, ValueBeat, use_usm_host_alloc>;
+  using PackConsumer =
+      Consumer<ColumnarBitPackWriteIOPipeID, PackedBeat, use_usm_host_alloc>;
+  using UnpackProducer =
+      Producer<ColumnarBitUnpackReadIOPipeID, PackedBeat, use_usm_host_alloc>;
+  using UnpackConsumer =
+      Consumer<ColumnarBitUnpackWriteIOPipeID, ValueBeat, use_usm_host_alloc>;
+
+  PackProducer::Init(q, beats);
+  PackConsumer::Init(q, beats);
+  UnpackProducer::Init(q, beats);
+  UnpackConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  auto pack_in = PackProducer::Data();
+  for (size_t i = 0; i < num_values; i++) {
+    pack_in[i / kLanes][i % kLanes] = column[i];
+  }
+  auto unpack_in = UnpackProducer::Data();
+  for (size_t i = 0; i < packed.size(); i++) {
+    unpack_in[i / kPackedBytes][i % kPackedBytes] = packed[i];
+  }
+
+  auto pack_event = q.single_task<ColumnarBitPackKernel>([=] {
+    fpga_tools::BitPack<typename PackProducer::Pipe,
+                        typename PackConsumer::Pipe, kBits>(beats);
+  });
+  auto unpack_event = q.single_task<ColumnarBitUnpackKernel>([=] {
+    fpga_tools::BitUnpack<typename UnpackProducer::Pipe,
+                          typename UnpackConsumer::Pipe, kBits>(beats);
+  });
+
+  event dma_e[4], kernel_e[4];
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(dma_e[0], kernel_e[0]) = PackProducer::Start(q);
+  std::tie(dma_e[1], kernel_e[1]) = PackConsumer::Start(q);
+  std::tie(dma_e[2], kernel_e[2]) = UnpackProducer::Start(q);
+  std::tie(dma_e[3], kernel_e[3]) = UnpackConsumer::Start(q);
+  for (int i = 0; i < 4; i++) {
+    dma_e[i].wait();
+    kernel_e[i].wait();
+  }
+  pack_event.wait();
+  unpack_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Bit packing: " << num_values << " values of " << kBits
+            << " bits, in " << diff.count() << " ms\n";
+
+  // validate the results
+  bool passed = true;
+  auto pack_out = PackConsumer::Data();
+  for (size_t i = 0; i < packed.size() && passed; i++) {
+    if (pack_out[i / kPackedBytes][i % kPackedBytes] != packed[i]) {
+      std::cerr << "ERROR: packed byte " << i << " mismatch\n";
+      passed &= false;
+    }
+  }
+  auto unpack_out = UnpackConsumer::Data();
+  for (size_t i = 0; i < num_values && passed; i++) {
+    if (unpack_out[i / kLanes][i % kLanes] != column[i]) {
+      std::cerr << "ERROR: unpacked value " << i << " is "
+                << unpack_out[i / kLanes][i % kLanes] << ", expected "
+                << column[i] << "\n";
+      passed &= false;
+    }
+  }
+
+  PackProducer::Destroy(q);
+  PackConsumer::Destroy(q);
+  UnpackProducer::Destroy(q);
+  UnpackConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// Run length encoding of a column, checked against the runs found on the
+// host, and decoding of the runs.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes>
+bool RunRleCodec(queue &q, size_t count) {
+  using Run = fpga_tools::RleRun<T>;
+  using ValueBeat = fpga_tools::DataBundle<T, kLanes>;
+  using RunBeat = fpga_tools::DataBundle<Run, kLanes>;
+
+  const size_t beats = count / kLanes;
+  const size_t num_values = beats * kLanes;
+
+  // a column of mostly short runs, some single values and some runs
+  // longer than a beat
+  std::vector<T> column;
+  std::vector<Run> runs;
+  while (column.size() < num_values) {
+    T val = T(rand() % 16);
+    if (!runs.empty() && runs.back().value == val) continue;
+    uint32_t len = (rand() % 8 == 0) ? 1 + rand() % 100 : 1 + rand() % 4;
+    len = std::min<size_t>(len, num_values - column.size());
+    column.insert(column.end(), len, val);
+    runs.push_back({val, len});
+  }
+  const size_t run_beats = (runs.size() + kLanes - 1) / kLanes;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using EncodeProducer =
+      Producer<ColumnarRleEncodeReadIOPipeID, ValueBeat, use_usm_host_alloc>;
+  using EncodeConsumer =
+      Consumer<ColumnarRleEncodeWriteIOPipeID, RunBeat, use_usm_host_alloc>;
+  using DecodeProducer =
+      Producer<ColumnarRleDecodeReadIOPipeID, RunBeat, use_usm_host_alloc>;
+  using DecodeConsumer =
+      Consumer<ColumnarRleDecodeWriteIOPipeID, ValueBeat, use_usm_host_alloc>;
+
+  EncodeProducer::Init(q, beats);
+  EncodeConsumer::Init(q, run_beats);
+  DecodeProducer::Init(q, run_beats);
+  DecodeConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  auto encode_in = EncodeProducer::Data();
+  for (size_t i = 0; i < num_values; i++) {
+    encode_in[i / kLanes][i % kLanes] = column[i];
+  }
+  auto decode_in = DecodeProducer::Data();
+  for (size_t i = 0; i < run_beats * kLanes; i++) {
+    decode_in[i / kLanes][i % kLanes] = i < runs.size() ? runs[i] : Run{0, 0};
+  }
+
+  size_t *sizes = malloc_host<size_t>(2, q);
+  if (sizes == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the sizes\n";
+    std::terminate();
+  }
+
+  auto encode_event = q.single_task<ColumnarRleEncodeKernel>([=] {
+    sizes[0] = fpga_tools::RleEncode<typename EncodeProducer::Pipe,
+                                     typename EncodeConsumer::Pipe>(beats);
+  });
+  auto decode_event = q.single_task<ColumnarRleDecodeKernel>([=] {
+    sizes[1] = fpga_tools::RleDecode<typename DecodeProducer::Pipe,
+                                     typename DecodeConsumer::Pipe>(
+        run_beats, num_values);
+  });
+
+  event dma_e[4], kernel_e[4];
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(dma_e[0], kernel_e[0]) = EncodeProducer::Start(q);
+  std::tie(dma_e[1], kernel_e[1]) = EncodeConsumer::Start(q);
+  std::tie(dma_e[2], kernel_e[2]) = DecodeProducer::Start(q);
+  std::tie(dma_e[3], kernel_e[3]) = DecodeConsumer::Start(q);
+  for (int i = 0; i < 4; i++) {
+    dma_e[i].wait();
+    kernel_e[i].wait();
+  }
+  encode_event.wait();
+  decode_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Run length encoding: " << num_values << " values, "
+            << runs.size() << " runs, in " << diff.count() << " ms\n";
+
+  // validate the results
+  bool passed = true;
+  if (sizes[0] != runs.size()) {
+    std::cerr << "ERROR: encoder wrote " << sizes[0] << " runs, expected "
+              << runs.size() << "\n";
+    passed &= false;
+  }
+  auto encode_out = EncodeConsumer::Data();
+  for (size_t i = 0; i < runs.size() && passed; i++) {
+    const Run &r = encode_out[i / kLanes][i % kLanes];
+    if (r.value != runs[i].value || r.length != runs[i].length) {
+      std::cerr << "ERROR: run " << i << " is (" << r.value << ", "
+                << r.length << "), expected (" << runs[i].value << ", "
+                << runs[i].length << ")\n";
+      passed &= false;
+    }
+  }
+  if (sizes[1] != num_values) {
+    std::cerr << "ERROR: decoder produced " << sizes[1] << " values, expected "
+              << num_values << "\n";
+    passed &= false;
+  }
+  auto decode_out = DecodeConsumer::Data();
+  for (size_t i = 0; i < num_values && passed; i++) {
+    if (decode_out[i / kLanes][i % kLanes] != column[i]) {
+      std::cerr << "ERROR: decoded value " << i << " is "
+                << decode_out[i / kLanes][i % kLanes] << ", expected "
+                << column[i] << "\n";
+      passed &= false;
+    }
+  }
+
+  free(sizes, q);
+  EncodeProducer::Destroy(q);
+  EncodeConsumer::Destroy(q);
+  DecodeProducer::Destroy(q);
+  DecodeConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It runs the delta/zigzag/varint codec, the bit packing codec and the run
+// length codec.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunColumnarCodecSystem(queue &q, size_t count) {
+  bool passed = true;
+  passed &= RunVarintCodec<T, use_usm_host_alloc, 4, 16>(q, count);
+  passed &= RunBitPackCodec<T, use_usm_host_alloc, 8, 13>(q, count);
+  passed &= RunRleCodec<T, use_usm_host_alloc, 4>(q, count);
+  return passed;
+}
+
+#endif /* __COLUMNARCODECTEST_HPP__ */
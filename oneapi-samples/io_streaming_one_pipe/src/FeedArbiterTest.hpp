@@ -0,0 +1,327 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __FEEDARBITERTEST_HPP__
+#define __FEEDARBITERTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "HostSideChannel.hpp"
+#include "feed_arbiter.hpp"
+#include "pipe_utils.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct FeedArbiterKernel;
+template <int feed> struct FeedLinkKernel;
+struct FeedAReadIOPipeID { static constexpr unsigned id = 0; };
+struct FeedBReadIOPipeID { static constexpr unsigned id = 1; };
+struct FeedWriteIOPipeID { static constexpr unsigned id = 2; };
+struct FeedPipesID;
+struct FeedCommandSideChannelID;
+struct FeedAckSideChannelID;
+struct FeedGapSideChannelID;
+
+constexpr int kFeedWindow = 64;
+constexpr int kFeedGapCapacity = 64;
+
+// a sequenced message, with a payload that is a function of its sequence
+// number so the host can check it
+struct FeedMessage {
+  uint32_t seq;
+  uint32_t payload[3];
+};
+
+inline uint32_t FeedSeqOf(const FeedMessage &m) { return m.seq; }
+
+inline FeedMessage FeedMakeMessage(uint32_t seq) {
+  return {seq, {seq * 0x9E3779B9, ~seq, seq ^ 0xA5A5A5A5}};
+}
+
+//
+// Arrange the messages of a feed, given as offsets from the first sequence
+// number, with a bounded reordering: each one is moved back by up to half
+// the window, so no message follows one that is a window or more above it.
+//
+inline std::vector<uint32_t> FeedShuffle(const std::vector<uint32_t> &seqs) {
+  std::vector<std::pair<uint32_t, uint32_t>> keyed;
+  for (auto s : seqs) keyed.push_back({s + rand() % (kFeedWindow / 2), s});
+  std::stable_sort(keyed.begin(), keyed.end());
+  std::vector<uint32_t> out;
+  for (auto &k : keyed) out.push_back(k.second);
+  return out;
+}
+
+//
+// This function builds the full system using fake IO pipes:
+//
+//   feed A -> link kernel --+
+//                           +--> FeedArbiter -> output
+//   feed B -> link kernel --+
+//
+// The link kernels move the messages of the fake IO pipes to the PipeArray
+// of the two feeds. The test runs two phases with one arbiter kernel:
+//    1: both feeds carry most messages, some on only one of them, each
+//       feed locally reordered and with a few repeats. Some runs of
+//       messages are on neither feed, and are found by the feeds moving
+//       past them, with the timeout off.
+//    2: feed B has stopped, and feed A has a few holes. The arbiter finds
+//       them with the timeout.
+// In both phases the output must be every delivered message, once and in
+// order, and the reported gaps must be exactly the missing runs. The
+// sequence numbers wrap around 2^32 in the first phase.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunFeedArbiterSystem(queue &q, size_t count) {
+  using fpga_tools::FeedGap;
+  const size_t messages = std::max<size_t>(count / 4, 8 * kFeedWindow);
+  const size_t phase2_messages = 8 * kFeedWindow;
+  const uint32_t first_seq = uint32_t(0) - uint32_t(messages / 2);
+  constexpr uint32_t kTimeout = 4096;
+
+  // phase 1: which feeds carry each message. The last two windows are on
+  // both, so the feeds always move past the missing runs.
+  std::vector<int> on(messages);
+  for (size_t i = 0; i < messages; i++) {
+    int r = rand() % 16;
+    on[i] = r < 12 ? 3 : (r < 14 ? 1 : 2);
+  }
+  for (int g = 0; g < 16; g++) {
+    size_t start = rand() % (messages - 4 * kFeedWindow);
+    size_t length = 1 + rand() % (g < 4 ? 3 * kFeedWindow : 4);
+    for (size_t i = start; i < start + length; i++) on[i] = 0;
+  }
+  on[0] = 3;
+
+  std::vector<std::vector<uint32_t>> feed(2);
+  for (int f = 0; f < 2; f++) {
+    std::vector<uint32_t> seqs;
+    for (size_t i = 0; i < messages; i++) {
+      if (on[i] & (1 << f)) seqs.push_back(i);
+      if (on[i] && rand() % 64 == 0) seqs.push_back(i);
+    }
+    feed[f] = FeedShuffle(seqs);
+  }
+
+  // phase 2: feed A only, in order, with holes
+  std::vector<bool> on2(phase2_messages, true);
+  for (int g = 0; g < 4; g++) {
+    size_t start = 1 + rand() % (phase2_messages - 8);
+    for (size_t i = start; i < start + 1 + g; i++) on2[i] = false;
+  }
+  std::vector<uint32_t> feed2;
+  for (size_t i = 0; i < phase2_messages; i++) {
+    if (on2[i]) feed2.push_back(messages + i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes, internal pipes and side channels
+  using FeedAProducer =
+      Producer<FeedAReadIOPipeID, FeedMessage, use_usm_host_alloc>;
+  using FeedBProducer =
+      Producer<FeedBReadIOPipeID, FeedMessage, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<FeedWriteIOPipeID, FeedMessage, use_usm_host_alloc>;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+  using FeedPipes = fpga_tools::PipeArray<FeedPipesID, FeedMessage, 16, 2>;
+  using CommandSideChannel =
+      HostToDeviceSideChannel<FeedCommandSideChannelID,
+                              fpga_tools::FeedArbiterCommand,
+                              use_usm_host_alloc, 1>;
+  using AckSideChannel =
+      DeviceToHostSideChannel<FeedAckSideChannelID, uint32_t,
+                              use_usm_host_alloc, 1>;
+  using GapSideChannel =
+      DeviceToHostSideChannel<FeedGapSideChannelID, FeedGap,
+                              use_usm_host_alloc, kFeedGapCapacity>;
+
+  FeedAProducer::Init(q, std::max(feed[0].size(), feed2.size()));
+  FeedBProducer::Init(q, feed[1].size());
+  FakeIOPipeOutConsumer::Init(q, messages);
+  CommandSideChannel::Init(q);
+  AckSideChannel::Init(q);
+  GapSideChannel::Init(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  fpga_tools::FeedArbiterCounters *counters =
+      malloc_host<fpga_tools::FeedArbiterCounters>(1, q);
+  if (counters == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the counters\n";
+    std::terminate();
+  }
+
+  auto arbiter_event = q.single_task<FeedArbiterKernel>([=] {
+    fpga_tools::FeedArbiter<kFeedWindow, FeedPipes, WriteIOPipe,
+                            CommandSideChannel, AckSideChannel,
+                            GapSideChannel>(first_seq, 0, counters,
+                                            FeedSeqOf);
+  });
+
+  bool passed = true;
+  size_t total_in = 0;
+  double total_ms = 0;
+  uint64_t forwarded = 0;
+  uint64_t gaps = 0;
+  for (int phase = 1; phase <= 2; phase++) {
+    if (phase == 2) {
+      CommandSideChannel::write(
+          {fpga_tools::kFeedArbiterSetTimeout, kTimeout});
+    }
+    const std::vector<uint32_t> &a = phase == 1 ? feed[0] : feed2;
+    const size_t b_count = phase == 1 ? feed[1].size() : 0;
+    const size_t phase_messages = phase == 1 ? messages : phase2_messages;
+    auto delivered = [&](size_t i) {
+      return phase == 1 ? on[i] != 0 : bool(on2[i]);
+    };
+
+    // the expected output and gaps
+    std::vector<uint32_t> expected_out;
+    std::vector<FeedGap> expected_gaps;
+    const uint32_t phase_seq = first_seq + (phase == 1 ? 0 : messages);
+    for (size_t i = 0; i < phase_messages; i++) {
+      if (delivered(i)) {
+        expected_out.push_back(phase_seq + i);
+      } else if (i != 0 && !delivered(i - 1)) {
+        expected_gaps.back().count++;
+      } else {
+        expected_gaps.push_back({uint32_t(phase_seq + i), 1});
+      }
+    }
+
+    FeedMessage *a_data = FeedAProducer::Data();
+    for (size_t i = 0; i < a.size(); i++) {
+      a_data[i] = FeedMakeMessage(first_seq + a[i]);
+    }
+    FeedMessage *b_data = FeedBProducer::Data();
+    for (size_t i = 0; i < b_count; i++) {
+      b_data[i] = FeedMakeMessage(first_seq + feed[1][i]);
+    }
+    total_in += a.size() + b_count;
+
+    // the link kernels
+    std::vector<event> link_events;
+    fpga_tools::UnrolledLoop<2>([&](auto f) {
+      using InPipe = std::conditional_t<f == 0, typename FeedAProducer::Pipe,
+                                        typename FeedBProducer::Pipe>;
+      const size_t n = f == 0 ? a.size() : b_count;
+      link_events.push_back(q.single_task<FeedLinkKernel<f>>([=] {
+        for (size_t i = 0; i < n; i++) {
+          FeedPipes::template PipeAt<f>::write(InPipe::read());
+        }
+      }));
+    });
+
+    event consume_dma_e, consume_kernel_e;
+    event produce_a_dma_e, produce_a_kernel_e;
+    event produce_b_dma_e, produce_b_kernel_e;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::tie(consume_dma_e, consume_kernel_e) =
+        FakeIOPipeOutConsumer::Start(q, expected_out.size());
+    std::tie(produce_a_dma_e, produce_a_kernel_e) =
+        FeedAProducer::Start(q, a.size());
+    std::tie(produce_b_dma_e, produce_b_kernel_e) =
+        FeedBProducer::Start(q, b_count);
+    produce_a_dma_e.wait();
+    produce_a_kernel_e.wait();
+    produce_b_dma_e.wait();
+    produce_b_kernel_e.wait();
+    for (auto &e : link_events) e.wait();
+    consume_kernel_e.wait();
+    consume_dma_e.wait();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> diff = end - start;
+    total_ms += diff.count();
+
+    // every delivered message, once and in order
+    FeedMessage *out = FakeIOPipeOutConsumer::Data();
+    for (size_t i = 0; i < expected_out.size() && passed; i++) {
+      const FeedMessage m = FeedMakeMessage(expected_out[i]);
+      if (out[i].seq != m.seq || out[i].payload[0] != m.payload[0] ||
+          out[i].payload[1] != m.payload[1] ||
+          out[i].payload[2] != m.payload[2]) {
+        std::cerr << "ERROR: phase " << phase << " output " << i
+                  << " has sequence number " << out[i].seq << ", expected "
+                  << m.seq << "\n";
+        passed &= false;
+      }
+    }
+
+    // the arbiter must be waiting for the message after the phase
+    CommandSideChannel::write({fpga_tools::kFeedArbiterReadCounters, 0});
+    const uint32_t next = AckSideChannel::read();
+    if (next != uint32_t(phase_seq + phase_messages)) {
+      std::cerr << "ERROR: phase " << phase << " ended at sequence number "
+                << next << ", expected " << phase_seq + phase_messages
+                << "\n";
+      passed &= false;
+    }
+
+    // the gaps
+    if (counters->unreported != 0) {
+      std::cerr << "ERROR: " << counters->unreported
+                << " gaps were not reported\n";
+      passed &= false;
+    }
+    if (counters->gaps - gaps != expected_gaps.size()) {
+      std::cerr << "ERROR: phase " << phase << " found "
+                << counters->gaps - gaps << " gaps, expected "
+                << expected_gaps.size() << "\n";
+      passed &= false;
+    }
+    for (size_t g = 0; g < expected_gaps.size() && passed; g++) {
+      FeedGap gap = GapSideChannel::read();
+      if (gap.first != expected_gaps[g].first ||
+          gap.count != expected_gaps[g].count) {
+        std::cerr << "ERROR: phase " << phase << " reported a gap of "
+                  << gap.count << " from " << gap.first << ", expected "
+                  << expected_gaps[g].count << " from "
+                  << expected_gaps[g].first << "\n";
+        passed &= false;
+      }
+    }
+    forwarded += expected_out.size();
+    gaps = counters->gaps;
+  }
+
+  // every other message was a duplicate
+  if (counters->forwarded != forwarded ||
+      counters->duplicates != total_in - forwarded) {
+    std::cerr << "ERROR: the arbiter forwarded " << counters->forwarded
+              << " messages and dropped " << counters->duplicates
+              << " duplicates, expected " << forwarded << " and "
+              << total_in - forwarded << "\n";
+    passed &= false;
+  }
+
+  std::cout << "Feed arbiter: " << total_in << " messages in, "
+            << counters->forwarded << " forwarded, " << counters->lost
+            << " lost in " << counters->gaps << " gaps in " << total_ms
+            << " ms\n";
+
+  CommandSideChannel::write({fpga_tools::kFeedArbiterStop, 0});
+  arbiter_event.wait();
+
+  free(counters, q);
+  FeedAProducer::Destroy(q);
+  FeedBProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+  CommandSideChannel::Destroy(q);
+  AckSideChannel::Destroy(q);
+  GapSideChannel::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __FEEDARBITERTEST_HPP__ */
@@ -0,0 +1,195 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __FFTTEST_HPP__
+#define __FFTTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+#include <sycl/ext/intel/ac_types/ac_fixed.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "data_bundle.hpp"
+#include "streaming_fft.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// Every sample type and size of the FFT is its own kernel with its own IO
+// pipes.
+template <typename TSample, int kSize, int kLanes> struct FftKernel;
+template <typename TSample, int kSize, int kLanes>
+struct FftReadIOPipeID { static constexpr unsigned id = 0; };
+template <typename TSample, int kSize, int kLanes>
+struct FftWriteIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// Submit a kernel that computes the FFTs of 'frames' frames of 'kSize'
+// samples from IOPipeIn and writes them to IOPipeOut.
+//
+template <class IOPipeIn, class IOPipeOut, typename TSample, int kSize,
+          int kLanes>
+event SubmitFftKernel(queue &q, size_t frames) {
+  return q.single_task<FftKernel<TSample, kSize, kLanes>>([=] {
+    fpga_tools::StreamingFFT<IOPipeIn, IOPipeOut, kSize>(frames);
+  });
+}
+
+// the value of a sample as a double, for the host reference
+template <typename T>
+double FftValue(const T &v) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return (double)v;
+  } else {
+    return v.to_double();
+  }
+}
+
+// a recursive radix-2 FFT on the host, in double precision
+inline void FftReference(std::vector<std::complex<double>> &x) {
+  const size_t n = x.size();
+  if (n == 1) return;
+  std::vector<std::complex<double>> even(n / 2), odd(n / 2);
+  for (size_t i = 0; i < n / 2; i++) {
+    even[i] = x[2 * i];
+    odd[i] = x[2 * i + 1];
+  }
+  FftReference(even);
+  FftReference(odd);
+  for (size_t k = 0; k < n / 2; k++) {
+    auto w = std::polar(1.0, -2 * M_PI * k / n) * odd[k];
+    x[k] = even[k] + w;
+    x[k + n / 2] = even[k] - w;
+  }
+}
+
+//
+// Run the FFT of one size on frames of random samples of type 'TSample' and
+// check the result against the FFT computed on the host. The error allowed
+// is relative to the largest output of the frame, plus, for fixed point
+// samples, the rounding of 'frac_bits' fractional bits in each of the
+// log2(kSize) stages.
+//
+template <typename TSample, bool use_usm_host_alloc, int kSize, int kLanes>
+bool RunFft(queue &q, size_t count, const char *name, int frac_bits = 0) {
+  using Complex = fpga_tools::FftComplex<TSample>;
+  using Beat = fpga_tools::DataBundle<Complex, kLanes>;
+  constexpr int kBeatsPerFrame = kSize / kLanes;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<FftReadIOPipeID<TSample, kSize, kLanes>, Beat,
+               use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<FftWriteIOPipeID<TSample, kSize, kLanes>, Beat,
+               use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  const size_t frames = std::max<size_t>(count / kSize, 1);
+  const size_t beats = frames * kBeatsPerFrame;
+  FakeIOPipeInProducer::Init(q, beats);
+  FakeIOPipeOutConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // random samples in [-1, 1]. The host FFT gets them after the conversion
+  // to 'TSample'.
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  std::vector<std::complex<double>> in(frames * kSize);
+  for (size_t i = 0; i < frames * kSize; i++) {
+    Complex sample(TSample((rand() % 2001 - 1000) / 1000.0),
+                   TSample((rand() % 2001 - 1000) / 1000.0));
+    in[i] = std::complex<double>(FftValue(sample.re), FftValue(sample.im));
+    i_stream_data[i / kLanes][i % kLanes] = sample;
+  }
+
+  auto kernel_event =
+      SubmitFftKernel<ReadIOPipe, WriteIOPipe, TSample, kSize, kLanes>(
+          q, frames);
+
+  event produce_dma_e, produce_kernel_e;
+  event consume_dma_e, consume_kernel_e;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
+  std::tie(consume_dma_e, consume_kernel_e) = FakeIOPipeOutConsumer::Start(q);
+
+  produce_dma_e.wait();
+  produce_kernel_e.wait();
+  consume_dma_e.wait();
+  consume_kernel_e.wait();
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "FFT (" << name << "): " << frames << " frames of " << kSize
+            << " samples, " << kLanes << " lanes, in " << diff.count()
+            << " ms\n";
+
+  // validate every frame against the host FFT. The error of the float FFT
+  // grows with the size and the magnitude of the output.
+  const double rounding =
+      frac_bits > 0 ? fpga_tools::Log2(kSize) * kSize * std::ldexp(1.0,
+                                                                  -frac_bits)
+                    : 0;
+  bool passed = true;
+  auto o_stream_data = FakeIOPipeOutConsumer::Data();
+  for (size_t f = 0; f < frames && passed; f++) {
+    std::vector<std::complex<double>> expected(in.begin() + f * kSize,
+                                               in.begin() + (f + 1) * kSize);
+    FftReference(expected);
+
+    double max_abs = 0;
+    for (auto &x : expected) max_abs = std::max(max_abs, std::abs(x));
+    const double tolerance = 1e-4 * max_abs + rounding;
+
+    for (int k = 0; k < kSize && passed; k++) {
+      size_t i = f * kSize + k;
+      Complex result = o_stream_data[i / kLanes][i % kLanes];
+      std::complex<double> out(FftValue(result.re), FftValue(result.im));
+      double error = std::abs(out - expected[k]);
+      if (error > tolerance) {
+        std::cerr << "ERROR: output mismatch in frame " << f << " at bin "
+                  << k << ": " << out << " != " << expected[k]
+                  << " (out != expected)\n";
+        passed &= false;
+      }
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It runs float FFTs of a few sizes, with radix-2 and radix-4 butterflies
+// across the lanes, and a fixed point FFT. The samples are complex floats
+// or ac_fixed, so the IO pipe type 'T' is unused.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunFftSystem(queue &q, size_t count) {
+  // 12 integer bits: 2 for the samples in [-1, 1], 8 for the growth of the
+  // 256-point transform and 2 to spare
+  using Fixed = ac_fixed<32, 12, true>;
+
+  bool passed = true;
+  passed &= RunFft<float, use_usm_host_alloc, 64, 2>(q, count, "float");
+  passed &= RunFft<float, use_usm_host_alloc, 256, 4>(q, count, "float");
+  passed &= RunFft<float, use_usm_host_alloc, 1024, 8>(q, count, "float");
+  passed &= RunFft<Fixed, use_usm_host_alloc, 256, 4>(q, count,
+                                                      "ac_fixed<32, 12>", 20);
+  return passed;
+}
+
+#endif /* __FFTTEST_HPP__ */
@@ -0,0 +1,506 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __HASHJOINTEST_HPP__
+#define __HASHJOINTEST_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "constexpr_math.hpp"
+#include "onchip_memory_with_cache.hpp"
+#include "tuple.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct HashJoinBuildSide;
+struct HashJoinProbeSide;
+template <class Side> struct HashJoinSideKernel;
+template <class Side> struct HashJoinInputPipeID;
+struct HashJoinCoreKernel;
+struct HashJoinResultWriterKernel;
+struct HashJoinOutputPipeID;
+struct HashJoinBuildReadIOPipeID { static constexpr unsigned id = 0; };
+struct HashJoinProbeReadIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// The relations are streams of 64-bit tuples: the key in the low 32 bits
+// and the payload in the high 32 bits. A match of build tuple (k, a) and
+// probe tuple (k, b) is output as the tuple (k, a, b).
+//
+using JoinTuple = fpga_tools::Tuple<uint32_t, uint32_t, uint32_t>;
+
+// A matched tuple, or the end of the output if 'last' is set. The end of
+// the output carries the number of build tuples that didn't fit the hash
+// table or its overflow area in the key field.
+using JoinOutputBeat = fpga_tools::Tuple<JoinTuple, bool>;
+
+// A tuple from one side of the join, or the end of a partition
+struct JoinInput {
+  uint64_t tuple;
+  bool last;
+};
+
+// The on-chip hash table has kJoinBuckets buckets of kJoinSlots slots. A
+// key lives in one bucket and a probe compares all of its slots at once.
+// The tuples of a bucket that don't fit its slots are chained in an
+// overflow area of kJoinOverflowSlots slots, shared by all buckets.
+constexpr int kJoinBuckets = 2048;
+constexpr int kJoinSlots = 8;
+constexpr int kJoinOverflowSlots = 4096;
+static_assert(kJoinOverflowSlots <= 0x10000, "chain entries are 16 bits");
+constexpr int kJoinBucketBits = fpga_tools::Log2(kJoinBuckets);
+constexpr int kJoinMaxPartitions = 1024;
+
+// Build tuples per partition that keep the chance of a full bucket low
+constexpr int kJoinTargetPartitionSize = kJoinBuckets * kJoinSlots / 4;
+
+constexpr int kJoinPartitionBits = fpga_tools::Log2(kJoinMaxPartitions);
+
+// The bucket and the partition come from the top bits of a multiplicative
+// hash, which are the well mixed ones, and don't overlap
+inline uint32_t JoinHash(uint32_t key) { return key * 0x9E3779B1u; }
+inline uint32_t JoinBucket(uint32_t h) { return h >> (32 - kJoinBucketBits); }
+inline uint32_t JoinPartition(uint32_t h, uint32_t num_partitions) {
+  return (h >> (32 - kJoinBucketBits - kJoinPartitionBits)) &
+         (num_partitions - 1);
+}
+
+//
+// Submit the kernel for one side of the join.
+//
+// With one partition, the 'count' tuples from IOPipeIn are forwarded
+// straight to the join, followed by an end of partition marker. With more
+// partitions, the tuples are sorted by partition into device memory and
+// then replayed one partition at a time:
+//    1. the tuples are copied to 'staging' in arrival order, while a
+//       histogram counts the tuples of each partition
+//    2. the histogram gives the exact start of each partition in 'spill',
+//       and the tuples are moved there from 'staging'
+// So every partition gets exactly the room it needs, however skewed the
+// keys are. 'staging' and 'spill' both hold 'count' tuples.
+//
+template <class Side, class IOPipeIn, class JoinPipe>
+event SubmitHashJoinSideKernel(queue &q, size_t count, uint32_t num_partitions,
+                               uint64_t *staging, uint64_t *spill) {
+  return q.single_task<HashJoinSideKernel<Side>>([=
+  ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+    if (num_partitions == 1) {
+      for (size_t i = 0; i < count; i++) {
+        JoinPipe::write({IOPipeIn::read(), false});
+      }
+      JoinPipe::write({0, true});
+      return;
+    }
+
+    // The histogram, and then the write position of each partition. It is
+    // read and updated every cycle, so it is kept in a cached memory.
+    fpga_tools::OnchipMemoryWithCache<uint32_t, kJoinMaxPartitions, 8> fill;
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      fill.write(p, 0);
+    }
+
+    // stage the tuples and count them
+    for (size_t i = 0; i < count; i++) {
+      uint64_t t = IOPipeIn::read();
+      staging[i] = t;
+      uint32_t p = JoinPartition(JoinHash(t), num_partitions);
+      fill.write(p, fill.read(p) + 1);
+    }
+
+    // the start of each partition
+    uint32_t start = 0;
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      uint32_t n = fill.read(p);
+      fill.write(p, start);
+      start += n;
+    }
+
+    // move the tuples to their partition
+    [[intel::ivdep(spill)]]  // NO-FORMAT: Attribute
+    for (size_t i = 0; i < count; i++) {
+      uint64_t t = staging[i];
+      uint32_t p = JoinPartition(JoinHash(t), num_partitions);
+      uint32_t n = fill.read(p);
+      spill[n] = t;
+      fill.write(p, n + 1);
+    }
+
+    // replay the partitions in order. Each one now ends where the next one
+    // starts.
+    size_t i = 0;
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      uint32_t end = fill.read(p);
+      for (; i < end; i++) {
+        JoinPipe::write({spill[i], false});
+      }
+      JoinPipe::write({0, true});
+    }
+  });
+}
+
+//
+// Submit the join kernel.
+//
+// For each of 'num_partitions' partitions, the build tuples from BuildPipe
+// are inserted into the on-chip hash table. Then the probe tuples from
+// ProbePipe are looked up and every match is written to OutputPipe.
+//
+// Each bucket's fill level is read and updated by every insert, so it is
+// kept in a cached memory to allow an insert per cycle. Each fill level
+// is tagged with the partition that wrote it, so the table doesn't have
+// to be cleared between partitions.
+//
+// A build tuple whose bucket's slots are full is pushed onto the front of
+// the bucket's chain in the overflow area, so duplicate keys and crowded
+// buckets cost a probe a walk down the chain instead of failing the join.
+// The fill level counts the chained tuples too, which tells a probe how
+// far to walk. Only when the overflow area is full too is a build tuple
+// counted and skipped; the host then reruns the join with more partitions.
+//
+template <class BuildPipe, class ProbePipe, class OutputPipe>
+event SubmitHashJoinCoreKernel(queue &q, uint32_t num_partitions) {
+  return q.single_task<HashJoinCoreKernel>([=] {
+    // the bucket fill levels: the partition in the high 16 bits and the
+    // number of tuples in the low 16 bits
+    fpga_tools::OnchipMemoryWithCache<uint32_t, kJoinBuckets, 8> fill(
+        0xFFFF0000u);
+    uint64_t slots[kJoinSlots][kJoinBuckets];
+
+    // the overflow chains: the first entry of each bucket's chain, and the
+    // tuple and the next entry of each entry
+    fpga_tools::OnchipMemoryWithCache<uint16_t, kJoinBuckets, 8> chain_head;
+    uint64_t overflow_tuple[kJoinOverflowSlots];
+    uint16_t overflow_next[kJoinOverflowSlots];
+    uint32_t overflow = 0;
+
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      // build
+      uint32_t overflow_used = 0;
+      bool done = false;
+      while (!done) {
+        auto in = BuildPipe::read();
+        done = in.last;
+        if (!done) {
+          uint32_t b = JoinBucket(JoinHash(in.tuple));
+          uint32_t f = fill.read(b);
+          uint32_t n = ((f >> 16) == p) ? (f & 0xFFFF) : 0;
+          if (n < kJoinSlots) {
+            fpga_tools::UnrolledLoop<kJoinSlots>([&](auto s) {
+              if (s == n) slots[s][b] = in.tuple;
+            });
+            fill.write(b, (p << 16) | (n + 1));
+          } else if (overflow_used < kJoinOverflowSlots) {
+            // the old head is stale for the first chained tuple, but the
+            // fill level stops the walk before it is followed
+            overflow_tuple[overflow_used] = in.tuple;
+            overflow_next[overflow_used] = chain_head.read(b);
+            chain_head.write(b, overflow_used);
+            overflow_used++;
+            fill.write(b, (p << 16) | (n + 1));
+          } else {
+            overflow++;
+          }
+        }
+      }
+
+      // probe
+      done = false;
+      while (!done) {
+        auto in = ProbePipe::read();
+        done = in.last;
+        if (!done) {
+          uint32_t key = in.tuple;
+          uint32_t b = JoinBucket(JoinHash(key));
+          uint32_t f = fill.read(b);
+          uint32_t n = ((f >> 16) == p) ? (f & 0xFFFF) : 0;
+          fpga_tools::UnrolledLoop<kJoinSlots>([&](auto s) {
+            uint64_t t = slots[s][b];
+            if (s < n && (uint32_t)t == key) {
+              JoinTuple out(key, t >> 32, in.tuple >> 32);
+              OutputPipe::write(JoinOutputBeat(out, false));
+            }
+          });
+
+          // walk the bucket's overflow chain
+          if (n > kJoinSlots) {
+            uint16_t e = chain_head.read(b);
+            for (uint32_t i = kJoinSlots; i < n; i++) {
+              uint64_t t = overflow_tuple[e];
+              if ((uint32_t)t == key) {
+                JoinTuple out(key, t >> 32, in.tuple >> 32);
+                OutputPipe::write(JoinOutputBeat(out, false));
+              }
+              e = overflow_next[e];
+            }
+          }
+        }
+      }
+    }
+
+    OutputPipe::write(JoinOutputBeat(JoinTuple(overflow, 0, 0), true));
+  });
+}
+
+//
+// Submit the kernel that writes the joined tuples to memory. At most
+// 'capacity' tuples are written. stats[0] is set to the number of tuples
+// output by the join and stats[1] to the number of build tuples that
+// didn't fit the hash table or its overflow area.
+//
+template <class OutputPipe>
+event SubmitHashJoinResultWriterKernel(queue &q, JoinTuple *out,
+                                       size_t capacity, uint64_t *stats) {
+  return q.single_task<HashJoinResultWriterKernel>([=
+  ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+    uint64_t n = 0;
+    bool done = false;
+    while (!done) {
+      JoinOutputBeat beat = OutputPipe::read();
+      done = beat.get<1>();
+      if (done) {
+        stats[1] = beat.get<0>().get<0>();
+      } else {
+        if (n < capacity) out[n] = beat.get<0>();
+        n++;
+      }
+    }
+    stats[0] = n;
+  });
+}
+
+//
+// Run one join of 'build_count' build tuples and 'probe_count' probe
+// tuples and check the result against a host reference. The first
+// 'hot_key_count' build tuples share one key, to skew the input.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunHashJoin(queue &q, size_t build_count, size_t probe_count,
+                 size_t hot_key_count = 0) {
+  static_assert(sizeof(T) == sizeof(uint64_t));
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using BuildProducer =
+      Producer<HashJoinBuildReadIOPipeID, T, use_usm_host_alloc>;
+  using ProbeProducer =
+      Producer<HashJoinProbeReadIOPipeID, T, use_usm_host_alloc>;
+  using BuildReadIOPipe = typename BuildProducer::Pipe;
+  using ProbeReadIOPipe = typename ProbeProducer::Pipe;
+
+  BuildProducer::Init(q, build_count);
+  ProbeProducer::Init(q, probe_count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // pipes between the join kernels
+  using BuildPipe =
+      sycl::ext::intel::pipe<HashJoinInputPipeID<HashJoinBuildSide>, JoinInput,
+                             16>;
+  using ProbePipe =
+      sycl::ext::intel::pipe<HashJoinInputPipeID<HashJoinProbeSide>, JoinInput,
+                             16>;
+  using OutputPipe =
+      sycl::ext::intel::pipe<HashJoinOutputPipeID, JoinOutputBeat, 16>;
+
+  // the relations. Keys are drawn from a range twice the size of the build
+  // relation, so some build keys repeat and about half the probes match.
+  const uint32_t key_range = 2 * build_count;
+  auto build_data = BuildProducer::Data();
+  auto probe_data = ProbeProducer::Data();
+  const uint32_t hot_key = rand() % key_range;
+  for (size_t i = 0; i < build_count; i++) {
+    uint32_t key = (i < hot_key_count) ? hot_key : rand() % key_range;
+    build_data[i] = ((T)i << 32) | key;
+  }
+  for (size_t i = 0; i < probe_count; i++) {
+    // probe the hot key now and then
+    bool hot = hot_key_count != 0 && i % 1024 == 0;
+    uint32_t key = hot ? hot_key : rand() % key_range;
+    probe_data[i] = ((T)i << 32) | key;
+  }
+
+  // the reference join
+  std::unordered_multimap<uint32_t, uint32_t> build_table;
+  for (size_t i = 0; i < build_count; i++) {
+    build_table.emplace((uint32_t)build_data[i], build_data[i] >> 32);
+  }
+  std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> expected;
+  for (size_t i = 0; i < probe_count; i++) {
+    auto range = build_table.equal_range((uint32_t)probe_data[i]);
+    for (auto it = range.first; it != range.second; it++) {
+      expected.emplace_back(it->first, it->second, probe_data[i] >> 32);
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  // Room for the results. With this key distribution a probe matches about
+  // one build tuple on average, but a probe of the hot key matches all of
+  // its tuples. The writer counts matches beyond the capacity, so an
+  // overflow is detected.
+  const size_t capacity = std::max(2 * probe_count, expected.size()) + 1024;
+  JoinTuple *result_host = new JoinTuple[capacity];
+  JoinTuple *result = use_usm_host_alloc ? malloc_host<JoinTuple>(capacity, q)
+                                         : malloc_device<JoinTuple>(capacity, q);
+  uint64_t *stats = malloc_host<uint64_t>(2, q);
+
+  // Spill to device memory if the build relation is larger than the
+  // on-chip table. If the overflow area fills up, rerun with twice the
+  // partitions.
+  uint32_t num_partitions = 1;
+  while (num_partitions * kJoinTargetPartitionSize < build_count) {
+    num_partitions *= 2;
+  }
+
+  bool passed = true;
+  uint64_t last_overflow = std::numeric_limits<uint64_t>::max();
+  while (true) {
+    if (num_partitions > kJoinMaxPartitions) {
+      std::cerr << "ERROR: the build relation needs more than "
+                << kJoinMaxPartitions << " partitions\n";
+      passed = false;
+      break;
+    }
+
+    // The partitions are sized by a histogram of the tuples, so they need
+    // no more room than the tuples themselves, staged once and sorted once
+    uint64_t *build_staging = nullptr, *build_spill = nullptr;
+    uint64_t *probe_staging = nullptr, *probe_spill = nullptr;
+    if (num_partitions > 1) {
+      build_staging = malloc_device<uint64_t>(build_count, q);
+      build_spill = malloc_device<uint64_t>(build_count, q);
+      probe_staging = malloc_device<uint64_t>(probe_count, q);
+      probe_spill = malloc_device<uint64_t>(probe_count, q);
+      if (build_staging == nullptr || build_spill == nullptr ||
+          probe_staging == nullptr || probe_spill == nullptr) {
+        std::cerr << "ERROR: failed to allocate space for the partitions\n";
+        std::terminate();
+      }
+    }
+
+    auto build_event =
+        SubmitHashJoinSideKernel<HashJoinBuildSide, BuildReadIOPipe,
+                                 BuildPipe>(q, build_count, num_partitions,
+                                            build_staging, build_spill);
+    auto probe_event =
+        SubmitHashJoinSideKernel<HashJoinProbeSide, ProbeReadIOPipe,
+                                 ProbePipe>(q, probe_count, num_partitions,
+                                            probe_staging, probe_spill);
+    auto core_event =
+        SubmitHashJoinCoreKernel<BuildPipe, ProbePipe, OutputPipe>(
+            q, num_partitions);
+    auto writer_event = SubmitHashJoinResultWriterKernel<OutputPipe>(
+        q, result, capacity, stats);
+
+    event build_dma_event, build_kernel_event;
+    event probe_dma_event, probe_kernel_event;
+    std::tie(build_dma_event, build_kernel_event) = BuildProducer::Start(q);
+    std::tie(probe_dma_event, probe_kernel_event) = ProbeProducer::Start(q);
+
+    build_dma_event.wait();
+    build_kernel_event.wait();
+    probe_dma_event.wait();
+    probe_kernel_event.wait();
+    build_event.wait();
+    probe_event.wait();
+    core_event.wait();
+    writer_event.wait();
+
+    if (num_partitions > 1) {
+      free(build_staging, q);
+      free(build_spill, q);
+      free(probe_staging, q);
+      free(probe_spill, q);
+    }
+
+    std::cout << "Hash join: " << build_count << " x " << probe_count
+              << " tuples in " << num_partitions << " partition(s), "
+              << stats[0] << " matches, expecting " << expected.size()
+              << "\n";
+
+    if (stats[1] == 0) break;
+
+    // the tuples of one key stay in one bucket however many partitions
+    // there are
+    if (stats[1] >= last_overflow) {
+      std::cerr << "ERROR: " << stats[1] << " build tuples did not fit, and "
+                << "repartitioning does not help. A key has more tuples than "
+                << kJoinSlots + kJoinOverflowSlots << "\n";
+      passed = false;
+      break;
+    }
+    last_overflow = stats[1];
+
+    std::cout << "Hash join: " << stats[1] << " build tuples did not fit, "
+              << "repartitioning\n";
+    num_partitions *= 2;
+  }
+
+  if (passed) {
+    size_t n = std::min<size_t>(stats[0], capacity);
+    if (use_usm_host_alloc) {
+      std::copy(result, result + n, result_host);
+    } else {
+      q.memcpy(result_host, result, n * sizeof(JoinTuple)).wait();
+    }
+
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> actual;
+    for (size_t i = 0; i < n; i++) {
+      actual.emplace_back(result_host[i].get<0>(), result_host[i].get<1>(),
+                          result_host[i].get<2>());
+    }
+    std::sort(actual.begin(), actual.end());
+
+    if (stats[0] > capacity) {
+      std::cerr << "ERROR: the join output more tuples than there is room for\n";
+      passed = false;
+    } else if (stats[0] != expected.size() || actual != expected) {
+      std::cerr << "ERROR: the join result does not match the reference\n";
+      passed = false;
+    }
+  }
+
+  delete[] result_host;
+  free(result, q);
+  free(stats, q);
+  BuildProducer::Destroy(q);
+  ProbeProducer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It runs a join whose build relation fits the on-chip hash table, one
+// whose build relation is spilled to device memory in partitions, and a
+// partitioned one with a hot key that has far more tuples than a bucket
+// has slots.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunHashJoinSystem(queue &q, size_t count) {
+  bool passed = true;
+
+  size_t small_build = std::min<size_t>(count, kJoinTargetPartitionSize);
+  passed &= RunHashJoin<T, use_usm_host_alloc>(q, small_build, count);
+
+  size_t large_build = std::min<size_t>(
+      count, kJoinTargetPartitionSize * (kJoinMaxPartitions / 4));
+  large_build = std::max<size_t>(large_build, 4 * kJoinTargetPartitionSize);
+  passed &= RunHashJoin<T, use_usm_host_alloc>(q, large_build, count);
+
+  passed &= RunHashJoin<T, use_usm_host_alloc>(q, large_build, count,
+                                               kJoinOverflowSlots / 2);
+
+  return passed;
+}
+
+#endif /* __HASHJOINTEST_HPP__ */
@@ -0,0 +1,181 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __HOSTCOMPLETIONQUEUE_HPP__
+#define __HOSTCOMPLETIONQUEUE_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+using namespace sycl;
+
+//
+// Runs host callbacks when SYCL events complete, on a completion thread,
+// so that the host does not block on event waits.
+//
+// Calling wait() on the events of a producer, a consumer and their DMAs
+// blocks the host thread until each of them is done, which serializes the
+// streams one host thread can drive. Instead, the host attaches a callback
+// to the events with OnComplete() and moves on. The completion thread polls
+// the status of the events and calls each callback once all of its events
+// have completed. A callback can launch more work and attach the next
+// callback to it, so a whole chain of launches runs without the host
+// thread, which only waits once, in Drain(), for everything to finish.
+//
+// An exception thrown by a callback does not stop the completion thread.
+// The callback counts as run, and Drain() rethrows the first such exception
+// once every other callback has run.
+//
+// EXAMPLE USAGE
+//    HostCompletionQueue completions;
+//    completions.OnComplete(MyProducer::Start(q), [&] { ... });
+//    ...
+//    completions.Drain();
+//
+class HostCompletionQueue {
+ public:
+  using Callback = std::function<void()>;
+
+  explicit HostCompletionQueue(
+      std::chrono::microseconds poll_interval = std::chrono::microseconds(20))
+      : poll_interval_(poll_interval), thread_([this] { Run(); }) {}
+
+  // disable copy constructor and operator=
+  HostCompletionQueue(const HostCompletionQueue &) = delete;
+  HostCompletionQueue &operator=(HostCompletionQueue const &) = delete;
+
+  ~HostCompletionQueue() {
+    try {
+      Drain();
+    } catch (const std::exception &e) {
+      std::cerr << "ERROR: a completion callback threw an exception that was "
+                << "not drained: " << e.what() << "\n";
+    } catch (...) {
+      std::cerr << "ERROR: a completion callback threw an exception that was "
+                << "not drained\n";
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // call 'callback' on the completion thread once all of 'events' have
+  // completed. Can be called from a callback.
+  void OnComplete(std::vector<event> events, Callback callback) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      incoming_.push_back({std::move(events), std::move(callback)});
+      outstanding_++;
+    }
+    cv_.notify_all();
+  }
+
+  // the (DMA, kernel) events from the Start() or Launch() of a Producer or
+  // Consumer (see FakeIOPipes.hpp)
+  void OnComplete(std::pair<event, event> events, Callback callback) {
+    OnComplete(std::vector<event>{events.first, events.second},
+               std::move(callback));
+  }
+
+  // block until every callback, including the ones added by callbacks, has
+  // run, then rethrow the first exception a callback threw since the last
+  // Drain(), if any. Must not be called from a callback.
+  void Drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [&] { return outstanding_ == 0; });
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+  // the number of callbacks that have not run yet
+  size_t Outstanding() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outstanding_;
+  }
+
+ private:
+  struct Continuation {
+    std::vector<event> events;
+    Callback callback;
+  };
+
+  // drop the completed events, and return whether all of them are
+  static bool Completed(std::vector<event> &events) {
+    while (!events.empty() &&
+           events.back().get_info<info::event::command_execution_status>() ==
+               info::event_command_status::complete) {
+      events.pop_back();
+    }
+    return events.empty();
+  }
+
+  // the completion thread
+  void Run() {
+    // only the completion thread touches 'waiting', so the events are polled
+    // and the callbacks run without holding the lock
+    std::list<Continuation> waiting;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (waiting.empty()) {
+          cv_.wait(lock, [&] { return stop_ || !incoming_.empty(); });
+          if (stop_ && incoming_.empty()) return;
+        }
+        waiting.splice(waiting.end(), incoming_);
+      }
+
+      bool progress = false;
+      for (auto it = waiting.begin(); it != waiting.end();) {
+        if (Completed(it->events)) {
+          // keep the first exception for Drain(), and carry on with the
+          // other callbacks
+          std::exception_ptr error;
+          try {
+            it->callback();
+          } catch (...) {
+            error = std::current_exception();
+          }
+          it = waiting.erase(it);
+          progress = true;
+
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (error && !error_) error_ = error;
+          if (--outstanding_ == 0) idle_cv_.notify_all();
+        } else {
+          ++it;
+        }
+      }
+
+      // back off while the device works
+      if (!progress) std::this_thread::sleep_for(poll_interval_);
+    }
+  }
+
+  const std::chrono::microseconds poll_interval_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;       // new callbacks or stop
+  std::condition_variable idle_cv_;  // outstanding_ reached 0
+  std::list<Continuation> incoming_;
+  size_t outstanding_{0};
+  std::exception_ptr error_;  // the first exception thrown by a callback
+  bool stop_{false};
+  std::thread thread_;
+};
+
+#endif /* __HOSTCOMPLETIONQUEUE_HPP__ */
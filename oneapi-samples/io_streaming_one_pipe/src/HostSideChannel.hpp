@@ -4,6 +4,7 @@
 #ifndef __HOSTSIDECHANNEL_HPP__
 #define __HOSTSIDECHANNEL_HPP__
 
+#include <cstdint>
 #include <iostream>
 #include <type_traits>
 
@@ -11,6 +12,8 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "FakeIOPipes.hpp"
+#include "HostCompletionQueue.hpp"
+#include "unrolled_loop.hpp"
 
 using namespace sycl;
 
@@ -19,7 +22,9 @@ using namespace sycl;
 // latency, side channel to send data from the host to the device. It exposes
 // a read() interface to the DEVICE code that the user can treat just like a
 // SYCL pipe. It also exposes a write interface to the HOST that allows the
-// user to easily write data from host to the device
+// user to easily write data from host to the device. Each write launches the
+// producer on its low latency launch path (see PrepareLaunch() in
+// FakeIOPipes.hpp).
 //
 template <typename Id, typename T, bool use_host_alloc, size_t min_capacity=0>
 class HostToDeviceSideChannel {
@@ -36,6 +41,7 @@ public:
   static void Init(queue &q) {
     q_ = &q;
     MyProducer::Init(q, 1);
+    MyProducer::PrepareLaunch(q);
   };
 
   static void Destroy(queue &q) {
@@ -59,11 +65,9 @@ public:
     // populate the data
     MyProducer::Data()[0] = data;
 
-    // start the kernel and wait on it to finish (blocking)
-    event dma, kernel;
-    std::tie(dma, kernel) = MyProducer::Start(*q_);
-    dma.wait();
-    kernel.wait();
+    // start the kernel and wait on it to finish (blocking). The launch
+    // queue is in-order, so the kernel finishes after the DMA.
+    MyProducer::Launch().second.wait();
   }
 
   // non-blocking
@@ -77,7 +81,124 @@ public:
     MyProducer::Data()[0] = data;
 
     // start the kernel and return the kernel event
-    return MyProducer::Start(*q_).second;
+    return MyProducer::Launch().second;
+  }
+};
+
+//
+// A message of a MultiplexedSideChannel: a new value for one of its logical
+// channels
+//
+template <typename T>
+struct SideChannelMessage {
+  uint16_t channel;
+  T value;
+};
+
+//
+// This class multiplexes 'channels' logical host to device side channels,
+// such as the tunables of a kernel, over one pipe and one producer kernel,
+// instead of one HostToDeviceSideChannel (with its own pipe and kernel) for
+// each. The HOST stages (channel, value) updates and sends a batch of up to
+// 'max_batch' of them with a single launch. The DEVICE demultiplexes them,
+// in order, either into a register per channel with Poll() or into a pipe
+// per channel with Demux().
+//
+template <typename Id, typename T, size_t channels, bool use_host_alloc,
+          size_t max_batch=16, size_t min_capacity=0>
+class MultiplexedSideChannel {
+protected:
+  using Message = SideChannelMessage<T>;
+  using MyProducer = Producer<Id, Message, use_host_alloc, min_capacity>;
+  static inline size_t staged_{0};
+
+public:
+  static_assert(channels > 0 && channels <= 0x10000);
+  static_assert(max_batch > 0);
+
+  // disable copy constructor and operator=
+  MultiplexedSideChannel()=delete;
+  MultiplexedSideChannel(const MultiplexedSideChannel &)=delete;
+  MultiplexedSideChannel& operator=(MultiplexedSideChannel const &)=delete;
+
+  static void Init(queue &q) {
+    MyProducer::Init(q, max_batch);
+    MyProducer::PrepareLaunch(q);
+    staged_ = 0;
+  };
+
+  static void Destroy(queue &q) {
+    MyProducer::Destroy(q);
+  };
+
+  // HOST CODE
+  // add an update to the batch, sending the batch first if it is full
+  static void Stage(size_t channel, const T &data) {
+    if (channel >= channels) {
+      std::cerr << "ERROR: side channel " << channel << " does not exist\n";
+      std::terminate();
+    }
+    if (staged_ == max_batch) Flush();
+    MyProducer::Data()[staged_++] = {uint16_t(channel), data};
+  }
+
+  // HOST CODE
+  // send the staged updates with one launch, and wait for them to be in the
+  // pipe (blocking). The device must be reading the channel, or the pipe
+  // must have room for the whole batch.
+  static void Flush() {
+    if (staged_ == 0) return;
+    MyProducer::Launch(staged_).second.wait();
+    staged_ = 0;
+  }
+
+  // HOST CODE
+  // send a single update (blocking)
+  static void write(size_t channel, const T &data) {
+    Stage(channel, data);
+    Flush();
+  }
+
+  static Message read() {
+    // DEVICE CODE
+    return MyProducer::Pipe::read();
+  }
+
+  static Message read(bool &success_code) {
+    // DEVICE CODE
+    return MyProducer::Pipe::read(success_code);
+  }
+
+  // DEVICE CODE
+  // apply the next update, if there is one, to 'registers', which hold the
+  // current value of each channel. Returns whether there was an update.
+  static bool Poll(T (&registers)[channels]) {
+    bool valid;
+    Message m = MyProducer::Pipe::read(valid);
+    if (valid) {
+      fpga_tools::UnrolledLoop<channels>([&](auto c) {
+        if (m.channel == int(c)) registers[c] = m.value;
+      });
+    }
+    return valid;
+  }
+
+  // DEVICE CODE
+  // forward the next update, if there is one, to the pipe of its channel in
+  // ChannelPipes, a PipeArray of 'channels' pipes of T. Returns whether
+  // there was an update.
+  template <typename ChannelPipes>
+  static bool Demux() {
+    bool valid;
+    Message m = MyProducer::Pipe::read(valid);
+    if (valid) {
+      fpga_tools::UnrolledLoop<channels>([&](auto c) {
+        if (m.channel == int(c)) {
+          ChannelPipes::template PipeAt<c>::write(m.value);
+        }
+      });
+    }
+    return valid;
   }
 };
 
@@ -86,7 +207,9 @@ public:
 // to send data from the device to the host. It exposes a read() interface
 // to the HOST code that lets the user get updates from the device.
 // It also exposes a write interface to the DEVICE that allows the user to
-// easily write data from device to the host.
+// easily write data from device to the host. Each read launches the
+// consumer on its low latency launch path (see PrepareLaunch() in
+// FakeIOPipes.hpp).
 //
 template <typename Id, typename T, bool use_host_alloc, size_t min_capacity=0>
 class DeviceToHostSideChannel {
@@ -103,6 +226,7 @@ public:
   static void Init(queue &q) {
     q_ = &q;
     MyConsumer::Init(q, 1);
+    MyConsumer::PrepareLaunch(q);
   };
 
   static void Destroy(queue &q) {
@@ -115,10 +239,7 @@ public:
     // HOST CODE
     // launch the kernel to read the data from the pipe into memory
     // and wait for it to finish (blocking)
-    event dma, kernel;
-    std::tie(dma, kernel) = MyConsumer::Start(*q_);
-    dma.wait();
-    kernel.wait();
+    LaunchRead().wait();
 
     // the kernel has finished, so return the data
     return MyConsumer::Data()[0];
@@ -130,9 +251,24 @@ public:
   static event read(bool &success_code) {
     // start the kernel and return the event
     // the user can use ::Data() later to get the data
-    // return the DMA event, since it happen second
     success_code = true;
-    return MyConsumer::Start(*q_).first;
+    return LaunchRead();
+  }
+
+  // non-blocking
+  // read 'count' updates, each launched when the previous one completes,
+  // and call 'on_data' with each of them, all on the completion thread of
+  // 'completions'. Call completions.Drain() to wait for the last one.
+  template <typename F>
+  static void ReadAsync(HostCompletionQueue &completions, size_t count,
+                        F on_data) {
+    // HOST CODE
+    if (count == 0) return;
+    completions.OnComplete({LaunchRead()},
+                           [&completions, count, on_data]() mutable {
+      on_data(Data());
+      ReadAsync(completions, count - 1, on_data);
+    });
   }
 
   static void write(const T &data) {
@@ -148,6 +284,15 @@ public:
   static T Data() {
     return MyConsumer::Data()[0];
   }
+
+private:
+  // launch the consumer, and return the event of the last command: the DMA
+  // if there is one, since the launch queue is in-order, else the kernel
+  static event LaunchRead() {
+    event dma, kernel;
+    std::tie(dma, kernel) = MyConsumer::Launch();
+    return use_host_alloc ? kernel : dma;
+  }
 };
 
 #endif /* __HOSTSIDECHANNEL_HPP__ */
@@ -0,0 +1,311 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __HYPERLOGLOGTEST_HPP__
+#define __HYPERLOGLOGTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "HostSideChannel.hpp"
+#include "onchip_memory_with_cache.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct HyperLogLogKernel;
+struct HyperLogLogReadIOPipeID { static constexpr unsigned id = 0; };
+struct HyperLogLogCommandSideChannelID;
+struct HyperLogLogSnapshotSideChannelID;
+
+// the commands the host sends to the HyperLogLog kernel
+constexpr int kHyperLogLogSnapshot = 0;
+constexpr int kHyperLogLogReset = 1;
+constexpr int kHyperLogLogStop = 2;
+
+//
+// The HyperLogLog hash: the 64-bit finalizer of MurmurHash3. The top
+// 'precision' bits of the hash select a register and the rank of the rest
+// is the position of its first set bit.
+//
+inline uint64_t HyperLogLogHash(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33;
+  key *= 0xC4CEB9FE1A85EC53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+template <int precision>
+void HyperLogLogIndexAndRank(uint64_t key, uint32_t &index, uint8_t &rank) {
+  constexpr int kRankBits = 64 - precision;
+  uint64_t hash = HyperLogLogHash(key);
+  index = hash >> kRankBits;
+
+  // priority encoder: the number of leading zeros of the low kRankBits bits
+  // plus one, or kRankBits + 1 if they are all zero
+  rank = kRankBits + 1;
+  fpga_tools::UnrolledLoop<kRankBits>([&](auto i) {
+    constexpr int kBit = i;
+    if ((hash >> kBit) & 1) rank = kRankBits - kBit;
+  });
+}
+
+//
+// Submit the HyperLogLog kernel.
+//
+// The kernel runs until the host sends kHyperLogLogStop. It reads keys from
+// IOPipeIn, one per cycle, and keeps the maximum rank seen by each of the
+// 2^precision registers. The registers live in an on-chip memory with a
+// small cache, which forwards the latest value of a register that was
+// updated in the last few cycles, so consecutive keys that hit the same
+// register don't stall the loop.
+//
+// Between frames of keys, and whenever the input goes idle, the kernel
+// checks for a command from the host:
+//    kHyperLogLogSnapshot: copy the registers to 'registers' and send the
+//                          number of keys they cover to the host
+//    kHyperLogLogReset:    clear the registers and send 0 to the host, so
+//                          that the host knows the reset happened before
+//                          it sends new keys
+//    kHyperLogLogStop:     exit
+//
+template <class IOPipeIn, class CommandSideChannel, class SnapshotSideChannel,
+          int precision>
+event SubmitHyperLogLogKernel(queue &q, uint8_t *registers,
+                              size_t frame_size) {
+  constexpr int kNumRegisters = 1 << precision;
+  constexpr size_t kTimeoutCounterMax = 1024;
+  constexpr int kCacheDepth = 4;
+
+  return q.single_task<HyperLogLogKernel>([=] {
+    fpga_tools::OnchipMemoryWithCache<uint8_t, kNumRegisters, kCacheDepth>
+        regs(0);
+    uint64_t keys = 0;
+    bool stop = false;
+
+    while (!stop) {
+      // process a frame of keys, or until the input goes idle
+      size_t processed = 0;
+      size_t timeout_counter = 0;
+      while (processed != frame_size &&
+             timeout_counter != kTimeoutCounterMax) {
+        bool valid_read;
+        auto key = IOPipeIn::read(valid_read);
+        if (valid_read) {
+          timeout_counter = 0;
+          processed++;
+
+          uint32_t index;
+          uint8_t rank;
+          HyperLogLogIndexAndRank<precision>(key, index, rank);
+          uint8_t old_rank = regs.read(index);
+          if (rank > old_rank) regs.write(index, rank);
+        } else {
+          timeout_counter++;
+        }
+      }
+      keys += processed;
+
+      // handle a command from the host
+      bool valid_command;
+      int command = CommandSideChannel::read(valid_command);
+      if (valid_command) {
+        if (command == kHyperLogLogSnapshot) {
+          for (int i = 0; i < kNumRegisters; i++) {
+            registers[i] = regs.read(i);
+          }
+          SnapshotSideChannel::write(keys);
+        } else if (command == kHyperLogLogReset) {
+          for (int i = 0; i < kNumRegisters; i++) {
+            regs.write(i, 0);
+          }
+          keys = 0;
+          SnapshotSideChannel::write(keys);
+        } else if (command == kHyperLogLogStop) {
+          stop = true;
+        }
+      }
+    }
+  });
+}
+
+//
+// Host side operations on register arrays: merging two sketches of
+// different streams gives the sketch of their union, and the estimate is
+// the bias corrected harmonic mean of the registers, with linear counting
+// for small cardinalities.
+//
+inline void HyperLogLogMerge(std::vector<uint8_t> &into,
+                             const std::vector<uint8_t> &other) {
+  for (size_t i = 0; i < into.size(); i++) {
+    into[i] = std::max(into[i], other[i]);
+  }
+}
+
+inline double HyperLogLogEstimate(const std::vector<uint8_t> &registers) {
+  const double m = registers.size();
+  double sum = 0;
+  int zeros = 0;
+  for (auto r : registers) {
+    sum += std::ldexp(1.0, -(int)r);
+    if (r == 0) zeros++;
+  }
+  const double alpha = 0.7213 / (1.0 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+  if (estimate <= 2.5 * m && zeros != 0) {
+    estimate = m * std::log(m / zeros);
+  }
+  return estimate;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It streams two sets of keys with a known number of distinct values
+// through the kernel, snapshots the registers after each one, and checks
+// them against registers computed on the host. It then checks the
+// estimates of each set, and of their union from the merged registers.
+//
+template <typename T, bool use_usm_host_alloc, int precision = 12>
+bool RunHyperLogLogSystem(queue &q, size_t count) {
+  constexpr int kNumRegisters = 1 << precision;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<HyperLogLogReadIOPipeID, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  FakeIOPipeInProducer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  //////////////////////////////////////////////////////////////////////////////
+  // the side channels
+  using CommandSideChannel =
+      HostToDeviceSideChannel<HyperLogLogCommandSideChannelID, int,
+                              use_usm_host_alloc, 1>;
+  using SnapshotSideChannel =
+      DeviceToHostSideChannel<HyperLogLogSnapshotSideChannelID, uint64_t,
+                              use_usm_host_alloc, 1>;
+  CommandSideChannel::Init(q);
+  SnapshotSideChannel::Init(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  uint8_t *registers = malloc_host<uint8_t>(kNumRegisters, q);
+  if (registers == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the registers\n";
+    std::terminate();
+  }
+
+  auto kernel_event =
+      SubmitHyperLogLogKernel<ReadIOPipe, CommandSideChannel,
+                              SnapshotSideChannel, precision>(q, registers,
+                                                              1024);
+
+  // stream 'count' keys with about count / 4 distinct values, starting at
+  // 'base', and return a snapshot of the registers
+  auto run_set = [&](uint64_t base, std::unordered_set<uint64_t> &distinct,
+                     std::vector<uint8_t> &snapshot) {
+    auto i_stream_data = FakeIOPipeInProducer::Data();
+    std::vector<uint8_t> expected(kNumRegisters, 0);
+    const uint64_t range = std::max<size_t>(count / 4, 1);
+    for (size_t i = 0; i < count; i++) {
+      i_stream_data[i] = base + (uint64_t)rand() % range;
+      distinct.insert(i_stream_data[i]);
+
+      uint32_t index;
+      uint8_t rank;
+      HyperLogLogIndexAndRank<precision>(i_stream_data[i], index, rank);
+      expected[index] = std::max(expected[index], rank);
+    }
+
+    CommandSideChannel::write(kHyperLogLogReset);
+    (void)SnapshotSideChannel::read();
+
+    event dma_event, kernel_event;
+    std::tie(dma_event, kernel_event) = FakeIOPipeInProducer::Start(q);
+    dma_event.wait();
+    kernel_event.wait();
+
+    // the keys may still be in flight, so snapshot until all are covered
+    uint64_t keys = 0;
+    do {
+      CommandSideChannel::write(kHyperLogLogSnapshot);
+      keys = SnapshotSideChannel::read();
+    } while (keys < count);
+    snapshot.assign(registers, registers + kNumRegisters);
+
+    bool ok = keys == count;
+    if (!ok) {
+      std::cerr << "ERROR: the snapshot covers " << keys
+                << " keys, expected " << count << "\n";
+    }
+    for (int i = 0; i < kNumRegisters && ok; i++) {
+      if (snapshot[i] != expected[i]) {
+        std::cerr << "ERROR: register " << i << " is " << (int)snapshot[i]
+                  << ", expected " << (int)expected[i] << "\n";
+        ok = false;
+      }
+    }
+    return ok;
+  };
+
+  // the expected standard error of the estimate is 1.04 / sqrt(m)
+  const double tolerance = 5 * 1.04 / std::sqrt((double)kNumRegisters);
+  auto check_estimate = [&](const char *name,
+                            const std::vector<uint8_t> &regs,
+                            size_t distinct) {
+    double estimate = HyperLogLogEstimate(regs);
+    double error = std::fabs(estimate - distinct) / distinct;
+    std::cout << "HyperLogLog " << name << ": " << distinct
+              << " distinct keys, estimated " << (size_t)estimate << " ("
+              << error * 100 << "% error)\n";
+    if (error > tolerance) {
+      std::cerr << "ERROR: estimate error is above " << tolerance * 100
+                << "%\n";
+      return false;
+    }
+    return true;
+  };
+
+  // two sets that overlap by half of their key ranges
+  std::unordered_set<uint64_t> distinct_a, distinct_b;
+  std::vector<uint8_t> snapshot_a, snapshot_b;
+  bool passed = true;
+  auto start = std::chrono::high_resolution_clock::now();
+  passed &= run_set(0, distinct_a, snapshot_a);
+  passed &= run_set(count / 8, distinct_b, snapshot_b);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "HyperLogLog: " << 2 * count << " keys in " << diff.count()
+            << " ms\n";
+
+  passed &= check_estimate("set A", snapshot_a, distinct_a.size());
+  passed &= check_estimate("set B", snapshot_b, distinct_b.size());
+  HyperLogLogMerge(snapshot_a, snapshot_b);
+  distinct_a.insert(distinct_b.begin(), distinct_b.end());
+  passed &= check_estimate("union", snapshot_a, distinct_a.size());
+
+  CommandSideChannel::write(kHyperLogLogStop);
+  kernel_event.wait();
+
+  free(registers, q);
+  FakeIOPipeInProducer::Destroy(q);
+  CommandSideChannel::Destroy(q);
+  SnapshotSideChannel::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __HYPERLOGLOGTEST_HPP__ */
@@ -0,0 +1,157 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __LAUNCHLATENCYTEST_HPP__
+#define __LAUNCHLATENCYTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct LaunchLatencyEchoKernel;
+struct LaunchLatencyProducerID;
+
+// how long the host waits for a launch to start before it gives up
+constexpr std::chrono::seconds kLaunchLatencyTimeout(10);
+
+//
+// The launch-to-start latencies of one launch path, in microseconds, and
+// the time each launch took to complete
+//
+struct LaunchLatencyStats {
+  std::vector<double> start_us;
+  std::vector<double> complete_us;
+};
+
+inline void PrintLaunchLatency(const char *name, LaunchLatencyStats &stats) {
+  auto print = [](const char *what, std::vector<double> &us) {
+    std::sort(us.begin(), us.end());
+    double mean = 0;
+    for (auto x : us) mean += x;
+    mean /= us.size();
+    std::cout << "    " << what << ": mean " << mean << " us, median "
+              << us[us.size() / 2] << " us, 99th percentile "
+              << us[us.size() * 99 / 100] << " us\n";
+  };
+  std::cout << "  " << name << "\n";
+  print("launch to start   ", stats.start_us);
+  print("launch to complete", stats.complete_us);
+}
+
+//
+// This function benchmarks the two ways of launching the fake IO pipe
+// producer that the side channels are built on:
+//    Start():  a new command group on the user's queue for every launch
+//    Launch(): the low latency path, on a dedicated in-order queue with the
+//              kernel looked up once by PrepareLaunch()
+//
+// An echo kernel runs for the whole benchmark and copies each element the
+// producer sends to host memory, where the host watches for it. The time
+// from the launch call to the element arriving is the launch-to-start
+// latency. The host then waits for the launch to complete before the next
+// one, as HostToDeviceSideChannel::write() does. A launch that doesn't start
+// within kLaunchLatencyTimeout fails the benchmark. The launch and the echo
+// kernel are then abandoned rather than waited on, since waiting for them
+// could block forever.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunLaunchLatencyBenchmark(queue &q, size_t count) {
+  using LatencyProducer =
+      Producer<LaunchLatencyProducerID, T, use_usm_host_alloc>;
+  using ProducerPipe = typename LatencyProducer::Pipe;
+  const int launches = std::max(int(std::min<size_t>(count, 1000)), 16);
+
+  LatencyProducer::Init(q, 1);
+  LatencyProducer::PrepareLaunch(q);
+
+  volatile T *seen = malloc_host<T>(1, q);
+  if (seen == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the echo output\n";
+    std::terminate();
+  }
+  *seen = 0;
+
+  auto echo_event = q.single_task<LaunchLatencyEchoKernel>([=] {
+    host_ptr<T> out((T *)seen);
+    for (int i = 0; i < 2 * launches; i++) {
+      *out = ProducerPipe::read();
+    }
+  });
+
+  // alternate the two paths, so they see the same conditions
+  LaunchLatencyStats start_stats, launch_stats;
+  T value = 0;
+  bool passed = true;
+  for (int i = 0; i < launches && passed; i++) {
+    for (int path = 0; path < 2 && passed; path++) {
+      LatencyProducer::Data()[0] = ++value;
+
+      auto begin = std::chrono::high_resolution_clock::now();
+      event dma, kernel;
+      if (path == 0) {
+        std::tie(dma, kernel) = LatencyProducer::Start(q, 1);
+      } else {
+        std::tie(dma, kernel) = LatencyProducer::Launch(1);
+      }
+      // only look at the clock now and then, to keep the spin tight
+      for (int spins = 1; *seen != value; spins++) {
+        if (spins % 1024 != 0) continue;
+        auto waited = std::chrono::high_resolution_clock::now() - begin;
+        if (waited > kLaunchLatencyTimeout) {
+          std::cerr << "ERROR: launch " << value << " of "
+                    << (path == 0 ? "Start()" : "Launch()")
+                    << " did not start within "
+                    << kLaunchLatencyTimeout.count() << " s\n";
+          passed = false;
+          break;
+        }
+      }
+      if (!passed) break;
+      auto started = std::chrono::high_resolution_clock::now();
+      dma.wait();
+      kernel.wait();
+      auto completed = std::chrono::high_resolution_clock::now();
+
+      std::chrono::duration<double, std::micro> to_start = started - begin;
+      std::chrono::duration<double, std::micro> to_complete =
+          completed - begin;
+      LaunchLatencyStats &stats = path == 0 ? start_stats : launch_stats;
+      stats.start_us.push_back(to_start.count());
+      stats.complete_us.push_back(to_complete.count());
+    }
+  }
+
+  if (!passed) {
+    // the stuck launch and the echo kernel may never finish, and
+    // LatencyProducer::Destroy() waits for the launches. Leave them, and the
+    // memory they use, to the runtime rather than hang here.
+    return false;
+  }
+
+  echo_event.wait();
+
+  const auto precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(1) << "Launch latency over "
+            << launches << " launches of each path:\n";
+  PrintLaunchLatency("Start() on the user's queue", start_stats);
+  PrintLaunchLatency("Launch() on the in-order launch queue", launch_stats);
+  std::cout << std::defaultfloat << std::setprecision(precision);
+
+  free((T *)seen, q);
+  LatencyProducer::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __LAUNCHLATENCYTEST_HPP__ */
@@ -8,6 +8,8 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "FakeIOPipes.hpp"
+#include "HostCompletionQueue.hpp"
+#include "TestData.hpp"
 
 // If the 'USE_REAL_IO_PIPE' macro is defined, this test will use real IO pipes.
 // To use this, ensure you have a BSP that supports IO pipes.
@@ -24,6 +26,9 @@ struct LoopBackMainKernel;
 struct LoopBackReadIOPipeID { static constexpr unsigned id = 0; };
 struct LoopBackWriteIOPipeID { static constexpr unsigned id = 1; };
 
+// the seed of the random input data of the fake IO pipes
+constexpr uint64_t kLoopbackDataSeed = 1;
+
 
 //
 // The simplest processing kernel. Streams data in 'IOPipeIn' and streams
@@ -37,9 +42,9 @@ template<class IOPipeIn, class IOPipeOut>
 event SubmitLoopbackKernel(queue& q, size_t count, bool& passed) {
  std::cout << "inside SubmitLoopbackKernel \n"; 
   unsigned long int *datain_host = (unsigned long int *)malloc(OUTER_LOOP_COUNT * INNER_LOOP_COUNT * sizeof(unsigned long int));
-  for(size_t count = 0; count < (OUTER_LOOP_COUNT*INNER_LOOP_COUNT); count++){
-    datain_host[count] = count;
-  }
+  // the input is the sequence 0, 1, 2, ... (see TestData.hpp)
+  auto input_data = TestDataGenerator<unsigned long int>::Sequential(0);
+  input_data.Fill(datain_host, OUTER_LOOP_COUNT * INNER_LOOP_COUNT);
   unsigned long int *dataout_host = (unsigned long int *)malloc(OUTER_LOOP_COUNT * INNER_LOOP_COUNT * sizeof(unsigned long int));
 
   buffer<unsigned long int, 1> buf_in(datain_host, range<1>(OUTER_LOOP_COUNT * INNER_LOOP_COUNT ));
@@ -61,14 +66,11 @@ event SubmitLoopbackKernel(queue& q, size_t count, bool& passed) {
   });
   });
   buf_out.get_access<access::mode::read>();
-  for (size_t i = 0; i < (OUTER_LOOP_COUNT*INNER_LOOP_COUNT); i++) {
-    if (dataout_host[i] != datain_host[i]) {
-      std::cerr << "ERROR: output mismatch at entry " << i << ": "
-                << dataout_host[i] << " != " << datain_host[i]
-                << " (out != in)\n";
-      passed &= false;
-    }
-  }
+  // check the output against the input, generated again
+  auto report =
+    input_data.Check(dataout_host, OUTER_LOOP_COUNT * INNER_LOOP_COUNT);
+  report.Print(std::cerr, "output");
+  passed &= report.Passed();
  std::cout << "passed = " << passed << "\n"; 
 return kevent;
 
@@ -112,8 +114,10 @@ bool RunLoopbackSystem(queue& q, size_t count) {
   // get the pointer to the fake input data
   auto i_stream_data = FakeIOPipeInProducer::Data();
 
-  // create some random input data for the fake IO pipe
-  std::generate_n(i_stream_data, count, [&] { return rand() % 100; } );
+  // create some random input data for the fake IO pipe, in parallel.
+  // It is generated again to check the output (see TestData.hpp).
+  auto input_data = TestDataGenerator<T>::Uniform(kLoopbackDataSeed, 100);
+  input_data.Fill(i_stream_data, count);
 #endif
 
   // submit the main processing kernel
@@ -127,12 +131,17 @@ bool RunLoopbackSystem(queue& q, size_t count) {
   std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
   std::tie(consume_dma_e, consume_kernel_e) = FakeIOPipeOutConsumer::Start(q);
 
-  // wait for producer and consumer to finish including the DMA events.
+  // validate the output on a completion thread once the producer and
+  // consumer finish, including the DMA events, instead of blocking on each
+  // of them (see HostCompletionQueue.hpp).
   // NOTE: if USM host allocations are used, the dma events are noops.
-  produce_dma_e.wait();
-  produce_kernel_e.wait();
-  consume_dma_e.wait();
-  consume_kernel_e.wait();
+  HostCompletionQueue completions;
+  completions.OnComplete({produce_dma_e, produce_kernel_e,
+                          consume_dma_e, consume_kernel_e}, [&] {
+    auto report = input_data.Check(FakeIOPipeOutConsumer::Data(), count);
+    report.Print(std::cerr, "output");
+    passed &= report.Passed();
+  });
 #endif
 
   // Wait for main kernel to finish.
@@ -145,18 +154,8 @@ bool RunLoopbackSystem(queue& q, size_t count) {
 
   // FAKE IO PIPES ONLY
 #ifndef USE_REAL_IO_PIPES
-  // get the pointer to the fake input data
-  auto o_stream_data = FakeIOPipeOutConsumer::Data();
-
-  // validate the output
-  for (size_t i = 0; i < count; i++) {
-    if (o_stream_data[i] != i_stream_data[i]) {
-      std::cerr << "ERROR: output mismatch at entry " << i << ": "
-                << o_stream_data[i] << " != " << i_stream_data[i]
-                << " (out != in)\n";
-      passed &= false;
-    }
-  }
+  // wait for the validation
+  completions.Drain();
 #endif
 
   return passed;
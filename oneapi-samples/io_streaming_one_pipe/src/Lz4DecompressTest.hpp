@@ -0,0 +1,585 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __LZ4DECOMPRESSTEST_HPP__
+#define __LZ4DECOMPRESSTEST_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "onchip_memory_with_cache.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct Lz4ParserKernel;
+struct Lz4HistoryKernel;
+struct Lz4BytePackerKernel;
+struct Lz4CommandPipeID;
+struct Lz4BytePipeID;
+struct Lz4ReadIOPipeID { static constexpr unsigned id = 0; };
+struct Lz4WriteIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// The input is a sequence of LZ4 blocks, each preceded by its size as a
+// 32-bit little endian word, and ended by a size of 0. This is the data
+// block layout of the LZ4 frame format. A block whose size has the top bit
+// set is stored uncompressed. Blocks may reference data in earlier blocks.
+//
+constexpr uint32_t kLz4UncompressedBlock = 0x80000000;
+constexpr int kLz4MinMatch = 4;
+constexpr int kLz4HistoryBytes = 1 << 16;  // covers the maximum offset
+
+// A command from the parser to the history kernel. It is either up to
+// kBytes literal bytes or a whole match (offset, length).
+template <int kBytes>
+struct Lz4Command {
+  bool last;
+  bool is_match;
+  uint8_t count;
+  uint8_t literal[kBytes];
+  uint16_t offset;
+  uint32_t length;
+};
+
+// Up to kBytes bytes of decompressed output
+template <int kBytes>
+struct Lz4Bytes {
+  bool last;
+  uint8_t count;
+  uint8_t byte[kBytes];
+};
+
+//
+// Host side LZ4 block compression and decompression, used to create the
+// test input and as the reference.
+//
+namespace lz4_host {
+
+inline uint32_t Read32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline void PutLength(std::vector<uint8_t> &out, size_t len) {
+  for (; len >= 255; len -= 255) out.push_back(255);
+  out.push_back(len);
+}
+
+inline void PutSequence(std::vector<uint8_t> &out, const uint8_t *lit,
+                        size_t lit_len, size_t offset, size_t match_len) {
+  size_t ml = match_len - kLz4MinMatch;
+  out.push_back((std::min<size_t>(lit_len, 15) << 4) |
+                std::min<size_t>(ml, 15));
+  if (lit_len >= 15) PutLength(out, lit_len - 15);
+  out.insert(out.end(), lit, lit + lit_len);
+  if (match_len > 0) {
+    out.push_back(offset & 0xFF);
+    out.push_back(offset >> 8);
+    if (ml >= 15) PutLength(out, ml - 15);
+  }
+}
+
+// Greedy compressor with a single entry hash table. It follows the end of
+// block rules: the last match starts at least 12 bytes before the end and
+// the last 5 bytes are literals.
+inline std::vector<uint8_t> CompressBlock(const uint8_t *src, size_t n) {
+  std::vector<uint8_t> out;
+  std::vector<int64_t> table(1 << 12, -1);
+  size_t anchor = 0;
+  size_t i = 0;
+
+  while (i + 12 <= n) {
+    uint32_t h = (Read32(src + i) * 2654435761u) >> 20;
+    int64_t cand = table[h];
+    table[h] = i;
+    if (cand >= 0 && i - cand <= 0xFFFF &&
+        Read32(src + cand) == Read32(src + i)) {
+      size_t len = kLz4MinMatch;
+      while (i + len < n - 5 && src[cand + len] == src[i + len]) len++;
+      PutSequence(out, src + anchor, i - anchor, i - cand, len);
+      i += len;
+      anchor = i;
+    } else {
+      i++;
+    }
+  }
+  PutSequence(out, src + anchor, n - anchor, 0, 0);
+  return out;
+}
+
+// Decompress a stream of size-prefixed blocks
+inline std::vector<uint8_t> Decompress(const uint8_t *src) {
+  std::vector<uint8_t> out;
+  while (true) {
+    uint32_t size = Read32(src);
+    src += 4;
+    if (size == 0) break;
+
+    if (size & kLz4UncompressedBlock) {
+      size &= ~kLz4UncompressedBlock;
+      out.insert(out.end(), src, src + size);
+      src += size;
+      continue;
+    }
+
+    const uint8_t *end = src + size;
+    while (src < end) {
+      uint8_t token = *src++;
+      size_t lit_len = token >> 4;
+      if (lit_len == 15) {
+        uint8_t b;
+        do {
+          b = *src++;
+          lit_len += b;
+        } while (b == 255);
+      }
+      out.insert(out.end(), src, src + lit_len);
+      src += lit_len;
+      if (src == end) break;
+
+      size_t offset = src[0] | (src[1] << 8);
+      src += 2;
+      size_t match_len = token & 15;
+      if (match_len == 15) {
+        uint8_t b;
+        do {
+          b = *src++;
+          match_len += b;
+        } while (b == 255);
+      }
+      match_len += kLz4MinMatch;
+      for (size_t i = 0; i < match_len; i++) {
+        out.push_back(out[out.size() - offset]);
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace lz4_host
+
+//
+// Submit the LZ4 parser kernel.
+//
+// Reads 'count' beats of the compressed stream from IOPipeIn and writes
+// literal and match commands to CommandPipe. Literals are forwarded up to
+// kBytes per cycle. Token, length and offset bytes are parsed one field
+// per cycle. A command with 'last' set ends the stream.
+//
+template <class IOPipeIn, class CommandPipe, typename T, int kBytes>
+event SubmitLz4ParserKernel(queue &q, size_t count) {
+  constexpr int kBeatBytes = sizeof(T);
+  static_assert(kBytes >= kBeatBytes);
+  constexpr int kBufBytes = kBytes + kBeatBytes;
+
+  enum class State {
+    kBlockSize, kToken, kLiteralLength, kLiterals, kOffset, kMatchLength
+  };
+
+  return q.single_task<Lz4ParserKernel>([=] {
+    // bytes of the stream that have been read but not consumed
+    uint8_t buf[kBufBytes];
+    int avail = 0;
+    size_t beats_read = 0;
+
+    State state = State::kBlockSize;
+    bool raw_block = false;
+    uint32_t block_remaining = 0;
+    uint32_t literal_length = 0;
+    uint32_t match_length = 0;
+    uint16_t offset = 0;
+    bool done = false;
+
+    while (!done) {
+      // top up the byte buffer
+      if (avail < kBytes && beats_read < count) {
+        T beat = IOPipeIn::read();
+        beats_read++;
+        fpga_tools::UnrolledLoop<kBeatBytes>([&](auto j) {
+          buf[avail + j] = beat >> (8 * j);
+        });
+        avail += kBeatBytes;
+      }
+
+      Lz4Command<kBytes> cmd{};
+      bool send = false;
+      int consumed = 0;
+      const bool block_header = (state == State::kBlockSize);
+
+      if (state == State::kBlockSize) {
+        if (avail >= 4) {
+          uint32_t size = buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+                          ((uint32_t)buf[3] << 24);
+          consumed = 4;
+          if (size == 0) {
+            cmd.last = true;
+            send = true;
+            done = true;
+          } else if (size & kLz4UncompressedBlock) {
+            raw_block = true;
+            literal_length = size & ~kLz4UncompressedBlock;
+            block_remaining = literal_length;
+            state = State::kLiterals;
+          } else {
+            raw_block = false;
+            block_remaining = size;
+            state = State::kToken;
+          }
+        }
+      } else if (state == State::kToken) {
+        if (avail >= 1) {
+          uint8_t token = buf[0];
+          consumed = 1;
+          literal_length = token >> 4;
+          match_length = token & 15;
+          state = (literal_length == 15) ? State::kLiteralLength
+                  : (literal_length > 0)   ? State::kLiterals
+                                           : State::kOffset;
+        }
+      } else if (state == State::kLiteralLength ||
+                 state == State::kMatchLength) {
+        if (avail >= 1) {
+          uint8_t b = buf[0];
+          consumed = 1;
+          if (state == State::kLiteralLength) {
+            literal_length += b;
+            if (b != 255) state = State::kLiterals;
+          } else {
+            match_length += b;
+            if (b != 255) {
+              cmd.is_match = true;
+              cmd.offset = offset;
+              cmd.length = match_length + kLz4MinMatch;
+              send = true;
+              state = State::kToken;
+            }
+          }
+        }
+      } else if (state == State::kLiterals) {
+        int n = std::min<uint32_t>(std::min(avail, kBytes), literal_length);
+        if (n > 0) {
+          fpga_tools::UnrolledLoop<kBytes>(
+              [&](auto j) { cmd.literal[j] = buf[j]; });
+          cmd.count = n;
+          send = true;
+          consumed = n;
+          literal_length -= n;
+          if (literal_length == 0) {
+            // the last sequence of a block has no match
+            bool block_end = raw_block || (block_remaining == (uint32_t)n);
+            state = block_end ? State::kBlockSize : State::kOffset;
+          }
+        }
+      } else {  // State::kOffset
+        if (avail >= 2) {
+          offset = buf[0] | (buf[1] << 8);
+          consumed = 2;
+          if (match_length == 15) {
+            state = State::kMatchLength;
+          } else {
+            cmd.is_match = true;
+            cmd.offset = offset;
+            cmd.length = match_length + kLz4MinMatch;
+            send = true;
+            state = State::kToken;
+          }
+        }
+      }
+
+      if (send) CommandPipe::write(cmd);
+
+      // shift out the consumed bytes
+      if (!block_header) block_remaining -= consumed;
+      fpga_tools::UnrolledLoop<kBufBytes>([&](auto j) {
+        if (j + consumed < kBufBytes) buf[j] = buf[j + consumed];
+      });
+      avail -= consumed;
+    }
+  });
+}
+
+//
+// Submit the LZ4 history kernel.
+//
+// Executes the commands from CommandPipe, writing up to kBytes bytes of
+// output per cycle to BytePipe. The last 64KB of output are kept in an
+// on-chip history buffer split into kBytes banks, where byte address a is
+// in bank a % kBytes. Each cycle touches a window of kBytes consecutive
+// addresses, which hits every bank at most once.
+//
+// A match with an offset of at least kBytes reads kBytes consecutive bytes
+// of history. A match with a shorter offset overlaps its own output. Byte
+// r of such a match is history byte (start - offset + r % offset), so each
+// cycle reads the 'offset' bytes before the match start and replicates
+// them. Bytes written in the last few cycles may still be in flight in the
+// memory pipeline, so each bank carries a small write cache.
+//
+template <class CommandPipe, class BytePipe, int kBytes>
+event SubmitLz4HistoryKernel(queue &q) {
+  static_assert(fpga_tools::IsPow2(kBytes));
+  constexpr int kBankDepth = kLz4HistoryBytes / kBytes;
+  constexpr int kCacheDepth = 8;
+  constexpr uint32_t kHistoryMask = kLz4HistoryBytes - 1;
+
+  return q.single_task<Lz4HistoryKernel>([=] {
+    fpga_tools::OnchipMemoryWithCache<uint8_t, kBankDepth, kCacheDepth>
+        history[kBytes];
+
+    uint32_t pos = 0;  // bytes of output so far
+
+    bool in_match = false;
+    uint32_t match_remaining = 0;
+    uint16_t match_offset = 0;
+    uint32_t match_src = 0;  // pos - offset at the start of the match
+    uint8_t phase = 0;       // bytes copied so far, modulo the offset
+    uint8_t phase_step = 0;  // kBytes % offset
+    bool done = false;
+
+    while (!done) {
+      Lz4Bytes<kBytes> out{};
+
+      if (!in_match) {
+        auto cmd = CommandPipe::read();
+        if (cmd.last) {
+          out.last = true;
+          done = true;
+        } else if (cmd.is_match) {
+          in_match = true;
+          match_remaining = cmd.length;
+          match_offset = cmd.offset;
+          match_src = pos - cmd.offset;
+          phase = 0;
+          phase_step = (cmd.offset < kBytes) ? kBytes % cmd.offset : 0;
+        } else {
+          out.count = cmd.count;
+          fpga_tools::UnrolledLoop<kBytes>(
+              [&](auto j) { out.byte[j] = cmd.literal[j]; });
+        }
+      }
+
+      if (in_match) {
+        const bool short_offset = match_offset < kBytes;
+        const uint32_t lo = short_offset ? match_src : pos - match_offset;
+
+        // read the bank holding each address of the window [lo, lo + kBytes)
+        uint8_t bank_byte[kBytes];
+        fpga_tools::UnrolledLoop<kBytes>([&](auto b) {
+          uint32_t addr = lo + ((b - lo) % kBytes);
+          bank_byte[b] = history[b].read((addr & kHistoryMask) / kBytes);
+        });
+
+        fpga_tools::UnrolledLoop<kBytes>([&](auto i) {
+          uint32_t src = short_offset ? match_src + (phase + i) % match_offset
+                                      : lo + i;
+          out.byte[i] = bank_byte[src % kBytes];
+        });
+
+        out.count = std::min<uint32_t>(kBytes, match_remaining);
+        match_remaining -= out.count;
+        in_match = (match_remaining != 0);
+        if (short_offset) {
+          phase = (phase + phase_step) % match_offset;
+        }
+      }
+
+      // write the new bytes to the history
+      fpga_tools::UnrolledLoop<kBytes>([&](auto b) {
+        uint32_t i = (b - pos) % kBytes;  // the byte that lands in bank b
+        if (i < out.count) {
+          history[b].write(((pos + i) & kHistoryMask) / kBytes, out.byte[i]);
+        }
+      });
+      pos += out.count;
+
+      if (out.count != 0 || out.last) BytePipe::write(out);
+    }
+  });
+}
+
+//
+// Submit the byte packer kernel. Packs the variable sized chunks from
+// BytePipe into full beats of T for IOPipeOut. The last beat is padded
+// with zeros.
+//
+template <class BytePipe, class IOPipeOut, typename T, int kBytes>
+event SubmitLz4BytePackerKernel(queue &q) {
+  constexpr int kBeatBytes = sizeof(T);
+  static_assert(kBytes % kBeatBytes == 0);
+  constexpr int kBeatsPerChunk = kBytes / kBeatBytes;
+  constexpr int kBufBytes = 2 * kBytes;
+
+  return q.single_task<Lz4BytePackerKernel>([=] {
+    uint8_t buf[kBufBytes];
+    int fill = 0;
+    bool done = false;
+
+    while (!done) {
+      auto in = BytePipe::read();
+      done = in.last;
+
+      fpga_tools::UnrolledLoop<kBytes>([&](auto j) {
+        if ((int)j < in.count) buf[fill + j] = in.byte[j];
+      });
+      fill += in.count;
+
+      // on the last chunk, pad out the final beat
+      if (done && fill % kBeatBytes != 0) {
+        fpga_tools::UnrolledLoop<kBufBytes>([&](auto j) {
+          if ((int)j >= fill) buf[j] = 0;
+        });
+        fill += kBeatBytes - fill % kBeatBytes;
+      }
+
+      // send the full beats
+      int sent = 0;
+      fpga_tools::UnrolledLoop<kBeatsPerChunk>([&](auto b) {
+        if (fill - sent >= kBeatBytes) {
+          T beat = 0;
+          fpga_tools::UnrolledLoop<kBeatBytes>([&](auto j) {
+            beat |= (T)buf[b * kBeatBytes + j] << (8 * j);
+          });
+          IOPipeOut::write(beat);
+          sent += kBeatBytes;
+        }
+      });
+      fpga_tools::UnrolledLoop<kBufBytes>([&](auto j) {
+        if (j + sent < kBufBytes) buf[j] = buf[j + sent];
+      });
+      fill -= sent;
+    }
+  });
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// Compressible data is compressed on the host, decompressed by the
+// kernels and compared with the original.
+//
+template <typename T, bool use_usm_host_alloc, int kBytes = sizeof(T)>
+bool RunLz4DecompressSystem(queue &q, size_t count) {
+  // data that compresses reasonably: words from a small dictionary, runs
+  // of one or two bytes (short offsets) and random bytes
+  const size_t num_bytes = count * sizeof(T);
+  std::vector<uint8_t> original;
+  std::vector<std::vector<uint8_t>> words(32);
+  for (auto &w : words) {
+    w.resize(3 + rand() % 20);
+    for (auto &c : w) c = 'a' + rand() % 26;
+  }
+  while (original.size() < num_bytes) {
+    int kind = rand() % 8;
+    if (kind < 5) {
+      auto &w = words[rand() % words.size()];
+      original.insert(original.end(), w.begin(), w.end());
+    } else if (kind == 5) {
+      int period = 1 + rand() % 3;
+      int len = 8 + rand() % 300;
+      for (int i = 0; i < len; i++) {
+        original.push_back(i % period ? 'x' : 'y');
+      }
+    } else {
+      for (int i = rand() % 16; i > 0; i--) original.push_back(rand());
+    }
+  }
+  original.resize(num_bytes);
+
+  // compress in blocks, storing one block uncompressed
+  constexpr size_t kBlockBytes = 16 * 1024;
+  std::vector<uint8_t> compressed;
+  auto put32 = [&](uint32_t v) {
+    for (int i = 0; i < 4; i++) compressed.push_back(v >> (8 * i));
+  };
+  for (size_t b = 0; b < num_bytes; b += kBlockBytes) {
+    size_t n = std::min(kBlockBytes, num_bytes - b);
+    if (b == kBlockBytes) {
+      put32(n | kLz4UncompressedBlock);
+      compressed.insert(compressed.end(), &original[b], &original[b] + n);
+    } else {
+      auto block = lz4_host::CompressBlock(&original[b], n);
+      put32(block.size());
+      compressed.insert(compressed.end(), block.begin(), block.end());
+    }
+  }
+  put32(0);
+
+  bool passed = true;
+  if (lz4_host::Decompress(compressed.data()) != original) {
+    std::cerr << "ERROR: the host LZ4 round trip failed\n";
+    passed &= false;
+  }
+
+  const size_t in_count = (compressed.size() + sizeof(T) - 1) / sizeof(T);
+  std::cout << "LZ4: " << num_bytes << " bytes compressed to "
+            << compressed.size() << " bytes\n";
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer = Producer<Lz4ReadIOPipeID, T, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<Lz4WriteIOPipeID, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, in_count);
+  FakeIOPipeOutConsumer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // pipes between the decompressor kernels
+  using CommandPipe =
+      sycl::ext::intel::pipe<Lz4CommandPipeID, Lz4Command<kBytes>, 16>;
+  using BytePipe = sycl::ext::intel::pipe<Lz4BytePipeID, Lz4Bytes<kBytes>, 16>;
+
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  std::fill(i_stream_data, i_stream_data + in_count, T(0));
+  std::memcpy(i_stream_data, compressed.data(), compressed.size());
+
+  auto parser_event =
+      SubmitLz4ParserKernel<ReadIOPipe, CommandPipe, T, kBytes>(q, in_count);
+  auto history_event = SubmitLz4HistoryKernel<CommandPipe, BytePipe, kBytes>(q);
+  auto packer_event =
+      SubmitLz4BytePackerKernel<BytePipe, WriteIOPipe, T, kBytes>(q);
+
+  event producer_dma_event, producer_kernel_event;
+  event consumer_dma_event, consumer_kernel_event;
+  std::tie(producer_dma_event, producer_kernel_event) =
+      FakeIOPipeInProducer::Start(q);
+  std::tie(consumer_dma_event, consumer_kernel_event) =
+      FakeIOPipeOutConsumer::Start(q);
+
+  producer_dma_event.wait();
+  producer_kernel_event.wait();
+  consumer_dma_event.wait();
+  consumer_kernel_event.wait();
+  parser_event.wait();
+  history_event.wait();
+  packer_event.wait();
+
+  // validate the results
+  auto o_stream_data = (const uint8_t *)FakeIOPipeOutConsumer::Data();
+  for (size_t i = 0; i < num_bytes; i++) {
+    if (o_stream_data[i] != original[i]) {
+      std::cerr << "ERROR: decompressed mismatch at byte " << i << ": "
+                << (int)o_stream_data[i] << " != " << (int)original[i]
+                << " (out != expected)\n";
+      passed &= false;
+      break;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __LZ4DECOMPRESSTEST_HPP__ */
@@ -0,0 +1,566 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __PACKETPARSERTEST_HPP__
+#define __PACKETPARSERTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "packet_parser.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// Every beat width is its own kernel with its own IO pipes.
+template <int kBeatBytes> struct PacketParserKernel;
+template <int kBeatBytes>
+struct PacketParserReadIOPipeID { static constexpr unsigned id = 0; };
+template <int kBeatBytes>
+struct PacketParserMetadataIOPipeID { static constexpr unsigned id = 1; };
+template <int kBeatBytes>
+struct PacketParserPayloadIOPipeID { static constexpr unsigned id = 2; };
+
+//
+// A small capture, in the pcap file format, of the kinds of packets the
+// parser must handle: a DNS query, an NTP packet with a VLAN tag, a VXLAN
+// packet with QinQ tags, an IPv4 multicast packet with a router alert
+// option, a TCP SYN with options, an ARP request, an IPv6 packet and a
+// non-first IPv4 fragment.
+//
+constexpr uint8_t kPacketParserCapture[] = {
+    0xd4, 0xc3, 0xb2, 0xa1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x80, 0x24, 0x4d, 0x63, 0x00, 0x00, 0x00, 0x00, 0x47, 0x00, 0x00, 0x00,
+    0x47, 0x00, 0x00, 0x00, 0x3c, 0xfd, 0xfe, 0xa5, 0x21, 0x08, 0x00, 0x1b,
+    0x21, 0x3a, 0x7f, 0xc2, 0x08, 0x00, 0x45, 0x00, 0x00, 0x39, 0x1c, 0x46,
+    0x40, 0x00, 0x40, 0x11, 0x4c, 0xac, 0xc0, 0xa8, 0x01, 0x0a, 0x08, 0x08,
+    0x08, 0x08, 0xcf, 0xdb, 0x00, 0x35, 0x00, 0x25, 0x00, 0x00, 0xa3, 0xe5,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x65,
+    0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00, 0x00,
+    0x01, 0x00, 0x01, 0x80, 0x24, 0x4d, 0x63, 0xe8, 0x03, 0x00, 0x00, 0x5e,
+    0x00, 0x00, 0x00, 0x5e, 0x00, 0x00, 0x00, 0x3c, 0xfd, 0xfe, 0xa5, 0x21,
+    0x08, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x81, 0x00, 0x20, 0x64, 0x08,
+    0x00, 0x45, 0x00, 0x00, 0x4c, 0x1c, 0x46, 0x40, 0x00, 0x40, 0x11, 0x0a,
+    0x59, 0x0a, 0x00, 0x00, 0x02, 0x0a, 0x00, 0x00, 0x01, 0x00, 0x7b, 0x00,
+    0x7b, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x24, 0x4d, 0x63, 0xd0, 0x07, 0x00,
+    0x00, 0x69, 0x00, 0x00, 0x00, 0x69, 0x00, 0x00, 0x00, 0x3c, 0xfd, 0xfe,
+    0xa5, 0x21, 0x08, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x88, 0xa8, 0x00,
+    0xc8, 0x81, 0x00, 0x61, 0x2c, 0x08, 0x00, 0x45, 0x00, 0x00, 0x53, 0x1c,
+    0x46, 0x40, 0x00, 0x40, 0x11, 0xb8, 0x26, 0xac, 0x10, 0x05, 0x04, 0xac,
+    0x10, 0x09, 0x09, 0xc0, 0x00, 0x12, 0xb5, 0x00, 0x3f, 0x00, 0x00, 0x08,
+    0x00, 0x00, 0x00, 0x00, 0x12, 0x34, 0x00, 0x00, 0x1b, 0x21, 0x3a, 0x7f,
+    0xc2, 0x3c, 0xfd, 0xfe, 0xa5, 0x21, 0x08, 0x08, 0x00, 0x45, 0x00, 0x00,
+    0x21, 0x1c, 0x46, 0x40, 0x00, 0x40, 0x11, 0x18, 0x81, 0x01, 0x01, 0x01,
+    0x01, 0x02, 0x02, 0x02, 0x02, 0x00, 0x01, 0x00, 0x02, 0x00, 0x0d, 0x00,
+    0x00, 0x69, 0x6e, 0x6e, 0x65, 0x72, 0x80, 0x24, 0x4d, 0x63, 0xb8, 0x0b,
+    0x00, 0x00, 0x3a, 0x00, 0x00, 0x00, 0x3a, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x5e, 0x00, 0x00, 0x16, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x08, 0x00,
+    0x46, 0xc0, 0x00, 0x2c, 0x1c, 0x46, 0x40, 0x00, 0x01, 0x11, 0x25, 0xe4,
+    0xc0, 0xa8, 0x01, 0x14, 0xe0, 0x00, 0x00, 0x16, 0x94, 0x04, 0x00, 0x00,
+    0x14, 0xe9, 0x14, 0xe9, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x24, 0x4d, 0x63,
+    0xa0, 0x0f, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00,
+    0x3c, 0xfd, 0xfe, 0xa5, 0x21, 0x08, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2,
+    0x08, 0x00, 0x45, 0x00, 0x00, 0x3c, 0x1c, 0x46, 0x40, 0x00, 0x40, 0x06,
+    0x26, 0xe9, 0xc0, 0xa8, 0x01, 0x0a, 0x5d, 0xb8, 0xd8, 0x22, 0x9e, 0x4a,
+    0x01, 0xbb, 0x3f, 0x9a, 0x2c, 0x11, 0x00, 0x00, 0x00, 0x00, 0xa0, 0x02,
+    0xfa, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x02, 0x04, 0x05, 0xb4, 0x04, 0x02,
+    0x08, 0x0a, 0x6b, 0x5a, 0x1e, 0x4c, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03,
+    0x03, 0x07, 0x80, 0x24, 0x4d, 0x63, 0x88, 0x13, 0x00, 0x00, 0x3c, 0x00,
+    0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x08, 0x06, 0x00, 0x01, 0x08, 0x00,
+    0x06, 0x04, 0x00, 0x01, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0xc0, 0xa8,
+    0x01, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0xa8, 0x01, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x24, 0x4d, 0x63, 0x70, 0x17,
+    0x00, 0x00, 0x4b, 0x00, 0x00, 0x00, 0x4b, 0x00, 0x00, 0x00, 0x33, 0x33,
+    0x00, 0x00, 0x00, 0xfb, 0x00, 0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x86, 0xdd,
+    0x60, 0x00, 0x00, 0x00, 0x00, 0x15, 0x11, 0x01, 0xfe, 0x80, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x02, 0x15, 0x5d, 0xff, 0xfe, 0x1a, 0x2b, 0x3c,
+    0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xfb, 0x14, 0xe9, 0x14, 0xe9, 0x00, 0x15, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x80, 0x24, 0x4d, 0x63, 0x58, 0x1b, 0x00, 0x00, 0x62, 0x00, 0x00,
+    0x00, 0x62, 0x00, 0x00, 0x00, 0x3c, 0xfd, 0xfe, 0xa5, 0x21, 0x08, 0x00,
+    0x1b, 0x21, 0x3a, 0x7f, 0xc2, 0x08, 0x00, 0x45, 0x00, 0x00, 0x54, 0x77,
+    0xaa, 0x00, 0xb9, 0x40, 0x11, 0xeb, 0x30, 0x0a, 0x01, 0x01, 0x01, 0x0a,
+    0x02, 0x02, 0x02, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+    0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c,
+    0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+};
+
+//
+// Reads the packets of a capture in the pcap file format, as written by
+// tcpdump or Wireshark for an Ethernet link. Returns false if the capture
+// is not one.
+//
+inline bool ReadPcap(const uint8_t *data, size_t size,
+                     std::vector<std::vector<uint8_t>> &packets) {
+  auto read32 = [&](size_t offset, bool swap) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) {
+      int byte = swap ? 3 - i : i;
+      x |= uint32_t(data[offset + byte]) << (8 * i);
+    }
+    return x;
+  };
+
+  if (size < 24) return false;
+  const uint32_t magic = read32(0, false);
+  bool swap;
+  if (magic == 0xA1B2C3D4 || magic == 0xA1B23C4D) {
+    swap = false;
+  } else if (magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1) {
+    swap = true;
+  } else {
+    return false;
+  }
+  const uint32_t kLinkTypeEthernet = 1;
+  if (read32(20, swap) != kLinkTypeEthernet) return false;
+
+  size_t offset = 24;
+  while (offset + 16 <= size) {
+    uint32_t captured = read32(offset + 8, swap);
+    offset += 16;
+    if (offset + captured > size) return false;
+    if (captured != 0) {
+      packets.emplace_back(data + offset, data + offset + captured);
+    }
+    offset += captured;
+  }
+  return true;
+}
+
+inline bool ReadPcapFile(const char *path,
+                         std::vector<std::vector<uint8_t>> &packets) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  return ReadPcap(data.data(), data.size(), packets);
+}
+
+//
+// Make a random packet, with any number of VLAN tags, IPv4 options and TCP
+// options, and some malformed and truncated headers.
+//
+inline std::vector<uint8_t> MakeRandomPacket() {
+  std::vector<uint8_t> p;
+  auto push16 = [&](uint16_t x) {
+    p.push_back(x >> 8);
+    p.push_back(x & 0xFF);
+  };
+  auto random_bytes = [&](int n) {
+    for (int i = 0; i < n; i++) p.push_back(rand() % 256);
+  };
+
+  // Ethernet and VLAN tags
+  random_bytes(12);
+  const uint16_t kTpids[] = {fpga_tools::kEtherTypeVlan,
+                             fpga_tools::kEtherTypeQinQ,
+                             fpga_tools::kEtherTypeQinQLegacy};
+  int tags = rand() % 8 == 0 ? 3 : rand() % 3;
+  for (int t = 0; t < tags; t++) {
+    push16(kTpids[rand() % 3]);
+    push16(rand() % 0x10000);
+  }
+  const uint16_t kOtherTypes[] = {0x86DD, 0x0806, 0x88CC};
+  bool ipv4 = rand() % 5 != 0;
+  push16(ipv4 ? fpga_tools::kEtherTypeIPv4 : kOtherTypes[rand() % 3]);
+
+  if (ipv4) {
+    // IPv4, with options one time in four
+    size_t l3 = p.size();
+    int ihl = rand() % 4 == 0 ? 6 + rand() % 10 : 5;
+    int version = rand() % 20 == 0 ? 6 : 4;
+    if (rand() % 40 == 0) ihl = rand() % 5;
+    const uint8_t kProtocols[] = {fpga_tools::kIpProtocolUdp,
+                                  fpga_tools::kIpProtocolTcp, 1, 47};
+    uint8_t protocol = kProtocols[rand() % 4 == 0 ? 2 + rand() % 2
+                                                  : rand() % 2];
+    uint16_t flags_fragment = 0x4000;
+    if (rand() % 10 == 0) flags_fragment = 0x2000 | (rand() % 0x2000);
+    p.push_back((version << 4) | ihl);
+    p.push_back(rand() % 256);
+    push16(rand() % 1500);
+    push16(rand() % 0x10000);
+    push16(flags_fragment);
+    p.push_back(rand() % 256);
+    p.push_back(protocol);
+    push16(0);
+    random_bytes(8);
+    random_bytes(std::max(ihl - 5, 0) * 4);
+
+    uint32_t sum = 0;
+    for (size_t i = l3; i + 1 < p.size(); i += 2) {
+      sum += (p[i] << 8) | p[i + 1];
+    }
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    uint16_t checksum = ~sum;
+    if (rand() % 10 == 0) checksum ^= 1 << (rand() % 16);
+    p[l3 + 10] = checksum >> 8;
+    p[l3 + 11] = checksum & 0xFF;
+
+    // UDP or TCP, with options one time in four
+    if (protocol == fpga_tools::kIpProtocolUdp) {
+      random_bytes(8);
+    } else if (protocol == fpga_tools::kIpProtocolTcp) {
+      int data_offset = rand() % 4 == 0 ? 6 + rand() % 10 : 5;
+      if (rand() % 40 == 0) data_offset = rand() % 5;
+      random_bytes(12);
+      p.push_back(data_offset << 4);
+      random_bytes(7 + std::max(data_offset - 5, 0) * 4);
+    }
+  }
+
+  // the payload, or a truncation of the packet
+  random_bytes(rand() % 200);
+  if (rand() % 10 == 0) p.resize(1 + rand() % p.size());
+  return p;
+}
+
+//
+// A packet with the longest headers the parser handles, cut to 'size'
+// bytes: two VLAN tags, an IPv4 header with 40 bytes of options and a TCP
+// header with 40 bytes of options. The checksum is left random.
+//
+inline std::vector<uint8_t> MakeLongHeaderPacket(size_t size) {
+  constexpr int kL3 = 14 + 4 * 2;
+  constexpr int kL4 = kL3 + 60;
+  std::vector<uint8_t> p(std::max<size_t>(size, kL4 + 60));
+  for (auto &b : p) b = rand() % 256;
+
+  p[12] = fpga_tools::kEtherTypeVlan >> 8;
+  p[13] = fpga_tools::kEtherTypeVlan & 0xFF;
+  p[16] = fpga_tools::kEtherTypeQinQ >> 8;
+  p[17] = fpga_tools::kEtherTypeQinQ & 0xFF;
+  p[20] = fpga_tools::kEtherTypeIPv4 >> 8;
+  p[21] = fpga_tools::kEtherTypeIPv4 & 0xFF;
+  p[kL3] = 0x4F;  // version 4, IHL 15
+  p[kL3 + 6] = 0x40;  // don't fragment
+  p[kL3 + 7] = 0;
+  p[kL3 + 9] = fpga_tools::kIpProtocolTcp;
+  p[kL4 + 12] = 0xF0;  // data offset 15
+
+  p.resize(size);
+  return p;
+}
+
+//
+// A straightforward parser on the host, to check the kernel against.
+// 'eth_ok' is set if the Ethernet header and VLAN tags are complete.
+//
+inline fpga_tools::PacketMetadata PacketParserReference(
+    const std::vector<uint8_t> &p, bool &eth_ok) {
+  fpga_tools::PacketMetadata m{};
+  const int n = p.size();
+  auto be16 = [&](int o) { return uint16_t((p[o] << 8) | p[o + 1]); };
+  auto be32 = [&](int o) { return (uint32_t(be16(o)) << 16) | be16(o + 2); };
+  eth_ok = false;
+
+  if (n < 14) {
+    m.truncated = true;
+    return m;
+  }
+  m.dst_mac = (uint64_t(be16(0)) << 32) | be32(2);
+  m.src_mac = (uint64_t(be16(6)) << 32) | be32(8);
+  uint16_t ether_type = be16(12);
+  int tags = 0;
+  while (tags < fpga_tools::kMaxVlanTags &&
+         (ether_type == fpga_tools::kEtherTypeVlan ||
+          ether_type == fpga_tools::kEtherTypeQinQ ||
+          ether_type == fpga_tools::kEtherTypeQinQLegacy)) {
+    if (n < 18 + 4 * tags) {
+      m.truncated = true;
+      return m;
+    }
+    m.vlan_tci[tags] = be16(14 + 4 * tags);
+    ether_type = be16(16 + 4 * tags);
+    tags++;
+  }
+  eth_ok = true;
+  m.vlan_tags = tags;
+  m.ether_type = ether_type;
+  const int l3 = 14 + 4 * tags;
+  m.l3_offset = l3;
+  m.payload_offset = l3;
+
+  if (ether_type != fpga_tools::kEtherTypeIPv4) return m;
+  if (n < l3 + 20) {
+    m.truncated = true;
+    return m;
+  }
+  const int ihl = p[l3] & 0xF;
+  if ((p[l3] >> 4) != 4 || ihl < 5) return m;
+  if (n < l3 + 4 * ihl) {
+    m.truncated = true;
+    return m;
+  }
+  m.ipv4 = true;
+  m.dscp_ecn = p[l3 + 1];
+  m.ip_total_length = be16(l3 + 2);
+  m.ip_fragment = (be16(l3 + 6) & 0x3FFF) != 0;
+  m.ttl = p[l3 + 8];
+  m.ip_protocol = p[l3 + 9];
+  m.src_ip = be32(l3 + 12);
+  m.dst_ip = be32(l3 + 16);
+  uint32_t sum = 0;
+  for (int i = 0; i < 2 * ihl; i++) sum += be16(l3 + 2 * i);
+  while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+  m.ipv4_checksum_ok = sum == 0xFFFF;
+  const int l4 = l3 + 4 * ihl;
+  m.l4_offset = l4;
+  m.payload_offset = l4;
+
+  const bool udp = m.ip_protocol == fpga_tools::kIpProtocolUdp;
+  const bool tcp = m.ip_protocol == fpga_tools::kIpProtocolTcp;
+  if ((be16(l3 + 6) & 0x1FFF) != 0 || !(udp || tcp)) return m;
+  if (n < l4 + (udp ? 8 : 20)) {
+    m.truncated = true;
+    return m;
+  }
+  int header_bytes = 8;
+  if (tcp) {
+    header_bytes = 4 * (p[l4 + 12] >> 4);
+    if (header_bytes < 20) return m;
+    if (n < l4 + header_bytes) {
+      m.truncated = true;
+      return m;
+    }
+  }
+  m.l4 = true;
+  m.src_port = be16(l4);
+  m.dst_port = be16(l4 + 2);
+  m.payload_offset = l4 + header_bytes;
+  return m;
+}
+
+// compares the meaningful fields of the parsed headers of a packet
+inline bool PacketMetadataMatches(const fpga_tools::PacketMetadata &a,
+                                  const fpga_tools::PacketMetadata &b,
+                                  bool eth_ok) {
+  bool match = a.truncated == b.truncated && a.ipv4 == b.ipv4 && a.l4 == b.l4;
+  if (eth_ok) {
+    match &= a.dst_mac == b.dst_mac && a.src_mac == b.src_mac &&
+             a.vlan_tags == b.vlan_tags && a.ether_type == b.ether_type &&
+             a.l3_offset == b.l3_offset &&
+             a.payload_offset == b.payload_offset;
+    for (int t = 0; t < b.vlan_tags && t < fpga_tools::kMaxVlanTags; t++) {
+      match &= a.vlan_tci[t] == b.vlan_tci[t];
+    }
+  }
+  if (b.ipv4) {
+    match &= a.ipv4_checksum_ok == b.ipv4_checksum_ok &&
+             a.ip_fragment == b.ip_fragment && a.dscp_ecn == b.dscp_ecn &&
+             a.ttl == b.ttl && a.ip_protocol == b.ip_protocol &&
+             a.ip_total_length == b.ip_total_length &&
+             a.src_ip == b.src_ip && a.dst_ip == b.dst_ip &&
+             a.l4_offset == b.l4_offset;
+  }
+  if (b.l4) {
+    match &= a.src_port == b.src_port && a.dst_port == b.dst_port;
+  }
+  return match;
+}
+
+//
+// Run the parser, with beats of 'kBeatBytes' bytes, on 'packets' and check
+// the metadata against the host parser. The packets must come out of the
+// payload pipe unchanged.
+//
+// The packets are sent in two bursts with the link idle in between. All of
+// the first burst must come out of the parser before the second one is
+// sent, so a packet held back in the parser until more beats arrive makes
+// the test hang.
+//
+template <typename T, bool use_usm_host_alloc, int kBeatBytes>
+bool RunPacketParser(queue &q,
+                     const std::vector<std::vector<uint8_t>> &packets) {
+  using Beat = fpga_tools::PacketBeat<kBeatBytes>;
+  using Metadata = fpga_tools::PacketMetadata;
+
+  size_t beats = 0;
+  for (auto &p : packets) beats += (p.size() + kBeatBytes - 1) / kBeatBytes;
+
+  // the packets and beats of each burst
+  const size_t burst_packets[2] = {packets.size() / 2,
+                                   packets.size() - packets.size() / 2};
+  size_t burst_beats[2] = {0, 0};
+  for (size_t i = 0; i < burst_packets[0]; i++) {
+    burst_beats[0] += (packets[i].size() + kBeatBytes - 1) / kBeatBytes;
+  }
+  burst_beats[1] = beats - burst_beats[0];
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<PacketParserReadIOPipeID<kBeatBytes>, Beat, use_usm_host_alloc>;
+  using FakeMetadataIOPipeOutConsumer =
+      Consumer<PacketParserMetadataIOPipeID<kBeatBytes>, Metadata,
+               use_usm_host_alloc>;
+  using FakePayloadIOPipeOutConsumer =
+      Consumer<PacketParserPayloadIOPipeID<kBeatBytes>, Beat,
+               use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using MetadataIOPipe = typename FakeMetadataIOPipeOutConsumer::Pipe;
+  using PayloadIOPipe = typename FakePayloadIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, std::max(burst_beats[0], burst_beats[1]));
+  FakeMetadataIOPipeOutConsumer::Init(q, burst_packets[1]);
+  FakePayloadIOPipeOutConsumer::Init(q,
+                                     std::max(burst_beats[0], burst_beats[1]));
+  FakeIOPipeInProducer::PrepareLaunch(q);
+  FakeMetadataIOPipeOutConsumer::PrepareLaunch(q);
+  FakePayloadIOPipeOutConsumer::PrepareLaunch(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // split the packets into beats. The unused bytes of the last beat of a
+  // packet are filled with junk, which the parser must ignore.
+  std::vector<Beat> i_stream_data(beats);
+  size_t beat = 0;
+  for (auto &p : packets) {
+    for (size_t offset = 0; offset < p.size(); offset += kBeatBytes) {
+      Beat &b = i_stream_data[beat++];
+      for (int j = 0; j < kBeatBytes; j++) {
+        b.data[j] = offset + j < p.size() ? p[offset + j] : rand() % 256;
+      }
+      b.sop = offset == 0;
+      b.eop = offset + kBeatBytes >= p.size();
+      b.empty = b.eop ? offset + kBeatBytes - p.size() : 0;
+    }
+  }
+
+  auto kernel_event =
+      q.single_task<PacketParserKernel<kBeatBytes>>([=] {
+        fpga_tools::PacketParser<ReadIOPipe, MetadataIOPipe, PayloadIOPipe>(
+            beats);
+      });
+
+  std::vector<Metadata> o_metadata;
+  std::vector<Beat> o_payload;
+  auto start = std::chrono::high_resolution_clock::now();
+  size_t first_beat = 0;
+  for (int burst = 0; burst < 2; burst++) {
+    std::copy(i_stream_data.begin() + first_beat,
+              i_stream_data.begin() + first_beat + burst_beats[burst],
+              FakeIOPipeInProducer::Data());
+    first_beat += burst_beats[burst];
+
+    event produce_dma_e, produce_kernel_e;
+    event metadata_dma_e, metadata_kernel_e;
+    event payload_dma_e, payload_kernel_e;
+    std::tie(produce_dma_e, produce_kernel_e) =
+        FakeIOPipeInProducer::Launch(burst_beats[burst]);
+    std::tie(metadata_dma_e, metadata_kernel_e) =
+        FakeMetadataIOPipeOutConsumer::Launch(burst_packets[burst]);
+    std::tie(payload_dma_e, payload_kernel_e) =
+        FakePayloadIOPipeOutConsumer::Launch(burst_beats[burst]);
+
+    produce_dma_e.wait();
+    produce_kernel_e.wait();
+    metadata_dma_e.wait();
+    metadata_kernel_e.wait();
+    payload_dma_e.wait();
+    payload_kernel_e.wait();
+
+    auto metadata = FakeMetadataIOPipeOutConsumer::Data();
+    o_metadata.insert(o_metadata.end(), metadata,
+                      metadata + burst_packets[burst]);
+    auto payload = FakePayloadIOPipeOutConsumer::Data();
+    o_payload.insert(o_payload.end(), payload,
+                     payload + burst_beats[burst]);
+  }
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Packet parser: " << packets.size() << " packets, "
+            << kBeatBytes << " byte beats, in " << diff.count() << " ms\n";
+
+  // validate the metadata against the host parser
+  bool passed = true;
+  for (size_t i = 0; i < packets.size() && passed; i++) {
+    bool eth_ok;
+    Metadata expected = PacketParserReference(packets[i], eth_ok);
+    if (!PacketMetadataMatches(o_metadata[i], expected, eth_ok)) {
+      std::cerr << "ERROR: metadata mismatch for packet " << i << " ("
+                << packets[i].size() << " bytes)\n";
+      passed &= false;
+    }
+  }
+
+  // the packets must be unchanged
+  for (size_t i = 0; i < beats && passed; i++) {
+    const Beat &a = o_payload[i];
+    const Beat &b = i_stream_data[i];
+    bool match = a.sop == b.sop && a.eop == b.eop && a.empty == b.empty;
+    for (int j = 0; j < kBeatBytes - (b.eop ? b.empty : 0); j++) {
+      match &= a.data[j] == b.data[j];
+    }
+    if (!match) {
+      std::cerr << "ERROR: payload mismatch at beat " << i << "\n";
+      passed &= false;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeMetadataIOPipeOutConsumer::Destroy(q);
+  FakePayloadIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// The packets come from the capture above, from the pcap file named by the
+// PACKET_PARSER_PCAP environment variable, if it is set, from a random
+// generator, and from cutting a packet with the longest headers at every
+// length through its headers. They are parsed with narrow and wide beats.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunPacketParserSystem(queue &q, size_t count) {
+  std::vector<std::vector<uint8_t>> packets;
+  if (!ReadPcap(kPacketParserCapture, sizeof(kPacketParserCapture),
+                packets)) {
+    std::cerr << "ERROR: failed to read the built in capture\n";
+    return false;
+  }
+  if (const char *path = std::getenv("PACKET_PARSER_PCAP")) {
+    if (!ReadPcapFile(path, packets)) {
+      std::cerr << "ERROR: failed to read the capture '" << path << "'\n";
+      return false;
+    }
+  }
+  const size_t random_packets = std::max<size_t>(count / 64, 256);
+  for (size_t i = 0; i < random_packets; i++) {
+    packets.push_back(MakeRandomPacket());
+  }
+  for (size_t size = 14; size <= 14 + 8 + 60 + 60 + 8; size++) {
+    packets.push_back(MakeLongHeaderPacket(size));
+  }
+
+  bool passed = true;
+  passed &= RunPacketParser<T, use_usm_host_alloc, 8>(q, packets);
+  passed &= RunPacketParser<T, use_usm_host_alloc, 32>(q, packets);
+  return passed;
+}
+
+#endif /* __PACKETPARSERTEST_HPP__ */
@@ -0,0 +1,537 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __PATTERNMATCHTEST_HPP__
+#define __PATTERNMATCHTEST_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct PatternMatchKernel;
+struct PatternMatchReadIOPipeID { static constexpr unsigned id = 0; };
+struct PatternMatchWriteIOPipeID { static constexpr unsigned id = 1; };
+struct PatternMatchTableID;
+struct PatternMatchHitID;
+
+//
+// Limits of the automaton stored on the device. The automaton is a DFA over
+// byte classes: the host maps every byte that appears in a pattern to its
+// own class and all other bytes to class 0, which keeps the transition
+// table small enough for on-chip RAM.
+//
+constexpr int kPatternMatchMaxStates = 512;
+constexpr int kPatternMatchMaxClasses = 32;
+constexpr int kPatternMatchMaxLen = 32;
+
+// Size of the automaton as loaded through the table side channel, in
+// 32-bit words: the byte class map, the transition table and the output
+// of each state.
+constexpr int kPatternMatchTableWords =
+    256 + kPatternMatchMaxStates * kPatternMatchMaxClasses +
+    kPatternMatchMaxStates;
+
+// A match of pattern 'pattern_id' whose last byte is at stream byte offset
+// 'offset'. The kernel ends each scan with a hit whose pattern_id is
+// kPatternMatchEndOfScan. Its offset holds the number of hits that were
+// dropped because a per-automaton hit buffer overflowed.
+struct PatternMatchHit {
+  uint64_t offset;
+  uint32_t pattern_id;
+};
+constexpr uint32_t kPatternMatchEndOfScan = 0xFFFFFFFF;
+
+// The hits are sent to the host in batches of this many. The end of scan
+// hit is repeated to fill the last batch.
+constexpr int kPatternMatchHitBatch = 256;
+
+//
+// Aho-Corasick automaton, built on the host.
+//
+// The device only reports the longest pattern ending at each offset. Other
+// patterns ending at the same offset are suffixes of the reported one and
+// can be recovered with Suffixes().
+//
+class AhoCorasickAutomaton {
+ public:
+  // returns the id of the new pattern
+  int AddPattern(const std::string &pattern) {
+    if (pattern.empty() || pattern.size() > kPatternMatchMaxLen) {
+      std::cerr << "ERROR: pattern length must be in [1, "
+                << kPatternMatchMaxLen << "]\n";
+      std::terminate();
+    }
+    patterns_.push_back(pattern);
+    return patterns_.size() - 1;
+  }
+
+  // Build the trie, failure links and the full transition table.
+  // Returns false if the automaton doesn't fit the device limits.
+  bool Build() {
+    // byte classes
+    std::fill(std::begin(byte_class_), std::end(byte_class_), 0);
+    num_classes_ = 1;
+    for (auto &p : patterns_) {
+      for (unsigned char c : p) {
+        if (byte_class_[c] == 0) byte_class_[c] = num_classes_++;
+      }
+    }
+    if (num_classes_ > kPatternMatchMaxClasses) return false;
+
+    // trie
+    next_.assign(1, std::vector<int>(num_classes_, -1));
+    fail_.assign(1, 0);
+    terminal_.assign(1, -1);
+    for (size_t id = 0; id < patterns_.size(); id++) {
+      int s = 0;
+      for (unsigned char c : patterns_[id]) {
+        int cls = byte_class_[c];
+        if (next_[s][cls] < 0) {
+          next_[s][cls] = next_.size();
+          next_.emplace_back(num_classes_, -1);
+          fail_.push_back(0);
+          terminal_.push_back(-1);
+        }
+        s = next_[s][cls];
+      }
+      terminal_[s] = id;
+    }
+    if (next_.size() > kPatternMatchMaxStates) return false;
+
+    // failure links and DFA transitions, breadth first
+    out_.assign(next_.size(), -1);
+    std::queue<int> work;
+    for (int cls = 0; cls < num_classes_; cls++) {
+      int s = next_[0][cls];
+      if (s < 0) {
+        next_[0][cls] = 0;
+      } else {
+        fail_[s] = 0;
+        work.push(s);
+      }
+    }
+    while (!work.empty()) {
+      int s = work.front();
+      work.pop();
+      out_[s] = (terminal_[s] >= 0) ? terminal_[s] : out_[fail_[s]];
+      for (int cls = 0; cls < num_classes_; cls++) {
+        int t = next_[s][cls];
+        if (t < 0) {
+          next_[s][cls] = next_[fail_[s]][cls];
+        } else {
+          fail_[t] = next_[fail_[s]][cls];
+          work.push(t);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // Serialize the automaton in the order the kernel loads it
+  void Serialize(uint32_t *table) const {
+    for (int b = 0; b < 256; b++) {
+      *table++ = byte_class_[b];
+    }
+    for (int s = 0; s < kPatternMatchMaxStates; s++) {
+      for (int cls = 0; cls < kPatternMatchMaxClasses; cls++) {
+        bool valid = (s < (int)next_.size()) && (cls < num_classes_);
+        *table++ = valid ? next_[s][cls] : 0;
+      }
+    }
+    // the output is stored as pattern id + 1, with 0 meaning no match
+    for (int s = 0; s < kPatternMatchMaxStates; s++) {
+      *table++ = (s < (int)out_.size()) ? out_[s] + 1 : 0;
+    }
+  }
+
+  // Reference scan, reporting the same hits as the kernel
+  std::vector<PatternMatchHit> Scan(const uint8_t *data, size_t len) const {
+    std::vector<PatternMatchHit> hits;
+    int s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = next_[s][byte_class_[data[i]]];
+      if (out_[s] >= 0) hits.push_back({i, (uint32_t)out_[s]});
+    }
+    return hits;
+  }
+
+  // Patterns that are proper suffixes of pattern 'id'. They match wherever
+  // 'id' matches.
+  std::vector<int> Suffixes(int id) const {
+    int s = 0;
+    for (unsigned char c : patterns_[id]) s = next_[s][byte_class_[c]];
+
+    std::vector<int> suffixes;
+    for (s = fail_[s]; s != 0; s = fail_[s]) {
+      if (terminal_[s] >= 0) suffixes.push_back(terminal_[s]);
+    }
+    return suffixes;
+  }
+
+  int NumStates() const { return next_.size(); }
+  int NumClasses() const { return num_classes_; }
+
+ private:
+  std::vector<std::string> patterns_;
+  int byte_class_[256];
+  int num_classes_{0};
+  std::vector<std::vector<int>> next_;
+  std::vector<int> fail_;
+  std::vector<int> terminal_;
+  std::vector<int> out_;
+};
+
+//
+// Submit the multi-pattern matching kernel.
+//
+// The kernel first loads the automaton from 'TablePipe'. It then streams
+// 'count' elements from IOPipeIn to IOPipeOut and writes every match to
+// 'HitPipe', in batches of kHitBatch hits.
+//
+// An automaton consumes one byte per step and its next state depends on a
+// RAM lookup of its current state, so a single automaton can't process
+// several bytes per cycle. Instead, the stream is cut into frames and each
+// frame into segments, one per automaton. There are kLanes lanes, each
+// consuming one byte per cycle. Each lane interleaves kInterleave
+// automata in time through a shift register of states. The RAM latency of
+// the state update is hidden as long as kInterleave covers it.
+//
+// An automaton starts kPatternMatchMaxLen - 1 bytes before its segment,
+// which is enough history to detect any pattern ending in the segment.
+// Hits in this warm-up region belong to the previous segment and are not
+// reported. The first automaton of a frame has no warm-up; it continues
+// from the state of the last automaton of the previous frame.
+//
+// Frames are double buffered: frame f+1 is read from IOPipeIn while frame
+// f is scanned. Hits are buffered per automaton during the scan and sent
+// in stream order after it.
+//
+// All lanes look up the same copy of the automaton. Its memories are
+// double pumped, giving each RAM block three read ports next to the port
+// that loads it, so the compiler replicates them for every three lanes
+// rather than for every lane.
+//
+template <class IOPipeIn, class IOPipeOut, class TablePipe, class HitPipe,
+          typename T, int kLanes = sizeof(T), int kInterleave = 4,
+          int kFrameBeats = 1024, int kMaxHitsPerAutomaton = 64,
+          int kHitBatch = kPatternMatchHitBatch>
+event SubmitPatternMatchKernel(queue &q, size_t count) {
+  constexpr int kBeatBytes = sizeof(T);
+  constexpr int kFrameBytes = kFrameBeats * kBeatBytes;
+  constexpr int kNumAutomata = kLanes * kInterleave;
+  static_assert(kFrameBytes % kNumAutomata == 0);
+  constexpr int kSegBytes = kFrameBytes / kNumAutomata;
+  constexpr int kWarmUp = kPatternMatchMaxLen - 1;
+  static_assert(kSegBytes >= kWarmUp, "frames too short for the lanes");
+
+  // Each automaton is visited once every kInterleave steps
+  constexpr int kScanSteps = (kSegBytes + kWarmUp) * kInterleave;
+  constexpr int kSteps = std::max(kScanSteps, kFrameBeats);
+
+  // read ports per replica of a double pumped RAM, one port loading it
+  constexpr int kReplicas = (kLanes + 2) / 3;
+
+  return q.single_task<PatternMatchKernel>([=] {
+    // The automaton, shared by the lanes
+    [[intel::fpga_memory("BLOCK_RAM"), intel::doublepump,
+      intel::max_replicates(kReplicas)]]  // NO-FORMAT: Attribute
+    uint8_t byte_class[256];
+    [[intel::fpga_memory("BLOCK_RAM"), intel::doublepump,
+      intel::max_replicates(kReplicas)]]  // NO-FORMAT: Attribute
+    uint16_t next_state[kPatternMatchMaxStates * kPatternMatchMaxClasses];
+    [[intel::fpga_memory("BLOCK_RAM"), intel::doublepump,
+      intel::max_replicates(kReplicas)]]  // NO-FORMAT: Attribute
+    uint16_t out_pattern[kPatternMatchMaxStates];
+
+    for (int b = 0; b < 256; b++) {
+      byte_class[b] = TablePipe::read();
+    }
+    for (int i = 0; i < kPatternMatchMaxStates * kPatternMatchMaxClasses;
+         i++) {
+      next_state[i] = TablePipe::read();
+    }
+    for (int s = 0; s < kPatternMatchMaxStates; s++) {
+      out_pattern[s] = TablePipe::read();
+    }
+
+    T frame[2][kFrameBeats];
+    PatternMatchHit hits[kLanes][kInterleave][kMaxHitsPerAutomaton];
+    uint64_t dropped_hits = 0;
+    int batch_fill = 0;  // the number of hits sent in the current batch
+    uint16_t carry_state = 0;
+
+    const size_t num_frames = (count + kFrameBeats - 1) / kFrameBeats;
+    const uint64_t total_bytes = (uint64_t)count * kBeatBytes;
+
+    // iteration f loads frame f and scans frame f - 1
+    for (size_t f = 0; f <= num_frames; f++) {
+      const bool load = (f < num_frames);
+      const bool scan = (f > 0);
+      const int load_buf = f & 1;
+      const int scan_buf = load_buf ^ 1;
+
+      const uint64_t scan_base = scan ? (f - 1) * kFrameBytes : 0;
+      const int scan_bytes =
+          scan ? (int)std::min<uint64_t>(kFrameBytes, total_bytes - scan_base)
+               : 0;
+
+      // the automaton states of each lane, in a shift register
+      uint16_t state[kLanes][kInterleave];
+      int num_hits[kLanes][kInterleave];
+      fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+        fpga_tools::UnrolledLoop<kInterleave>([&](auto a) {
+          state[l][a] = (l == 0 && a == 0) ? carry_state : 0;
+          num_hits[l][a] = 0;
+        });
+      });
+
+      for (int step = 0; step < kSteps; step++) {
+        // read the next frame, passing the data through
+        if (load && step < kFrameBeats) {
+          size_t beat = f * kFrameBeats + step;
+          if (beat < count) {
+            T v = IOPipeIn::read();
+            IOPipeOut::write(v);
+            frame[load_buf][step] = v;
+          }
+        }
+
+        // advance one automaton in each lane
+        if (scan && step < kScanSteps) {
+          const int a = step % kInterleave;
+          const int i = step / kInterleave;
+
+          fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+            const int pos = (l * kInterleave + a) * kSegBytes + i - kWarmUp;
+            uint16_t s = state[l][0];
+
+            if (pos >= 0 && pos < scan_bytes) {
+              T beat = frame[scan_buf][pos / kBeatBytes];
+              uint8_t b = beat >> (8 * (pos % kBeatBytes));
+              s = next_state[s * kPatternMatchMaxClasses + byte_class[b]];
+
+              uint16_t p = out_pattern[s];
+              if (p != 0 && i >= kWarmUp) {
+                if (num_hits[l][a] < kMaxHitsPerAutomaton) {
+                  hits[l][a][num_hits[l][a]] = {scan_base + pos,
+                                                (uint32_t)(p - 1)};
+                  num_hits[l][a]++;
+                } else {
+                  dropped_hits++;
+                }
+              }
+            }
+
+            // rotate the shift register
+            fpga_tools::UnrolledLoop<kInterleave - 1>(
+                [&](auto j) { state[l][j] = state[l][j + 1]; });
+            state[l][kInterleave - 1] = s;
+          });
+        }
+      }
+
+      if (scan) {
+        // the last automaton ends at the end of the frame
+        carry_state = state[kLanes - 1][kInterleave - 1];
+
+        // send the hits in stream order
+        for (int l = 0; l < kLanes; l++) {
+          for (int a = 0; a < kInterleave; a++) {
+            for (int h = 0; h < num_hits[l][a]; h++) {
+              HitPipe::write(hits[l][a][h]);
+              batch_fill = (batch_fill == kHitBatch - 1) ? 0 : batch_fill + 1;
+            }
+          }
+        }
+      }
+    }
+
+    // end the scan, filling the last batch
+    do {
+      HitPipe::write({dropped_hits, kPatternMatchEndOfScan});
+      batch_fill = (batch_fill == kHitBatch - 1) ? 0 : batch_fill + 1;
+    } while (batch_fill != 0);
+  });
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It loads an automaton, streams random data with embedded patterns through
+// the kernel and compares the hits against the host reference.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunPatternMatchSystem(queue &q, size_t count) {
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<PatternMatchReadIOPipeID, T, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<PatternMatchWriteIOPipeID, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, count);
+  FakeIOPipeOutConsumer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  //////////////////////////////////////////////////////////////////////////////
+  // the automaton and the hits
+  // The automaton is too large to send one word at a time through a
+  // HostToDeviceSideChannel, so it is streamed by its own producer. The
+  // hits are read a batch at a time by a consumer, which the pipe can hold
+  // while the host handles the previous batch.
+  using TableProducer =
+      Producer<PatternMatchTableID, uint32_t, use_usm_host_alloc>;
+  using HitConsumer = Consumer<PatternMatchHitID, PatternMatchHit,
+                               use_usm_host_alloc, kPatternMatchHitBatch>;
+
+  TableProducer::Init(q, kPatternMatchTableWords);
+  HitConsumer::Init(q, kPatternMatchHitBatch);
+  HitConsumer::PrepareLaunch(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Patterns over a small alphabet, including some that are suffixes or
+  // prefixes of others
+  const char alphabet[] = "abcdefghijklmnop";
+  constexpr int kAlphabetSize = sizeof(alphabet) - 1;
+  AhoCorasickAutomaton ac;
+  std::vector<std::string> patterns = {"he", "she", "his", "hers", "ab",
+                                       "abcab"};
+  for (int i = 0; i < 24; i++) {
+    std::string p;
+    int len = 3 + rand() % 10;
+    for (int j = 0; j < len; j++) p += alphabet[rand() % kAlphabetSize];
+    patterns.push_back(p);
+  }
+  for (auto &p : patterns) ac.AddPattern(p);
+
+  if (!ac.Build()) {
+    std::cerr << "ERROR: automaton does not fit the device limits\n";
+    return false;
+  }
+  std::cout << "Pattern matcher: " << patterns.size() << " patterns, "
+            << ac.NumStates() << " states, " << ac.NumClasses()
+            << " byte classes\n";
+  ac.Serialize(TableProducer::Data());
+
+  // random text with patterns inserted at random offsets
+  const size_t num_bytes = count * sizeof(T);
+  std::vector<uint8_t> text(num_bytes);
+  for (auto &c : text) c = alphabet[rand() % kAlphabetSize];
+  for (size_t i = 0; i < num_bytes / 64; i++) {
+    auto &p = patterns[rand() % patterns.size()];
+    size_t offset = rand() % num_bytes;
+    if (offset + p.size() <= num_bytes) {
+      std::copy(p.begin(), p.end(), text.begin() + offset);
+    }
+  }
+  std::memcpy(FakeIOPipeInProducer::Data(), text.data(), num_bytes);
+
+  auto expected = ac.Scan(text.data(), num_bytes);
+
+  // launch the kernel, load the automaton and stream the data
+  auto kernel_event =
+      SubmitPatternMatchKernel<ReadIOPipe, WriteIOPipe,
+                               typename TableProducer::Pipe,
+                               typename HitConsumer::Pipe, T>(q, count);
+
+  event table_dma_event, table_kernel_event;
+  std::tie(table_dma_event, table_kernel_event) = TableProducer::Start(q);
+
+  event producer_dma_event, producer_kernel_event;
+  event consumer_dma_event, consumer_kernel_event;
+  std::tie(producer_dma_event, producer_kernel_event) =
+      FakeIOPipeInProducer::Start(q);
+  std::tie(consumer_dma_event, consumer_kernel_event) =
+      FakeIOPipeOutConsumer::Start(q);
+
+  // read batches of hits until the end of the scan
+  std::vector<PatternMatchHit> hits;
+  uint64_t dropped_hits = 0;
+  bool end_of_scan = false;
+  while (!end_of_scan) {
+    event hit_dma_event, hit_kernel_event;
+    std::tie(hit_dma_event, hit_kernel_event) = HitConsumer::Launch();
+    hit_dma_event.wait();
+    hit_kernel_event.wait();
+
+    auto batch = HitConsumer::Data();
+    for (int i = 0; i < kPatternMatchHitBatch && !end_of_scan; i++) {
+      if (batch[i].pattern_id == kPatternMatchEndOfScan) {
+        dropped_hits = batch[i].offset;
+        end_of_scan = true;
+      } else {
+        hits.push_back(batch[i]);
+      }
+    }
+  }
+
+  table_dma_event.wait();
+  table_kernel_event.wait();
+  producer_dma_event.wait();
+  producer_kernel_event.wait();
+  consumer_dma_event.wait();
+  consumer_kernel_event.wait();
+  kernel_event.wait();
+
+  bool passed = true;
+
+  // validate the pass-through data
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  auto o_stream_data = FakeIOPipeOutConsumer::Data();
+  for (size_t i = 0; i < count; i++) {
+    if (o_stream_data[i] != i_stream_data[i]) {
+      std::cerr << "ERROR: output mismatch at entry " << i << ": "
+                << o_stream_data[i] << " != " << i_stream_data[i]
+                << " (out != in)\n";
+      passed &= false;
+      break;
+    }
+  }
+
+  // validate the hits
+  std::cout << "Pattern matcher: " << hits.size() << " hits, expecting "
+            << expected.size() << "\n";
+  if (dropped_hits != 0) {
+    std::cerr << "ERROR: " << dropped_hits << " hits were dropped\n";
+    passed &= false;
+  }
+  if (hits.size() != expected.size()) {
+    std::cerr << "ERROR: hit count mismatch\n";
+    passed &= false;
+  }
+  for (size_t i = 0; i < std::min(hits.size(), expected.size()); i++) {
+    if (hits[i].offset != expected[i].offset ||
+        hits[i].pattern_id != expected[i].pattern_id) {
+      std::cerr << "ERROR: hit " << i << " is (" << hits[i].offset << ", "
+                << hits[i].pattern_id << "), expected ("
+                << expected[i].offset << ", " << expected[i].pattern_id
+                << ")\n";
+      passed &= false;
+      break;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+  TableProducer::Destroy(q);
+  HitConsumer::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __PATTERNMATCHTEST_HPP__ */
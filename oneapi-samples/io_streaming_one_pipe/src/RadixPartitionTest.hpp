@@ -0,0 +1,308 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __RADIXPARTITIONTEST_HPP__
+#define __RADIXPARTITIONTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "TestData.hpp"
+#include "constexpr_math.hpp"
+#include "onchip_memory_with_cache.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct RadixPartitionKernel;
+struct RadixPartitionReadIOPipeID { static constexpr unsigned id = 0; };
+
+// the seed of the random keys (see TestData.hpp)
+constexpr uint64_t kRadixPartitionDataSeed = 3;
+
+//
+// The partition of a tuple: kBits bits of its key (the low 32 bits of the
+// tuple) starting at bit kShift, or, if kHash is set, the top kBits bits of
+// a multiplicative hash of the key.
+//
+template <int kBits, int kShift = 0, bool kHash = false>
+struct RadixPartitioner {
+  static constexpr int kNumPartitions = 1 << kBits;
+
+  static uint32_t Partition(uint64_t tuple) {
+    uint32_t key = tuple;
+    if constexpr (kHash) {
+      return (key * 0x9E3779B1u) >> (32 - kBits);
+    } else {
+      return (key >> kShift) & (kNumPartitions - 1);
+    }
+  }
+};
+
+// kBurst tuples written to memory with a single store
+template <typename T, int kBurst>
+struct PartitionBurst {
+  T v[kBurst];
+};
+
+//
+// Submit the radix partitioning kernel.
+//
+// Reads 'count' tuples from IOPipeIn and writes each one to its partition
+// in 'out'. Tuples keep their input order within a partition. The kernel
+// works in two passes, so no tuple is ever dropped:
+//    1. the tuples are copied to 'staging' in arrival order, while a
+//       histogram counts the tuples of each partition
+//    2. the histogram gives each partition a region of 'out' that starts on
+//       a burst boundary and holds exactly its tuples, and the tuples are
+//       moved there from 'staging'
+// 'staging' holds 'count' tuples and 'out' RadixPartitionOutCount() tuples.
+//
+// In the second pass, each partition has a write combining buffer of kBurst
+// tuples on chip. A tuple is added to its partition's buffer, and when the
+// buffer fills it is written to memory as one full burst. Every memory
+// write is a full burst except the final flush of each partition. The
+// buffer fill levels and contents are read and written every cycle, so
+// they are kept in cached memories.
+//
+// When the kernel finishes, partition p holds counts[p] tuples starting at
+// out[offsets[p]].
+//
+template <class IOPipeIn, class Partitioner, typename T, int kBurst = 8>
+event SubmitRadixPartitionKernel(queue &q, size_t count, T *staging, T *out,
+                                 uint32_t *offsets, uint32_t *counts) {
+  constexpr int kNumPartitions = Partitioner::kNumPartitions;
+  constexpr int kCacheDepth = 8;
+  static_assert(fpga_tools::IsPow2(kBurst));
+  using Burst = PartitionBurst<T, kBurst>;
+
+  return q.single_task<RadixPartitionKernel>([=
+  ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+    // the histogram, and then the number of tuples written to each
+    // partition
+    fpga_tools::OnchipMemoryWithCache<uint32_t, kNumPartitions, kCacheDepth>
+        fill(0);
+    // the write combining buffers, one memory per slot
+    fpga_tools::OnchipMemoryWithCache<T, kNumPartitions, kCacheDepth>
+        buffer[kBurst];
+    // the first burst of each partition in 'out'
+    uint32_t first_burst[kNumPartitions];
+
+    // stage the tuples and count them
+    for (size_t i = 0; i < count; i++) {
+      T t = IOPipeIn::read();
+      staging[i] = t;
+      uint32_t p = Partitioner::Partition(t);
+      fill.write(p, fill.read(p) + 1);
+    }
+
+    // the start of each partition, rounded up to a burst
+    uint32_t next_burst = 0;
+    for (uint32_t p = 0; p < kNumPartitions; p++) {
+      uint32_t n = fill.read(p);
+      first_burst[p] = next_burst;
+      offsets[p] = next_burst * kBurst;
+      next_burst += (n + kBurst - 1) / kBurst;
+      fill.write(p, 0);
+    }
+
+    Burst *bursts = (Burst *)out;
+
+    // move the tuples to their partition
+    [[intel::ivdep(bursts)]]  // NO-FORMAT: Attribute
+    for (size_t i = 0; i < count; i++) {
+      T t = staging[i];
+      uint32_t p = Partitioner::Partition(t);
+      uint32_t n = fill.read(p);
+      const uint32_t slot = n % kBurst;
+
+      // the buffer is full with this tuple: write it out as one burst
+      if (slot == kBurst - 1) {
+        Burst b;
+        fpga_tools::UnrolledLoop<kBurst - 1>(
+            [&](auto s) { b.v[s] = buffer[s].read(p); });
+        b.v[kBurst - 1] = t;
+        bursts[first_burst[p] + n / kBurst] = b;
+      } else {
+        fpga_tools::UnrolledLoop<kBurst - 1>([&](auto s) {
+          if (s == slot) buffer[s].write(p, t);
+        });
+      }
+      fill.write(p, n + 1);
+    }
+
+    // flush the partially filled buffers and write the counts
+    for (uint32_t p = 0; p < kNumPartitions; p++) {
+      uint32_t n = fill.read(p);
+      if (n % kBurst != 0) {
+        Burst b;
+        fpga_tools::UnrolledLoop<kBurst>(
+            [&](auto s) { b.v[s] = buffer[s].read(p); });
+        bursts[first_burst[p] + n / kBurst] = b;
+      }
+      counts[p] = n;
+    }
+  });
+}
+
+//
+// The size of the 'out' buffer of SubmitRadixPartitionKernel, in tuples:
+// every tuple, plus the padding of the last burst of each partition.
+//
+template <int kNumPartitions, int kBurst>
+constexpr size_t RadixPartitionOutCount(size_t count) {
+  return fpga_tools::RoundUpToMultiple<size_t>(count, kBurst) +
+         (size_t)kNumPartitions * kBurst;
+}
+
+//
+// Partition 'count' tuples with random keys and check that every partition
+// holds exactly its tuples, in input order. With 'skewed' set, the keys
+// follow a Zipf distribution, so key 0 alone is about a fifth of the tuples.
+//
+template <typename T, bool use_usm_host_alloc, class Partitioner, int kBurst>
+bool RunRadixPartition(queue &q, size_t count, bool skewed) {
+  constexpr int kNumPartitions = Partitioner::kNumPartitions;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<RadixPartitionReadIOPipeID, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  const size_t out_count =
+      RadixPartitionOutCount<kNumPartitions, kBurst>(count);
+
+  T *out_host;
+  T *out;
+  T *staging = malloc_device<T>(std::max<size_t>(count, 1), q);
+  uint32_t *offsets = malloc_host<uint32_t>(kNumPartitions, q);
+  uint32_t *counts = malloc_host<uint32_t>(kNumPartitions, q);
+  if (use_usm_host_alloc) {
+    out_host = malloc_host<T>(out_count, q);
+    out = out_host;
+  } else {
+    out_host = new T[out_count];
+    out = malloc_device<T>(out_count, q);
+  }
+  if (out_host == nullptr || out == nullptr || staging == nullptr ||
+      offsets == nullptr || counts == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the partitions\n";
+    std::terminate();
+  }
+
+  // random tuples: the key in the low 32 bits, the index in the high bits
+  auto keys =
+      skewed ? TestDataGenerator<uint32_t>::Zipf(kRadixPartitionDataSeed,
+                                                 1 << 20, 1.2)
+             : TestDataGenerator<uint32_t>::Uniform(kRadixPartitionDataSeed,
+                                                    uint64_t(1) << 32);
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  for (size_t i = 0; i < count; i++) {
+    i_stream_data[i] = ((T)i << 32) | keys(i);
+  }
+
+  auto kernel_event =
+      SubmitRadixPartitionKernel<ReadIOPipe, Partitioner, T, kBurst>(
+          q, count, staging, out, offsets, counts);
+
+  event producer_dma_event, producer_kernel_event;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(producer_dma_event, producer_kernel_event) =
+      FakeIOPipeInProducer::Start(q);
+
+  producer_dma_event.wait();
+  producer_kernel_event.wait();
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  if (!use_usm_host_alloc) {
+    q.memcpy(out_host, out, out_count * sizeof(T)).wait();
+  }
+
+  // the bursts written to memory, and how many of them were full
+  size_t num_bursts = 0, num_full_bursts = 0;
+  for (int p = 0; p < kNumPartitions; p++) {
+    num_bursts += (counts[p] + kBurst - 1) / kBurst;
+    num_full_bursts += counts[p] / kBurst;
+  }
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Radix partition" << (skewed ? " (skewed keys)" : "") << ": "
+            << count << " tuples into " << kNumPartitions << " partitions in "
+            << diff.count() << " ms, " << num_full_bursts << " of "
+            << num_bursts << " bursts were full\n";
+
+  // validate the results
+  bool passed = true;
+  for (int p = 0; p < kNumPartitions && passed; p++) {
+    if (offsets[p] % kBurst != 0 || offsets[p] + counts[p] > out_count ||
+        (p > 0 && offsets[p] < offsets[p - 1] + counts[p - 1])) {
+      std::cerr << "ERROR: partition " << p << " of " << counts[p]
+                << " tuples at offset " << offsets[p]
+                << " overlaps another one or the end of the buffer\n";
+      passed &= false;
+    }
+  }
+
+  std::vector<uint32_t> expected_fill(kNumPartitions, 0);
+  for (size_t i = 0; i < count && passed; i++) {
+    uint32_t p = Partitioner::Partition(i_stream_data[i]);
+    uint32_t n = expected_fill[p]++;
+    if (n >= counts[p] || out_host[offsets[p] + n] != i_stream_data[i]) {
+      std::cerr << "ERROR: tuple " << i << " is not entry " << n
+                << " of partition " << p << "\n";
+      passed &= false;
+    }
+  }
+  for (int p = 0; p < kNumPartitions && passed; p++) {
+    if (counts[p] != expected_fill[p]) {
+      std::cerr << "ERROR: partition " << p << " has " << counts[p]
+                << " tuples, expected " << expected_fill[p] << "\n";
+      passed &= false;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  free(staging, q);
+  free(offsets, q);
+  free(counts, q);
+  if (use_usm_host_alloc) {
+    free(out_host, q);
+  } else {
+    delete[] out_host;
+    free(out, q);
+  }
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It partitions a stream of uniformly random keys, and a stream of skewed
+// keys in which one partition gets far more than its share of the tuples.
+//
+template <typename T, bool use_usm_host_alloc, int kBits = 6, int kShift = 0,
+          bool kHash = false, int kBurst = 8>
+bool RunRadixPartitionSystem(queue &q, size_t count) {
+  using Partitioner = RadixPartitioner<kBits, kShift, kHash>;
+
+  bool passed = true;
+  passed &= RunRadixPartition<T, use_usm_host_alloc, Partitioner, kBurst>(
+      q, count, false);
+  passed &= RunRadixPartition<T, use_usm_host_alloc, Partitioner, kBurst>(
+      q, count, true);
+  return passed;
+}
+
+#endif /* __RADIXPARTITIONTEST_HPP__ */
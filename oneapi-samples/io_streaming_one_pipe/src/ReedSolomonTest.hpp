@@ -0,0 +1,475 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __REEDSOLOMONTEST_HPP__
+#define __REEDSOLOMONTEST_HPP__
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "pipe_utils.hpp"
+#include "rom_base.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct RSStripeKernel;
+struct RSEncodeKernel;
+struct RSShardWriterKernel;
+struct RSDecodeKernel;
+struct RSStripedPipesID;
+struct RSDataPipesID;
+struct RSParityPipesID;
+struct RSEncodeReadIOPipeID { static constexpr unsigned id = 0; };
+struct RSDecodeWriteIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// GF(2^8) arithmetic with the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D),
+// for which 2 is a generator
+//
+namespace gf256 {
+
+// multiply by x, the generator 2
+constexpr uint8_t XTime(uint8_t a) {
+  return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1D : 0x00));
+}
+
+constexpr uint8_t MulSlow(uint8_t a, uint8_t b) {
+  uint8_t p = 0;
+  for (int i = 0; i < 8; i++) {
+    if (b & 1) p ^= a;
+    a = XTime(a);
+    b >>= 1;
+  }
+  return p;
+}
+
+//
+// The exp and log tables, built together in one pass over the powers of
+// the generator, so that they are cheap to evaluate at compile time. The
+// exp table is twice as deep so that log(a) + log(b) needs no modulo.
+//
+struct Tables {
+  constexpr Tables() : exp(), log() {
+    uint8_t x = 1;
+    for (int i = 0; i < 255; i++) {
+      exp[i] = x;
+      exp[i + 255] = x;
+      log[x] = i;
+      x = XTime(x);
+    }
+    exp[510] = exp[0];
+    exp[511] = exp[1];
+  }
+
+  uint8_t exp[512];
+  uint8_t log[256];  // log(0) is undefined and left as 0
+};
+
+inline constexpr Tables kTables;
+
+constexpr uint8_t Exp(int e) { return kTables.exp[e % 255]; }
+
+constexpr uint8_t Log(int x) { return kTables.log[x]; }
+
+constexpr uint8_t Inv(uint8_t a) { return Exp(255 - Log(a)); }
+
+struct ExpROM : fpga_tools::ROMBase<uint8_t, 512> {
+  constexpr ExpROM()
+      : fpga_tools::ROMBase<uint8_t, 512>(
+            [](int e) { return kTables.exp[e]; }) {}
+};
+
+struct LogROM : fpga_tools::ROMBase<uint8_t, 256> {
+  constexpr LogROM()
+      : fpga_tools::ROMBase<uint8_t, 256>(
+            [](int x) { return kTables.log[x]; }) {}
+};
+
+}  // namespace gf256
+
+//
+// The parity rows of a systematic RS(k, m) code. Parity i is the GF(2^8)
+// dot product of row i of a Cauchy matrix with the k data bytes. Every
+// square submatrix of a Cauchy matrix is invertible, so any k of the k + m
+// shards are enough to recover the data.
+//
+template <int k, int m>
+struct RSParityMatrix {
+  static_assert(k + m <= 256);
+
+  constexpr RSParityMatrix() : coef(), log_coef() {
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < k; j++) {
+        coef[i][j] = gf256::Inv((uint8_t)((k + i) ^ j));
+        log_coef[i][j] = gf256::Log(coef[i][j]);
+      }
+    }
+  }
+
+  uint8_t coef[m][k];
+  uint8_t log_coef[m][k];
+};
+
+//
+// The shards used to reconstruct the data and the k x k matrix that maps
+// them back to the data shards. Built on the host for each erasure pattern.
+//
+template <int k>
+struct RSDecodePlan {
+  uint8_t src[k];       // shard index of each input
+  uint8_t coef[k][k];   // data[i] = sum_j coef[i][j] * shard[src[j]]
+};
+
+// Build the decode plan for the given surviving shards. Returns false if
+// fewer than k shards survive.
+template <int k, int m>
+bool MakeRSDecodePlan(const std::vector<int> &surviving, RSDecodePlan<k> &plan) {
+  if (surviving.size() < k) return false;
+
+  // the rows of the generator matrix for the first k surviving shards
+  constexpr RSParityMatrix<k, m> parity;
+  uint8_t a[k][2 * k] = {};
+  for (int r = 0; r < k; r++) {
+    int s = surviving[r];
+    plan.src[r] = s;
+    for (int c = 0; c < k; c++) {
+      a[r][c] = (s < k) ? (s == c) : parity.coef[s - k][c];
+    }
+    a[r][k + r] = 1;
+  }
+
+  // Gauss-Jordan inversion
+  for (int c = 0; c < k; c++) {
+    int p = c;
+    while (p < k && a[p][c] == 0) p++;
+    if (p == k) return false;
+    std::swap(a[p], a[c]);
+
+    uint8_t inv = gf256::Inv(a[c][c]);
+    for (int j = 0; j < 2 * k; j++) a[c][j] = gf256::MulSlow(a[c][j], inv);
+    for (int r = 0; r < k; r++) {
+      if (r != c && a[r][c] != 0) {
+        uint8_t f = a[r][c];
+        for (int j = 0; j < 2 * k; j++) {
+          a[r][j] ^= gf256::MulSlow(f, a[c][j]);
+        }
+      }
+    }
+  }
+
+  for (int r = 0; r < k; r++) {
+    for (int c = 0; c < k; c++) plan.coef[r][c] = a[r][k + c];
+  }
+  return true;
+}
+
+// Multiply every byte of 'x' by the GF(2^8) element with log 'log_c'
+template <typename T>
+T RSMulBytes(T x, uint8_t log_c) {
+  constexpr gf256::ExpROM exp_rom;
+  constexpr gf256::LogROM log_rom;
+  T res = 0;
+  fpga_tools::UnrolledLoop<sizeof(T)>([&](auto b) {
+    uint8_t v = x >> (8 * b);
+    uint8_t p = (v == 0) ? 0 : exp_rom[log_rom[v] + log_c];
+    res |= (T)p << (8 * b);
+  });
+  return res;
+}
+
+//
+// Stripe the input stream over the k data pipes. Beat i goes to data
+// shard i % k. The last row is padded with zeros.
+//
+template <class IOPipeIn, class DataPipes, typename T, int k>
+event SubmitRSStripeKernel(queue &q, size_t count) {
+  return q.single_task<RSStripeKernel>([=] {
+    const size_t rows = (count + k - 1) / k;
+    for (size_t r = 0; r < rows; r++) {
+      fpga_tools::UnrolledLoop<k>([&](auto j) {
+        T v = (r * k + j < count) ? IOPipeIn::read() : T(0);
+        DataPipes::template PipeAt<j>::write(v);
+      });
+    }
+  });
+}
+
+//
+// The RS(k, m) encoder. Each iteration reads one beat from each of the k
+// data pipes and writes one beat to each of the m parity pipes, so
+// sizeof(T) bytes of every shard are coded per cycle. The parity matrix
+// is a compile time constant, so each product is a pair of ROM lookups.
+//
+template <class DataPipesIn, class DataPipesOut, class ParityPipes,
+          typename T, int k, int m>
+event SubmitRSEncodeKernel(queue &q, size_t rows) {
+  return q.single_task<RSEncodeKernel>([=] {
+    constexpr RSParityMatrix<k, m> parity;
+
+    [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+    for (size_t r = 0; r < rows; r++) {
+      T data[k];
+      fpga_tools::UnrolledLoop<k>([&](auto j) {
+        data[j] = DataPipesIn::template PipeAt<j>::read();
+        DataPipesOut::template PipeAt<j>::write(data[j]);
+      });
+
+      fpga_tools::UnrolledLoop<m>([&](auto i) {
+        T p = 0;
+        fpga_tools::UnrolledLoop<k>([&](auto j) {
+          p ^= RSMulBytes(data[j], parity.log_coef[i][j]);
+        });
+        ParityPipes::template PipeAt<i>::write(p);
+      });
+    }
+  });
+}
+
+//
+// Write the data and parity shards to memory. Shard s occupies
+// shards[s * rows, (s + 1) * rows).
+//
+template <class DataPipes, class ParityPipes, typename T, int k, int m>
+event SubmitRSShardWriterKernel(queue &q, T *shards, size_t rows) {
+  return q.single_task<RSShardWriterKernel>([=
+  ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+    for (size_t r = 0; r < rows; r++) {
+      fpga_tools::UnrolledLoop<k>([&](auto j) {
+        shards[j * rows + r] = DataPipes::template PipeAt<j>::read();
+      });
+      fpga_tools::UnrolledLoop<m>([&](auto i) {
+        shards[(k + i) * rows + r] = ParityPipes::template PipeAt<i>::read();
+      });
+    }
+  });
+}
+
+//
+// The RS(k, m) decoder. Reads the k shards named by 'plan' from memory and
+// writes the reconstructed data stream, in the original beat order, to
+// IOPipeOut. The decode matrix depends on which shards were lost, so it is
+// a kernel argument and the products use the log of each coefficient.
+//
+template <class IOPipeOut, typename T, int k>
+event SubmitRSDecodeKernel(queue &q, const T *shards, size_t rows,
+                           size_t count, RSDecodePlan<k> plan) {
+  return q.single_task<RSDecodeKernel>([=
+  ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+    constexpr gf256::LogROM log_rom;
+
+    // coefficients are stored as logs, zero coefficients are flagged
+    uint8_t log_coef[k][k];
+    bool zero_coef[k][k];
+    size_t src_offset[k];
+    fpga_tools::UnrolledLoop<k>([&](auto i) {
+      src_offset[i] = plan.src[i] * rows;
+      fpga_tools::UnrolledLoop<k>([&](auto j) {
+        log_coef[i][j] = log_rom[plan.coef[i][j]];
+        zero_coef[i][j] = (plan.coef[i][j] == 0);
+      });
+    });
+
+    [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+    for (size_t r = 0; r < rows; r++) {
+      T in[k];
+      fpga_tools::UnrolledLoop<k>(
+          [&](auto j) { in[j] = shards[src_offset[j] + r]; });
+
+      fpga_tools::UnrolledLoop<k>([&](auto i) {
+        T d = 0;
+        fpga_tools::UnrolledLoop<k>([&](auto j) {
+          if (!zero_coef[i][j]) d ^= RSMulBytes(in[j], log_coef[i][j]);
+        });
+        if (r * k + i < count) IOPipeOut::write(d);
+      });
+    }
+  });
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// The input stream is striped over k data shards and encoded, the shards
+// are written to memory and checked against a host reference, then up to
+// m shards are erased and the data is reconstructed from the rest.
+//
+template <typename T, bool use_usm_host_alloc, int k = 4, int m = 2>
+bool RunReedSolomonSystem(queue &q, size_t count) {
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<RSEncodeReadIOPipeID, T, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<RSDecodeWriteIOPipeID, T, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, count);
+  FakeIOPipeOutConsumer::Init(q, count);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // pipes between the encoder kernels
+  using StripedPipes = fpga_tools::PipeArray<RSStripedPipesID, T, 16, k>;
+  using DataPipes = fpga_tools::PipeArray<RSDataPipesID, T, 16, k>;
+  using ParityPipes = fpga_tools::PipeArray<RSParityPipesID, T, 16, m>;
+
+  const size_t rows = (count + k - 1) / k;
+  const size_t shard_beats = (k + m) * rows;
+
+  // the shards
+  T *shards_host;
+  T *shards;
+  if (use_usm_host_alloc) {
+    shards_host = malloc_host<T>(shard_beats, q);
+    shards = shards_host;
+  } else {
+    shards_host = new T[shard_beats];
+    shards = malloc_device<T>(shard_beats, q);
+  }
+  if (shards_host == nullptr || shards == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the shards\n";
+    std::terminate();
+  }
+
+  // random input data
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  for (size_t i = 0; i < count; i++) {
+    i_stream_data[i] = ((T)rand() << 32) ^ rand();
+  }
+
+  bool passed = true;
+
+  // encode
+  auto start = std::chrono::high_resolution_clock::now();
+  auto stripe_event =
+      SubmitRSStripeKernel<ReadIOPipe, StripedPipes, T, k>(q, count);
+  auto encode_event =
+      SubmitRSEncodeKernel<StripedPipes, DataPipes, ParityPipes, T, k, m>(
+          q, rows);
+  auto writer_event =
+      SubmitRSShardWriterKernel<DataPipes, ParityPipes, T, k, m>(q, shards,
+                                                                  rows);
+
+  event producer_dma_event, producer_kernel_event;
+  std::tie(producer_dma_event, producer_kernel_event) =
+      FakeIOPipeInProducer::Start(q);
+
+  producer_dma_event.wait();
+  producer_kernel_event.wait();
+  stripe_event.wait();
+  encode_event.wait();
+  writer_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "RS(" << k << ", " << m << ") encode: "
+            << count * sizeof(T) * 1e-3 / diff.count() << " MB/s\n";
+
+  if (!use_usm_host_alloc) {
+    q.memcpy(shards_host, shards, shard_beats * sizeof(T)).wait();
+  }
+
+  // check the shards against the host reference
+  constexpr RSParityMatrix<k, m> parity;
+  for (size_t r = 0; r < rows && passed; r++) {
+    for (int s = 0; s < k + m; s++) {
+      T expected = 0;
+      if (s < k) {
+        expected = (r * k + s < count) ? i_stream_data[r * k + s] : T(0);
+      } else {
+        for (int j = 0; j < k; j++) {
+          T v = (r * k + j < count) ? i_stream_data[r * k + j] : T(0);
+          for (size_t b = 0; b < sizeof(T); b++) {
+            uint8_t p = gf256::MulSlow(v >> (8 * b), parity.coef[s - k][j]);
+            expected ^= (T)p << (8 * b);
+          }
+        }
+      }
+      if (shards_host[s * rows + r] != expected) {
+        std::cerr << "ERROR: shard " << s << " mismatch at row " << r << ": "
+                  << shards_host[s * rows + r] << " != " << expected
+                  << " (out != expected)\n";
+        passed &= false;
+        break;
+      }
+    }
+  }
+
+  // erase m random shards and reconstruct the data from the others
+  std::vector<int> surviving(k + m);
+  std::iota(surviving.begin(), surviving.end(), 0);
+  for (int i = 0; i < m; i++) {
+    std::swap(surviving[i], surviving[i + rand() % (k + m - i)]);
+  }
+  std::vector<int> lost(surviving.begin(), surviving.begin() + m);
+  surviving.erase(surviving.begin(), surviving.begin() + m);
+  std::sort(surviving.begin(), surviving.end());
+  for (int s : lost) {
+    if (use_usm_host_alloc) {
+      std::fill(shards_host + s * rows, shards_host + (s + 1) * rows, T(0));
+    } else {
+      q.memset(shards + s * rows, 0, rows * sizeof(T)).wait();
+    }
+  }
+
+  RSDecodePlan<k> plan;
+  if (!MakeRSDecodePlan<k, m>(surviving, plan)) {
+    std::cerr << "ERROR: no decode plan for the surviving shards\n";
+    passed &= false;
+  } else {
+    std::cout << "RS(" << k << ", " << m << ") decode from shards";
+    for (int s : surviving) std::cout << " " << s;
+    std::cout << "\n";
+
+    start = std::chrono::high_resolution_clock::now();
+    auto decode_event =
+        SubmitRSDecodeKernel<WriteIOPipe, T, k>(q, shards, rows, count, plan);
+
+    event consumer_dma_event, consumer_kernel_event;
+    std::tie(consumer_dma_event, consumer_kernel_event) =
+        FakeIOPipeOutConsumer::Start(q);
+
+    consumer_dma_event.wait();
+    consumer_kernel_event.wait();
+    decode_event.wait();
+    end = std::chrono::high_resolution_clock::now();
+
+    diff = end - start;
+    std::cout << "RS(" << k << ", " << m << ") decode: "
+              << count * sizeof(T) * 1e-3 / diff.count() << " MB/s\n";
+
+    auto o_stream_data = FakeIOPipeOutConsumer::Data();
+    for (size_t i = 0; i < count; i++) {
+      if (o_stream_data[i] != i_stream_data[i]) {
+        std::cerr << "ERROR: reconstruction mismatch at entry " << i << ": "
+                  << o_stream_data[i] << " != " << i_stream_data[i]
+                  << " (out != in)\n";
+        passed &= false;
+        break;
+      }
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+  if (use_usm_host_alloc) {
+    free(shards_host, q);
+  } else {
+    delete[] shards_host;
+    free(shards, q);
+  }
+
+  return passed;
+}
+
+#endif /* __REEDSOLOMONTEST_HPP__ */
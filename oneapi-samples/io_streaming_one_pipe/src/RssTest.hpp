@@ -0,0 +1,385 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __RSSTEST_HPP__
+#define __RSSTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "HostSideChannel.hpp"
+#include "packet_parser.hpp"
+#include "pipe_utils.hpp"
+#include "rss_distributor.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct RssParserKernel;
+struct RssDistributorKernel;
+template <int lane> struct RssLaneKernel;
+struct RssReadIOPipeID { static constexpr unsigned id = 0; };
+struct RssParsedMetadataPipeID;
+struct RssParsedPayloadPipeID;
+struct RssMetadataPipesID;
+struct RssPayloadPipesID;
+struct RssCommandSideChannelID;
+struct RssAckSideChannelID;
+
+constexpr int kRssBeatBytes = 16;
+
+// the flow of a test packet
+struct RssFlow {
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint16_t src_port;
+  uint16_t dst_port;
+  uint8_t protocol;
+  int vlan_tags;
+  bool ipv4;
+};
+
+//
+// Build a packet of 'flow', with 'seq' at the start of its payload. The
+// IPv4 header checksum is left at 0, since the distributor ignores it.
+//
+inline std::vector<uint8_t> RssMakePacket(const RssFlow &flow, uint32_t seq) {
+  std::vector<uint8_t> p;
+  auto push16 = [&](uint16_t x) {
+    p.push_back(x >> 8);
+    p.push_back(x & 0xFF);
+  };
+  auto push32 = [&](uint32_t x) {
+    push16(x >> 16);
+    push16(x & 0xFFFF);
+  };
+
+  for (int i = 0; i < 12; i++) p.push_back(0x10 + i);
+  for (int t = 0; t < flow.vlan_tags; t++) {
+    push16(fpga_tools::kEtherTypeVlan);
+    push16(100 + t);
+  }
+  if (!flow.ipv4) {
+    push16(0x86DD);
+  } else {
+    push16(fpga_tools::kEtherTypeIPv4);
+    p.push_back(0x45);
+    p.push_back(0);
+    push16(0);
+    push16(0);
+    push16(0x4000);
+    p.push_back(64);
+    p.push_back(flow.protocol);
+    push16(0);
+    push32(flow.src_ip);
+    push32(flow.dst_ip);
+    push16(flow.src_port);
+    push16(flow.dst_port);
+    if (flow.protocol == fpga_tools::kIpProtocolUdp) {
+      push16(0);
+      push16(0);
+    } else {
+      for (int i = 0; i < 8; i++) p.push_back(0);
+      p.push_back(5 << 4);
+      for (int i = 0; i < 7; i++) p.push_back(0);
+    }
+  }
+  push32(seq);
+  for (int i = rand() % 100; i > 0; i--) p.push_back(rand() % 256);
+  return p;
+}
+
+//
+// The Toeplitz hash as the RSS specification describes it: a 32-bit window
+// slides along the key, one bit per bit of the input, and is XORed into
+// the result for every set input bit.
+//
+inline uint32_t RssReferenceHash(const uint8_t *key, const uint8_t *in,
+                                 int bytes) {
+  uint32_t window = (uint32_t(key[0]) << 24) | (uint32_t(key[1]) << 16) |
+                    (uint32_t(key[2]) << 8) | key[3];
+  int next_bit = 32;
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) {
+    for (int b = 7; b >= 0; b--) {
+      if ((in[i] >> b) & 1) result ^= window;
+      int key_bit = (key[next_bit / 8] >> (7 - next_bit % 8)) & 1;
+      window = (window << 1) | key_bit;
+      next_bit++;
+    }
+  }
+  return result;
+}
+
+// the hash the NIC computes for a flow, with TCP and UDP ports hashed
+inline uint32_t RssReferenceFlowHash(const uint8_t *key, const RssFlow &flow) {
+  if (!flow.ipv4) return 0;
+  uint8_t in[12];
+  for (int i = 0; i < 4; i++) {
+    in[i] = flow.src_ip >> (24 - 8 * i);
+    in[4 + i] = flow.dst_ip >> (24 - 8 * i);
+  }
+  in[8] = flow.src_port >> 8;
+  in[9] = flow.src_port & 0xFF;
+  in[10] = flow.dst_port >> 8;
+  in[11] = flow.dst_port & 0xFF;
+  return RssReferenceHash(key, in, 12);
+}
+
+//
+// This function builds the full system using fake IO pipes:
+//
+//   packets -> PacketParser -> RssDistributor -> kLanes lane kernels
+//
+// The lane kernels stand in for replicated processing kernels and record
+// the packets they get. The test sends two batches of packets from a set
+// of flows, with the default round robin indirection table and then with a
+// table the host writes through the side channel. It checks that every
+// packet reaches the lane its host computed hash selects, that each lane
+// gets its packets in order, and that the hashes match the published
+// verification vectors of the RSS specification.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes = 4>
+bool RunRssSystem(queue &q, size_t count) {
+  using Beat = fpga_tools::PacketBeat<kRssBeatBytes>;
+  using fpga_tools::RssMetadata;
+  const uint8_t *key = fpga_tools::kRssDefaultKey;
+
+  // the flows: the verification vectors of the RSS specification, then
+  // random TCP, UDP and non-IPv4 flows
+  constexpr uint8_t kTcp = fpga_tools::kIpProtocolTcp;
+  std::vector<RssFlow> flows = {
+      {0x420995BB, 0xA18E6450, 2794, 1766, kTcp, 0, true},
+      {0xC75C6F02, 0x41458C53, 14230, 4739, kTcp, 0, true},
+      {0x1813C65F, 0x0C16CFB8, 12898, 38024, kTcp, 0, true},
+      {0x261BCD1E, 0xD18EA306, 48228, 2217, kTcp, 0, true},
+      {0x9927A3BF, 0xCABC7F02, 44251, 1303, kTcp, 0, true}};
+  const uint32_t kVerificationHashes[] = {0x51ccc178, 0xc626b0ea, 0x5c2b394a,
+                                          0xafc7327f, 0x10e828a2};
+  bool passed = true;
+  for (int i = 0; i < 5; i++) {
+    if (RssReferenceFlowHash(key, flows[i]) != kVerificationHashes[i]) {
+      std::cerr << "ERROR: the host hash of verification vector " << i
+                << " is wrong\n";
+      passed &= false;
+    }
+  }
+  for (int i = 0; i < 59; i++) {
+    RssFlow f;
+    f.src_ip = (uint32_t(rand()) << 16) ^ rand();
+    f.dst_ip = (uint32_t(rand()) << 16) ^ rand();
+    f.src_port = rand() % 0x10000;
+    f.dst_port = rand() % 0x10000;
+    f.protocol = rand() % 2 ? fpga_tools::kIpProtocolTcp
+                            : fpga_tools::kIpProtocolUdp;
+    f.vlan_tags = rand() % 3;
+    f.ipv4 = rand() % 10 != 0;
+    flows.push_back(f);
+  }
+
+  const size_t packets = std::max<size_t>(count / 16, 256);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes, internal pipes and side channels
+  using FakeIOPipeInProducer =
+      Producer<RssReadIOPipeID, Beat, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using ParsedMetadataPipe =
+      ext::intel::pipe<RssParsedMetadataPipeID, fpga_tools::PacketMetadata, 16>;
+  using ParsedPayloadPipe = ext::intel::pipe<RssParsedPayloadPipeID, Beat, 64>;
+  using MetadataPipes =
+      fpga_tools::PipeArray<RssMetadataPipesID, RssMetadata, 16, kLanes>;
+  using PayloadPipes =
+      fpga_tools::PipeArray<RssPayloadPipesID, Beat, 64, kLanes>;
+  using CommandSideChannel =
+      HostToDeviceSideChannel<RssCommandSideChannelID, fpga_tools::RssCommand,
+                              use_usm_host_alloc, 1>;
+  using AckSideChannel =
+      DeviceToHostSideChannel<RssAckSideChannelID, uint16_t,
+                              use_usm_host_alloc, 1>;
+
+  // make the packets of both batches up front, to size the producer, and
+  // remember the flow of each one
+  std::vector<std::vector<std::vector<uint8_t>>> batches(2);
+  std::vector<std::vector<int>> batch_flows(2);
+  size_t max_beats = 0;
+  for (int b = 0; b < 2; b++) {
+    size_t beats = 0;
+    for (size_t i = 0; i < packets; i++) {
+      int f = rand() % flows.size();
+      batches[b].push_back(RssMakePacket(flows[f], i));
+      batch_flows[b].push_back(f);
+      beats += (batches[b][i].size() + kRssBeatBytes - 1) / kRssBeatBytes;
+    }
+    max_beats = std::max(max_beats, beats);
+  }
+
+  FakeIOPipeInProducer::Init(q, max_beats);
+  CommandSideChannel::Init(q);
+  AckSideChannel::Init(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // the lane kernels record their packets here
+  std::vector<RssMetadata *> lane_metadata(kLanes);
+  std::vector<Beat *> lane_beats(kLanes);
+  for (int l = 0; l < kLanes; l++) {
+    lane_metadata[l] = malloc_host<RssMetadata>(packets, q);
+    lane_beats[l] = malloc_host<Beat>(max_beats, q);
+    if (lane_metadata[l] == nullptr || lane_beats[l] == nullptr) {
+      std::cerr << "ERROR: failed to allocate space for the lane outputs\n";
+      std::terminate();
+    }
+  }
+
+  fpga_tools::RssConfig config;
+  std::memcpy(config.key, key, fpga_tools::kRssKeyBytes);
+  config.hash_tcp_ports = true;
+  config.hash_udp_ports = true;
+  auto distributor_event = q.single_task<RssDistributorKernel>([=] {
+    fpga_tools::RssDistributor<kLanes, ParsedMetadataPipe, ParsedPayloadPipe,
+                               MetadataPipes, PayloadPipes, CommandSideChannel,
+                               AckSideChannel>(config);
+  });
+
+  // the host's copy of the indirection table, which starts out round robin
+  std::vector<int> table(fpga_tools::kRssIndirectionTableSize);
+  for (int i = 0; i < fpga_tools::kRssIndirectionTableSize; i++) {
+    table[i] = i % kLanes;
+  }
+
+  double total_ms = 0;
+  for (int b = 0; b < 2; b++) {
+    // the second batch uses a new indirection table
+    if (b == 1) {
+      for (int i = 0; i < fpga_tools::kRssIndirectionTableSize; i++) {
+        table[i] = rand() % kLanes;
+        CommandSideChannel::write(
+            {fpga_tools::kRssSetEntry, uint8_t(table[i]), uint16_t(i)});
+        if (AckSideChannel::read() != i) {
+          std::cerr << "ERROR: wrong acknowledgement of entry " << i << "\n";
+          passed &= false;
+        }
+      }
+    }
+
+    // split the packets into beats, and work out where each one should go
+    auto i_stream_data = FakeIOPipeInProducer::Data();
+    size_t beats = 0;
+    std::vector<int> expected_lane(packets);
+    std::vector<size_t> lane_packets(kLanes, 0);
+    for (size_t i = 0; i < packets; i++) {
+      auto &p = batches[b][i];
+      for (size_t offset = 0; offset < p.size(); offset += kRssBeatBytes) {
+        Beat &beat = i_stream_data[beats++];
+        for (int j = 0; j < kRssBeatBytes; j++) {
+          beat.data[j] = offset + j < p.size() ? p[offset + j] : 0;
+        }
+        beat.sop = offset == 0;
+        beat.eop = offset + kRssBeatBytes >= p.size();
+        beat.empty = beat.eop ? offset + kRssBeatBytes - p.size() : 0;
+      }
+      uint32_t hash = RssReferenceFlowHash(key, flows[batch_flows[b][i]]);
+      expected_lane[i] = table[hash % fpga_tools::kRssIndirectionTableSize];
+      lane_packets[expected_lane[i]]++;
+    }
+
+    // the lane kernels
+    std::vector<event> lane_events;
+    fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+      RssMetadata *metadata_out = lane_metadata[l];
+      Beat *beats_out = lane_beats[l];
+      size_t n = lane_packets[l];
+      lane_events.push_back(q.single_task<RssLaneKernel<l>>([=] {
+        size_t beat = 0;
+        for (size_t i = 0; i < n; i++) {
+          metadata_out[i] = MetadataPipes::template PipeAt<l>::read();
+          bool eop;
+          do {
+            Beat in = PayloadPipes::template PipeAt<l>::read();
+            beats_out[beat++] = in;
+            eop = in.eop;
+          } while (!eop);
+        }
+      }));
+    });
+
+    auto parser_event = q.single_task<RssParserKernel>([=] {
+      fpga_tools::PacketParser<ReadIOPipe, ParsedMetadataPipe,
+                               ParsedPayloadPipe>(beats);
+    });
+
+    event produce_dma_e, produce_kernel_e;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::tie(produce_dma_e, produce_kernel_e) =
+        FakeIOPipeInProducer::Start(q, beats);
+    produce_dma_e.wait();
+    produce_kernel_e.wait();
+    parser_event.wait();
+    for (auto &e : lane_events) e.wait();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> diff = end - start;
+    total_ms += diff.count();
+
+    // each lane must have its packets, in order, with the right hashes
+    for (int l = 0; l < kLanes; l++) {
+      size_t packet = 0;
+      size_t beat = 0;
+      for (size_t i = 0; i < packets && passed; i++) {
+        if (expected_lane[i] != l) continue;
+        const RssFlow &flow = flows[batch_flows[b][i]];
+        const RssMetadata &m = lane_metadata[l][packet++];
+        uint32_t hash = RssReferenceFlowHash(key, flow);
+        if (m.hash != hash) {
+          std::cerr << "ERROR: lane " << l << " packet " << i << " has hash "
+                    << std::hex << m.hash << ", expected " << hash << std::dec
+                    << "\n";
+          passed &= false;
+        }
+
+        // the sequence number, at the start of the payload, orders the
+        // packets of the lane
+        auto &p = batches[b][i];
+        uint8_t seq[4];
+        for (int j = 0; j < 4; j++) {
+          size_t offset = m.packet.payload_offset + j;
+          seq[j] = lane_beats[l][beat + offset / kRssBeatBytes]
+                       .data[offset % kRssBeatBytes];
+        }
+        uint32_t got = (seq[0] << 24) | (seq[1] << 16) | (seq[2] << 8) | seq[3];
+        if (got != i) {
+          std::cerr << "ERROR: lane " << l << " got packet " << got
+                    << ", expected packet " << i << "\n";
+          passed &= false;
+        }
+        beat += (p.size() + kRssBeatBytes - 1) / kRssBeatBytes;
+      }
+    }
+  }
+
+  std::cout << "RSS: " << 2 * packets << " packets from " << flows.size()
+            << " flows to " << kLanes << " lanes in " << total_ms << " ms\n";
+
+  CommandSideChannel::write({fpga_tools::kRssStop, 0, 0});
+  distributor_event.wait();
+
+  for (int l = 0; l < kLanes; l++) {
+    free(lane_metadata[l], q);
+    free(lane_beats[l], q);
+  }
+  FakeIOPipeInProducer::Destroy(q);
+  CommandSideChannel::Destroy(q);
+  AckSideChannel::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __RSSTEST_HPP__ */
@@ -0,0 +1,154 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __SCANTEST_HPP__
+#define __SCANTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "data_bundle.hpp"
+#include "scan.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// Every variant of the scan is its own kernel with its own IO pipes.
+template <bool kExclusive, bool kSegmented> struct ScanKernel;
+template <bool kExclusive, bool kSegmented>
+struct ScanReadIOPipeID { static constexpr unsigned id = 0; };
+template <bool kExclusive, bool kSegmented>
+struct ScanWriteIOPipeID { static constexpr unsigned id = 1; };
+
+//
+// Submit a kernel that scans 'beats' beats from IOPipeIn to IOPipeOut,
+// summing the elements. The segmented variant restarts the sum at every
+// element flagged as a segment head.
+//
+template <class IOPipeIn, class IOPipeOut, bool kExclusive, bool kSegmented,
+          typename T>
+event SubmitScanKernel(queue &q, size_t beats) {
+  return q.single_task<ScanKernel<kExclusive, kSegmented>>([=] {
+    if constexpr (kSegmented) {
+      fpga_tools::StreamingSegmentedScan<IOPipeIn, IOPipeOut, kExclusive>(
+          beats, T(0), std::plus<T>());
+    } else {
+      fpga_tools::StreamingScan<IOPipeIn, IOPipeOut, kExclusive>(
+          beats, T(0), std::plus<T>());
+    }
+  });
+}
+
+//
+// Run one variant of the scan on random data and check it against a serial
+// scan on the host.
+//
+template <typename T, bool use_usm_host_alloc, bool kExclusive,
+          bool kSegmented, int kLanes>
+bool RunScan(queue &q, size_t count) {
+  using InBeat = std::conditional_t<kSegmented,
+                                    fpga_tools::SegmentedScanBeat<T, kLanes>,
+                                    fpga_tools::DataBundle<T, kLanes>>;
+  using OutBeat = fpga_tools::DataBundle<T, kLanes>;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<ScanReadIOPipeID<kExclusive, kSegmented>, InBeat,
+               use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<ScanWriteIOPipeID<kExclusive, kSegmented>, OutBeat,
+               use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  const size_t beats = count / kLanes;
+  FakeIOPipeInProducer::Init(q, beats);
+  FakeIOPipeOutConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // random input with segments of random length, some of which span beats
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  std::vector<T> in(beats * kLanes);
+  std::vector<bool> head(beats * kLanes);
+  for (size_t i = 0; i < beats * kLanes; i++) {
+    in[i] = rand() % 1000;
+    head[i] = (i == 0) || (rand() % 13 == 0);
+    if constexpr (kSegmented) {
+      i_stream_data[i / kLanes].data[i % kLanes] = in[i];
+      i_stream_data[i / kLanes].head[i % kLanes] = head[i];
+    } else {
+      i_stream_data[i / kLanes][i % kLanes] = in[i];
+    }
+  }
+
+  auto kernel_event =
+      SubmitScanKernel<ReadIOPipe, WriteIOPipe, kExclusive, kSegmented, T>(
+          q, beats);
+
+  event produce_dma_e, produce_kernel_e;
+  event consume_dma_e, consume_kernel_e;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
+  std::tie(consume_dma_e, consume_kernel_e) = FakeIOPipeOutConsumer::Start(q);
+
+  produce_dma_e.wait();
+  produce_kernel_e.wait();
+  consume_dma_e.wait();
+  consume_kernel_e.wait();
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << (kSegmented ? "Segmented " : "")
+            << (kExclusive ? "exclusive" : "inclusive") << " scan: "
+            << beats * kLanes << " elements, " << kLanes << " lanes, in "
+            << diff.count() << " ms\n";
+
+  // validate the output against a serial scan
+  bool passed = true;
+  auto o_stream_data = FakeIOPipeOutConsumer::Data();
+  T sum = 0;
+  for (size_t i = 0; i < beats * kLanes && passed; i++) {
+    if (kSegmented && head[i]) {
+      sum = 0;
+    }
+    T expected = kExclusive ? sum : T(sum + in[i]);
+    sum += in[i];
+
+    T result = o_stream_data[i / kLanes][i % kLanes];
+    if (result != expected) {
+      std::cerr << "ERROR: output mismatch at entry " << i << ": " << result
+                << " != " << expected << " (out != expected)\n";
+      passed &= false;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It runs the inclusive and exclusive scans, plain and segmented.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes = 8>
+bool RunScanSystem(queue &q, size_t count) {
+  bool passed = true;
+  passed &= RunScan<T, use_usm_host_alloc, false, false, kLanes>(q, count);
+  passed &= RunScan<T, use_usm_host_alloc, true, false, kLanes>(q, count);
+  passed &= RunScan<T, use_usm_host_alloc, false, true, kLanes>(q, count);
+  passed &= RunScan<T, use_usm_host_alloc, true, true, kLanes>(q, count);
+  return passed;
+}
+
+#endif /* __SCANTEST_HPP__ */
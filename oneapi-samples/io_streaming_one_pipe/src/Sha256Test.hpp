@@ -0,0 +1,424 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __SHA256TEST_HPP__
+#define __SHA256TEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "data_bundle.hpp"
+#include "pipe_utils.hpp"
+#include "unrolled_loop.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct Sha256PadKernel;
+struct Sha256CompressKernel;
+struct Sha256ReadIOPipeID { static constexpr unsigned id = 0; };
+struct Sha256WriteIOPipeID { static constexpr unsigned id = 1; };
+struct Sha256BlockPipesID;
+
+constexpr int kSha256BlockBytes = 64;
+
+//
+// A beat of the framed input stream: 'valid' bytes of 'data' belong to the
+// current message and 'last' marks the final beat of a message. Every
+// message starts in a new beat and every beat but the last is full, so a
+// beat is exactly one 512-bit block of the message.
+//
+struct Sha256InputBeat {
+  fpga_tools::DataBundle<uint8_t, kSha256BlockBytes> data;
+  uint8_t valid;
+  bool last;
+};
+
+// a padded 512-bit block of message 'msg', as 16 big-endian words
+struct Sha256Block {
+  uint32_t w[16];
+  uint32_t msg;
+  bool first;
+  bool last;
+};
+
+// the digest of message 'msg'
+struct Sha256Digest {
+  uint32_t h[8];
+  uint32_t msg;
+};
+
+constexpr uint32_t kSha256InitialHash[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+constexpr uint32_t kSha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t Sha256Rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+//
+// The SHA-256 compression function, fully unrolled: the 64 rounds and the
+// message schedule become a 64 stage pipeline.
+//
+inline void Sha256Compress(uint32_t h[8], const uint32_t block[16]) {
+  uint32_t w[16];
+  uint32_t s[8];
+  fpga_tools::UnrolledLoop<16>([&](auto i) { w[i] = block[i]; });
+  fpga_tools::UnrolledLoop<8>([&](auto i) { s[i] = h[i]; });
+
+  fpga_tools::UnrolledLoop<64>([&](auto r) {
+    // the message schedule, kept as a sliding window of 16 words
+    uint32_t wr;
+    if constexpr (r < 16) {
+      wr = w[r];
+    } else {
+      uint32_t w15 = w[(r - 15) % 16];
+      uint32_t w2 = w[(r - 2) % 16];
+      uint32_t s0 = Sha256Rotr(w15, 7) ^ Sha256Rotr(w15, 18) ^ (w15 >> 3);
+      uint32_t s1 = Sha256Rotr(w2, 17) ^ Sha256Rotr(w2, 19) ^ (w2 >> 10);
+      wr = w[r % 16] + s0 + w[(r - 7) % 16] + s1;
+      w[r % 16] = wr;
+    }
+
+    uint32_t e = s[4];
+    uint32_t a = s[0];
+    uint32_t ch = (e & s[5]) ^ (~e & s[6]);
+    uint32_t maj = (a & s[1]) ^ (a & s[2]) ^ (s[1] & s[2]);
+    uint32_t t1 = s[7] + (Sha256Rotr(e, 6) ^ Sha256Rotr(e, 11) ^
+                          Sha256Rotr(e, 25)) +
+                  ch + kSha256RoundConstants[r] + wr;
+    uint32_t t2 =
+        (Sha256Rotr(a, 2) ^ Sha256Rotr(a, 13) ^ Sha256Rotr(a, 22)) + maj;
+    s[7] = s[6];
+    s[6] = s[5];
+    s[5] = s[4];
+    s[4] = s[3] + t1;
+    s[3] = s[2];
+    s[2] = s[1];
+    s[1] = s[0];
+    s[0] = t1 + t2;
+  });
+
+  fpga_tools::UnrolledLoop<8>([&](auto i) { h[i] += s[i]; });
+}
+
+//
+// Submit the SHA-256 kernels.
+//
+// The pad kernel reads 'num_messages' framed messages from IOPipeIn, pads
+// them into 512-bit blocks and sends the blocks of message m to lane
+// m % kLanes.
+//
+// Hashing a message is a chain of compressions, each of which needs the
+// result of the one before it, so a single message can't use a pipelined
+// compression function more than once per pipeline latency. The compress
+// kernel therefore visits the lanes round robin, one per cycle, and keeps
+// the intermediate hash of each lane in a state array. With as many lanes
+// as cycles of pipeline latency, a new block enters the pipeline every
+// cycle. A lane with no block ready leaves a bubble.
+//
+// The digests are written to IOPipeOut as the messages complete, tagged
+// with their message number. Short messages can overtake long ones in
+// other lanes, so writing them in order would need a reorder buffer as
+// deep as the longest message.
+//
+template <class IOPipeIn, class IOPipeOut, int kLanes>
+std::vector<event> SubmitSha256Kernels(queue &q, size_t num_messages) {
+  using BlockPipes =
+      fpga_tools::PipeArray<Sha256BlockPipesID, Sha256Block, 16, kLanes>;
+
+  auto pad_event = q.single_task<Sha256PadKernel>([=] {
+    size_t msg = 0;
+    uint64_t length = 0;
+    bool first = true;
+    bool extra_block = false;
+    bool extra_block_marker = false;
+
+    while (msg < num_messages) {
+      Sha256Block block;
+      uint8_t bytes[kSha256BlockBytes];
+      bool block_ends_message = false;
+
+      if (extra_block) {
+        // the padding didn't fit the last block of the message
+        fpga_tools::UnrolledLoop<kSha256BlockBytes>(
+            [&](auto i) { bytes[i] = 0; });
+        if (extra_block_marker) bytes[0] = 0x80;
+        block_ends_message = true;
+        extra_block = false;
+      } else {
+        Sha256InputBeat beat = IOPipeIn::read();
+        int valid = beat.valid;
+        length += valid;
+
+        // the message bytes, then the 0x80 marker, then zeros
+        fpga_tools::UnrolledLoop<kSha256BlockBytes>([&](auto i) {
+          if ((int)i < valid) {
+            bytes[i] = beat.data[i];
+          } else if ((int)i == valid) {
+            bytes[i] = 0x80;
+          } else {
+            bytes[i] = 0;
+          }
+        });
+
+        // the 64-bit length must fit after the marker
+        if (beat.last) {
+          block_ends_message = valid < kSha256BlockBytes - 8;
+          extra_block = !block_ends_message;
+          extra_block_marker = valid == kSha256BlockBytes;
+        }
+      }
+
+      // the length of the message in bits, big-endian
+      uint64_t bit_length = length * 8;
+      if (block_ends_message) {
+        fpga_tools::UnrolledLoop<8>([&](auto i) {
+          bytes[kSha256BlockBytes - 8 + i] = bit_length >> (56 - 8 * i);
+        });
+      }
+
+      fpga_tools::UnrolledLoop<16>([&](auto i) {
+        block.w[i] = (uint32_t(bytes[4 * i]) << 24) |
+                     (uint32_t(bytes[4 * i + 1]) << 16) |
+                     (uint32_t(bytes[4 * i + 2]) << 8) |
+                     uint32_t(bytes[4 * i + 3]);
+      });
+      block.msg = msg;
+      block.first = first;
+      block.last = block_ends_message;
+
+      const int lane = msg % kLanes;
+      fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+        if (l == lane) BlockPipes::template PipeAt<l>::write(block);
+      });
+
+      first = block_ends_message;
+      if (block_ends_message) {
+        length = 0;
+        msg++;
+      }
+    }
+  });
+
+  auto compress_event = q.single_task<Sha256CompressKernel>([=] {
+    uint32_t state[kLanes][8];
+    size_t digests = 0;
+    int lane = 0;
+
+    // a lane's state is only used again kLanes iterations later
+    [[intel::ivdep(state, kLanes)]]  // NO-FORMAT: Attribute
+    while (digests < num_messages) {
+      bool valid = false;
+      Sha256Block block;
+      fpga_tools::UnrolledLoop<kLanes>([&](auto l) {
+        if (l == lane) block = BlockPipes::template PipeAt<l>::read(valid);
+      });
+
+      if (valid) {
+        uint32_t h[8];
+        fpga_tools::UnrolledLoop<8>([&](auto i) {
+          h[i] = block.first ? kSha256InitialHash[i] : state[lane][i];
+        });
+        Sha256Compress(h, block.w);
+        fpga_tools::UnrolledLoop<8>([&](auto i) { state[lane][i] = h[i]; });
+
+        if (block.last) {
+          Sha256Digest digest;
+          fpga_tools::UnrolledLoop<8>([&](auto i) { digest.h[i] = h[i]; });
+          digest.msg = block.msg;
+          IOPipeOut::write(digest);
+          digests++;
+        }
+      }
+
+      lane = (lane == kLanes - 1) ? 0 : lane + 1;
+    }
+  });
+
+  return {pad_event, compress_event};
+}
+
+//
+// Host reference implementation
+//
+inline Sha256Digest Sha256Host(const std::vector<uint8_t> &msg) {
+  std::vector<uint8_t> padded(msg);
+  padded.push_back(0x80);
+  while (padded.size() % kSha256BlockBytes != kSha256BlockBytes - 8) {
+    padded.push_back(0);
+  }
+  uint64_t bit_length = (uint64_t)msg.size() * 8;
+  for (int i = 0; i < 8; i++) {
+    padded.push_back(bit_length >> (56 - 8 * i));
+  }
+
+  Sha256Digest digest;
+  std::copy(kSha256InitialHash, kSha256InitialHash + 8, digest.h);
+  for (size_t b = 0; b < padded.size(); b += kSha256BlockBytes) {
+    uint32_t block[16];
+    for (int i = 0; i < 16; i++) {
+      block[i] = (uint32_t(padded[b + 4 * i]) << 24) |
+                 (uint32_t(padded[b + 4 * i + 1]) << 16) |
+                 (uint32_t(padded[b + 4 * i + 2]) << 8) |
+                 uint32_t(padded[b + 4 * i + 3]);
+    }
+    Sha256Compress(digest.h, block);
+  }
+  return digest;
+}
+
+inline std::string Sha256Hex(const Sha256Digest &digest) {
+  static const char *kHex = "0123456789abcdef";
+  std::string s;
+  for (int i = 0; i < 8; i++) {
+    for (int n = 7; n >= 0; n--) {
+      s += kHex[(digest.h[i] >> (4 * n)) & 0xF];
+    }
+  }
+  return s;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It hashes the standard test vectors and messages of random lengths, and
+// checks the digests against the host implementation, which is itself
+// checked against the known digests of the test vectors.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes = 16>
+bool RunSha256System(queue &q, size_t count) {
+  bool passed = true;
+
+  // the test vectors from FIPS 180-2, followed by random messages whose
+  // total size is about 'count' bytes
+  std::vector<std::vector<uint8_t>> messages;
+  std::vector<std::string> expected_hex;
+  auto add_string = [&](const std::string &str, const std::string &hex) {
+    messages.emplace_back(str.begin(), str.end());
+    expected_hex.push_back(hex);
+  };
+  add_string("abc",
+             "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  add_string("",
+             "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  add_string("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+             "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  size_t total = 0;
+  while (total < count) {
+    std::vector<uint8_t> msg(rand() % 300);
+    std::generate(msg.begin(), msg.end(), [] { return rand(); });
+    total += msg.size();
+    messages.push_back(std::move(msg));
+  }
+  const size_t num_messages = messages.size();
+
+  for (size_t i = 0; i < expected_hex.size(); i++) {
+    if (Sha256Hex(Sha256Host(messages[i])) != expected_hex[i]) {
+      std::cerr << "ERROR: host SHA-256 of test vector " << i
+                << " is wrong\n";
+      passed &= false;
+    }
+  }
+
+  // frame the messages into beats
+  std::vector<Sha256InputBeat> beats;
+  for (auto &msg : messages) {
+    size_t pos = 0;
+    do {
+      Sha256InputBeat beat;
+      beat.valid = std::min<size_t>(kSha256BlockBytes, msg.size() - pos);
+      for (int i = 0; i < kSha256BlockBytes; i++) {
+        beat.data[i] = (i < beat.valid) ? msg[pos + i] : 0;
+      }
+      pos += beat.valid;
+      beat.last = pos == msg.size();
+      beats.push_back(beat);
+    } while (pos < msg.size());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<Sha256ReadIOPipeID, Sha256InputBeat, use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<Sha256WriteIOPipeID, Sha256Digest, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  FakeIOPipeInProducer::Init(q, beats.size());
+  FakeIOPipeOutConsumer::Init(q, num_messages);
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::copy(beats.begin(), beats.end(), FakeIOPipeInProducer::Data());
+
+  auto kernel_events =
+      SubmitSha256Kernels<ReadIOPipe, WriteIOPipe, kLanes>(q, num_messages);
+
+  event produce_dma_e, produce_kernel_e;
+  event consume_dma_e, consume_kernel_e;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
+  std::tie(consume_dma_e, consume_kernel_e) = FakeIOPipeOutConsumer::Start(q);
+
+  produce_dma_e.wait();
+  produce_kernel_e.wait();
+  consume_dma_e.wait();
+  consume_kernel_e.wait();
+  for (auto &e : kernel_events) {
+    e.wait();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "SHA-256: " << num_messages << " messages, " << beats.size()
+            << " blocks of input, in " << diff.count() << " ms\n";
+
+  // validate the digests, which arrive in completion order
+  auto o_stream_data = FakeIOPipeOutConsumer::Data();
+  std::vector<bool> seen(num_messages, false);
+  for (size_t i = 0; i < num_messages && passed; i++) {
+    uint32_t msg = o_stream_data[i].msg;
+    if (msg >= num_messages || seen[msg]) {
+      std::cerr << "ERROR: unexpected digest for message " << msg << "\n";
+      passed &= false;
+      break;
+    }
+    seen[msg] = true;
+
+    std::string result = Sha256Hex(o_stream_data[i]);
+    std::string expected = Sha256Hex(Sha256Host(messages[msg]));
+    if (result != expected) {
+      std::cerr << "ERROR: digest of message " << msg << " is " << result
+                << ", expected " << expected << "\n";
+      passed &= false;
+    }
+  }
+
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __SHA256TEST_HPP__ */
@@ -8,7 +8,9 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "FakeIOPipes.hpp"
+#include "HostCompletionQueue.hpp"
 #include "HostSideChannel.hpp"
+#include "TestData.hpp"
 
 using namespace sycl;
 using namespace std::chrono_literals;
@@ -17,9 +19,16 @@ using namespace std::chrono_literals;
 struct SideChannelMainKernel;
 struct SideChannelReadIOPipeID { static constexpr unsigned id = 0; };
 struct SideChannelWriteIOPipeID { static constexpr unsigned id = 1; };
-struct HostToDeviceSideChannelID;
+struct ControlSideChannelID;
 struct DeviceToHostSideChannelID;
-struct HostToDeviceTermSideChannelID;
+
+// the seed of the random input data
+constexpr uint64_t kSideChannelDataSeed = 2;
+
+// the logical channels of the multiplexed host to device control channel
+constexpr size_t kMatchNumChannel = 0;
+constexpr size_t kTerminateChannel = 1;
+constexpr size_t kControlChannels = 2;
 
 //
 // Submit the main processing kernel (or kernels, in general).
@@ -28,15 +37,14 @@ struct HostToDeviceTermSideChannelID;
 //
 // This kernel streams data into and out of IO pipes (IOPipeIn and IOPipeOut,
 // respectively). If the value matches the current value of 'match_num', it
-// sends the value to the host via the HostToDeviceSideChannel. In the outer
-// loop, it reads configuration data from the host via the
-// HostToDeviceSideChannel and HostToDeviceTermSideChannel. The former updates
-// 'match_num' and the latter causes this kernel to break from the outer loop
-// and terminate.
+// sends the value to the host via the DeviceToHostSideChannel. In the outer
+// loop, it reads configuration data from the host via ControlSideChannel, a
+// MultiplexedSideChannel with two logical channels: kMatchNumChannel updates
+// 'match_num' and kTerminateChannel causes this kernel to break from the
+// outer loop and terminate.
 //
 template<class IOPipeIn, class IOPipeOut,
-         class HostToDeviceSideChannel, class DeviceToHostSideChannel,
-         class HostToDeviceTermSideChannel>
+         class ControlSideChannel, class DeviceToHostSideChannel>
 event SubmitSideChannelKernels(queue& q, int initial_match_num,
                                size_t frame_size) {
   // the maximum number of consecutive input read misses before
@@ -48,16 +56,16 @@ event SubmitSideChannelKernels(queue& q, int initial_match_num,
 
   // submit the main processing kernel
   return q.single_task<SideChannelMainKernel>([=] {
-    int match_num = initial_match_num;
+    // the current value of each control channel
+    int control[kControlChannels] = {initial_match_num, 0};
     size_t timeout_counter;
     size_t samples_processed = 0;
     bool terminate = false;
 
     while (!terminate) {
-      // check for an update to the sum_threshold from the host
-      bool valid_update;
-      int tmp = HostToDeviceSideChannel::read(valid_update);
-      if (valid_update) match_num = tmp;
+      // check for an update to one of the control channels from the host
+      ControlSideChannel::Poll(control);
+      int match_num = control[kMatchNumChannel];
 
       // reset the timeout counter
       timeout_counter = 0;
@@ -95,10 +103,8 @@ event SubmitSideChannelKernels(queue& q, int initial_match_num,
         }
       }
 
-      // the host uses this side channel to tell the kernel to exit
-      // Any successful read from this channel means the host wants this
-      // kernel to end; the actual value read doesn't matter
-      (void)HostToDeviceTermSideChannel::read(terminate);
+      // the host uses the terminate channel to tell the kernel to exit
+      terminate = control[kTerminateChannel] != 0;
     }
   });
 }
@@ -126,12 +132,11 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
 
   //////////////////////////////////////////////////////////////////////////////
   // the side channels
-  using MyHostToDeviceSideChannel = 
-    HostToDeviceSideChannel<HostToDeviceSideChannelID,
-                            int, use_usm_host_alloc, 1>;
-  using MyHostToDeviceTermSideChannel = 
-    HostToDeviceSideChannel<HostToDeviceTermSideChannelID,
-                            char, use_usm_host_alloc, 1>;
+  // The host to device updates share one multiplexed side channel, with one
+  // pipe and one producer kernel for all of its logical channels.
+  using MyControlSideChannel = 
+    MultiplexedSideChannel<ControlSideChannelID, int, kControlChannels,
+                           use_usm_host_alloc>;
   
   // This side channel is used to sent updates from the device to the host.
   // We explicitly set the depth of the FIFO to '8' here. If the host does not
@@ -146,8 +151,7 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
 
 
   // initialize the side channels
-  MyHostToDeviceSideChannel::Init(q);
-  MyHostToDeviceTermSideChannel::Init(q);
+  MyControlSideChannel::Init(q);
   MyDeviceToHostSideChannel::Init(q);
   //////////////////////////////////////////////////////////////////////////////
 
@@ -161,13 +165,20 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
   // is count * (4/count) = 4.
   int rand_max = std::max(4, (int)(count / 4));
   size_t frame_size = 1024;
-  std::generate_n(i_stream_data, count, [&] { return rand() % rand_max; } );
+  // The data is generated in parallel, and again to check the output (see
+  // TestData.hpp).
+  auto input_data = TestDataGenerator<T>::Uniform(kSideChannelDataSeed,
+                                                  rand_max);
+  input_data.Fill(i_stream_data, count);
 
   // submit the main kernels, once and only once
   auto main_kernel = 
-    SubmitSideChannelKernels<ReadIOPipe, WriteIOPipe, MyHostToDeviceSideChannel,
-                             MyDeviceToHostSideChannel,
-                             MyHostToDeviceTermSideChannel>(q, -1, frame_size);
+    SubmitSideChannelKernels<ReadIOPipe, WriteIOPipe, MyControlSideChannel,
+                             MyDeviceToHostSideChannel>(q, -1, frame_size);
+
+  // the completion thread that collects the results of each test, so the
+  // host thread does not block on every event (see HostCompletionQueue.hpp)
+  HostCompletionQueue completions;
 
   //////////////////////////////////////////////////////////////////////////////
   // this lambda will perform a single test to detect all `match_num` elements
@@ -182,7 +193,7 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
               << "expecting " << expected_updated_count << " matches\n";
 
     // first, update the kernel with the number to match (blocking)
-    MyHostToDeviceSideChannel::write(match_num);
+    MyControlSideChannel::write(kMatchNumChannel, match_num);
 
     // This sleep is an artifact of validating the side channel updates.
     // The line of code above writes the new 'match_num' data into
@@ -197,6 +208,8 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
     // know it resides (since the previous operation is blocking).
     std::this_thread::sleep_for(10ms);
 
+    bool test_passed = true;
+
     // launch the producer and consumer to send the data through the kernel
     event producer_dma_event, producer_kernel_event;
     event consumer_dma_event, consumer_kernel_event;
@@ -205,33 +218,25 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
     std::tie(consumer_dma_event, consumer_kernel_event) =
       FakeIOPipeOutConsumer::Start(q);
 
-    // get updates from the device
-    for (size_t i = 0; i < expected_updated_count; i++) {
-      auto device_update = MyDeviceToHostSideChannel::read();
+    // get updates from the device. Each read is launched on the completion
+    // thread when the previous one completes.
+    MyDeviceToHostSideChannel::ReadAsync(completions, expected_updated_count,
+                                         [&](int device_update) {
       device_updates.push_back(device_update);
-    }
+    });
 
-    // wait for producer and consumer to finish, including the DMA events
+    // validate the output once the producer and consumer finish, including
+    // the DMA events
     // NOTE: if USM host allocations are used, the dma events are noops.
-    producer_dma_event.wait();
-    producer_kernel_event.wait();
-    consumer_dma_event.wait();
-    consumer_kernel_event.wait();
+    completions.OnComplete({producer_dma_event, producer_kernel_event,
+                            consumer_dma_event, consumer_kernel_event}, [&] {
+      auto report = input_data.Check(FakeIOPipeOutConsumer::Data(), count);
+      report.Print(std::cerr, "output");
+      test_passed &= report.Passed();
+    });
 
-    bool test_passed = true;
-
-    // get the pointer to the fake output data
-    auto o_stream_data = FakeIOPipeOutConsumer::Data();
-
-    // validate the output
-    for (size_t i = 0; i < count; i++) {
-      if (o_stream_data[i] != i_stream_data[i]) {
-        std::cerr << "ERROR: output mismatch at entry " << i << ": "
-                  << o_stream_data[i] << " != " << i_stream_data[i]
-                  << " (out != in)\n";
-        test_passed &= false;
-      }
-    }
+    // the only wait of the test: for the device updates and the validation
+    completions.Drain();
 
     // validate the updates from the device
     for (size_t i = 0; i < expected_updated_count; i++) {
@@ -255,7 +260,7 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
   passed &= test_lambda(rand() % rand_max);
 
   // we are done testing now, so send a signal to main processing kernel to exit
-  MyHostToDeviceTermSideChannel::write(0);
+  MyControlSideChannel::write(kTerminateChannel, 1);
 
   // wait for the main kernel to finish
   main_kernel.wait();
@@ -263,8 +268,7 @@ bool RunSideChannelsSystem(queue& q, size_t count) {
   // destroy the fake IO pipes and the side channels
   FakeIOPipeInProducer::Destroy(q);
   FakeIOPipeOutConsumer::Destroy(q);
-  MyHostToDeviceSideChannel::Destroy(q);
-  MyHostToDeviceTermSideChannel::Destroy(q);
+  MyControlSideChannel::Destroy(q);
   MyDeviceToHostSideChannel::Destroy(q);
 
   return passed;
@@ -0,0 +1,154 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __STREAMCOMPACTIONTEST_HPP__
+#define __STREAMCOMPACTIONTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "data_bundle.hpp"
+#include "stream_compaction.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// They are templated on the selectivity of the filter, which is a
+// compile-time part of the predicate.
+template <int kPercent> struct StreamCompactionKernel;
+template <int kPercent>
+struct StreamCompactionReadIOPipeID { static constexpr unsigned id = 0; };
+template <int kPercent>
+struct StreamCompactionWriteIOPipeID { static constexpr unsigned id = 1; };
+
+// the filter: keeps about kPercent percent of uniformly random values
+template <int kPercent>
+struct StreamCompactionPredicate {
+  template <typename T>
+  bool operator()(const T &x) const {
+    return x % 100 < kPercent;
+  }
+};
+
+//
+// Submit a kernel that filters 'beats' beats from IOPipeIn into dense beats
+// on IOPipeOut and writes the number of values kept to 'kept'.
+//
+template <class IOPipeIn, class IOPipeOut, int kPercent>
+event SubmitStreamCompactionKernel(queue &q, size_t beats, size_t *kept) {
+  return q.single_task<StreamCompactionKernel<kPercent>>([=] {
+    *kept = fpga_tools::StreamCompaction<IOPipeIn, IOPipeOut>(
+        beats, StreamCompactionPredicate<kPercent>());
+  });
+}
+
+//
+// Filter random data through the compaction kernel and check that the
+// output is exactly the values that pass the predicate, in order.
+//
+template <typename T, bool use_usm_host_alloc, int kPercent, int kLanes>
+bool RunStreamCompaction(queue &q, size_t count) {
+  using Beat = fpga_tools::DataBundle<T, kLanes>;
+  StreamCompactionPredicate<kPercent> pred;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes
+  using FakeIOPipeInProducer =
+      Producer<StreamCompactionReadIOPipeID<kPercent>, Beat,
+               use_usm_host_alloc>;
+  using FakeIOPipeOutConsumer =
+      Consumer<StreamCompactionWriteIOPipeID<kPercent>, Beat,
+               use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using WriteIOPipe = typename FakeIOPipeOutConsumer::Pipe;
+
+  const size_t beats = count / kLanes;
+  FakeIOPipeInProducer::Init(q, beats);
+  FakeIOPipeOutConsumer::Init(q, beats);
+  //////////////////////////////////////////////////////////////////////////////
+
+  // the input data and the values expected to survive the filter
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  std::vector<T> expected;
+  for (size_t i = 0; i < beats * kLanes; i++) {
+    T val = rand();
+    i_stream_data[i / kLanes][i % kLanes] = val;
+    if (pred(val)) {
+      expected.push_back(val);
+    }
+  }
+  const size_t out_beats = (expected.size() + kLanes - 1) / kLanes;
+
+  size_t *kept = malloc_host<size_t>(1, q);
+  if (kept == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the result count\n";
+    std::terminate();
+  }
+
+  auto kernel_event =
+      SubmitStreamCompactionKernel<ReadIOPipe, WriteIOPipe, kPercent>(
+          q, beats, kept);
+
+  event produce_dma_e, produce_kernel_e;
+  event consume_dma_e, consume_kernel_e;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
+  std::tie(consume_dma_e, consume_kernel_e) =
+      FakeIOPipeOutConsumer::Start(q, out_beats);
+
+  produce_dma_e.wait();
+  produce_kernel_e.wait();
+  consume_dma_e.wait();
+  consume_kernel_e.wait();
+  kernel_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Stream compaction (" << kPercent << "% kept): " << beats
+            << " beats in, " << out_beats << " dense beats out, in "
+            << diff.count() << " ms\n";
+
+  // validate the output
+  bool passed = true;
+  if (*kept != expected.size()) {
+    std::cerr << "ERROR: kernel kept " << *kept << " values, expected "
+              << expected.size() << "\n";
+    passed &= false;
+  }
+  auto o_stream_data = FakeIOPipeOutConsumer::Data();
+  for (size_t i = 0; i < expected.size() && passed; i++) {
+    T result = o_stream_data[i / kLanes][i % kLanes];
+    if (result != expected[i]) {
+      std::cerr << "ERROR: output mismatch at entry " << i << ": " << result
+                << " != " << expected[i] << " (out != expected)\n";
+      passed &= false;
+    }
+  }
+
+  free(kept, q);
+  FakeIOPipeInProducer::Destroy(q);
+  FakeIOPipeOutConsumer::Destroy(q);
+
+  return passed;
+}
+
+//
+// This function builds the full system using fake IO pipes.
+// It runs a selective filter, like those of typical queries, and one that
+// keeps half of the values.
+//
+template <typename T, bool use_usm_host_alloc, int kLanes = 8>
+bool RunStreamCompactionSystem(queue &q, size_t count) {
+  bool passed = true;
+  passed &= RunStreamCompaction<T, use_usm_host_alloc, 3, kLanes>(q, count);
+  passed &= RunStreamCompaction<T, use_usm_host_alloc, 50, kLanes>(q, count);
+  return passed;
+}
+
+#endif /* __STREAMCOMPACTIONTEST_HPP__ */
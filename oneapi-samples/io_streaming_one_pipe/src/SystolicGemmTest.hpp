@@ -0,0 +1,233 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __SYSTOLICGEMMTEST_HPP__
+#define __SYSTOLICGEMMTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+#include <sycl/ext/intel/ac_types/ac_fixed.hpp>
+#include <sycl/ext/intel/ac_types/ac_int.hpp>
+
+#include "data_bundle.hpp"
+#include "memory_utils.hpp"
+#include "systolic_gemm.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling.
+// They are templated on the element type so that several GEMMs can be
+// built into the same design.
+template <typename TIn> struct GemmFeedAKernel;
+template <typename TIn> struct GemmFeedBKernel;
+template <typename TIn> struct GemmKernel;
+template <typename TIn> struct GemmDrainKernel;
+template <typename TIn> struct GemmAPipeID;
+template <typename TIn> struct GemmBPipeID;
+template <typename TIn> struct GemmCPipeID;
+
+//
+// Multiply an m x k matrix A by a k x n matrix B on the device, through
+// device memory, using a rows x cols systolic array.
+//
+// The host reorders the matrices into the order the array consumes them:
+// A as panels of 'rows' rows stored column by column, B as panels of
+// 'cols' columns stored row by row. Each tile of C is then one contiguous
+// read of an A panel and a B panel, which the feeder kernels stream with
+// MemoryToPipe. The C tiles are written back with PipeToMemory and
+// reordered on the host.
+//
+template <typename TIn, typename TAcc, int rows, int cols>
+void SystolicGemmHost(queue &q, const std::vector<TIn> &a,
+                      const std::vector<TIn> &b, std::vector<TAcc> &c, int m,
+                      int n, int k) {
+  using ABundle = fpga_tools::DataBundle<TIn, rows>;
+  using BBundle = fpga_tools::DataBundle<TIn, cols>;
+  using CBundle = fpga_tools::DataBundle<TAcc, cols>;
+  using APipe = sycl::ext::intel::pipe<GemmAPipeID<TIn>, ABundle, 16>;
+  using BPipe = sycl::ext::intel::pipe<GemmBPipeID<TIn>, BBundle, 16>;
+  using CPipe = sycl::ext::intel::pipe<GemmCPipeID<TIn>, CBundle, 16>;
+
+  // pad the matrices to whole tiles. The depth must cover the drain time
+  // of a tile.
+  const int m_tiles = (m + rows - 1) / rows;
+  const int n_tiles = (n + cols - 1) / cols;
+  const int k_depth = std::max(k, rows);
+  const int num_tiles = m_tiles * n_tiles;
+
+  std::vector<TIn> a_panels((size_t)m_tiles * k_depth * rows, TIn(0));
+  std::vector<TIn> b_panels((size_t)n_tiles * k_depth * cols, TIn(0));
+  for (int i = 0; i < m; i++) {
+    for (int kk = 0; kk < k; kk++) {
+      a_panels[((size_t)(i / rows) * k_depth + kk) * rows + i % rows] =
+          a[(size_t)i * k + kk];
+    }
+  }
+  for (int kk = 0; kk < k; kk++) {
+    for (int j = 0; j < n; j++) {
+      b_panels[((size_t)(j / cols) * k_depth + kk) * cols + j % cols] =
+          b[(size_t)kk * n + j];
+    }
+  }
+
+  TIn *a_dev = malloc_device<TIn>(a_panels.size(), q);
+  TIn *b_dev = malloc_device<TIn>(b_panels.size(), q);
+  TAcc *c_dev = malloc_device<TAcc>((size_t)num_tiles * rows * cols, q);
+  if (a_dev == nullptr || b_dev == nullptr || c_dev == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the matrices\n";
+    std::terminate();
+  }
+  q.memcpy(a_dev, a_panels.data(), a_panels.size() * sizeof(TIn)).wait();
+  q.memcpy(b_dev, b_panels.data(), b_panels.size() * sizeof(TIn)).wait();
+
+  // the tiles are computed row by row: A panels are reused across a row
+  // of tiles and B panels across a column
+  auto feed_a_event = q.single_task<GemmFeedAKernel<TIn>>([=] {
+    for (int ti = 0; ti < m_tiles; ti++) {
+      for (int tj = 0; tj < n_tiles; tj++) {
+        fpga_tools::MemoryToPipe<APipe, rows, false>(
+            a_dev + (size_t)ti * k_depth * rows, k_depth);
+      }
+    }
+  });
+  auto feed_b_event = q.single_task<GemmFeedBKernel<TIn>>([=] {
+    for (int ti = 0; ti < m_tiles; ti++) {
+      for (int tj = 0; tj < n_tiles; tj++) {
+        fpga_tools::MemoryToPipe<BPipe, cols, false>(
+            b_dev + (size_t)tj * k_depth * cols, k_depth);
+      }
+    }
+  });
+  auto gemm_event = q.single_task<GemmKernel<TIn>>([=] {
+    fpga_tools::SystolicGemm<TIn, TAcc, rows, cols, APipe, BPipe, CPipe>(
+        num_tiles, k_depth);
+  });
+  auto drain_event = q.single_task<GemmDrainKernel<TIn>>([=] {
+    for (int t = 0; t < num_tiles; t++) {
+      fpga_tools::PipeToMemory<CPipe, cols, false>(
+          c_dev + (size_t)t * rows * cols, rows);
+    }
+  });
+
+  feed_a_event.wait();
+  feed_b_event.wait();
+  gemm_event.wait();
+  drain_event.wait();
+
+  std::vector<TAcc> c_tiles((size_t)num_tiles * rows * cols);
+  q.memcpy(c_tiles.data(), c_dev, c_tiles.size() * sizeof(TAcc)).wait();
+  c.resize((size_t)m * n);
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      size_t tile = (size_t)(i / rows) * n_tiles + j / cols;
+      c[(size_t)i * n + j] =
+          c_tiles[(tile * rows + i % rows) * cols + j % cols];
+    }
+  }
+
+  free(a_dev, q);
+  free(b_dev, q);
+  free(c_dev, q);
+}
+
+// whether a matrix element type is an ac_fixed
+template <typename T>
+struct GemmIsFixed : std::false_type {};
+template <int W, int I, bool S, ac_q_mode Q, ac_o_mode O>
+struct GemmIsFixed<ac_fixed<W, I, S, Q, O>> : std::true_type {};
+
+// the value of a matrix element as a double, for the host reference
+template <typename T>
+double GemmValue(const T &v) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    return (double)v;
+  } else {
+    return v.to_double();
+  }
+}
+
+//
+// Multiply random matrices on the device and compare with a host
+// reference. Integer and fixed point types must match exactly; floating
+// point results must match to a relative tolerance. Fixed point inputs are
+// random 8-bit values scaled by 2^-6, so they fit an ac_fixed<8, 2>, and the
+// accumulator must have at least 12 fractional bits to be exact.
+//
+template <typename TIn, typename TAcc, int rows, int cols>
+bool RunSystolicGemm(queue &q, int m, int n, int k, const char *name) {
+  constexpr bool kIsFloat = std::is_floating_point_v<TIn>;
+
+  std::vector<TIn> a((size_t)m * k), b((size_t)k * n);
+  auto random_value = [] {
+    if constexpr (kIsFloat) {
+      return TIn(rand() % 2001 / 1000.0 - 1.0);
+    } else if constexpr (GemmIsFixed<TIn>::value) {
+      return TIn((rand() % 256 - 128) / 64.0);
+    } else {
+      return TIn(rand() % 256 - 128);
+    }
+  };
+  for (auto &v : a) v = random_value();
+  for (auto &v : b) v = random_value();
+
+  std::vector<TAcc> c;
+  auto start = std::chrono::high_resolution_clock::now();
+  SystolicGemmHost<TIn, TAcc, rows, cols>(q, a, b, c, m, n, k);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Systolic GEMM (" << name << ", " << rows << "x" << cols
+            << " PEs): " << m << "x" << k << " * " << k << "x" << n << " in "
+            << diff.count() << " ms\n";
+
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      double ref = 0;
+      for (int kk = 0; kk < k; kk++) {
+        ref += GemmValue(a[(size_t)i * k + kk]) *
+               GemmValue(b[(size_t)kk * n + j]);
+      }
+      double res = GemmValue(c[(size_t)i * n + j]);
+      bool ok = kIsFloat ? std::fabs(res - ref) <= 1e-3 * (1 + std::fabs(ref))
+                         : res == ref;
+      if (!ok) {
+        std::cerr << "ERROR: C[" << i << "][" << j << "] is " << res
+                  << ", expected " << ref << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//
+// This function runs the systolic GEMM with floating point, 8-bit integer
+// (ac_int) and 8-bit fixed point (ac_fixed) inputs. The matrix sizes are not
+// multiples of the array size, which exercises the padding. The matrices are moved through
+// device memory, so the IO pipe type and allocation mode are not used.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunSystolicGemmSystem(queue &q, size_t count) {
+  // the matrix size grows with the test size, with a cap to keep the
+  // host reference fast
+  int dim = std::min<size_t>(count / 16, 250) + 6;
+
+  bool passed = true;
+  passed &= RunSystolicGemm<float, float, 8, 8>(q, dim, dim + 3, dim - 5,
+                                                "float");
+  passed &= RunSystolicGemm<ac_int<8, true>, ac_int<32, true>, 8, 8>(
+      q, dim + 1, dim - 2, dim + 7, "ac_int<8>");
+  passed &= RunSystolicGemm<ac_fixed<8, 2, true>, ac_fixed<32, 16, true>, 8,
+                            8>(q, dim - 1, dim + 5, dim + 2, "ac_fixed<8, 2>");
+  return passed;
+}
+
+#endif /* __SYSTOLICGEMMTEST_HPP__ */
@@ -0,0 +1,291 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __TESTDATA_HPP__
+#define __TESTDATA_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Reproducible test data for the fake IO pipes, generated and checked in
+// parallel on the host.
+//
+// The value of each entry is a function of the seed and the index of the
+// entry only, computed with the Philox4x32-10 counter-based random number
+// generator. So any range of entries can be generated on its own, the data
+// is split across threads, and the output of a kernel can be checked by
+// generating the expected values again instead of keeping a copy of them.
+// The same seed always gives the same data.
+//
+// EXAMPLE USAGE
+//    auto data = TestDataGenerator<int>::Uniform(kSeed, 100);
+//    data.Fill(MyProducer::Data(), count);
+//    ...
+//    auto report = data.Check(MyConsumer::Data(), count);
+//    report.Print(std::cerr, "output");
+//    passed &= report.Passed();
+//
+
+//
+// Philox4x32-10: encrypts the 128-bit 'counter' with the 64-bit 'key'.
+// Each (counter, key) pair gives 128 independent random bits.
+//
+inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter,
+                                          std::array<uint32_t, 2> key) {
+  for (int round = 0; round < 10; round++) {
+    const uint64_t p0 = uint64_t(0xD2511F53) * counter[0];
+    const uint64_t p1 = uint64_t(0xCD9E8D57) * counter[2];
+    counter = {uint32_t(p1 >> 32) ^ counter[1] ^ key[0], uint32_t(p1),
+               uint32_t(p0 >> 32) ^ counter[3] ^ key[1], uint32_t(p0)};
+    key[0] += 0x9E3779B9;
+    key[1] += 0xBB67AE85;
+  }
+  return counter;
+}
+
+//
+// Splits [0, count) into a range per thread, and calls 'fn(begin, end, t)'
+// for range 't' on that thread. Small counts run on the calling thread.
+//
+template <typename F>
+void ParallelForRanges(size_t count, F fn) {
+  constexpr size_t kMinRange = 1 << 16;
+  const size_t threads = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()),
+      (count + kMinRange - 1) / kMinRange);
+  if (threads <= 1) {
+    fn(size_t(0), count, size_t(0));
+    return;
+  }
+
+  const size_t range = (count + threads - 1) / threads;
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < threads; t++) {
+    const size_t begin = t * range;
+    const size_t end = std::min(count, begin + range);
+    pool.emplace_back([=] { fn(begin, end, t); });
+  }
+  for (auto &thread : pool) thread.join();
+}
+
+//
+// The result of checking data against a TestDataGenerator. It counts the
+// mismatches and keeps the first few of them, instead of one error line
+// per mismatch.
+//
+template <typename T>
+struct TestDataReport {
+  static constexpr size_t kMaxExamples = 8;
+
+  struct Mismatch {
+    size_t index;
+    T actual;
+    T expected;
+  };
+
+  size_t checked = 0;
+  size_t mismatches = 0;
+  size_t first = 0;  // the index of the first and last mismatches
+  size_t last = 0;
+  std::vector<Mismatch> examples;  // the first mismatches, by index
+
+  bool Passed() const { return mismatches == 0; }
+
+  void Add(size_t index, const T &actual, const T &expected) {
+    if (mismatches == 0) first = index;
+    last = index;
+    mismatches++;
+    if (examples.size() < kMaxExamples) {
+      examples.push_back({index, actual, expected});
+    }
+  }
+
+  // add the report of the entries that follow this report's
+  void Merge(const TestDataReport &next) {
+    if (next.mismatches != 0) {
+      if (mismatches == 0) first = next.first;
+      last = next.last;
+      for (const auto &m : next.examples) {
+        if (examples.size() == kMaxExamples) break;
+        examples.push_back(m);
+      }
+    }
+    checked += next.checked;
+    mismatches += next.mismatches;
+  }
+
+  // print a summary of the mismatches, if there are any, to 'os'
+  void Print(std::ostream &os, const std::string &what) const {
+    if (Passed()) return;
+    os << "ERROR: " << mismatches << " of " << checked << " " << what
+       << " entries mismatch, from entry " << first << " to " << last
+       << "\n";
+    for (const auto &m : examples) {
+      os << "  entry " << m.index << ": " << m.actual << " != " << m.expected
+         << " (actual != expected)\n";
+    }
+    if (mismatches > examples.size()) {
+      os << "  ... " << (mismatches - examples.size()) << " more\n";
+    }
+  }
+};
+
+//
+// Generates entry 'i' of a test data stream with one of these
+// distributions:
+//    Uniform:    uniform in [0, range)
+//    Zipf:       k - 1 with a probability proportional to 1 / k^exponent,
+//                for k in [1, range], so 0 is the most frequent value
+//    Sequential: first, first + 1, first + 2, ...
+//
+template <typename T>
+class TestDataGenerator {
+ public:
+  enum Distribution { kUniform, kZipf, kSequential };
+
+  static TestDataGenerator Uniform(uint64_t seed, uint64_t range) {
+    return TestDataGenerator(kUniform, seed, std::max<uint64_t>(range, 1));
+  }
+
+  static TestDataGenerator Zipf(uint64_t seed, uint64_t range,
+                                double exponent) {
+    TestDataGenerator gen(kZipf, seed, std::max<uint64_t>(range, 1));
+    gen.InitZipf(exponent);
+    return gen;
+  }
+
+  static TestDataGenerator Sequential(uint64_t first) {
+    TestDataGenerator gen(kSequential, 0, 0);
+    gen.first_ = first;
+    return gen;
+  }
+
+  // the value of entry 'i'
+  T operator()(size_t i) const {
+    if (distribution_ == kSequential) {
+      return static_cast<T>(first_ + i);
+    } else if (distribution_ == kUniform) {
+      const auto r = Random(i, 0);
+      if (range_ <= (uint64_t(1) << 32)) {
+        // the high bits of the product, with no division
+        return static_cast<T>((uint64_t(r[0]) * range_) >> 32);
+      }
+      return static_cast<T>((uint64_t(r[1]) << 32 | r[0]) % range_);
+    } else {
+      return static_cast<T>(ZipfSample(i) - 1);
+    }
+  }
+
+  // write entries [0, count) to 'data', in parallel
+  void Fill(T *data, size_t count) const {
+    ParallelForRanges(count, [&](size_t begin, size_t end, size_t) {
+      for (size_t i = begin; i < end; i++) data[i] = (*this)(i);
+    });
+  }
+
+  // compare 'data' to entries [0, count), in parallel
+  TestDataReport<T> Check(const T *data, size_t count) const {
+    std::vector<TestDataReport<T>> reports(
+        std::max(1u, std::thread::hardware_concurrency()));
+    ParallelForRanges(count, [&](size_t begin, size_t end, size_t t) {
+      TestDataReport<T> &report = reports[t];
+      for (size_t i = begin; i < end; i++) {
+        const T expected = (*this)(i);
+        if (data[i] != expected) report.Add(i, data[i], expected);
+      }
+      report.checked = end - begin;
+    });
+
+    // the ranges are in order of thread
+    TestDataReport<T> report;
+    for (const auto &r : reports) report.Merge(r);
+    return report;
+  }
+
+ private:
+  TestDataGenerator(Distribution distribution, uint64_t seed, uint64_t range)
+      : distribution_(distribution), seed_(seed), range_(range) {}
+
+  // the random bits of attempt 'attempt' at entry 'i'
+  std::array<uint32_t, 4> Random(size_t i, uint32_t attempt) const {
+    return Philox4x32({uint32_t(i), uint32_t(uint64_t(i) >> 32), attempt, 0},
+                      {uint32_t(seed_), uint32_t(seed_ >> 32)});
+  }
+
+  // a uniform double in [0, 1) from 64 random bits
+  static double Uniform01(uint32_t hi, uint32_t lo) {
+    return double((uint64_t(hi) << 32 | lo) >> 11) * 0x1.0p-53;
+  }
+
+  //
+  // Zipf sampling by rejection-inversion (Hormann and Derflinger, 1996):
+  // invert the integral of the continuous density h(x) = x^-exponent, and
+  // accept the nearest integer unless it falls in the small area where the
+  // continuous density is above the discrete one. It takes no tables, and
+  // fewer than 2 attempts on average for any range and exponent.
+  //
+  void InitZipf(double exponent) {
+    exponent_ = exponent;
+    h_integral_x1_ = HIntegral(1.5) - 1.0;
+    h_integral_n_ = HIntegral(double(range_) + 0.5);
+    s_ = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+  }
+
+  uint64_t ZipfSample(size_t i) const {
+    for (uint32_t attempt = 0;; attempt++) {
+      const auto r = Random(i, attempt);
+      for (int half = 0; half < 2; half++) {
+        const double u01 = Uniform01(r[2 * half], r[2 * half + 1]);
+        const double u = h_integral_n_ + u01 * (h_integral_x1_ - h_integral_n_);
+        const double x = HIntegralInverse(u);
+        const double k = std::min(std::max(std::floor(x + 0.5), 1.0),
+                                  double(range_));
+        if (k - x <= s_ || u >= HIntegral(k + 0.5) - H(k)) {
+          return uint64_t(k);
+        }
+      }
+    }
+  }
+
+  double H(double x) const { return std::exp(-exponent_ * std::log(x)); }
+
+  double HIntegral(double x) const {
+    const double log_x = std::log(x);
+    return Helper2((1.0 - exponent_) * log_x) * log_x;
+  }
+
+  double HIntegralInverse(double x) const {
+    const double t = std::max(x * (1.0 - exponent_), -1.0);
+    return std::exp(Helper1(t) * x);
+  }
+
+  // log(1 + x) / x, accurate near 0
+  static double Helper1(double x) {
+    if (std::abs(x) > 1e-8) return std::log1p(x) / x;
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+
+  // (exp(x) - 1) / x, accurate near 0
+  static double Helper2(double x) {
+    if (std::abs(x) > 1e-8) return std::expm1(x) / x;
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+  }
+
+  Distribution distribution_;
+  uint64_t seed_;
+  uint64_t range_;
+  uint64_t first_ = 0;
+  double exponent_ = 0;
+  double h_integral_x1_ = 0;
+  double h_integral_n_ = 0;
+  double s_ = 0;
+};
+
+#endif /* __TESTDATA_HPP__ */
@@ -0,0 +1,302 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __TRAFFICSHAPERTEST_HPP__
+#define __TRAFFICSHAPERTEST_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "FakeIOPipes.hpp"
+#include "HostSideChannel.hpp"
+#include "packet_parser.hpp"
+#include "traffic_shaper.hpp"
+
+using namespace sycl;
+
+// declare the kernel and pipe ID stucts globally to reduce name mangling
+struct ShaperParserKernel;
+struct TrafficShaperKernel;
+struct ShaperDrainKernel;
+struct ShaperReadIOPipeID { static constexpr unsigned id = 0; };
+struct ShaperParsedMetadataPipeID;
+struct ShaperParsedPayloadPipeID;
+struct ShapedMetadataPipeID;
+struct ShapedPayloadPipeID;
+struct ShaperCommandSideChannelID;
+struct ShaperAckSideChannelID;
+
+constexpr int kShaperBeatBytes = 16;
+constexpr int kShaperClasses = 8;
+
+// the class of a packet is the class selector of its DSCP
+inline int ShaperClassOf(const fpga_tools::PacketMetadata &m) {
+  return m.ipv4 ? m.dscp_ecn >> 5 : 0;
+}
+
+// an IPv4 UDP packet of 'length' bytes in class 'cls', with 'seq' at the
+// start of its payload
+inline std::vector<uint8_t> ShaperMakePacket(int cls, uint32_t seq,
+                                             size_t length) {
+  std::vector<uint8_t> p(std::max<size_t>(length, 46), 0);
+  p[12] = fpga_tools::kEtherTypeIPv4 >> 8;
+  p[13] = fpga_tools::kEtherTypeIPv4 & 0xFF;
+  p[14] = 0x45;
+  p[15] = cls << 5;
+  p[23] = fpga_tools::kIpProtocolUdp;
+  for (int i = 0; i < 4; i++) p[42 + i] = seq >> (24 - 8 * i);
+  return p;
+}
+
+//
+// This function builds the full system using fake IO pipes:
+//
+//   packets -> PacketParser -> TrafficShaper -> drain kernel
+//
+// The host configures the classes through the side channel:
+//    class 1: policed, with a rate of 0. Its packets conform until the
+//             bucket is in debt, and are dropped after that, whatever their
+//             timing, so the host knows exactly which ones get through.
+//    class 2: shaped, at 1/4 byte per cycle. None are dropped.
+//    class 3: policed, at 1/8 byte per cycle. The bytes that get through
+//             are bounded by the burst size, the rate and the cycle count.
+//    others:  unlimited
+// The last packet is the only one in class 7, so the drain kernel knows
+// when to stop. The test checks the output packets and the counters.
+//
+template <typename T, bool use_usm_host_alloc>
+bool RunTrafficShaperSystem(queue &q, size_t count) {
+  using Beat = fpga_tools::PacketBeat<kShaperBeatBytes>;
+  using Metadata = fpga_tools::PacketMetadata;
+  constexpr uint32_t kBurst = 1500;
+  constexpr uint32_t kClass1Burst = 3000;
+  constexpr uint32_t kOneBytePerCycle =
+      1 << fpga_tools::kShaperTokenFractionBits;
+  constexpr uint32_t kClass2Rate = kOneBytePerCycle / 4;
+  constexpr uint32_t kClass3Rate = kOneBytePerCycle / 8;
+  constexpr size_t kMaxPacketBytes = 1514;
+
+  // the packets: random classes 0 to 6, and a last one in class 7
+  const size_t packets = std::max<size_t>(count / 16, 256);
+  std::vector<std::vector<uint8_t>> in(packets);
+  std::vector<int> in_class(packets);
+  std::vector<size_t> in_first_beat(packets);
+  size_t beats = 0;
+  for (size_t i = 0; i < packets; i++) {
+    in_class[i] = i == packets - 1 ? 7 : rand() % 7;
+    size_t length = 60 + rand() % (kMaxPacketBytes - 59);
+    in[i] = ShaperMakePacket(in_class[i], i, length);
+    in_first_beat[i] = beats;
+    beats += (in[i].size() + kShaperBeatBytes - 1) / kShaperBeatBytes;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // IO pipes, internal pipes and side channels
+  using FakeIOPipeInProducer =
+      Producer<ShaperReadIOPipeID, Beat, use_usm_host_alloc>;
+  using ReadIOPipe = typename FakeIOPipeInProducer::Pipe;
+  using ParsedMetadataPipe =
+      ext::intel::pipe<ShaperParsedMetadataPipeID, Metadata, 16>;
+  using ParsedPayloadPipe =
+      ext::intel::pipe<ShaperParsedPayloadPipeID, Beat, 64>;
+  using ShapedMetadataPipe =
+      ext::intel::pipe<ShapedMetadataPipeID, Metadata, 16>;
+  using ShapedPayloadPipe = ext::intel::pipe<ShapedPayloadPipeID, Beat, 64>;
+  using CommandSideChannel =
+      HostToDeviceSideChannel<ShaperCommandSideChannelID,
+                              fpga_tools::ShaperCommand, use_usm_host_alloc,
+                              1>;
+  using AckSideChannel =
+      DeviceToHostSideChannel<ShaperAckSideChannelID, uint64_t,
+                              use_usm_host_alloc, 1>;
+
+  FakeIOPipeInProducer::Init(q, beats);
+  CommandSideChannel::Init(q);
+  AckSideChannel::Init(q);
+  //////////////////////////////////////////////////////////////////////////////
+
+  auto i_stream_data = FakeIOPipeInProducer::Data();
+  for (size_t i = 0; i < packets; i++) {
+    auto &p = in[i];
+    for (size_t offset = 0; offset < p.size(); offset += kShaperBeatBytes) {
+      Beat &beat = i_stream_data[in_first_beat[i] + offset / kShaperBeatBytes];
+      for (int j = 0; j < kShaperBeatBytes; j++) {
+        beat.data[j] = offset + j < p.size() ? p[offset + j] : 0;
+      }
+      beat.sop = offset == 0;
+      beat.eop = offset + kShaperBeatBytes >= p.size();
+      beat.empty = beat.eop ? offset + kShaperBeatBytes - p.size() : 0;
+    }
+  }
+
+  fpga_tools::ShaperCounters *counters =
+      malloc_host<fpga_tools::ShaperCounters>(kShaperClasses, q);
+  Metadata *out_metadata = malloc_host<Metadata>(packets, q);
+  Beat *out_beats = malloc_host<Beat>(beats, q);
+  size_t *out_packets = malloc_host<size_t>(1, q);
+  if (counters == nullptr || out_metadata == nullptr ||
+      out_beats == nullptr || out_packets == nullptr) {
+    std::cerr << "ERROR: failed to allocate space for the shaper outputs\n";
+    std::terminate();
+  }
+
+  auto shaper_event = q.single_task<TrafficShaperKernel>([=] {
+    fpga_tools::TrafficShaper<kShaperClasses, ParsedMetadataPipe,
+                              ParsedPayloadPipe, ShapedMetadataPipe,
+                              ShapedPayloadPipe, CommandSideChannel,
+                              AckSideChannel>(counters, ShaperClassOf);
+  });
+
+  // configure the classes, and wait for the configuration to be applied
+  CommandSideChannel::write({fpga_tools::kShaperConfigure, 1,
+                             {fpga_tools::kShaperPolice, 0, kClass1Burst}});
+  CommandSideChannel::write({fpga_tools::kShaperConfigure, 2,
+                             {fpga_tools::kShaperShape, kClass2Rate, kBurst}});
+  CommandSideChannel::write({fpga_tools::kShaperConfigure, 3,
+                             {fpga_tools::kShaperPolice, kClass3Rate, kBurst}});
+  CommandSideChannel::write({fpga_tools::kShaperReadCounters, 0, {}});
+  const uint64_t start_cycle = AckSideChannel::read();
+
+  auto drain_event = q.single_task<ShaperDrainKernel>([=] {
+    size_t packet = 0;
+    size_t beat = 0;
+    bool last = false;
+    while (!last) {
+      Metadata m = ShapedMetadataPipe::read();
+      out_metadata[packet++] = m;
+      bool eop;
+      do {
+        Beat b = ShapedPayloadPipe::read();
+        out_beats[beat++] = b;
+        eop = b.eop;
+      } while (!eop);
+      last = ShaperClassOf(m) == 7;
+    }
+    *out_packets = packet;
+  });
+
+  auto parser_event = q.single_task<ShaperParserKernel>([=] {
+    fpga_tools::PacketParser<ReadIOPipe, ParsedMetadataPipe,
+                             ParsedPayloadPipe>(beats);
+  });
+
+  event produce_dma_e, produce_kernel_e;
+  auto start = std::chrono::high_resolution_clock::now();
+  std::tie(produce_dma_e, produce_kernel_e) = FakeIOPipeInProducer::Start(q);
+  produce_dma_e.wait();
+  produce_kernel_e.wait();
+  parser_event.wait();
+  drain_event.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  CommandSideChannel::write({fpga_tools::kShaperReadCounters, 0, {}});
+  const uint64_t cycles = AckSideChannel::read() - start_cycle;
+  CommandSideChannel::write({fpga_tools::kShaperStop, 0, {}});
+  shaper_event.wait();
+
+  std::chrono::duration<double, std::milli> diff = end - start;
+  std::cout << "Traffic shaper: " << packets << " packets in " << diff.count()
+            << " ms (" << cycles << " shaper cycles), " << counters[2].delayed
+            << " delayed and " << counters[1].dropped + counters[3].dropped
+            << " dropped\n";
+
+  // match the output packets to the input packets, in order
+  bool passed = true;
+  std::vector<size_t> forwarded(kShaperClasses, 0);
+  std::vector<size_t> dropped(kShaperClasses, 0);
+  size_t class3_bytes = 0;
+  int64_t class1_tokens = kClass1Burst;
+  size_t out = 0;
+  size_t out_beat = 0;
+  for (size_t i = 0; i < packets && passed; i++) {
+    bool got = false;
+    if (out < *out_packets) {
+      const size_t offset = out_metadata[out].payload_offset;
+      const Beat &b = out_beats[out_beat + offset / kShaperBeatBytes];
+      uint32_t seq = 0;
+      for (int j = 0; j < 4; j++) {
+        seq = (seq << 8) | b.data[offset % kShaperBeatBytes + j];
+      }
+      got = seq == i;
+    }
+
+    const int cls = in_class[i];
+    bool expected = true;
+    if (cls == 1) {
+      expected = class1_tokens >= 0;
+      if (expected) class1_tokens -= in[i].size();
+    } else if (cls == 3) {
+      expected = got;
+    }
+    if (got != expected) {
+      std::cerr << "ERROR: packet " << i << " of class " << cls << " was "
+                << (got ? "forwarded" : "dropped") << "\n";
+      passed &= false;
+    }
+
+    if (got) {
+      forwarded[cls]++;
+      if (cls == 3) class3_bytes += in[i].size();
+      const size_t n = (in[i].size() + kShaperBeatBytes - 1) / kShaperBeatBytes;
+      for (size_t k = 0; k < n; k++) {
+        const Beat &a = out_beats[out_beat + k];
+        const Beat &b = i_stream_data[in_first_beat[i] + k];
+        bool match = a.sop == b.sop && a.eop == b.eop && a.empty == b.empty;
+        for (int j = 0; j < kShaperBeatBytes; j++) {
+          match &= a.data[j] == b.data[j];
+        }
+        if (!match) {
+          std::cerr << "ERROR: packet " << i << " was corrupted\n";
+          passed &= false;
+        }
+      }
+      out++;
+      out_beat += n;
+    } else {
+      dropped[cls]++;
+    }
+  }
+  if (passed && out != *out_packets) {
+    std::cerr << "ERROR: " << *out_packets - out << " extra packets\n";
+    passed &= false;
+  }
+
+  // the counters must add up, and class 3 must respect its rate
+  for (int c = 0; c < kShaperClasses && passed; c++) {
+    const auto &k = counters[c];
+    if (k.conforming + k.delayed != forwarded[c] || k.dropped != dropped[c]) {
+      std::cerr << "ERROR: the counters of class " << c << " are "
+                << k.conforming << " conforming, " << k.delayed
+                << " delayed and " << k.dropped << " dropped, but "
+                << forwarded[c] << " were forwarded and " << dropped[c]
+                << " were dropped\n";
+      passed &= false;
+    }
+  }
+  const double class3_limit =
+      kBurst + double(kClass3Rate) * cycles / kOneBytePerCycle +
+      kMaxPacketBytes;
+  if (class3_bytes > class3_limit) {
+    std::cerr << "ERROR: class 3 sent " << class3_bytes
+              << " bytes, more than its limit of " << class3_limit << "\n";
+    passed &= false;
+  }
+
+  free(counters, q);
+  free(out_metadata, q);
+  free(out_beats, q);
+  free(out_packets, q);
+  FakeIOPipeInProducer::Destroy(q);
+  CommandSideChannel::Destroy(q);
+  AckSideChannel::Destroy(q);
+
+  return passed;
+}
+
+#endif /* __TRAFFICSHAPERTEST_HPP__ */
@@ -0,0 +1,192 @@
+// Copyright 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __USMPOOL_HPP__
+#define __USMPOOL_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+using namespace sycl;
+
+//
+// A pool of memory allocations for a queue, used by the fake IO pipes and
+// side channels (see FakeIOPipes.hpp).
+//
+// A USM host allocation pins its pages with a system call, and a USM device
+// allocation goes through the device driver, so a test or service that
+// cycles Init() and Destroy() pays for those on every cycle. The pool keeps
+// freed blocks and hands them out again. Blocks are rounded up to a size
+// class, so a block can be reused for a slightly different size. The size
+// classes are a quarter of a power of 2 apart, which wastes at most 25% of
+// a block.
+//
+// There are three arenas: USM host memory, USM device memory, and ordinary
+// host memory for the host side copy of device allocations. Blocks are only
+// returned to the runtime by Trim() or Release().
+//
+class UsmPool {
+ public:
+  enum Arena { kHostArena = 0, kDeviceArena, kSystemArena, kArenas };
+
+  struct ArenaStats {
+    size_t allocations;  // calls to Allocate()
+    size_t reused;       // allocations served with a pooled block
+    size_t in_use_bytes;
+    size_t peak_in_use_bytes;
+    size_t reserved_bytes;  // in use or pooled
+  };
+
+  // the pool of queue 'q', which is created on first use
+  static UsmPool &Get(queue &q) {
+    std::lock_guard<std::mutex> lock(pools_mutex_);
+    auto &pool = pools_[q];
+    if (!pool) pool.reset(new UsmPool(q));
+    return *pool;
+  }
+
+  // return the pooled blocks of queue 'q' to the runtime, and drop its pool
+  // if none of its blocks are in use
+  static void Release(queue &q) {
+    std::lock_guard<std::mutex> lock(pools_mutex_);
+    auto it = pools_.find(q);
+    if (it == pools_.end()) return;
+    it->second->Trim();
+    if (it->second->blocks_.empty()) pools_.erase(it);
+  }
+
+  // allocate space for 'count' elements of T in 'arena'. Returns nullptr if
+  // the runtime is out of memory.
+  template <typename T>
+  T *Allocate(Arena arena, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t bytes = SizeClass(count * sizeof(T));
+    ArenaStats &stats = stats_[arena];
+    stats.allocations++;
+
+    void *p = nullptr;
+    auto &free_blocks = free_[arena][bytes];
+    if (!free_blocks.empty()) {
+      p = free_blocks.back();
+      free_blocks.pop_back();
+      stats.reused++;
+    } else {
+      p = AllocateBlock(arena, bytes);
+      if (p == nullptr) return nullptr;
+      stats.reserved_bytes += bytes;
+    }
+
+    blocks_[p] = {arena, bytes};
+    stats.in_use_bytes += bytes;
+    stats.peak_in_use_bytes =
+        std::max(stats.peak_in_use_bytes, stats.in_use_bytes);
+    return static_cast<T *>(p);
+  }
+
+  // return a block from Allocate() to the pool
+  void Free(void *p) {
+    if (p == nullptr) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = blocks_.find(p);
+    if (it == blocks_.end()) {
+      std::cerr << "ERROR: freeing memory that is not from the USM pool\n";
+      std::terminate();
+    }
+    const Block block = it->second;
+    blocks_.erase(it);
+    stats_[block.arena].in_use_bytes -= block.bytes;
+    free_[block.arena][block.bytes].push_back(p);
+  }
+
+  // return the pooled blocks to the runtime
+  void Trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int arena = 0; arena < kArenas; arena++) {
+      for (auto &size_blocks : free_[arena]) {
+        for (void *p : size_blocks.second) {
+          FreeBlock(Arena(arena), p);
+          stats_[arena].reserved_bytes -= size_blocks.first;
+        }
+      }
+      free_[arena].clear();
+    }
+  }
+
+  ArenaStats Stats(Arena arena) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_[arena];
+  }
+
+  void PrintStats(std::ostream &os) const {
+    static const char *kNames[kArenas] = {"USM host", "USM device", "system"};
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "USM pool:\n";
+    for (int arena = 0; arena < kArenas; arena++) {
+      const ArenaStats &s = stats_[arena];
+      os << "  " << kNames[arena] << " arena: " << s.allocations
+         << " allocations, " << s.reused << " from the pool, "
+         << s.in_use_bytes << " bytes in use (peak " << s.peak_in_use_bytes
+         << "), " << s.reserved_bytes << " bytes reserved\n";
+    }
+  }
+
+  // the size of the block that holds 'bytes' bytes
+  static size_t SizeClass(size_t bytes) {
+    constexpr size_t kMinBlockBytes = 64;
+    if (bytes <= kMinBlockBytes) return kMinBlockBytes;
+    size_t power = kMinBlockBytes;
+    while (power < bytes / 2) power *= 2;
+    const size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+  }
+
+  // disable copy constructor and operator=
+  UsmPool(const UsmPool &) = delete;
+  UsmPool &operator=(UsmPool const &) = delete;
+
+  ~UsmPool() { Trim(); }
+
+ private:
+  struct Block {
+    Arena arena;
+    size_t bytes;
+  };
+
+  static constexpr std::align_val_t kSystemAlignment{64};
+
+  explicit UsmPool(queue &q) : q_(q), stats_{} {}
+
+  void *AllocateBlock(Arena arena, size_t bytes) {
+    if (arena == kHostArena) return malloc_host(bytes, q_);
+    if (arena == kDeviceArena) return malloc_device(bytes, q_);
+    return ::operator new(bytes, kSystemAlignment, std::nothrow);
+  }
+
+  void FreeBlock(Arena arena, void *p) {
+    if (arena == kSystemArena) {
+      ::operator delete(p, kSystemAlignment);
+    } else {
+      sycl::free(p, q_);
+    }
+  }
+
+  queue q_;
+  mutable std::mutex mutex_;
+  ArenaStats stats_[kArenas];
+  std::map<size_t, std::vector<void *>> free_[kArenas];
+  std::unordered_map<void *, Block> blocks_;
+
+  static inline std::mutex pools_mutex_;
+  static inline std::unordered_map<queue, std::unique_ptr<UsmPool>> pools_;
+};
+
+#endif /* __USMPOOL_HPP__ */
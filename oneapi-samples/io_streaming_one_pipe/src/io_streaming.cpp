@@ -22,6 +22,86 @@ using IOPipeType = unsigned long int;
 #include "LoopbackTest.hpp"
 #include "SideChannelTest.hpp"
 
+// By default every additional kernel is built into the FPGA image. To build
+// a smaller image with only one of them, next to the loopback and side
+// channel tests, define ACCELERATOR_ONLY and its ACCELERATOR_<NAME> macro
+// (cmake -DACCELERATOR=<name>). See the README for the names.
+#if !defined(ACCELERATOR_ONLY)
+#define ACCELERATOR_PATTERN_MATCH
+#define ACCELERATOR_AES_CTR
+#define ACCELERATOR_REED_SOLOMON
+#define ACCELERATOR_LZ4_DECOMPRESS
+#define ACCELERATOR_HASH_JOIN
+#define ACCELERATOR_RADIX_PARTITION
+#define ACCELERATOR_SYSTOLIC_GEMM
+#define ACCELERATOR_SCAN
+#define ACCELERATOR_STREAM_COMPACTION
+#define ACCELERATOR_COLUMNAR_CODEC
+#define ACCELERATOR_HYPERLOGLOG
+#define ACCELERATOR_SHA256
+#define ACCELERATOR_FFT
+#define ACCELERATOR_PACKET_PARSER
+#define ACCELERATOR_RSS
+#define ACCELERATOR_TRAFFIC_SHAPER
+#define ACCELERATOR_FEED_ARBITER
+#define ACCELERATOR_LAUNCH_LATENCY
+#endif
+
+#if defined(ACCELERATOR_PATTERN_MATCH)
+#include "PatternMatchTest.hpp"
+#endif
+#if defined(ACCELERATOR_AES_CTR)
+#include "AesCtrTest.hpp"
+#endif
+#if defined(ACCELERATOR_REED_SOLOMON)
+#include "ReedSolomonTest.hpp"
+#endif
+#if defined(ACCELERATOR_LZ4_DECOMPRESS)
+#include "Lz4DecompressTest.hpp"
+#endif
+#if defined(ACCELERATOR_HASH_JOIN)
+#include "HashJoinTest.hpp"
+#endif
+#if defined(ACCELERATOR_RADIX_PARTITION)
+#include "RadixPartitionTest.hpp"
+#endif
+#if defined(ACCELERATOR_SYSTOLIC_GEMM)
+#include "SystolicGemmTest.hpp"
+#endif
+#if defined(ACCELERATOR_SCAN)
+#include "ScanTest.hpp"
+#endif
+#if defined(ACCELERATOR_STREAM_COMPACTION)
+#include "StreamCompactionTest.hpp"
+#endif
+#if defined(ACCELERATOR_COLUMNAR_CODEC)
+#include "ColumnarCodecTest.hpp"
+#endif
+#if defined(ACCELERATOR_HYPERLOGLOG)
+#include "HyperLogLogTest.hpp"
+#endif
+#if defined(ACCELERATOR_SHA256)
+#include "Sha256Test.hpp"
+#endif
+#if defined(ACCELERATOR_FFT)
+#include "FftTest.hpp"
+#endif
+#if defined(ACCELERATOR_PACKET_PARSER)
+#include "PacketParserTest.hpp"
+#endif
+#if defined(ACCELERATOR_RSS)
+#include "RssTest.hpp"
+#endif
+#if defined(ACCELERATOR_TRAFFIC_SHAPER)
+#include "TrafficShaperTest.hpp"
+#endif
+#if defined(ACCELERATOR_FEED_ARBITER)
+#include "FeedArbiterTest.hpp"
+#endif
+#if defined(ACCELERATOR_LAUNCH_LATENCY)
+#include "LaunchLatencyTest.hpp"
+#endif
+
 using namespace sycl;
 
 // check is USM host allocations are enabled
@@ -72,10 +152,160 @@ int main() {
 
     // run the side channel example system
     // see 'SideChannelTest.hpp'
-    /*std::cout << "Running side channel test\n";
-    passed &= 
+    std::cout << "Running side channel test\n";
+    passed &=
       RunSideChannelsSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
-    */
+
+#if defined(ACCELERATOR_PATTERN_MATCH)
+    // run the multi-pattern matching example system
+    // see 'PatternMatchTest.hpp'
+    std::cout << "Running pattern match test\n";
+    passed &=
+      RunPatternMatchSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_AES_CTR)
+    // run the AES-CTR example systems
+    // see 'AesCtrTest.hpp'
+    std::cout << "Running AES-CTR test\n";
+    passed &=
+      RunAesCtrSystem<IOPipeType, kUseUSMHostAllocation, 128>(q, count);
+    passed &=
+      RunAesCtrSystem<IOPipeType, kUseUSMHostAllocation, 256>(q, count);
+#endif
+
+#if defined(ACCELERATOR_REED_SOLOMON)
+    // run the Reed-Solomon erasure coding example system
+    // see 'ReedSolomonTest.hpp'
+    std::cout << "Running Reed-Solomon test\n";
+    passed &=
+      RunReedSolomonSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_LZ4_DECOMPRESS)
+    // run the LZ4 decompression example system
+    // see 'Lz4DecompressTest.hpp'
+    std::cout << "Running LZ4 decompression test\n";
+    passed &=
+      RunLz4DecompressSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_HASH_JOIN)
+    // run the hash join example system
+    // see 'HashJoinTest.hpp'
+    std::cout << "Running hash join test\n";
+    passed &=
+      RunHashJoinSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_RADIX_PARTITION)
+    // run the radix partitioning example system
+    // see 'RadixPartitionTest.hpp'
+    std::cout << "Running radix partition test\n";
+    passed &=
+      RunRadixPartitionSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_SYSTOLIC_GEMM)
+    // run the systolic GEMM example system
+    // see 'SystolicGemmTest.hpp'
+    std::cout << "Running systolic GEMM test\n";
+    passed &=
+      RunSystolicGemmSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_SCAN)
+    // run the multi-lane scan example system
+    // see 'ScanTest.hpp'
+    std::cout << "Running scan test\n";
+    passed &=
+      RunScanSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_STREAM_COMPACTION)
+    // run the stream compaction example system
+    // see 'StreamCompactionTest.hpp'
+    std::cout << "Running stream compaction test\n";
+    passed &=
+      RunStreamCompactionSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_COLUMNAR_CODEC)
+    // run the columnar codec example system
+    // see 'ColumnarCodecTest.hpp'
+    std::cout << "Running columnar codec test\n";
+    passed &=
+      RunColumnarCodecSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_HYPERLOGLOG)
+    // run the HyperLogLog example system
+    // see 'HyperLogLogTest.hpp'
+    std::cout << "Running HyperLogLog test\n";
+    passed &=
+      RunHyperLogLogSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_SHA256)
+    // run the SHA-256 example system
+    // see 'Sha256Test.hpp'
+    std::cout << "Running SHA-256 test\n";
+    passed &=
+      RunSha256System<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_FFT)
+    // run the FFT example system
+    // see 'FftTest.hpp'
+    std::cout << "Running FFT test\n";
+    passed &=
+      RunFftSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_PACKET_PARSER)
+    // run the packet parser example system
+    // see 'PacketParserTest.hpp'
+    std::cout << "Running packet parser test\n";
+    passed &=
+      RunPacketParserSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_RSS)
+    // run the RSS example system
+    // see 'RssTest.hpp'
+    std::cout << "Running RSS test\n";
+    passed &=
+      RunRssSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_TRAFFIC_SHAPER)
+    // run the traffic shaper example system
+    // see 'TrafficShaperTest.hpp'
+    std::cout << "Running traffic shaper test\n";
+    passed &=
+      RunTrafficShaperSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_FEED_ARBITER)
+    // run the A/B feed arbiter example system
+    // see 'FeedArbiterTest.hpp'
+    std::cout << "Running feed arbiter test\n";
+    passed &=
+      RunFeedArbiterSystem<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+#if defined(ACCELERATOR_LAUNCH_LATENCY)
+    // benchmark the side channel launch paths
+    // see 'LaunchLatencyTest.hpp'
+    std::cout << "Running launch latency benchmark\n";
+    passed &=
+      RunLaunchLatencyBenchmark<IOPipeType, kUseUSMHostAllocation>(q, count);
+#endif
+
+    // report how much of the fake IO pipe memory was reused, and return it
+    // to the runtime. See 'UsmPool.hpp'.
+    UsmPool::Get(q).PrintStats(std::cout);
+    UsmPool::Release(q);
   } catch (exception const &e) {
     // Catches exceptions in the host code
     std::cerr << "Caught a SYCL host exception:\n" << e.what() << "\n";
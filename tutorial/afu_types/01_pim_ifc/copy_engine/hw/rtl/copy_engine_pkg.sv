@@ -46,4 +46,24 @@ package copy_engine_pkg;
         logic [63:0] num_lines_write;
     } t_wr_state;
 
+    // Transforms applied by the data stream engine as lines pass from the
+    // read engine to the write engine. The encoding is visible to software
+    // in CSR 14. XFORM_INVERT is the reset value.
+    typedef enum logic [3:0] {
+        XFORM_INVERT    = 4'h0,     // Invert every bit
+        XFORM_NONE      = 4'h1,     // Pass through unmodified (plain copy)
+        XFORM_BYTE_SWAP = 4'h2,     // Reverse the byte order of each 64 bit word
+        XFORM_XOR_KEY   = 4'h3,     // XOR each 64 bit word with the argument
+        XFORM_CHECKSUM  = 4'h4,     // Replace each line with the sum of its 32 bit words
+        XFORM_EXTRACT32 = 4'h5      // Pack one 32 bit field from each 64 bit word
+    } t_xform_mode;
+
+    // Transform configuration (CSR to data stream engine)
+    typedef struct {
+        t_xform_mode mode;
+        // Mode-specific argument. The XOR key for XFORM_XOR_KEY and the
+        // field's bit offset (arg[5:0]) for XFORM_EXTRACT32.
+        logic [63:0] arg;
+    } t_xform_cfg;
+
 endpackage // copy_engine_pkg
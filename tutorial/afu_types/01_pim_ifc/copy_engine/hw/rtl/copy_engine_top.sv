@@ -44,6 +44,7 @@ module copy_engine_top
     copy_engine_pkg::t_rd_state rd_state;
     copy_engine_pkg::t_wr_cmd wr_cmd;
     copy_engine_pkg::t_wr_state wr_state;
+    copy_engine_pkg::t_xform_cfg xform_cfg;
 
     csr_mgr
       #(
@@ -62,7 +63,9 @@ module copy_engine_top
         .rd_state,
 
         .wr_cmd,
-        .wr_state
+        .wr_state,
+
+        .xform_cfg
         );
 
 
@@ -143,10 +146,10 @@ module copy_engine_top
     //
     // ====================================================================
 
-    // Forward the data stream through a sample data stream engine.
-    // The assumption is that a real algorithm would be doing some
-    // manipulation of the data stream and this demonstrates that
-    // data path.
+    // Forward the data stream through the data stream engine, which
+    // applies the CSR-selected transform to each line. A real algorithm
+    // could replace or extend the engine without changing the
+    // surrounding data path.
     //
 
     // ***
@@ -168,7 +171,8 @@ module copy_engine_top
     data_stream_engine data_engine
        (
         .data_stream_in(data_stream_from_rd),
-        .data_stream_out(data_stream_to_wr)
+        .data_stream_out(data_stream_to_wr),
+        .xform_cfg
         );
 
 
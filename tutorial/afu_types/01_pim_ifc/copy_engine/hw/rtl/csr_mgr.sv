@@ -59,7 +59,12 @@
 //      commands completed to the status line address. Turn status writes ON
 //      by setting bit 0 when writing register 13. Turn status writes OFF and
 //      use interrupts instead by clearing bit 0 in this register.
-//      
+//  14: Data stream transform mode (copy_engine_pkg::t_xform_mode) in [3:0].
+//      The mode may only be changed while no commands are in flight. The
+//      reset value is 0 (invert the data). Readable.
+//  15: Data stream transform argument. The XOR key in mode XFORM_XOR_KEY
+//      and the bit offset of the field in mode XFORM_EXTRACT32. Readable.
+//
 
 
 module csr_mgr
@@ -81,7 +86,10 @@ module csr_mgr
     // Write engine control - initiate a write of num_lines from addr when enable is set.
     // Write data comes from a read. For a given read/write pair, num_lines must match.
     output copy_engine_pkg::t_wr_cmd wr_cmd,
-    input  copy_engine_pkg::t_wr_state wr_state
+    input  copy_engine_pkg::t_wr_state wr_state,
+
+    // Data stream engine configuration
+    output copy_engine_pkg::t_xform_cfg xform_cfg
     );
 
     // Each interface names its associated clock and reset.
@@ -190,7 +198,7 @@ module csr_mgr
             // AXI addresses are always in byte address space. Ignore the
             // low 3 bits to index 64 bit CSRs. Ignore high bits and let the
             // address space wrap.
-            case (mmio64_reg.ar.addr[5:3])
+            case (mmio64_reg.ar.addr[6:3])
               0: // AFU DFH (device feature header)
                 begin
                     // Here we define a trivial feature list.  In this
@@ -233,6 +241,9 @@ module csr_mgr
               6: mmio64_reg.r.data <= rd_state.num_lines_read;
               7: mmio64_reg.r.data <= wr_state.num_lines_write;
 
+              14: mmio64_reg.r.data <= 64'(xform_cfg.mode);
+              15: mmio64_reg.r.data <= xform_cfg.arg;
+
               default: mmio64_reg.r.data <= '0;
             endcase
         end
@@ -375,6 +386,12 @@ module csr_mgr
                     wr_cmd.mem_status_addr <= mmio64_reg.w.data[$bits(wr_cmd.mem_status_addr)-1 : 0];
                     wr_cmd.mem_status_addr[0] <= 1'b0;
                 end
+
+              // Data stream transform mode
+              14: xform_cfg.mode <= copy_engine_pkg::t_xform_mode'(mmio64_reg.w.data[3:0]);
+
+              // Data stream transform argument
+              15: xform_cfg.arg <= mmio64_reg.w.data;
             endcase
         end
  
@@ -386,6 +403,8 @@ module csr_mgr
             wr_cmd.enable <= 1'b0;
             wr_cmd.intr_ack <= 1'b0;
             wr_cmd.use_mem_status <= 1'b0;
+            xform_cfg.mode <= copy_engine_pkg::XFORM_INVERT;
+            xform_cfg.arg <= '0;
         end
     end
 
@@ -4,34 +4,136 @@
 `include "ofs_plat_if.vh"
 
 //
-// Streaming data engine. This could be a module that manipulates the data
-// stream in some way that is useful to the algorithm. It sits here in
-// the data path as an example of connecting the blocks.
+// Streaming data engine. This module manipulates the data stream on its
+// way from the read engine to the write engine, saving software a pass
+// over the data. The transform is selected by CSRs (see csr_mgr.sv and
+// copy_engine_pkg::t_xform_mode).
 //
-// Data arrives in request order.
+// Data arrives in request order. Every input line generates exactly one
+// output line, so the write engine's line counts always match the reads
+// that feed it.
+//
+// The configuration is sampled as each line passes. Software must only
+// change the transform while no copy commands are in flight.
 //
 
 module data_stream_engine
    (
     ofs_plat_axi_stream_if.to_source data_stream_in,
-    ofs_plat_axi_stream_if.to_sink   data_stream_out
+    ofs_plat_axi_stream_if.to_sink   data_stream_out,
+
+    // Transform configuration from the CSR manager
+    input  copy_engine_pkg::t_xform_cfg xform_cfg
     );
 
+    import copy_engine_pkg::*;
+
     wire clk = data_stream_in.clk;
     wire reset_n = data_stream_in.reset_n;
 
+    // The bus is treated as a vector of 64 bit words. For some transforms
+    // it is also viewed as a vector of 32 bit words.
+    localparam NUM_WORDS = ofs_plat_host_chan_pkg::DATA_WIDTH / 64;
+    typedef logic [NUM_WORDS-1 : 0][63:0] t_words;
+    typedef logic [2*NUM_WORDS-1 : 0][31:0] t_dwords;
+
+    t_words in_words;
+    assign in_words = data_stream_in.t.data;
+    t_dwords in_dwords;
+    assign in_dwords = data_stream_in.t.data;
+
+
+    // ====================================================================
     //
-    // Invert the payload as a proxy for doing something useful. Both the
-    // incoming and outgoing streams have standard ready/enable signals.
-    // This function may have any latency as ready/enable are honored.
+    //   Transforms
     //
+    // ====================================================================
+
+    // Reverse the bytes in each 64 bit word
+    t_words swap_words;
+    always_comb
+    begin
+        for (int w = 0; w < NUM_WORDS; w = w + 1)
+        begin
+            for (int b = 0; b < 8; b = b + 1)
+            begin
+                swap_words[w][8*b +: 8] = in_words[w][8*(7-b) +: 8];
+            end
+        end
+    end
+
+    // Sum of all 32 bit words in the line. The result is 64 bits wide, so
+    // it never overflows for any bus width.
+    logic [63:0] line_sum;
+    always_comb
+    begin
+        line_sum = '0;
+        for (int d = 0; d < 2*NUM_WORDS; d = d + 1)
+        begin
+            line_sum = line_sum + 64'(in_dwords[d]);
+        end
+    end
 
-    assign data_stream_in.tready = data_stream_out.tready;
-    assign data_stream_out.tvalid = data_stream_in.tvalid;
+    // Extract 32 bits starting at bit offset arg[5:0] from each 64 bit word.
+    // The fields are packed into the low half of the line. Bits beyond the
+    // end of a word read as zero.
+    t_dwords extract_dwords;
     always_comb
     begin
-        data_stream_out.t = data_stream_in.t;
-        data_stream_out.t.data = ~data_stream_in.t.data;
+        extract_dwords = '0;
+        for (int w = 0; w < NUM_WORDS; w = w + 1)
+        begin
+            extract_dwords[w] = 32'(in_words[w] >> xform_cfg.arg[5:0]);
+        end
+    end
+
+    // Select the transform
+    logic [ofs_plat_host_chan_pkg::DATA_WIDTH-1 : 0] xform_data;
+    always_comb
+    begin
+        xform_data = '0;
+
+        case (xform_cfg.mode)
+          XFORM_NONE: xform_data = data_stream_in.t.data;
+          XFORM_BYTE_SWAP: xform_data = swap_words;
+          XFORM_XOR_KEY: xform_data = data_stream_in.t.data ^ {NUM_WORDS{xform_cfg.arg}};
+          XFORM_CHECKSUM: xform_data[63:0] = line_sum;
+          XFORM_EXTRACT32: xform_data = extract_dwords;
+          default: xform_data = ~data_stream_in.t.data;
+        endcase
+    end
+
+
+    // ====================================================================
+    //
+    //   Output register
+    //
+    // ====================================================================
+
+    //
+    // A single register stage breaks the timing path through the transform
+    // logic. Both the incoming and outgoing streams have standard ready/enable
+    // signals and the register advances whenever it is empty or the sink
+    // is consuming the current value.
+    //
+
+    logic out_valid;
+    assign data_stream_in.tready = !out_valid || data_stream_out.tready;
+    assign data_stream_out.tvalid = out_valid;
+
+    always_ff @(posedge clk)
+    begin
+        if (data_stream_in.tready)
+        begin
+            out_valid <= data_stream_in.tvalid;
+            data_stream_out.t <= data_stream_in.t;
+            data_stream_out.t.data <= xform_data;
+        end
+
+        if (!reset_n)
+        begin
+            out_valid <= 1'b0;
+        end
     end
 
 endmodule // data_stream_engine
@@ -11,6 +11,8 @@
 
 #include <opae/fpga.h>
 
+#include "data_transform.h"
+
 typedef struct
 {
     volatile char *ptr;
@@ -79,6 +81,77 @@ static t_pinned_buffer* alloc_buffer_group(fpga_handle accel_handle,
 }
 
 
+//
+// Fill the first num_bytes of each buffer in a group. Source buffers get
+// a pseudo-random pattern (xorshift64) so that transforms are exercised
+// on varied data. Destination buffers are cleared.
+//
+static void init_buffer_group(t_pinned_buffer* bufs,
+                              uint32_t num_bufs,
+                              uint32_t num_bytes,
+                              bool is_src)
+{
+    uint64_t x = 0x9e3779b97f4a7c15;
+
+    for (uint32_t i = 0; i < num_bufs; i += 1)
+    {
+        volatile uint64_t *p = (volatile uint64_t*)bufs[i].ptr;
+        for (uint32_t w = 0; w < num_bytes / 8; w += 1)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            p[w] = is_src ? x : 0;
+        }
+    }
+}
+
+
+//
+// Compare destination buffers against the software model of the data
+// stream engine applied to the source buffers. Returns the number of
+// mismatched lines.
+//
+static uint64_t check_buffer_group(t_pinned_buffer* src_bufs,
+                                   t_pinned_buffer* dst_bufs,
+                                   uint32_t num_bufs,
+                                   uint32_t num_bytes,
+                                   uint32_t line_bytes,
+                                   t_xform_mode xform_mode,
+                                   uint64_t xform_arg)
+{
+    uint64_t num_errors = 0;
+    uint64_t expected[line_bytes / 8];
+
+    for (uint32_t i = 0; i < num_bufs; i += 1)
+    {
+        for (uint32_t offset = 0; offset < num_bytes; offset += line_bytes)
+        {
+            data_transform_line(xform_mode, xform_arg,
+                                src_bufs[i].ptr + offset, expected, line_bytes);
+
+            const volatile uint64_t *actual = (volatile uint64_t*)(dst_bufs[i].ptr + offset);
+            for (uint32_t w = 0; w < line_bytes / 8; w += 1)
+            {
+                if (actual[w] != expected[w])
+                {
+                    if (num_errors < 10)
+                    {
+                        fprintf(stderr, "  Buffer %d, offset 0x%x, word %d: expected 0x%016lx, found 0x%016lx\n",
+                                i, offset, w, expected[w], actual[w]);
+                    }
+
+                    num_errors += 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    return num_errors;
+}
+
+
 static void free_buffer_group(fpga_handle accel_handle,
                               uint32_t num_bufs,
                               t_pinned_buffer* bufs)
@@ -184,7 +257,9 @@ int copy_engine(
     uint32_t chunk_size,
     uint32_t completion_freq,
     bool use_interrupts,
-    uint32_t max_reqs_in_flight)
+    uint32_t max_reqs_in_flight,
+    t_xform_mode xform_mode,
+    uint64_t xform_arg)
 {
     fpga_result r;
     pthread_t intr_thread = 0;
@@ -268,6 +343,8 @@ int copy_engine(
     printf("  Completion frequency (commands between completions): %d\n", completion_freq);
     printf("  Use interrupts: %s\n", use_interrupts ? "Yes" : "No");
     printf("  Maximum requests in flight: %d\n", max_reqs_in_flight);
+    printf("  Data transform: %s (argument 0x%lx)\n",
+           data_transform_name(xform_mode), xform_arg);
     printf("\n");
 
 
@@ -291,6 +368,20 @@ int copy_engine(
         return -1;
     }
 
+    init_buffer_group(src_bufs, num_bufs, chunk_size, true);
+    init_buffer_group(dst_bufs, num_bufs, chunk_size, false);
+
+    // Configure the data stream engine. No commands are in flight yet.
+    writeMMIO64(14, xform_mode);
+    writeMMIO64(15, xform_arg);
+    if (readMMIO64(14) != xform_mode)
+    {
+        fprintf(stderr, "AFU did not accept data transform mode %d\n", xform_mode);
+        free_buffer_group(accel_handle, num_bufs, src_bufs);
+        free_buffer_group(accel_handle, num_bufs, dst_bufs);
+        return -1;
+    }
+
 
     volatile uint64_t *status_line;
     uint64_t status_wsid = 0;
@@ -431,8 +522,25 @@ int copy_engine(
                rd_lines, wr_lines);
     }
 
+    // Every buffer was the target of at least one copy. Check the transformed
+    // data against the software model.
+    int status = 0;
+    const uint64_t num_errors = check_buffer_group(src_bufs, dst_bufs, num_bufs,
+                                                   chunk_size, data_bus_num_bytes,
+                                                   xform_mode, xform_arg);
+    if (num_errors)
+    {
+        printf("\n*** %ld lines do not match the %s transform model ***\n",
+               num_errors, data_transform_name(xform_mode));
+        status = 1;
+    }
+    else
+    {
+        printf("Transformed data matches the model\n");
+    }
+
     free_buffer_group(accel_handle, num_bufs, src_bufs);
     free_buffer_group(accel_handle, num_bufs, dst_bufs);
 
-    return 0;
+    return status;
 }
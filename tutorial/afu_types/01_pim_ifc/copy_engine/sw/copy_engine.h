@@ -4,11 +4,15 @@
 #ifndef __COPY_ENGINE_H__
 #define __COPY_ENGINE_H__
 
+#include "data_transform.h"
+
 int copy_engine(
     fpga_handle accel_handle, bool is_ase_sim,
     uint32_t chunk_size,
     uint32_t completion_freq,
     bool use_interrupts,
-    uint32_t max_reqs_in_flight);
+    uint32_t max_reqs_in_flight,
+    t_xform_mode xform_mode,
+    uint64_t xform_arg);
 
 #endif // __COPY_ENGINE_H__
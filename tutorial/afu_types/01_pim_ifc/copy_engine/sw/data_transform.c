@@ -0,0 +1,115 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "data_transform.h"
+
+static const char *s_xform_names[XFORM_NUM_MODES] =
+{
+    "invert",
+    "none",
+    "byte-swap",
+    "xor",
+    "checksum",
+    "extract32"
+};
+
+
+const char* data_transform_name(t_xform_mode mode)
+{
+    if ((unsigned)mode >= XFORM_NUM_MODES) return NULL;
+    return s_xform_names[mode];
+}
+
+
+bool data_transform_parse(const char *name, t_xform_mode *mode)
+{
+    for (int i = 0; i < XFORM_NUM_MODES; i += 1)
+    {
+        if (0 == strcasecmp(name, s_xform_names[i]))
+        {
+            *mode = (t_xform_mode)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+//
+// The model works on lines as vectors of little-endian 64 bit words,
+// matching the way the RTL slices the data bus. Host memory is mapped
+// to the bus with byte 0 in bits [7:0].
+//
+void data_transform_line(t_xform_mode mode, uint64_t arg,
+                         const volatile void *src, volatile void *dst,
+                         uint32_t line_bytes)
+{
+    const volatile uint64_t *in = src;
+    volatile uint64_t *out = dst;
+    const uint32_t num_words = line_bytes / 8;
+
+    switch (mode)
+    {
+      case XFORM_NONE:
+        for (uint32_t w = 0; w < num_words; w += 1)
+            out[w] = in[w];
+        break;
+
+      case XFORM_BYTE_SWAP:
+        for (uint32_t w = 0; w < num_words; w += 1)
+            out[w] = __builtin_bswap64(in[w]);
+        break;
+
+      case XFORM_XOR_KEY:
+        for (uint32_t w = 0; w < num_words; w += 1)
+            out[w] = in[w] ^ arg;
+        break;
+
+      case XFORM_CHECKSUM:
+        {
+            // Sum of all 32 bit words, written to the low 64 bits
+            uint64_t sum = 0;
+            for (uint32_t w = 0; w < num_words; w += 1)
+            {
+                sum += (uint32_t)in[w];
+                sum += (uint32_t)(in[w] >> 32);
+            }
+
+            out[0] = sum;
+            for (uint32_t w = 1; w < num_words; w += 1)
+                out[w] = 0;
+        }
+        break;
+
+      case XFORM_EXTRACT32:
+        {
+            // One 32 bit field per 64 bit word, packed into the low half
+            // of the line. Shifts of 64 or more are impossible since the
+            // RTL uses only arg[5:0].
+            const uint32_t shift = arg & 0x3f;
+            uint64_t fields[num_words];
+            for (uint32_t w = 0; w < num_words; w += 1)
+                fields[w] = (uint32_t)(in[w] >> shift);
+
+            for (uint32_t w = 0; w < num_words; w += 1)
+            {
+                uint64_t v = 0;
+                if (2 * w < num_words) v = fields[2 * w];
+                if (2 * w + 1 < num_words) v |= fields[2 * w + 1] << 32;
+                out[w] = v;
+            }
+        }
+        break;
+
+      case XFORM_INVERT:
+      default:
+        for (uint32_t w = 0; w < num_words; w += 1)
+            out[w] = ~in[w];
+        break;
+    }
+}
@@ -0,0 +1,41 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#ifndef __DATA_TRANSFORM_H__
+#define __DATA_TRANSFORM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Transforms applied by the AFU's data stream engine. The values match
+// copy_engine_pkg::t_xform_mode in the RTL and are written to CSR 14.
+//
+typedef enum
+{
+    XFORM_INVERT = 0,
+    XFORM_NONE = 1,
+    XFORM_BYTE_SWAP = 2,
+    XFORM_XOR_KEY = 3,
+    XFORM_CHECKSUM = 4,
+    XFORM_EXTRACT32 = 5,
+
+    XFORM_NUM_MODES
+}
+t_xform_mode;
+
+// Map between modes and the names used on the command line. Returns
+// NULL or false on an unknown mode or name.
+const char* data_transform_name(t_xform_mode mode);
+bool data_transform_parse(const char *name, t_xform_mode *mode);
+
+//
+// Software model of the data stream engine. Transform one bus-width line
+// from src to dst, exactly as the AFU would. line_bytes must be a multiple
+// of 8.
+//
+void data_transform_line(t_xform_mode mode, uint64_t arg,
+                         const volatile void *src, volatile void *dst,
+                         uint32_t line_bytes);
+
+#endif // __DATA_TRANSFORM_H__
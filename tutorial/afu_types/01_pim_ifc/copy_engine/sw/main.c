@@ -22,6 +22,8 @@ static uint32_t chunk_size = 8192;
 static uint32_t completion_freq = 32;
 static uint32_t max_reqs_in_flight = 0;
 static bool use_interrupts = false;
+static t_xform_mode xform_mode = XFORM_INVERT;
+static uint64_t xform_arg = 0;
 
 
 //
@@ -35,6 +37,7 @@ help(void)
            "    copy_engine [-h] [--chunk-size=<num bytes>]\n"
            "                     [--completion-freq=<commands per completion>]\n"
            "                     [--interrupts]\n"
+           "                     [--transform=<mode>] [--xform-arg=<value>]\n"
            "\n"
            "      -h,--help             Print this help\n"
            "\n"
@@ -48,6 +51,11 @@ help(void)
            "                            When not set, completion is signaled by a write\n"
            "                            to host memory.\n"
            "      -m,--max-reqs         Maximum number of commands in flight.\n"
+           "      -t,--transform        Transform applied to data on its way through\n"
+           "                            the FPGA: invert, none, byte-swap, xor,\n"
+           "                            checksum or extract32. (Default: invert)\n"
+           "      -a,--xform-arg        Transform argument: the 64 bit key for xor or\n"
+           "                            the field's bit offset for extract32.\n"
            "\n");
 }
 
@@ -55,7 +63,7 @@ help(void)
 //
 // Parse command line arguments
 //
-#define GETOPT_STRING ":hc:f:im:"
+#define GETOPT_STRING ":hc:f:im:t:a:"
 static int
 parse_args(int argc, char *argv[])
 {
@@ -65,6 +73,8 @@ parse_args(int argc, char *argv[])
         {"completion-freq", required_argument, NULL, 'f'},
         {"interrupts",      no_argument,       NULL, 'i'},
         {"max-reqs",        required_argument, NULL, 'm'},
+        {"transform",       required_argument, NULL, 't'},
+        {"xform-arg",       required_argument, NULL, 'a'},
         {0, 0, 0, 0}
     };
 
@@ -125,6 +135,22 @@ parse_args(int argc, char *argv[])
             }
             break;
 
+        case 't': /* transform */
+            if (!data_transform_parse(tmp_optarg, &xform_mode)) {
+                fprintf(stderr, "Invalid transform: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 'a': /* xform-arg */
+            endptr = NULL;
+            xform_arg = strtoull(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "Invalid transform argument: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
         case ':': /* missing option argument */
             fprintf(stderr, "Missing option argument. Use --help.\n");
             return -1;
@@ -224,7 +250,7 @@ int main(int argc, char *argv[])
     int status = 0;
     status = copy_engine(accel_handle, is_ase_sim,
                          chunk_size, completion_freq, use_interrupts,
-                         max_reqs_in_flight);
+                         max_reqs_in_flight, xform_mode, xform_arg);
 
     // Done
     fpgaClose(accel_handle);
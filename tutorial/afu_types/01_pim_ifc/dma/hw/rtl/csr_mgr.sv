@@ -15,6 +15,16 @@
 //
 // Read registers (64 bits, byte address is offset * 8):
 //
+// The indexed CSRs are listed in dma_pkg. In addition, a 4KB window of card
+// DDR is mapped at byte address 0x1000 (DMA_MEM_WINDOW_MEM_ADDR). The DDR
+// address of the window is set by writing the window base register at byte
+// address 0x200 (DMA_MEM_WINDOW_CNTL_ADDR). The low 12 bits of the base are
+// ignored. Window reads and writes are forwarded to DDR as 64 bit accesses
+// by dma_mem_window and reads are answered when DDR responds. A window
+// access is held until the DMA engine is idle, so an access issued while
+// a transfer is running stalls until the transfer completes. A long stall
+// can exceed the host's MMIO timeout.
+//
 
 import dma_pkg::*;
 
@@ -24,7 +34,14 @@ module csr_mgr #(
     ofs_plat_axi_mem_lite_if.to_source mmio64_to_afu,
 
     input  t_dma_csr_status dma_csr_status, //status    
-    output t_dma_csr_map    dma_csr_map   //control, descriptor, etc
+    output t_dma_csr_map    dma_csr_map,  //control, descriptor, etc
+
+    // DDR memory window requests and read responses
+    output logic                mem_window_req_valid,
+    input  logic                mem_window_req_ready,
+    output t_dma_mem_window_req mem_window_req,
+    input  logic                mem_window_rsp_valid,
+    input  logic [63:0]         mem_window_rsp_data
 );
     // Each interface names its associated clock and reset.
     logic clk;
@@ -126,15 +143,41 @@ module csr_mgr #(
         `OFS_PLAT_AXI_MEM_LITE_IF_REPLICATE_PARAMS(mmio64_to_afu)
     ) mmio64_reg();
 
+    // Addresses in the DDR memory window and the window base register.
+    // Like the indexed CSRs, high address bits are ignored.
+    logic ar_is_window, ar_is_window_cntl;
+    assign ar_is_window = mmio64_reg.ar.addr[DMA_MEM_WINDOW_SPAN_W];
+    assign ar_is_window_cntl = (mmio64_reg.ar.addr[DMA_MEM_WINDOW_SPAN_W : 3] ==
+                                (DMA_MEM_WINDOW_CNTL_ADDR >> 3));
+
+    logic aw_is_window, aw_is_window_cntl;
+    assign aw_is_window = mmio64_reg.aw.addr[DMA_MEM_WINDOW_SPAN_W];
+    assign aw_is_window_cntl = (mmio64_reg.aw.addr[DMA_MEM_WINDOW_SPAN_W : 3] ==
+                                (DMA_MEM_WINDOW_CNTL_ADDR >> 3));
+
+    // DDR address of the memory window
+    logic [DDR_ADDR_W-1 : DMA_MEM_WINDOW_SPAN_W] mem_window_base;
+
     // Is a CSR read request active this cycle? The test is simple because
     // the mmio64_reg.arvalid can only be set when the read response fifo
-    // is empty.
+    // is empty. Reads from the memory window are forwarded to DDR and
+    // complete when mem_window_rsp_valid is set.
     logic is_csr_read;
-    assign is_csr_read = mmio64_reg.arvalid;
+    assign is_csr_read = mmio64_reg.arvalid && !ar_is_window;
+
+    logic is_window_read;
+    assign is_window_read = mmio64_reg.arvalid && ar_is_window;
+    logic window_read_sent;
+
+    // Is a CSR write request active this cycle? Writes to the memory window
+    // complete once they are accepted by the window.
+    logic is_window_write;
+    assign is_window_write = mmio64_reg.awvalid && mmio64_reg.wvalid &&
+                             aw_is_window;
 
-    // Is a CSR write request active this cycle?
     logic is_csr_write;
-    assign is_csr_write = mmio64_reg.awvalid && mmio64_reg.wvalid;
+    assign is_csr_write = mmio64_reg.awvalid && mmio64_reg.wvalid &&
+                          (!aw_is_window || mem_window_req_ready);
 
 
     //
@@ -145,7 +188,7 @@ module csr_mgr #(
     assign mmio64_to_afu.arready = !mmio64_reg.arvalid && !mmio64_reg.rvalid;
 
     always_ff @(posedge clk) begin
-        if (is_csr_read) begin
+        if (is_csr_read || mem_window_rsp_valid) begin
             // Current read request was handled
             mmio64_reg.arvalid <= 1'b0;
         end
@@ -180,6 +223,9 @@ module csr_mgr #(
             // AXI addresses are always in byte address space. Ignore the
             // low 3 bits to index 64 bit CSRs. Ignore high bits and let the
             // address space wrap.
+            if (ar_is_window_cntl)
+              mmio64_reg.r.data <= 64'({ mem_window_base, DMA_MEM_WINDOW_SPAN_W'(0) });
+            else
             case (mmio64_reg.ar.addr[7:3])
               DMA_DFH:                 mmio64_reg.r.data <= dma_csr_map.header.dfh;
               DMA_GUID_L:              mmio64_reg.r.data <= dma_csr_map.header.guid_l;
@@ -204,6 +250,14 @@ module csr_mgr #(
               DMA_WR_DEST_PERF_CNTR:   mmio64_reg.r.data <= dma_csr_map.status.wr_dest_perf_cntr;
             endcase
 
+        end else if (mem_window_rsp_valid) begin
+            // Memory window read response from DDR
+            mmio64_reg.rvalid <= 1'b1;
+
+            mmio64_reg.r <= '0;
+            mmio64_reg.r.id <= mmio64_reg.ar.id;
+            mmio64_reg.r.user <= mmio64_reg.ar.user;
+            mmio64_reg.r.data <= mem_window_rsp_data;
         end else if (mmio64_to_afu.rready) begin
             // If a read response was pending, it completed
             mmio64_reg.rvalid <= 1'b0;
@@ -219,6 +273,35 @@ module csr_mgr #(
     end
 
 
+    //
+    // Forward memory window accesses to DDR. Only one read is outstanding
+    // since the next MMIO read isn't accepted until the current one is
+    // answered. Writes are posted and take priority over a waiting read.
+    //
+    assign mem_window_req_valid = is_window_write || (is_window_read && !window_read_sent);
+
+    always_comb begin
+        mem_window_req.is_write = is_window_write;
+        mem_window_req.addr = is_window_write ?
+                                { mem_window_base, mmio64_reg.aw.addr[DMA_MEM_WINDOW_SPAN_W-1 : 3], 3'b0 } :
+                                { mem_window_base, mmio64_reg.ar.addr[DMA_MEM_WINDOW_SPAN_W-1 : 3], 3'b0 };
+        mem_window_req.data = mmio64_reg.w.data;
+    end
+
+    always_ff @(posedge clk) begin
+        if (mem_window_rsp_valid) begin
+            window_read_sent <= 1'b0;
+        end
+        else if (mem_window_req_valid && mem_window_req_ready && !is_window_write) begin
+            window_read_sent <= 1'b1;
+        end
+
+        if (!reset_n) begin
+            window_read_sent <= 1'b0;
+        end
+    end
+
+
     //
     // CSR write handling.  Host software must tell the AFU the memory address
     // to which it should be writing.  The address is set by writing a CSR.
@@ -289,7 +372,10 @@ module csr_mgr #(
             dma_csr_map.descriptor.descriptor_control.go <= 'b0;
         end
 
-        if (is_csr_write) begin
+        if (is_csr_write && aw_is_window_cntl) begin
+            mem_window_base <= mmio64_reg.w.data[DDR_ADDR_W-1 : DMA_MEM_WINDOW_SPAN_W];
+        end
+        else if (is_csr_write && !aw_is_window) begin
             // AXI addresses are always in byte address space. Ignore the
             // low 3 bits to index 64 bit CSRs. Ignore high bits and let the
             // address space wrap.
@@ -309,6 +395,7 @@ module csr_mgr #(
             dma_csr_map.descriptor.length             <= 'b0;
             dma_csr_map.descriptor.descriptor_control <= 'b0;
             dma_csr_map.control                       <= 'b0;
+            mem_window_base                           <= 'b0;
         end
     end
 
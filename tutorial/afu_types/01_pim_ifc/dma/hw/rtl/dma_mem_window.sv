@@ -0,0 +1,195 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+`include "ofs_plat_if.vh"
+
+//
+// DDR memory window (address span extender). Single 64 bit MMIO reads and
+// writes from the CSR manager are turned into one line AXI-MM requests to
+// local memory, giving software cheap access to small amounts of card
+// state without setting up a DMA descriptor.
+//
+// The window shares the DDR port with the DMA engine. A window request is
+// only started while the engine is idle and the engine's DDR port is
+// stalled until the window access completes. Only one window access is
+// in flight at a time.
+//
+
+module dma_mem_window (
+    input  logic clk,
+    input  logic reset_n,
+
+    // Requests from the CSR manager
+    input  logic                         req_valid,
+    output logic                         req_ready,
+    input  dma_pkg::t_dma_mem_window_req req,
+
+    // Read responses to the CSR manager
+    output logic                         rsp_valid,
+    output logic [63:0]                  rsp_data,
+
+    // The DMA engine has no active or pending descriptors
+    input  logic                         engine_idle,
+
+    // Set while the window owns the DDR port. The DDR bank selector must
+    // follow window_descriptor instead of the engine's descriptor.
+    output logic                         window_active,
+    output dma_pkg::t_dma_descriptor     window_descriptor,
+
+    // DDR port from the DMA engine's AXI-MM mux
+    ofs_plat_axi_mem_if.to_source engine_ddr_mem,
+    // DDR port to the bank selector
+    ofs_plat_axi_mem_if.to_sink ddr_mem
+);
+
+    import dma_pkg::*;
+
+    localparam NUM_WORDS = DDR_DATA_W / 64;
+    localparam WORD_IDX_W = $clog2(NUM_WORDS);
+
+    typedef enum logic [1:0] {
+        STATE_IDLE,
+        STATE_REQ,
+        STATE_RSP
+    } t_state;
+
+    t_state state;
+    t_dma_mem_window_req cur_req;
+    logic ar_sent, aw_sent, w_sent;
+
+    // Index of the 64 bit word within the DDR line
+    logic [WORD_IDX_W-1 : 0] word_idx;
+    assign word_idx = cur_req.addr[3 +: WORD_IDX_W];
+
+    // Line-aligned DDR address of the request
+    logic [DDR_ADDR_W-1 : 0] line_addr;
+    assign line_addr = { cur_req.addr[DDR_ADDR_W-1 : ddr_mem.ADDR_BYTE_IDX_WIDTH],
+                         ddr_mem.ADDR_BYTE_IDX_WIDTH'(0) };
+
+    assign req_ready = (state == STATE_IDLE) && engine_idle;
+    assign window_active = (state != STATE_IDLE);
+
+    // The bank selector decodes the DDR address of a descriptor. Present
+    // the window address as a single line descriptor in the matching mode.
+    always_comb begin
+        window_descriptor = '0;
+        window_descriptor.descriptor_control.mode = cur_req.is_write ? HOST_TO_DDR : DDR_TO_HOST;
+        window_descriptor.src_addr = cur_req.addr;
+        window_descriptor.dest_addr = cur_req.addr;
+        window_descriptor.length = 1;
+    end
+
+    always_ff @(posedge clk) begin
+        case (state)
+          STATE_IDLE:
+            begin
+                ar_sent <= 1'b0;
+                aw_sent <= 1'b0;
+                w_sent <= 1'b0;
+
+                if (req_valid && req_ready) begin
+                    cur_req <= req;
+                    state <= STATE_REQ;
+                end
+            end
+
+          STATE_REQ:
+            begin
+                if (ddr_mem.arvalid && ddr_mem.arready) ar_sent <= 1'b1;
+                if (ddr_mem.awvalid && ddr_mem.awready) aw_sent <= 1'b1;
+                if (ddr_mem.wvalid && ddr_mem.wready) w_sent <= 1'b1;
+
+                if (cur_req.is_write ?
+                       ((aw_sent || ddr_mem.awready) && (w_sent || ddr_mem.wready)) :
+                       ddr_mem.arready) begin
+                    state <= STATE_RSP;
+                end
+            end
+
+          STATE_RSP:
+            begin
+                if (cur_req.is_write ? ddr_mem.bvalid : ddr_mem.rvalid) begin
+                    state <= STATE_IDLE;
+                end
+            end
+
+          default:
+            state <= STATE_IDLE;
+        endcase
+
+        if (!reset_n) begin
+            state <= STATE_IDLE;
+        end
+    end
+
+    // Return the addressed word of the line along with the read response
+    always_ff @(posedge clk) begin
+        rsp_valid <= (state == STATE_RSP) && !cur_req.is_write && ddr_mem.rvalid;
+        rsp_data <= ddr_mem.r.data[64 * word_idx +: 64];
+
+        if (!reset_n) begin
+            rsp_valid <= 1'b0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   DDR port multiplexing
+    //
+    // ====================================================================
+
+    always_comb begin
+        if (!window_active) begin
+            ddr_mem.arvalid = engine_ddr_mem.arvalid;
+            ddr_mem.ar = engine_ddr_mem.ar;
+            ddr_mem.rready = engine_ddr_mem.rready;
+            ddr_mem.awvalid = engine_ddr_mem.awvalid;
+            ddr_mem.aw = engine_ddr_mem.aw;
+            ddr_mem.wvalid = engine_ddr_mem.wvalid;
+            ddr_mem.w = engine_ddr_mem.w;
+            ddr_mem.bready = engine_ddr_mem.bready;
+        end
+        else begin
+            ddr_mem.arvalid = (state == STATE_REQ) && !cur_req.is_write && !ar_sent;
+            ddr_mem.ar = '0;
+            ddr_mem.ar.addr = line_addr;
+            ddr_mem.ar.size = ddr_mem.ADDR_BYTE_IDX_WIDTH;
+            ddr_mem.ar.burst = BURST_INCR;
+            ddr_mem.rready = 1'b1;
+
+            ddr_mem.awvalid = (state == STATE_REQ) && cur_req.is_write && !aw_sent;
+            ddr_mem.aw = '0;
+            ddr_mem.aw.addr = line_addr;
+            ddr_mem.aw.size = ddr_mem.ADDR_BYTE_IDX_WIDTH;
+            ddr_mem.aw.burst = BURST_INCR;
+
+            // Only the addressed word is written
+            ddr_mem.wvalid = (state == STATE_REQ) && cur_req.is_write && !w_sent;
+            ddr_mem.w = '0;
+            ddr_mem.w.data = { NUM_WORDS{cur_req.data} };
+            ddr_mem.w.strb[8 * word_idx +: 8] = 8'hff;
+            ddr_mem.w.last = 1'b1;
+            ddr_mem.bready = 1'b1;
+        end
+
+        // The engine sees no traffic while the window owns the port
+        engine_ddr_mem.arready = ddr_mem.arready && !window_active;
+        engine_ddr_mem.rvalid = ddr_mem.rvalid && !window_active;
+        engine_ddr_mem.r = ddr_mem.r;
+        engine_ddr_mem.awready = ddr_mem.awready && !window_active;
+        engine_ddr_mem.wready = ddr_mem.wready && !window_active;
+        engine_ddr_mem.bvalid = ddr_mem.bvalid && !window_active;
+        engine_ddr_mem.b = ddr_mem.b;
+    end
+
+    // synthesis translate_off
+    always_ff @(posedge clk) begin
+        if (req_valid && req_ready && reset_n) begin
+            $display("DMA_MEM_WINDOW: %0s addr 0x%0h",
+                     (req.is_write ? "Write" : "Read"), req.addr);
+        end
+    end
+    // synthesis translate_on
+
+endmodule : dma_mem_window
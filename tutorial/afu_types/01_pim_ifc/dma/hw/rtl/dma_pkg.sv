@@ -70,6 +70,19 @@ package dma_pkg;
 
     localparam DMA_CSR_REG_W  = 64;
     localparam DMA_CSR_USED_W = 32;
+
+    // =========================================================================
+    //
+    // DDR memory window (address span extender). A 4KB window of card DDR
+    // is mapped into MMIO space. The window base CSR selects the DDR
+    // address of the window. It lives outside the indexed CSRs above.
+    //
+    // =========================================================================
+
+    localparam DMA_MEM_WINDOW_CNTL_ADDR = 'h200;   // R/W, byte address
+    localparam DMA_MEM_WINDOW_MEM_ADDR  = 'h1000;  // R/W, byte address
+    localparam DMA_MEM_WINDOW_SPAN      = 4096;
+    localparam DMA_MEM_WINDOW_SPAN_W    = $clog2(DMA_MEM_WINDOW_SPAN);
     
     // =========================================================================
     //
@@ -255,4 +268,11 @@ package dma_pkg;
       t_dma_csr_info             info;
     } t_dma_csr_map;
 
+    // 64 bit access to DDR through the memory window
+    typedef struct packed {
+      logic                  is_write;
+      logic [DDR_ADDR_W-1:0] addr;      // Byte address, 8 byte aligned
+      logic [63:0]           data;
+    } t_dma_mem_window_req;
+
 endpackage : dma_pkg
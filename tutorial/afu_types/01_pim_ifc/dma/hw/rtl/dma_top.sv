@@ -33,6 +33,8 @@ module dma_top #(
     assign src_mem.reset_n = reset_n; 
     assign dest_mem.clk = clk; 
     assign dest_mem.reset_n = reset_n; 
+    assign engine_ddr_mem.clk = clk;
+    assign engine_ddr_mem.reset_n = reset_n;
 
     // ====================================================================
     //
@@ -82,11 +84,22 @@ module dma_top #(
      end
 
 
+    logic mem_window_req_valid;
+    logic mem_window_req_ready;
+    dma_pkg::t_dma_mem_window_req mem_window_req;
+    logic mem_window_rsp_valid;
+    logic [63:0] mem_window_rsp_data;
+
     csr_mgr #(
     ) csr_mgr_inst (
         .mmio64_to_afu,
         .dma_csr_map,
-        .dma_csr_status
+        .dma_csr_status,
+        .mem_window_req_valid,
+        .mem_window_req_ready,
+        .mem_window_req,
+        .mem_window_rsp_valid,
+        .mem_window_rsp_data
     );
 
     ofs_plat_prim_fifo_bram #(
@@ -133,15 +146,40 @@ module dma_top #(
       `LOCAL_MEM_AXI_MEM_PARAMS_DEFAULT
     ) selected_ddr_mem();
 
+    // DDR port of the engine, before the memory window
+    ofs_plat_axi_mem_if #(
+      `LOCAL_MEM_AXI_MEM_PARAMS_DEFAULT
+    ) engine_ddr_mem();
+
+    logic mem_window_active;
+    dma_pkg::t_dma_descriptor mem_window_descriptor;
+
     dma_ddr_selector #(
         .NUM_LOCAL_MEM_BANKS (NUM_LOCAL_MEM_BANKS),
         .ADDR_WIDTH(dma_pkg::SRC_ADDR_W) // SRC_ADDR_W := DEST_ADDR_W
     ) ddr_selector (
-        .descriptor(dma_descriptor),
+        .descriptor(mem_window_active ? mem_window_descriptor : dma_descriptor),
         .selected_ddr_mem,
         .ddr_mem
      );
 
+    // The DDR memory window (MMIO access to local memory) shares the
+    // engine's DDR port.
+    dma_mem_window mem_window (
+        .clk,
+        .reset_n,
+        .req_valid(mem_window_req_valid),
+        .req_ready(mem_window_req_ready),
+        .req(mem_window_req),
+        .rsp_valid(mem_window_rsp_valid),
+        .rsp_data(mem_window_rsp_data),
+        .engine_idle(!dma_csr_status.busy && !descriptor_fifo_not_empty),
+        .window_active(mem_window_active),
+        .window_descriptor(mem_window_descriptor),
+        .engine_ddr_mem,
+        .ddr_mem(selected_ddr_mem)
+    );
+
     dma_axi_mm_mux #(
     ) dma_axi_mm_mux (
         .clk,
@@ -150,7 +188,7 @@ module dma_top #(
         .src_mem,
         .dest_mem,
         .host_mem,
-        .ddr_mem(selected_ddr_mem)
+        .ddr_mem(engine_ddr_mem)
     );
     // ====================================================================
     //
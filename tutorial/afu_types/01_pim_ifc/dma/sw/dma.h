@@ -38,14 +38,14 @@
 #define DMA_BURST_SIZE_BYTES 8*8
 #define DMA_BURST_SIZE_WORDS 8
 
-//#define ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_CNTL_BASE 0x200
+#define ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_CNTL_BASE 0x200
 
 #define DMA_MEM_WINDOW_SPAN (4*1024)
 #define DMA_MEM_WINDOW_SPAN_MASK ((uint64_t)(DMA_MEM_WINDOW_SPAN-1))
 
 
 #define ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_WINDOWED_SLAVE_BASE 0x1000
-#define MEM_WINDOW_MEM(dfh) (ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_WINDOWED_SLAVE_BASE+dfh)
+#define MEM_WINDOW_MEM(dfh) (ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_WINDOWED_SLAVE_BASE+(dfh))
 
 #define DMA_FPGA_MEM_BANK_SIZE (4L * 1024 * 1024 * 1024) // 4GB
 #define DMA_FPGA_MEM_BANK_ADDR_MASK 0xFFFFFFFF 
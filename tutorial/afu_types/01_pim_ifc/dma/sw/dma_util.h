@@ -38,6 +38,12 @@ void dma_transfer(fpga_handle accel_handle,
                   int len,
                   bool verbose);
 
+void dma_transfer_quiet(fpga_handle accel_handle,
+                        e_dma_mode mode,
+                        uint64_t src,
+                        uint64_t dest,
+                        int len);
+
 volatile void* alloc_io_shared_buffer(fpga_handle accel_handle,
                                    ssize_t size,
                                    uint64_t *wsid,
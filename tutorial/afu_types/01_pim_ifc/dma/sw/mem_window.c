@@ -0,0 +1,142 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <opae/fpga.h>
+#include "dma.h"
+#include "dma_util.h"
+#include "mem_window.h"
+
+#define MEM_WINDOW_BASE_UNKNOWN (~(uint64_t)0)
+
+static inline uint64_t window_base(uint64_t ddr_addr) {
+  return ddr_addr & ~DMA_MEM_WINDOW_SPAN_MASK;
+}
+
+static inline uint64_t readMMIO64(mem_window_t *w, uint64_t offset) {
+  if (w->mmio_buf) {
+    return w->mmio_buf[offset / 8];
+  } else {
+    fpga_result r;
+    uint64_t v;
+    r = fpgaReadMMIO64(w->accel_handle, 0, offset, &v);
+    assert(FPGA_OK == r);
+    return v;
+  }
+}
+
+static inline void writeMMIO64(mem_window_t *w, uint64_t offset, uint64_t v) {
+  if (w->mmio_buf) {
+    w->mmio_buf[offset / 8] = v;
+  } else {
+    fpgaWriteMMIO64(w->accel_handle, 0, offset, v);
+  }
+}
+
+// Point the window at the window holding ddr_addr and return the MMIO
+// offset of ddr_addr. The base register is only written when the window
+// moves.
+static uint64_t window_seek(mem_window_t *w, uint64_t ddr_addr) {
+  const uint64_t base = window_base(ddr_addr);
+
+  if (base != w->base) {
+    writeMMIO64(w, ACL_DMA_INST_ADDRESS_SPAN_EXTENDER_0_CNTL_BASE, base);
+    w->base = base;
+    w->num_base_writes += 1;
+  }
+
+  return MEM_WINDOW_MEM(ddr_addr & DMA_MEM_WINDOW_SPAN_MASK);
+}
+
+void mem_window_init(mem_window_t *w, fpga_handle accel_handle,
+                     volatile uint64_t *mmio_buf, volatile void *dma_buf,
+                     uint64_t dma_buf_iova, size_t dma_buf_size) {
+  memset(w, 0, sizeof(*w));
+  w->accel_handle = accel_handle;
+  w->mmio_buf = mmio_buf;
+  w->base = MEM_WINDOW_BASE_UNKNOWN;
+  w->dma_buf = (volatile uint8_t *)dma_buf;
+  w->dma_buf_iova = dma_buf_iova;
+  w->dma_buf_size = dma_buf ? dma_buf_size : 0;
+  w->dma_threshold = MEM_WINDOW_DMA_THRESHOLD;
+}
+
+void mem_window_invalidate(mem_window_t *w) {
+  w->base = MEM_WINDOW_BASE_UNKNOWN;
+}
+
+uint64_t mem_window_read64(mem_window_t *w, uint64_t ddr_addr) {
+  assert(ddr_addr % 8 == 0);
+
+  w->num_mmio_reads += 1;
+  return readMMIO64(w, window_seek(w, ddr_addr));
+}
+
+void mem_window_write64(mem_window_t *w, uint64_t ddr_addr, uint64_t value) {
+  assert(ddr_addr % 8 == 0);
+
+  w->num_mmio_writes += 1;
+  writeMMIO64(w, window_seek(w, ddr_addr), value);
+}
+
+void mem_window_read(mem_window_t *w, uint64_t ddr_addr, void *dst,
+                     size_t bytes) {
+  assert(ddr_addr % 8 == 0);
+  assert(bytes % 8 == 0);
+
+  // DMA moves whole lines. Round the region out to line boundaries.
+  const uint64_t line_addr = ddr_addr & ~(uint64_t)(DMA_LINE_SIZE - 1);
+  const size_t line_bytes =
+      ((ddr_addr + bytes - line_addr + DMA_LINE_SIZE - 1) / DMA_LINE_SIZE) *
+      DMA_LINE_SIZE;
+
+  if ((bytes >= w->dma_threshold) && (line_bytes <= w->dma_buf_size)) {
+    w->num_dma_reads += 1;
+    dma_transfer_quiet(w->accel_handle, ddr_to_host, line_addr,
+                       w->dma_buf_iova | DMA_HOST_MASK,
+                       line_bytes / DMA_LINE_SIZE);
+    memcpy(dst, (const void *)(w->dma_buf + (ddr_addr - line_addr)), bytes);
+    return;
+  }
+
+  uint64_t *dst_words = (uint64_t *)dst;
+  for (size_t i = 0; i < bytes / 8; i++) {
+    dst_words[i] = mem_window_read64(w, ddr_addr + 8 * i);
+  }
+}
+
+typedef struct {
+  uint64_t addr;
+  size_t idx;
+} gather_entry_t;
+
+static int cmp_gather_entry(const void *a, const void *b) {
+  const uint64_t addr_a = ((const gather_entry_t *)a)->addr;
+  const uint64_t addr_b = ((const gather_entry_t *)b)->addr;
+  return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+void mem_window_gather64(mem_window_t *w, const uint64_t *ddr_addrs,
+                         uint64_t *values, size_t n) {
+  gather_entry_t *entries = malloc(n * sizeof(gather_entry_t));
+  assert(entries || (n == 0));
+
+  // Sorting by address groups accesses to the same window, so the window
+  // base is written at most once per window touched.
+  for (size_t i = 0; i < n; i++) {
+    entries[i].addr = ddr_addrs[i];
+    entries[i].idx = i;
+  }
+  qsort(entries, n, sizeof(gather_entry_t), cmp_gather_entry);
+
+  for (size_t i = 0; i < n; i++) {
+    values[entries[i].idx] = mem_window_read64(w, entries[i].addr);
+  }
+
+  free(entries);
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Access to card DDR through the AFU's MMIO memory window (address span
+// extender). A 4KB window of DDR is visible at MEM_WINDOW_MEM(0) in MMIO
+// space and the DDR address of the window is set by writing the window
+// base register. Small reads go through the window, avoiding the cost of
+// a DMA descriptor. Larger reads use DMA to a host bounce buffer.
+//
+// The window shares the DDR port with the DMA engine. The AFU holds a
+// window access until the engine is idle, so an access issued while a
+// transfer is running stalls until the transfer completes. A long stall
+// can exceed the host's MMIO timeout, so avoid window accesses while a
+// large transfer is running.
+//
+
+#ifndef __MEM_WINDOW_H__
+#define __MEM_WINDOW_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <opae/fpga.h>
+
+// Reads of at least this many bytes use DMA by default. An MMIO read
+// round trip costs about as much as a few hundred bytes of DMA once the
+// descriptor setup and completion polling are included.
+#define MEM_WINDOW_DMA_THRESHOLD 512
+
+typedef struct {
+  fpga_handle accel_handle;
+  // Direct pointer to MMIO space or NULL to use OPAE calls (e.g. in ASE)
+  volatile uint64_t *mmio_buf;
+
+  // DDR address of the current window, cached to avoid rewriting the
+  // window base register. ~0 when unknown.
+  uint64_t base;
+
+  // Host bounce buffer for DMA reads
+  volatile uint8_t *dma_buf;
+  uint64_t dma_buf_iova;
+  size_t dma_buf_size;
+
+  // Reads of at least dma_threshold bytes use DMA
+  size_t dma_threshold;
+
+  // Statistics
+  uint64_t num_base_writes;
+  uint64_t num_mmio_reads;
+  uint64_t num_mmio_writes;
+  uint64_t num_dma_reads;
+} mem_window_t;
+
+// dma_buf may be NULL, in which case all reads use the window.
+void mem_window_init(mem_window_t *w,
+                     fpga_handle accel_handle,
+                     volatile uint64_t *mmio_buf,
+                     volatile void *dma_buf,
+                     uint64_t dma_buf_iova,
+                     size_t dma_buf_size);
+
+// The cached window base is forgotten. Call this if anything else may
+// have moved the window.
+void mem_window_invalidate(mem_window_t *w);
+
+// Single 64 bit accesses. ddr_addr must be 8 byte aligned.
+uint64_t mem_window_read64(mem_window_t *w, uint64_t ddr_addr);
+void mem_window_write64(mem_window_t *w, uint64_t ddr_addr, uint64_t value);
+
+// Read a contiguous region. Regions smaller than dma_threshold are read
+// through the window and larger ones with DMA. ddr_addr and bytes must be
+// multiples of 8.
+void mem_window_read(mem_window_t *w, uint64_t ddr_addr, void *dst, size_t bytes);
+
+// Read n scattered 64 bit words. Accesses are grouped by window so that
+// the window base is written once per window touched instead of whenever
+// consecutive addresses fall in different windows. Results are returned
+// in the order of ddr_addrs.
+void mem_window_gather64(mem_window_t *w, const uint64_t *ddr_addrs,
+                         uint64_t *values, size_t n);
+
+#endif // __MEM_WINDOW_H__
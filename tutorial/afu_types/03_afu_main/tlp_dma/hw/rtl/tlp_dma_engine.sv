@@ -0,0 +1,854 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// A pipelined DMA engine implemented directly on PCIe SS TLP encoded AXI
+// streams, using power user (PU) encoding. Unlike hello_world_tlp, the
+// engine streams at full bus rate:
+//
+//  - Read requests (MRd) are sent on TX B, one per cycle, with up to
+//    NUM_READ_TAGS requests outstanding. Tags are assigned in issue order
+//    and requests retire in issue order, so a tag is simply the low bits
+//    of the request counter.
+//
+//  - Completions arrive on RX A out of order across tags and possibly split
+//    at read completion boundaries. Each completion is realigned to 64 byte
+//    lines and written to a reassembly buffer slot owned by its tag. Slots
+//    are drained in request order into an order-sensitive checksum that
+//    software compares against the same computation on the source buffer.
+//
+//  - Writes (MWr) are sent on TX A with a payload of up to MAX_WR_LINES
+//    lines, typically the system's max payload size. The payload is a
+//    pattern derived from the address so that software can check it.
+//    MMIO read completions share TX A and are inserted between write TLPs.
+//
+// The engine measures raw TLP throughput. The read and write streams are
+// independent. Replacing the checksum and the pattern generator with real
+// data sources and sinks is left to an application.
+//
+// The implementation assumes a 512 bit TLP stream in which every TLP
+// starts at the beginning of a beat, with the 32 byte PU header in the
+// low half of the first beat. Read requests and write payloads are
+// multiples of 64 bytes and naturally aligned, so completions are split
+// only at 64 byte boundaries.
+//
+
+//
+// CSRs (64 bits, byte address is offset * 8). Only 64 bit accesses are
+// supported.
+//
+// Read registers:
+//
+//   0: Device feature header (DFH)
+//   1: AFU_ID_L
+//   2: AFU_ID_H
+//   3: DFH_RSVD0
+//   4: DFH_RSVD1
+//   5: Engine properties
+//        [63:48] Number of read tags
+//        [47:40] Maximum lines per read request
+//        [39:32] Maximum lines per write TLP
+//        [23:16] Data bus width (bytes)
+//        [15: 0] Clock frequency (MHz)
+//   6: Status
+//        [1] Writes active
+//        [0] Reads active
+//   7: Cycles from the most recent start until both streams finished
+//   8: Number of lines read and retired
+//   9: Number of lines written
+//  10: Read data checksum A: sum of the 64 bit words of all lines read
+//  11: Read data checksum B: sum of checksum A after each line
+//
+// Write registers:
+//
+//  16: Read buffer base address (64 byte aligned)
+//  17: Write buffer base address (64 byte aligned)
+//  18: Buffer address mask. Both buffers are size (mask + 1) bytes, which
+//      must be a power of 2 and a multiple of the request sizes. Requests
+//      wrap around the buffers.
+//  19: Request sizes, in 64 byte lines
+//        [15: 8] Lines per write TLP (1 to MAX_WR_LINES)
+//        [ 7: 0] Lines per read request (1 to MAX_RD_LINES)
+//  20: Number of read requests
+//  21: Number of write TLPs
+//  22: Write pattern seed. The 64 bit word at byte offset N in the write
+//      buffer is written as (seed ^ N).
+//  23: Start. Clears the counters and starts the streams.
+//        [1] Start writes
+//        [0] Start reads
+//
+// All writes are posted on TX A before the MMIO completion of a status
+// read that reports them finished, so PCIe ordering guarantees the data
+// is visible in host memory once software sees writes inactive.
+//
+
+`include "ofs_plat_if.vh"
+`include "afu_json_info.vh"
+
+module tlp_dma_engine
+  #(
+    parameter pcie_ss_hdr_pkg::ReqHdr_pf_num_t PF_ID,
+    parameter pcie_ss_hdr_pkg::ReqHdr_vf_num_t VF_ID,
+    parameter logic VF_ACTIVE,
+
+    // Maximum number of read requests in flight. Must be a power of 2
+    // and no more than the FIM allows.
+    parameter NUM_READ_TAGS = 64,
+    // Maximum sizes of read requests and write TLPs, in 64 byte lines.
+    // Both must be at least 2. Programmed sizes must not exceed the
+    // system's max read request and max payload sizes.
+    parameter MAX_RD_LINES = 8,
+    parameter MAX_WR_LINES = 8
+    )
+   (
+    input  logic clk,
+    input  logic rst_n,
+
+    pcie_ss_axis_if.sink   i_rx_if,
+    pcie_ss_axis_if.source o_tx_if,
+
+    // Read requests are sent on TX B so they can flow around writes on
+    // TX A. Write commits on RX B are not needed.
+    pcie_ss_axis_if.sink   i_rx_b_if,
+    pcie_ss_axis_if.source o_tx_b_if
+    );
+
+    localparam TAG_BITS = $clog2(NUM_READ_TAGS);
+    localparam RD_LINE_IDX_BITS = $clog2(MAX_RD_LINES);
+    localparam WR_BEAT_IDX_BITS = $clog2(MAX_WR_LINES + 1);
+
+    localparam HDR_BYTES = $bits(pcie_ss_hdr_pkg::PCIe_PUReqHdr_t) / 8;
+    localparam LINE_BYTES = 64;
+
+    typedef logic [LINE_BYTES*8-1 : 0] t_line;
+    typedef logic [7:0][63:0] t_line_words;
+
+
+    // ====================================================================
+    //
+    //   Stream registers
+    //
+    // ====================================================================
+
+    //
+    // Register the incoming RX stream. Unlike hello_world_tlp, the register
+    // accepts a new beat in the same cycle that the current one is consumed.
+    //
+    pcie_ss_axis_if rx_st(clk, rst_n);
+
+    assign i_rx_if.tready = !rx_st.tvalid || rx_st.tready;
+
+    always_ff @(posedge clk)
+    begin
+        if (i_rx_if.tready)
+        begin
+            rx_st.tvalid <= i_rx_if.tvalid;
+            rx_st.tlast <= i_rx_if.tlast;
+            rx_st.tdata <= i_rx_if.tdata;
+            rx_st.tkeep <= i_rx_if.tkeep;
+            rx_st.tuser_vendor <= i_rx_if.tuser_vendor;
+        end
+
+        if (!rst_n)
+        begin
+            rx_st.tvalid <= 1'b0;
+        end
+    end
+
+    // Ready for a new TX beat when the outbound registers are empty or
+    // draining this cycle.
+    logic tx_a_ready;
+    assign tx_a_ready = !o_tx_if.tvalid || o_tx_if.tready;
+    logic tx_b_ready;
+    assign tx_b_ready = !o_tx_b_if.tvalid || o_tx_b_if.tready;
+
+    // Write commits are not used
+    assign i_rx_b_if.tready = 1'b1;
+
+
+    // ====================================================================
+    //
+    //   Configuration and counters
+    //
+    // ====================================================================
+
+    logic [63:0] rd_base_addr, wr_base_addr;
+    logic [63:0] buf_addr_mask;
+    logic [7:0] rd_req_lines, wr_tlp_lines;
+    logic [63:0] rd_num_reqs, wr_num_tlps;
+    logic [63:0] wr_seed;
+
+    logic rd_active, wr_active;
+    logic start_rd, start_wr;
+
+    logic [63:0] run_cycles;
+    logic [63:0] rd_lines_retired, wr_lines_sent;
+    logic [63:0] rd_sum_a, rd_sum_b;
+
+    always_ff @(posedge clk)
+    begin
+        if (rd_active || wr_active)
+        begin
+            run_cycles <= run_cycles + 1;
+        end
+
+        if (start_rd || start_wr)
+        begin
+            run_cycles <= '0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   RX stream decode
+    //
+    // ====================================================================
+
+    // The incoming RX A stream holds MMIO requests from the host and
+    // completions for DMA reads.
+
+    logic rx_sop;
+    pcie_ss_hdr_pkg::PCIe_PUReqHdr_t rx_req_hdr;
+    pcie_ss_hdr_pkg::PCIe_PUCplHdr_t rx_cpl_hdr;
+    assign rx_req_hdr = rx_st.tdata[0 +: $bits(pcie_ss_hdr_pkg::PCIe_PUReqHdr_t)];
+    assign rx_cpl_hdr = rx_st.tdata[0 +: $bits(pcie_ss_hdr_pkg::PCIe_PUCplHdr_t)];
+
+    logic rx_hdr_is_pu;
+    assign rx_hdr_is_pu = rx_sop && rx_st.tvalid &&
+                          pcie_ss_hdr_pkg::func_hdr_is_pu_mode(rx_st.tuser_vendor);
+
+    logic rx_is_cpl, rx_is_mmio_rd, rx_is_mmio_wr;
+    assign rx_is_cpl = rx_hdr_is_pu && pcie_ss_hdr_pkg::func_is_completion(rx_req_hdr.fmt_type);
+    assign rx_is_mmio_rd = rx_hdr_is_pu && pcie_ss_hdr_pkg::func_is_mrd_req(rx_req_hdr.fmt_type);
+    assign rx_is_mmio_wr = rx_hdr_is_pu && pcie_ss_hdr_pkg::func_is_mwr_req(rx_req_hdr.fmt_type);
+
+    // CSR index of an MMIO request (byte address bits [7:3])
+    logic [4:0] rx_csr_idx;
+    assign rx_csr_idx = pcie_ss_hdr_pkg::func_is_addr64(rx_req_hdr.fmt_type) ?
+                            rx_req_hdr.host_addr_l[5:1] : rx_req_hdr.host_addr_h[7:3];
+
+    // Payload of an MMIO write, at the start of the data following the header
+    logic [63:0] rx_mmio_wr_data;
+    assign rx_mmio_wr_data = rx_st.tdata[HDR_BYTES*8 +: 64];
+
+    // MMIO read request waiting for a response slot on TX A
+    logic mmio_rd_valid;
+    pcie_ss_hdr_pkg::PCIe_PUReqHdr_t mmio_rd_hdr;
+    logic [4:0] mmio_rd_csr_idx;
+    logic mmio_rd_done;
+
+    // Completions and MMIO writes are always consumed. Only a new MMIO
+    // read stalls, waiting for the previous one to be answered, so DMA
+    // completions keep flowing while software polls the status CSR.
+    assign rx_st.tready = !(mmio_rd_valid && rx_is_mmio_rd);
+
+    always_ff @(posedge clk)
+    begin
+        if (rx_st.tvalid && rx_st.tready)
+        begin
+            rx_sop <= rx_st.tlast;
+        end
+
+        if (mmio_rd_done)
+        begin
+            mmio_rd_valid <= 1'b0;
+        end
+        else if (rx_is_mmio_rd && rx_st.tready)
+        begin
+            mmio_rd_valid <= 1'b1;
+            mmio_rd_hdr <= rx_req_hdr;
+            mmio_rd_csr_idx <= rx_csr_idx;
+        end
+
+        if (!rst_n)
+        begin
+            rx_sop <= 1'b1;
+            mmio_rd_valid <= 1'b0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   CSR writes
+    //
+    // ====================================================================
+
+    always_ff @(posedge clk)
+    begin
+        start_rd <= 1'b0;
+        start_wr <= 1'b0;
+
+        if (rx_is_mmio_wr && rx_st.tready)
+        begin
+            case (rx_csr_idx)
+              16: rd_base_addr <= { rx_mmio_wr_data[63:6], 6'b0 };
+              17: wr_base_addr <= { rx_mmio_wr_data[63:6], 6'b0 };
+              18: buf_addr_mask <= rx_mmio_wr_data;
+              19:
+                begin
+                    rd_req_lines <= rx_mmio_wr_data[7:0];
+                    wr_tlp_lines <= rx_mmio_wr_data[15:8];
+                end
+              20: rd_num_reqs <= rx_mmio_wr_data;
+              21: wr_num_tlps <= rx_mmio_wr_data;
+              22: wr_seed <= rx_mmio_wr_data;
+              23:
+                begin
+                    start_rd <= rx_mmio_wr_data[0];
+                    start_wr <= rx_mmio_wr_data[1];
+                end
+              default: ;
+            endcase
+        end
+
+        if (!rst_n)
+        begin
+            rd_req_lines <= 8'(MAX_RD_LINES);
+            wr_tlp_lines <= 8'(MAX_WR_LINES);
+            rd_num_reqs <= '0;
+            wr_num_tlps <= '0;
+            buf_addr_mask <= '0;
+            wr_seed <= '0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   Read request generation (TX B)
+    //
+    // ====================================================================
+
+    logic [63:0] rd_reqs_issued;
+    logic [63:0] rd_reqs_retired;
+    logic [63:0] rd_issue_offset;
+
+    logic [15:0] rd_req_bytes;
+    assign rd_req_bytes = 16'(rd_req_lines) * LINE_BYTES;
+
+    // A tag is free once the request that last used it has retired
+    logic rd_can_issue;
+    assign rd_can_issue = rd_active &&
+                          (rd_reqs_issued != rd_num_reqs) &&
+                          ((rd_reqs_issued - rd_reqs_retired) < NUM_READ_TAGS);
+
+    logic [TAG_BITS-1 : 0] rd_issue_tag;
+    assign rd_issue_tag = rd_reqs_issued[TAG_BITS-1 : 0];
+
+    pcie_ss_hdr_pkg::PCIe_PUReqHdr_t rd_req_hdr;
+    logic [63:0] rd_req_addr;
+    assign rd_req_addr = rd_base_addr + rd_issue_offset;
+
+    always_comb
+    begin
+        rd_req_hdr = '0;
+        rd_req_hdr.length = 10'(rd_req_bytes >> 2);
+        rd_req_hdr.tag_l = 8'(rd_issue_tag);
+        rd_req_hdr.first_dw_be = 4'hf;
+        rd_req_hdr.last_dw_be = 4'hf;
+
+        // PCIe requires the 3DW header for addresses below 4GB. The 32 bit
+        // address goes where the high half of a 64 bit address would be.
+        if (|rd_req_addr[63:32])
+        begin
+            rd_req_hdr.fmt_type = pcie_ss_hdr_pkg::ReqHdr_FmtType_e'(pcie_ss_hdr_pkg::PCIE_FMTTYPE_MEM_READ64);
+            rd_req_hdr.host_addr_h = rd_req_addr[63:32];
+            rd_req_hdr.host_addr_l = rd_req_addr[31:2];
+        end
+        else
+        begin
+            rd_req_hdr.fmt_type = pcie_ss_hdr_pkg::ReqHdr_FmtType_e'(pcie_ss_hdr_pkg::PCIE_FMTTYPE_MEM_READ32);
+            rd_req_hdr.host_addr_h = { rd_req_addr[31:2], 2'b0 };
+        end
+
+        rd_req_hdr.pf_num = PF_ID;
+        rd_req_hdr.vf_num = VF_ID;
+        rd_req_hdr.vf_active = VF_ACTIVE;
+    end
+
+    always_ff @(posedge clk)
+    begin
+        if (tx_b_ready)
+        begin
+            o_tx_b_if.tvalid <= rd_can_issue;
+            o_tx_b_if.tlast <= 1'b1;
+            o_tx_b_if.tdata <= { '0, rd_req_hdr };
+            o_tx_b_if.tkeep <= { '0, {HDR_BYTES{1'b1}} };
+            // PU encoding
+            o_tx_b_if.tuser_vendor <= '0;
+
+            if (rd_can_issue)
+            begin
+                rd_reqs_issued <= rd_reqs_issued + 1;
+                rd_issue_offset <= (rd_issue_offset + rd_req_bytes) & buf_addr_mask;
+            end
+        end
+
+        if (start_rd)
+        begin
+            rd_reqs_issued <= '0;
+            rd_issue_offset <= '0;
+        end
+
+        if (!rst_n)
+        begin
+            o_tx_b_if.tvalid <= 1'b0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   Completion reassembly
+    //
+    // ====================================================================
+
+    //
+    // The reassembly buffer holds one slot of MAX_RD_LINES for each tag.
+    // A completion's position within its request is known from the byte
+    // count (remaining bytes, including the current completion).
+    //
+
+    logic cpl_active;
+    logic [TAG_BITS-1 : 0] cpl_tag;
+    logic [RD_LINE_IDX_BITS-1 : 0] cpl_line_idx;
+    logic cpl_is_last;
+    logic [LINE_BYTES*8/2-1 : 0] cpl_prev_upper;
+
+    // Offset of a new completion within its request, in lines
+    logic [RD_LINE_IDX_BITS-1 : 0] rx_cpl_line_idx;
+    assign rx_cpl_line_idx = RD_LINE_IDX_BITS'((rd_req_bytes - 16'(rx_cpl_hdr.byte_count)) >> 6);
+
+    // Reassembly buffer write port (registered)
+    logic rd_buf_wen;
+    logic [TAG_BITS+RD_LINE_IDX_BITS-1 : 0] rd_buf_waddr;
+    t_line rd_buf_wdata;
+    logic rd_buf_wlast;
+
+    // One bit per tag, set when all completions for the tag have arrived
+    logic [NUM_READ_TAGS-1 : 0] rd_tag_done;
+
+    always_ff @(posedge clk)
+    begin
+        rd_buf_wen <= 1'b0;
+
+        if (rx_st.tvalid && rx_st.tready)
+        begin
+            // Keep the upper half of every beat. Payload lines are split
+            // across consecutive beats because of the 32 byte header.
+            cpl_prev_upper <= rx_st.tdata[LINE_BYTES*8/2 +: LINE_BYTES*8/2];
+
+            if (rx_is_cpl)
+            begin
+                cpl_active <= !rx_st.tlast;
+                cpl_tag <= TAG_BITS'(rx_cpl_hdr.tag_l);
+                cpl_line_idx <= rx_cpl_line_idx;
+                // Is this the final completion for the request?
+                cpl_is_last <= (rx_cpl_hdr.byte_count == { rx_cpl_hdr.length, 2'b0 });
+            end
+            else if (cpl_active)
+            begin
+                // Each beat after the header completes a line
+                rd_buf_wen <= 1'b1;
+                rd_buf_waddr <= { cpl_tag, cpl_line_idx };
+                rd_buf_wdata <= { rx_st.tdata[0 +: LINE_BYTES*8/2], cpl_prev_upper };
+                rd_buf_wlast <= rx_st.tlast && cpl_is_last;
+
+                cpl_line_idx <= cpl_line_idx + 1;
+                cpl_active <= !rx_st.tlast;
+            end
+        end
+
+        if (!rst_n)
+        begin
+            cpl_active <= 1'b0;
+            rd_buf_wen <= 1'b0;
+        end
+    end
+
+    // Reassembly buffer storage
+    t_line rd_buf[NUM_READ_TAGS * MAX_RD_LINES];
+    logic [TAG_BITS+RD_LINE_IDX_BITS-1 : 0] rd_buf_raddr;
+    t_line rd_buf_rdata;
+
+    always_ff @(posedge clk)
+    begin
+        if (rd_buf_wen)
+        begin
+            rd_buf[rd_buf_waddr] <= rd_buf_wdata;
+        end
+
+        rd_buf_rdata <= rd_buf[rd_buf_raddr];
+    end
+
+
+    // ====================================================================
+    //
+    //   In-order retirement and read checksum
+    //
+    // ====================================================================
+
+    logic [TAG_BITS-1 : 0] rd_retire_tag;
+    assign rd_retire_tag = rd_reqs_retired[TAG_BITS-1 : 0];
+    logic [RD_LINE_IDX_BITS-1 : 0] rd_retire_line_idx;
+
+    logic rd_retire_en;
+    assign rd_retire_en = rd_tag_done[rd_retire_tag];
+    logic rd_retire_last_line;
+    assign rd_retire_last_line = (rd_retire_line_idx == RD_LINE_IDX_BITS'(rd_req_lines - 1));
+
+    assign rd_buf_raddr = { rd_retire_tag, rd_retire_line_idx };
+
+    always_ff @(posedge clk)
+    begin
+        if (rd_retire_en)
+        begin
+            rd_retire_line_idx <= rd_retire_line_idx + 1;
+
+            if (rd_retire_last_line)
+            begin
+                rd_retire_line_idx <= '0;
+                rd_reqs_retired <= rd_reqs_retired + 1;
+                rd_tag_done[rd_retire_tag] <= 1'b0;
+            end
+        end
+
+        // The tag being retired and the tag being completed are never the
+        // same, since a tag is not reused until it is retired.
+        if (rd_buf_wen && rd_buf_wlast)
+        begin
+            rd_tag_done[rd_buf_waddr[RD_LINE_IDX_BITS +: TAG_BITS]] <= 1'b1;
+        end
+
+        if (start_rd)
+        begin
+            rd_reqs_retired <= '0;
+            rd_retire_line_idx <= '0;
+        end
+
+        if (!rst_n)
+        begin
+            rd_tag_done <= '0;
+            rd_reqs_retired <= '0;
+            rd_retire_line_idx <= '0;
+        end
+    end
+
+    // Reads are finished once all requests are retired
+    always_ff @(posedge clk)
+    begin
+        if (rd_active && (rd_reqs_retired == rd_num_reqs))
+        begin
+            rd_active <= 1'b0;
+        end
+
+        if (start_rd)
+        begin
+            rd_active <= 1'b1;
+        end
+
+        if (!rst_n)
+        begin
+            rd_active <= 1'b0;
+        end
+    end
+
+    //
+    // Checksum of the retired lines, in order. Checksum A is the sum of all
+    // 64 bit words and checksum B is the sum of A after each line, making
+    // the result depend on line order (a Fletcher-style sum).
+    //
+    logic rd_data_valid;
+    t_line_words rd_data_words;
+    assign rd_data_words = rd_buf_rdata;
+
+    logic [63:0] rd_data_sum;
+    always_comb
+    begin
+        rd_data_sum = '0;
+        for (int w = 0; w < 8; w = w + 1)
+        begin
+            rd_data_sum = rd_data_sum + rd_data_words[w];
+        end
+    end
+
+    logic line_sum_valid;
+    logic [63:0] line_sum;
+
+    always_ff @(posedge clk)
+    begin
+        // RAM read latency is one cycle
+        rd_data_valid <= rd_retire_en;
+
+        line_sum_valid <= rd_data_valid;
+        line_sum <= rd_data_sum;
+
+        if (line_sum_valid)
+        begin
+            rd_sum_a <= rd_sum_a + line_sum;
+            rd_sum_b <= rd_sum_b + rd_sum_a + line_sum;
+            rd_lines_retired <= rd_lines_retired + 1;
+        end
+
+        if (start_rd)
+        begin
+            rd_sum_a <= '0;
+            rd_sum_b <= '0;
+            rd_lines_retired <= '0;
+        end
+
+        if (!rst_n)
+        begin
+            rd_data_valid <= 1'b0;
+            line_sum_valid <= 1'b0;
+        end
+    end
+
+
+    // ====================================================================
+    //
+    //   Write TLP generation and TX A arbitration
+    //
+    // ====================================================================
+
+    logic [63:0] wr_tlps_sent;
+    logic [63:0] wr_offset;
+    // Beat index within the current write TLP. A TLP of N lines is N+1
+    // beats because the header shifts the payload by half a beat.
+    logic [WR_BEAT_IDX_BITS-1 : 0] wr_beat_idx;
+
+    logic [15:0] wr_tlp_bytes;
+    assign wr_tlp_bytes = 16'(wr_tlp_lines) * LINE_BYTES;
+
+    // MMIO completions have priority but may not interrupt a write TLP
+    logic send_mmio_cpl;
+    assign send_mmio_cpl = tx_a_ready && mmio_rd_valid && (wr_beat_idx == 0);
+    assign mmio_rd_done = send_mmio_cpl;
+
+    logic send_wr_beat;
+    assign send_wr_beat = tx_a_ready && !send_mmio_cpl && wr_active &&
+                          (wr_tlps_sent != wr_num_tlps);
+
+    logic wr_last_beat;
+    assign wr_last_beat = (wr_beat_idx == WR_BEAT_IDX_BITS'(wr_tlp_lines));
+
+    logic [63:0] wr_tlp_addr;
+    assign wr_tlp_addr = wr_base_addr + wr_offset;
+
+    pcie_ss_hdr_pkg::PCIe_PUReqHdr_t wr_tlp_hdr;
+    always_comb
+    begin
+        wr_tlp_hdr = '0;
+        wr_tlp_hdr.length = 10'(wr_tlp_bytes >> 2);
+        wr_tlp_hdr.first_dw_be = 4'hf;
+        wr_tlp_hdr.last_dw_be = 4'hf;
+
+        // 3DW header below 4GB, as for reads
+        if (|wr_tlp_addr[63:32])
+        begin
+            wr_tlp_hdr.fmt_type = pcie_ss_hdr_pkg::ReqHdr_FmtType_e'(pcie_ss_hdr_pkg::PCIE_FMTTYPE_MEM_WRITE64);
+            wr_tlp_hdr.host_addr_h = wr_tlp_addr[63:32];
+            wr_tlp_hdr.host_addr_l = wr_tlp_addr[31:2];
+        end
+        else
+        begin
+            wr_tlp_hdr.fmt_type = pcie_ss_hdr_pkg::ReqHdr_FmtType_e'(pcie_ss_hdr_pkg::PCIE_FMTTYPE_MEM_WRITE32);
+            wr_tlp_hdr.host_addr_h = { wr_tlp_addr[31:2], 2'b0 };
+        end
+
+        wr_tlp_hdr.pf_num = PF_ID;
+        wr_tlp_hdr.vf_num = VF_ID;
+        wr_tlp_hdr.vf_active = VF_ACTIVE;
+    end
+
+    // Write payload beat. Word w of beat b holds payload byte offset
+    // (64 * b + 8 * w - HDR_BYTES). In the first beat, the low words
+    // are the header.
+    t_line_words wr_beat_data;
+    logic [LINE_BYTES-1 : 0] wr_beat_keep;
+
+    always_comb
+    begin
+        for (int w = 0; w < 8; w = w + 1)
+        begin
+            wr_beat_data[w] = wr_seed ^
+                              (wr_offset + 64'(wr_beat_idx) * LINE_BYTES + 8 * w - HDR_BYTES);
+        end
+
+        if (wr_beat_idx == 0)
+        begin
+            wr_beat_data[HDR_BYTES/8-1 : 0] = wr_tlp_hdr;
+        end
+
+        // The last beat holds only the final half line of the payload
+        wr_beat_keep = wr_last_beat ? { '0, {(LINE_BYTES/2){1'b1}} } : '1;
+    end
+
+    // Construct MMIO completion in response to RX read request
+    pcie_ss_hdr_pkg::PCIe_PUCplHdr_t tx_cpl_hdr;
+    localparam TX_CPL_HDR_BYTES = $bits(pcie_ss_hdr_pkg::PCIe_PUCplHdr_t) / 8;
+
+    always_comb
+    begin
+        tx_cpl_hdr = '0;
+        tx_cpl_hdr.fmt_type = pcie_ss_hdr_pkg::ReqHdr_FmtType_e'(pcie_ss_hdr_pkg::PCIE_FMTTYPE_CPLD);
+        tx_cpl_hdr.length = mmio_rd_hdr.length;
+        tx_cpl_hdr.req_id = mmio_rd_hdr.req_id;
+        tx_cpl_hdr.tag_h = mmio_rd_hdr.tag_h;
+        tx_cpl_hdr.tag_m = mmio_rd_hdr.tag_m;
+        tx_cpl_hdr.tag_l = mmio_rd_hdr.tag_l;
+        tx_cpl_hdr.TC = mmio_rd_hdr.TC;
+        tx_cpl_hdr.byte_count = mmio_rd_hdr.length << 2;
+        tx_cpl_hdr.low_addr[6:2] =
+            pcie_ss_hdr_pkg::func_is_addr64(mmio_rd_hdr.fmt_type) ?
+                mmio_rd_hdr.host_addr_l[4:0] : mmio_rd_hdr.host_addr_h[6:2];
+
+        tx_cpl_hdr.comp_id = { VF_ID, VF_ACTIVE, PF_ID };
+        tx_cpl_hdr.pf_num = PF_ID;
+        tx_cpl_hdr.vf_num = VF_ID;
+        tx_cpl_hdr.vf_active = VF_ACTIVE;
+    end
+
+    logic [63:0] cpl_data;
+    logic [127:0] afu_id = `AFU_ACCEL_UUID;
+
+    always_comb
+    begin
+        case (mmio_rd_csr_idx)
+            // AFU DFH
+            0:
+                begin
+                    cpl_data = '0;
+                    // Feature type is AFU
+                    cpl_data[63:60] = 4'h1;
+                    // End of list
+                    cpl_data[40] = 1'b1;
+                end
+
+            // AFU_ID_L
+            1: cpl_data = afu_id[63:0];
+
+            // AFU_ID_H
+            2: cpl_data = afu_id[127:64];
+
+            // Engine properties
+            5:
+                begin
+                    cpl_data = '0;
+                    cpl_data[63:48] = 16'(NUM_READ_TAGS);
+                    cpl_data[47:40] = 8'(MAX_RD_LINES);
+                    cpl_data[39:32] = 8'(MAX_WR_LINES);
+                    cpl_data[23:16] = 8'(LINE_BYTES);
+                    cpl_data[15:0] = 16'(`OFS_PLAT_PARAM_CLOCKS_PCLK_FREQ);
+                end
+
+            6: cpl_data = { 62'b0, wr_active, rd_active };
+            7: cpl_data = run_cycles;
+            8: cpl_data = rd_lines_retired;
+            9: cpl_data = wr_lines_sent;
+            10: cpl_data = rd_sum_a;
+            11: cpl_data = rd_sum_b;
+
+            default: cpl_data = '0;
+        endcase
+
+        // Was the request short, asking for the high 32 bits of the 64 bit register?
+        if (tx_cpl_hdr.low_addr[2])
+        begin
+            cpl_data[31:0] = cpl_data[63:32];
+        end
+    end
+
+    always_ff @(posedge clk)
+    begin
+        if (tx_a_ready)
+        begin
+            o_tx_if.tvalid <= send_mmio_cpl || send_wr_beat;
+
+            if (send_mmio_cpl)
+            begin
+                o_tx_if.tdata <= { '0, cpl_data, tx_cpl_hdr };
+                o_tx_if.tlast <= 1'b1;
+                o_tx_if.tuser_vendor <= '0;
+                // Keep matches the data: either 8 or 4 bytes of data and the header
+                o_tx_if.tkeep <= { '0, {4{(mmio_rd_hdr.length > 1)}}, {4{1'b1}}, {TX_CPL_HDR_BYTES{1'b1}} };
+            end
+            else
+            begin
+                o_tx_if.tdata <= wr_beat_data;
+                o_tx_if.tlast <= wr_last_beat;
+                o_tx_if.tuser_vendor <= '0;
+                o_tx_if.tkeep <= wr_beat_keep;
+            end
+        end
+
+        if (send_wr_beat)
+        begin
+            wr_beat_idx <= wr_beat_idx + 1;
+            if (wr_beat_idx != 0)
+            begin
+                wr_lines_sent <= wr_lines_sent + 1;
+            end
+
+            if (wr_last_beat)
+            begin
+                wr_beat_idx <= '0;
+                wr_tlps_sent <= wr_tlps_sent + 1;
+                wr_offset <= (wr_offset + wr_tlp_bytes) & buf_addr_mask;
+            end
+        end
+
+        if (start_wr)
+        begin
+            wr_tlps_sent <= '0;
+            wr_offset <= '0;
+            wr_lines_sent <= '0;
+        end
+
+        if (!rst_n)
+        begin
+            o_tx_if.tvalid <= 1'b0;
+            wr_beat_idx <= '0;
+        end
+    end
+
+    // Writes are finished once all TLPs are sent
+    always_ff @(posedge clk)
+    begin
+        if (wr_active && (wr_tlps_sent == wr_num_tlps))
+        begin
+            wr_active <= 1'b0;
+        end
+
+        if (start_wr)
+        begin
+            wr_active <= 1'b1;
+        end
+
+        if (!rst_n)
+        begin
+            wr_active <= 1'b0;
+        end
+    end
+
+
+    // synthesis translate_off
+    always_ff @(posedge clk)
+    begin
+        if (rst_n && start_rd)
+        begin
+            $display("TLP_DMA: Start %0d reads of %0d lines from 0x%0h",
+                     rd_num_reqs, rd_req_lines, rd_base_addr);
+        end
+
+        if (rst_n && start_wr)
+        begin
+            $display("TLP_DMA: Start %0d writes of %0d lines to 0x%0h",
+                     wr_num_tlps, wr_tlp_lines, wr_base_addr);
+        end
+    end
+    // synthesis translate_on
+
+endmodule
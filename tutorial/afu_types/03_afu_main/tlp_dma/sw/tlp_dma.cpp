@@ -0,0 +1,530 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Throughput benchmark for the tlp_dma AFU. The AFU reads and writes host
+// memory with raw PCIe TLPs. Measured throughput is compared against the
+// bound computed by the TLP model for the same traffic, and the data moved
+// is checked against the model.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+#include <time.h>
+#include <uuid/uuid.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <opae/fpga.h>
+
+// State from the AFU's JSON file, extracted using OPAE's afu_json_mgr script
+#include "afu_json_info.h"
+#include "tlp_model.h"
+
+#define CACHELINE_BYTES 64
+
+static fpga_handle s_accel_handle;
+static bool s_is_ase_sim;
+
+static bool do_reads = true;
+static bool do_writes = true;
+static uint32_t mps = 256;
+static uint32_t mrrs = 512;
+static uint32_t rcb = 64;
+static uint64_t buf_size = 2 * 1024 * 1024;
+static uint64_t total_bytes = 0;
+static double link_gbps = 31.5;
+
+
+static void
+help(void)
+{
+    printf("\n"
+           "Usage:\n"
+           "    tlp_dma [-h] [--mode=<read|write|both>] [--mps=<bytes>] [--mrrs=<bytes>]\n"
+           "            [--rcb=<bytes>] [--buf-size=<bytes>] [--bytes=<bytes>]\n"
+           "            [--link-gbps=<GB/s>]\n"
+           "\n"
+           "      -h,--help             Print this help\n"
+           "\n"
+           "      -m,--mode             Traffic to generate. (Default: both)\n"
+           "      -p,--mps              Write TLP payload size. Must not exceed the\n"
+           "                            system's max payload size. (Default: 256)\n"
+           "      -r,--mrrs             Read request size. Must not exceed the system's\n"
+           "                            max read request size. (Default: 512)\n"
+           "      -c,--rcb              Read completion boundary, used only by the\n"
+           "                            model. (Default: 64)\n"
+           "      -s,--buf-size         Size of each host buffer. Buffers larger than\n"
+           "                            4KB require 2MB huge pages. (Default: 2MB)\n"
+           "      -b,--bytes            Bytes to move in each direction.\n"
+           "                            (Default: 4GB, 64KB in ASE)\n"
+           "      -l,--link-gbps        Usable link bandwidth in each direction, after\n"
+           "                            encoding, in GB/s. (Default: 31.5, PCIe Gen4 x16)\n"
+           "\n");
+}
+
+
+static bool
+parse_uint64(const char *arg, uint64_t *v)
+{
+    char *endptr = NULL;
+    *v = strtoull(arg, &endptr, 0);
+    return (endptr == arg + strlen(arg));
+}
+
+
+#define GETOPT_STRING ":hm:p:r:c:s:b:l:"
+static int
+parse_args(int argc, char *argv[])
+{
+    struct option longopts[] = {
+        {"help",      no_argument,       NULL, 'h'},
+        {"mode",      required_argument, NULL, 'm'},
+        {"mps",       required_argument, NULL, 'p'},
+        {"mrrs",      required_argument, NULL, 'r'},
+        {"rcb",       required_argument, NULL, 'c'},
+        {"buf-size",  required_argument, NULL, 's'},
+        {"bytes",     required_argument, NULL, 'b'},
+        {"link-gbps", required_argument, NULL, 'l'},
+        {0, 0, 0, 0}
+    };
+
+    int getopt_ret;
+    int option_index;
+    uint64_t v;
+
+    while (-1
+           != (getopt_ret = getopt_long(argc, argv, GETOPT_STRING, longopts,
+                        &option_index))) {
+        const char *tmp_optarg = optarg;
+
+        if ((optarg) && ('=' == *tmp_optarg)) {
+            ++tmp_optarg;
+        }
+
+        switch (getopt_ret) {
+        case 'h': /* help */
+            help();
+            return -1;
+
+        case 'm': /* mode */
+            do_reads = !strcmp(tmp_optarg, "read") || !strcmp(tmp_optarg, "both");
+            do_writes = !strcmp(tmp_optarg, "write") || !strcmp(tmp_optarg, "both");
+            if (!do_reads && !do_writes) {
+                fprintf(stderr, "Invalid mode: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 'p': /* mps */
+        case 'r': /* mrrs */
+        case 'c': /* rcb */
+            if (!parse_uint64(tmp_optarg, &v) || (v < CACHELINE_BYTES) || (v > 4096) ||
+                (v & (v - 1))) {
+                fprintf(stderr, "Sizes must be powers of 2 from 64 to 4096: %s\n", tmp_optarg);
+                return -1;
+            }
+            if (getopt_ret == 'p') mps = v;
+            else if (getopt_ret == 'r') mrrs = v;
+            else rcb = v;
+            break;
+
+        case 's': /* buf-size */
+            if (!parse_uint64(tmp_optarg, &buf_size) || (buf_size < 4096) ||
+                (buf_size & (buf_size - 1))) {
+                fprintf(stderr, "Buffer size must be a power of 2, at least 4KB: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 'b': /* bytes */
+            if (!parse_uint64(tmp_optarg, &total_bytes) || (total_bytes == 0)) {
+                fprintf(stderr, "Invalid byte count: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 'l': /* link-gbps */
+            link_gbps = atof(tmp_optarg);
+            if (link_gbps <= 0) {
+                fprintf(stderr, "Invalid link bandwidth: %s\n", tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case ':': /* missing option argument */
+            fprintf(stderr, "Missing option argument. Use --help.\n");
+            return -1;
+
+        case '?':
+        default: /* invalid option */
+            fprintf(stderr, "Invalid cmdline options. Use --help.\n");
+            return -1;
+        }
+    }
+
+    if (optind != argc) {
+        fprintf(stderr, "Unexpected extra arguments\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//
+// Search for an accelerator matching the requested UUID and connect to it.
+//
+static fpga_handle connect_to_accel(const char *accel_uuid, bool *is_ase_sim)
+{
+    fpga_properties filter = NULL;
+    fpga_guid guid;
+    fpga_token accel_token;
+    uint32_t num_matches;
+    fpga_handle accel_handle;
+    fpga_result r;
+
+    // Don't print verbose messages in ASE by default
+    setenv("ASE_LOG", "0", 0);
+    *is_ase_sim = false;
+
+    // Set up a filter that will search for an accelerator
+    fpgaGetProperties(NULL, &filter);
+    fpgaPropertiesSetObjectType(filter, FPGA_ACCELERATOR);
+
+    // Add the desired UUID to the filter
+    uuid_parse(accel_uuid, guid);
+    fpgaPropertiesSetGUID(filter, guid);
+
+    // Do the search across the available FPGA contexts
+    num_matches = 1;
+    fpgaEnumerate(&filter, 1, &accel_token, 1, &num_matches);
+
+    // Not needed anymore
+    fpgaDestroyProperties(&filter);
+
+    if (num_matches < 1)
+    {
+        fprintf(stderr, "Accelerator %s not found!\n", accel_uuid);
+        return 0;
+    }
+
+    // Open accelerator
+    r = fpgaOpen(accel_token, &accel_handle, 0);
+    assert(FPGA_OK == r);
+
+    // While the token is available, check whether it is for HW
+    // or for ASE simulation.
+    fpga_properties accel_props;
+    uint16_t vendor_id, dev_id;
+    fpgaGetProperties(accel_token, &accel_props);
+    fpgaPropertiesGetVendorID(accel_props, &vendor_id);
+    fpgaPropertiesGetDeviceID(accel_props, &dev_id);
+    *is_ase_sim = (vendor_id == 0x8086) && (dev_id == 0xa5e);
+
+    // Done with token
+    fpgaDestroyToken(&accel_token);
+
+    return accel_handle;
+}
+
+
+static inline uint64_t readMMIO64(uint32_t idx)
+{
+    uint64_t v;
+    fpga_result r = fpgaReadMMIO64(s_accel_handle, 0, 8 * idx, &v);
+    assert(FPGA_OK == r);
+    (void)r;
+    return v;
+}
+
+
+static inline void writeMMIO64(uint32_t idx, uint64_t v)
+{
+    fpgaWriteMMIO64(s_accel_handle, 0, 8 * idx, v);
+}
+
+
+//
+// Allocate a buffer in I/O memory, shared with the FPGA.
+//
+static volatile uint8_t* alloc_buffer(ssize_t size, uint64_t *wsid, uint64_t *io_addr)
+{
+    fpga_result r;
+    void* buf;
+
+    r = fpgaPrepareBuffer(s_accel_handle, size, &buf, wsid, 0);
+    if (FPGA_OK != r) return NULL;
+
+    // Get the physical address of the buffer in the accelerator
+    r = fpgaGetIOAddress(s_accel_handle, *wsid, io_addr);
+    assert(FPGA_OK == r);
+
+    return (volatile uint8_t*)buf;
+}
+
+
+//
+// Expected read checksum. The source buffer is pushed through the model:
+// each request is split into completions, the completions of a window of
+// outstanding requests are delivered out of order, reassembled and then
+// retired in request order, just as the AFU does.
+//
+static bool model_read_checksum(const uint8_t *src, uint64_t num_reqs,
+                                uint16_t num_tags, tlp_model::LineChecksum *sum)
+{
+    tlp_model::Reassembler reasm(num_tags, mrrs);
+    std::mt19937_64 rng(1);
+
+    // The buffer is read repeatedly. Reassembly depends only on the request
+    // offset, so model each distinct request once per pass and replay the
+    // checksum for the rest.
+    const uint64_t reqs_per_buf = buf_size / mrrs;
+    const uint64_t modeled_reqs = std::min(num_reqs, reqs_per_buf);
+
+    for (uint64_t base = 0; base < modeled_reqs; base += num_tags)
+    {
+        const uint64_t n = std::min(uint64_t(num_tags), modeled_reqs - base);
+
+        // Completions of up to num_tags requests in flight. Completions for
+        // a single request stay in order, as PCIe requires, but requests
+        // are interleaved randomly.
+        std::vector<std::vector<tlp_model::Tlp>> cpls(n);
+        for (uint64_t i = 0; i < n; i += 1)
+        {
+            tlp_model::Tlp rd = tlp_model::split_requests(false, (base + i) * mrrs, mrrs, mrrs)[0];
+            rd.tag = (base + i) % num_tags;
+            reasm.issue(rd.tag);
+            cpls[i] = tlp_model::completions(rd, rcb, std::min(rcb, mps));
+            std::reverse(cpls[i].begin(), cpls[i].end());
+        }
+
+        std::vector<uint64_t> live;
+        for (uint64_t i = 0; i < n; i += 1) live.push_back(i);
+        while (!live.empty())
+        {
+            const size_t pick = rng() % live.size();
+            std::vector<tlp_model::Tlp> &q = cpls[live[pick]];
+
+            const tlp_model::Tlp &c = q.back();
+            const uint64_t offset = (base + live[pick]) * mrrs + mrrs - c.remaining_bytes();
+            if (!reasm.complete(c, src + offset)) return false;
+
+            q.pop_back();
+            if (q.empty()) live.erase(live.begin() + pick);
+        }
+
+        for (uint64_t i = 0; i < n; i += 1)
+        {
+            const uint16_t tag = (base + i) % num_tags;
+            if (!reasm.ready(tag)) return false;
+            sum->add_lines(reasm.slot(tag), mrrs);
+            reasm.retire(tag);
+        }
+    }
+
+    // Remaining passes over the buffer
+    for (uint64_t r = modeled_reqs; r < num_reqs; r += 1)
+    {
+        sum->add_lines(src + (r % reqs_per_buf) * mrrs, mrrs);
+    }
+
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (parse_args(argc, argv) < 0)
+        return 1;
+
+    s_accel_handle = connect_to_accel(AFU_ACCEL_UUID, &s_is_ase_sim);
+    if (NULL == s_accel_handle) return 0;
+
+    if (s_is_ase_sim)
+    {
+        printf("Running in ASE mode\n");
+        if (total_bytes == 0) total_bytes = 65536;
+    }
+    if (total_bytes == 0) total_bytes = 4ULL << 30;
+
+    // AFU properties
+    const uint64_t props = readMMIO64(5);
+    const uint32_t clock_mhz = props & 0xffff;
+    const uint32_t num_tags = props >> 48;
+    const uint32_t max_rd_lines = (props >> 40) & 0xff;
+    const uint32_t max_wr_lines = (props >> 32) & 0xff;
+
+    printf("AFU properties:\n");
+    printf("  Clock MHz: %d\n", clock_mhz);
+    printf("  Read tags: %d\n", num_tags);
+    printf("  Maximum read request: %d bytes\n", max_rd_lines * CACHELINE_BYTES);
+    printf("  Maximum write payload: %d bytes\n", max_wr_lines * CACHELINE_BYTES);
+    printf("\n");
+
+    if ((mrrs > max_rd_lines * CACHELINE_BYTES) || (mps > max_wr_lines * CACHELINE_BYTES) ||
+        (mrrs > buf_size) || (mps > buf_size))
+    {
+        fprintf(stderr, "Request sizes exceed the AFU maximum or the buffer size\n");
+        return 1;
+    }
+
+    const uint64_t num_rd_reqs = do_reads ? total_bytes / mrrs : 0;
+    const uint64_t num_wr_tlps = do_writes ? total_bytes / mps : 0;
+
+    uint64_t rd_wsid, rd_pa, wr_wsid, wr_pa;
+    volatile uint8_t *rd_buf = alloc_buffer(buf_size, &rd_wsid, &rd_pa);
+    volatile uint8_t *wr_buf = alloc_buffer(buf_size, &wr_wsid, &wr_pa);
+    if ((NULL == rd_buf) || (NULL == wr_buf))
+    {
+        fprintf(stderr, "Pinned buffer allocation failed!\n");
+        return 1;
+    }
+
+    // Random source data and a cleared destination
+    std::mt19937_64 rng(buf_size);
+    for (uint64_t i = 0; i < buf_size; i += 8)
+    {
+        *(volatile uint64_t*)(rd_buf + i) = rng();
+        *(volatile uint64_t*)(wr_buf + i) = 0;
+    }
+    const uint64_t seed = rng();
+
+    printf("Test parameters:\n");
+    printf("  Reads: %ld requests of %d bytes\n", num_rd_reqs, mrrs);
+    printf("  Writes: %ld TLPs of %d bytes\n", num_wr_tlps, mps);
+    printf("  Buffer size: %ld bytes\n", buf_size);
+    printf("\n");
+
+    writeMMIO64(16, rd_pa);
+    writeMMIO64(17, wr_pa);
+    writeMMIO64(18, buf_size - 1);
+    writeMMIO64(19, ((mps / CACHELINE_BYTES) << 8) | (mrrs / CACHELINE_BYTES));
+    writeMMIO64(20, num_rd_reqs);
+    writeMMIO64(21, num_wr_tlps);
+    writeMMIO64(22, seed);
+
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    writeMMIO64(23, (do_writes ? 2 : 0) | (do_reads ? 1 : 0));
+
+    // Wait for both streams to finish
+    while (readMMIO64(6) != 0)
+    {
+        if (s_is_ase_sim) usleep(1000);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double host_sec = end_time.tv_sec - start_time.tv_sec +
+                      1e-9 * (end_time.tv_nsec - start_time.tv_nsec);
+
+    // Time is measured by the AFU in cycles, avoiding MMIO latency
+    const uint64_t cycles = readMMIO64(7);
+    const double afu_sec = (double)cycles / (clock_mhz * 1e6);
+    const uint64_t rd_lines = readMMIO64(8);
+    const uint64_t wr_lines = readMMIO64(9);
+
+    printf("Total time: %f sec (AFU), %f sec (host)\n", afu_sec, host_sec);
+
+    int status = 0;
+
+    //
+    // Compare against the model. The bound for each direction is the link
+    // bandwidth scaled by payload efficiency. Read data flows toward the FPGA
+    // in completions. Requests and writes flow toward the host.
+    // The buffer addresses pick 3DW or 4DW request headers, as in the AFU.
+    //
+    const uint64_t buf_tlp_bytes = std::min(buf_size, total_bytes);
+    if (do_reads)
+    {
+        const double gb = (double)rd_lines * CACHELINE_BYTES / 1e9;
+
+        std::vector<tlp_model::Tlp> reqs =
+            tlp_model::split_requests(false, rd_pa, buf_tlp_bytes, mrrs, num_tags);
+        std::vector<tlp_model::Tlp> cpls;
+        for (size_t i = 0; i < reqs.size(); i += 1)
+        {
+            std::vector<tlp_model::Tlp> c = tlp_model::completions(reqs[i], rcb, std::min(rcb, mps));
+            cpls.insert(cpls.end(), c.begin(), c.end());
+        }
+        const double eff = (double)buf_tlp_bytes / tlp_model::link_bytes(cpls);
+
+        printf("\nReads:\n");
+        printf("  Lines: %ld\n", rd_lines);
+        printf("  Throughput: %0.2f GB/s\n", gb / afu_sec);
+        printf("  Model bound: %0.2f GB/s (%0.1f%% completion efficiency, %d byte completions)\n",
+               link_gbps * eff, 100.0 * eff, std::min(rcb, mps));
+
+        tlp_model::LineChecksum expected;
+        std::vector<uint8_t> src(buf_size);
+        for (uint64_t i = 0; i < buf_size; i += 1) src[i] = rd_buf[i];
+        if (!model_read_checksum(src.data(), num_rd_reqs, num_tags, &expected))
+        {
+            printf("  *** Model reassembly error ***\n");
+            status = 1;
+        }
+        else if ((expected.a != readMMIO64(10)) || (expected.b != readMMIO64(11)))
+        {
+            printf("  *** Checksum mismatch: expected 0x%016lx 0x%016lx, AFU 0x%016lx 0x%016lx ***\n",
+                   expected.a, expected.b, readMMIO64(10), readMMIO64(11));
+            status = 1;
+        }
+        else
+        {
+            printf("  Checksum matches the model\n");
+        }
+    }
+
+    if (do_writes)
+    {
+        const double gb = (double)wr_lines * CACHELINE_BYTES / 1e9;
+
+        std::vector<tlp_model::Tlp> wrs =
+            tlp_model::split_requests(true, wr_pa, buf_tlp_bytes, mps);
+        const double eff = (double)buf_tlp_bytes / tlp_model::link_bytes(wrs);
+
+        printf("\nWrites:\n");
+        printf("  Lines: %ld\n", wr_lines);
+        printf("  Throughput: %0.2f GB/s\n", gb / afu_sec);
+        printf("  Model bound: %0.2f GB/s (%0.1f%% write efficiency)\n",
+               link_gbps * eff, 100.0 * eff);
+
+        // The status read above reported writes done. PCIe ordering guarantees
+        // the data is visible.
+        uint64_t num_errors = 0;
+        for (uint64_t i = 0; i < buf_tlp_bytes; i += 8)
+        {
+            const uint64_t v = *(volatile uint64_t*)(wr_buf + i);
+            if (v != (seed ^ i))
+            {
+                if (num_errors < 10)
+                    printf("  Offset 0x%lx: expected 0x%016lx, found 0x%016lx\n", i, seed ^ i, v);
+                num_errors += 1;
+            }
+        }
+
+        if (num_errors)
+        {
+            printf("  *** %ld write data errors ***\n", num_errors);
+            status = 1;
+        }
+        else
+        {
+            printf("  Write data matches the pattern\n");
+        }
+    }
+
+    fpgaReleaseBuffer(s_accel_handle, rd_wsid);
+    fpgaReleaseBuffer(s_accel_handle, wr_wsid);
+    fpgaClose(s_accel_handle);
+
+    return status;
+}
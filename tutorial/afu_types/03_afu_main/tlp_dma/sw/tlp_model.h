@@ -0,0 +1,363 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Software model of the PCIe transactions generated and consumed by the
+// tlp_dma AFU. The model encodes and decodes standard PCIe TLP headers,
+// splits transfers into TLPs the way the AFU and a completer do, reassembles
+// completions in the same way as the AFU's reassembly buffer and computes
+// the checksum that the AFU reports for reads.
+//
+// The model has no OPAE dependence and can be used on its own, e.g. to
+// check TLP streams captured from simulation.
+//
+// Headers are encoded as in the PCIe Base Specification, byte 0 holding
+// Fmt and Type. The PCIe SS power user header carries this standard header
+// in its low 16 bytes, followed by 16 bytes of sideband (PF/VF, BAR, etc.)
+// that are not modeled here.
+//
+
+#ifndef __TLP_MODEL_H__
+#define __TLP_MODEL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace tlp_model
+{
+
+// Fmt/Type byte values
+enum FmtType : uint8_t
+{
+    MRD32 = 0x00,
+    MRD64 = 0x20,
+    MWR32 = 0x40,
+    MWR64 = 0x60,
+    CPL   = 0x0a,
+    CPLD  = 0x4a
+};
+
+struct Tlp
+{
+    uint8_t fmt_type;
+    uint8_t tc;
+    // Payload length in DWORDs. 1024 is encoded as 0.
+    uint16_t length_dw;
+    uint16_t requester_id;
+    // 10 bit tag
+    uint16_t tag;
+
+    // Requests
+    uint8_t first_be;
+    uint8_t last_be;
+    uint64_t addr;
+
+    // Completions
+    uint16_t completer_id;
+    uint8_t status;
+    // Remaining bytes of the request, including this completion. 4096 is
+    // encoded as 0.
+    uint16_t byte_count;
+    uint8_t lower_addr;
+
+    Tlp() { memset(this, 0, sizeof(*this)); }
+
+    bool is_completion() const { return (fmt_type & 0x1f) == 0x0a; }
+    bool is_write() const { return (fmt_type & 0xdf) == MWR32; }
+    bool is_read() const { return (fmt_type & 0xdf) == MRD32; }
+    bool has_data() const { return (fmt_type & 0x40) != 0; }
+    bool is_addr64() const { return !is_completion() && ((fmt_type & 0x20) != 0); }
+
+    uint32_t header_bytes() const { return (is_addr64() ? 16 : 12); }
+    uint32_t payload_bytes() const
+    {
+        if (!has_data()) return 0;
+        return (length_dw == 0 ? 1024 : length_dw) * 4;
+    }
+    uint32_t remaining_bytes() const { return (byte_count == 0 ? 4096 : byte_count); }
+};
+
+
+//
+// Header encoding. Returns the number of header bytes written to buf,
+// which must hold at least 16 bytes.
+//
+inline uint32_t encode(const Tlp &t, uint8_t *buf)
+{
+    memset(buf, 0, 16);
+
+    // DW0: 10 bit tags store tag[9] and tag[8] in byte 1
+    buf[0] = t.fmt_type;
+    buf[1] = ((t.tag >> 2) & 0x80) | ((t.tc & 7) << 4) | ((t.tag >> 5) & 0x08);
+    buf[2] = (t.length_dw >> 8) & 0x3;
+    buf[3] = t.length_dw & 0xff;
+
+    if (t.is_completion())
+    {
+        buf[4] = t.completer_id >> 8;
+        buf[5] = t.completer_id & 0xff;
+        buf[6] = ((t.status & 7) << 5) | ((t.byte_count >> 8) & 0xf);
+        buf[7] = t.byte_count & 0xff;
+        buf[8] = t.requester_id >> 8;
+        buf[9] = t.requester_id & 0xff;
+        buf[10] = t.tag & 0xff;
+        buf[11] = t.lower_addr & 0x7f;
+        return 12;
+    }
+
+    buf[4] = t.requester_id >> 8;
+    buf[5] = t.requester_id & 0xff;
+    buf[6] = t.tag & 0xff;
+    buf[7] = ((t.last_be & 0xf) << 4) | (t.first_be & 0xf);
+
+    uint32_t a;
+    uint8_t *p = &buf[8];
+    if (t.is_addr64())
+    {
+        a = t.addr >> 32;
+        p[0] = a >> 24; p[1] = a >> 16; p[2] = a >> 8; p[3] = a;
+        p += 4;
+    }
+    a = t.addr & 0xfffffffc;
+    p[0] = a >> 24; p[1] = a >> 16; p[2] = a >> 8; p[3] = a;
+
+    return t.header_bytes();
+}
+
+
+//
+// Header decoding. Returns false when the buffer is too short or the
+// Fmt/Type is not one of the types in FmtType.
+//
+inline bool decode(const uint8_t *buf, uint32_t len, Tlp *t)
+{
+    if (len < 12) return false;
+
+    *t = Tlp();
+    t->fmt_type = buf[0];
+    if (!t->is_completion() && !t->is_read() && !t->is_write()) return false;
+    if (len < t->header_bytes()) return false;
+
+    t->tc = (buf[1] >> 4) & 7;
+    t->tag = ((buf[1] & 0x80) << 2) | ((buf[1] & 0x08) << 5);
+    t->length_dw = ((buf[2] & 0x3) << 8) | buf[3];
+
+    if (t->is_completion())
+    {
+        t->completer_id = (buf[4] << 8) | buf[5];
+        t->status = buf[6] >> 5;
+        t->byte_count = ((buf[6] & 0xf) << 8) | buf[7];
+        t->requester_id = (buf[8] << 8) | buf[9];
+        t->tag |= buf[10];
+        t->lower_addr = buf[11] & 0x7f;
+        return true;
+    }
+
+    t->requester_id = (buf[4] << 8) | buf[5];
+    t->tag |= buf[6];
+    t->last_be = buf[7] >> 4;
+    t->first_be = buf[7] & 0xf;
+
+    const uint8_t *p = &buf[8];
+    if (t->is_addr64())
+    {
+        t->addr = (uint64_t(p[0]) << 56) | (uint64_t(p[1]) << 48) |
+                  (uint64_t(p[2]) << 40) | (uint64_t(p[3]) << 32);
+        p += 4;
+    }
+    t->addr |= (uint64_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] & 0xfc);
+
+    return true;
+}
+
+
+//
+// Split a transfer into requests of at most max_bytes, never crossing
+// a 4KB boundary. Writes use the max payload size and reads the max read
+// request size. Tags are assigned round-robin from num_tags, as in the AFU.
+//
+inline std::vector<Tlp> split_requests(bool is_write, uint64_t addr, uint64_t bytes,
+                                       uint32_t max_bytes, uint16_t num_tags = 1)
+{
+    std::vector<Tlp> tlps;
+    uint16_t tag = 0;
+
+    while (bytes)
+    {
+        uint64_t n = max_bytes - (addr % max_bytes);
+        const uint64_t to_4k = 4096 - (addr & 4095);
+        if (n > to_4k) n = to_4k;
+        if (n > bytes) n = bytes;
+
+        // 3DW headers below 4GB, as the AFU and PCIe require
+        Tlp t;
+        const bool addr64 = (addr >> 32) != 0;
+        t.fmt_type = is_write ? (addr64 ? MWR64 : MWR32) : (addr64 ? MRD64 : MRD32);
+        t.length_dw = ((n + 3) / 4) & 0x3ff;
+        t.first_be = 0xf;
+        t.last_be = (n > 4) ? 0xf : 0;
+        t.addr = addr;
+        if (!is_write)
+        {
+            t.tag = tag;
+            tag = (tag + 1) % num_tags;
+        }
+        tlps.push_back(t);
+
+        addr += n;
+        bytes -= n;
+    }
+
+    return tlps;
+}
+
+
+//
+// Completions a completer might return for a read request. Completions
+// are split at read completion boundaries (rcb), with at most
+// max_cpl_bytes per completion. max_cpl_bytes must be a multiple of rcb
+// and no larger than the max payload size.
+//
+inline std::vector<Tlp> completions(const Tlp &rd, uint32_t rcb, uint32_t max_cpl_bytes)
+{
+    std::vector<Tlp> cpls;
+
+    uint64_t addr = rd.addr;
+    uint32_t remaining = (rd.length_dw == 0 ? 1024 : rd.length_dw) * 4;
+
+    while (remaining)
+    {
+        // The first completion ends at an RCB boundary, later ones are
+        // RCB multiples.
+        uint32_t n = max_cpl_bytes - (addr % rcb);
+        if (n > remaining) n = remaining;
+
+        Tlp c;
+        c.fmt_type = CPLD;
+        c.tc = rd.tc;
+        c.length_dw = (n / 4) & 0x3ff;
+        c.requester_id = rd.requester_id;
+        c.tag = rd.tag;
+        c.byte_count = remaining & 0xfff;
+        c.lower_addr = addr & 0x7f;
+        cpls.push_back(c);
+
+        addr += n;
+        remaining -= n;
+    }
+
+    return cpls;
+}
+
+
+//
+// Completion reassembly, matching the AFU. Each tag owns a slot of
+// req_bytes. A completion's offset in the slot is the request size
+// minus its byte count, and the request is complete when a completion's
+// byte count equals its own length.
+//
+class Reassembler
+{
+  public:
+    Reassembler(uint16_t num_tags, uint32_t req_bytes) :
+        req_bytes(req_bytes),
+        slots(num_tags * req_bytes),
+        pending(num_tags, false),
+        done(num_tags, false)
+    {}
+
+    void issue(uint16_t tag)
+    {
+        pending[tag] = true;
+        done[tag] = false;
+    }
+
+    // Returns false on a protocol error: an unexpected tag, a completion
+    // that does not fit in the request or one arriving after the last.
+    bool complete(const Tlp &cpl, const uint8_t *payload)
+    {
+        const uint16_t tag = cpl.tag;
+        if ((tag >= pending.size()) || !pending[tag] || done[tag]) return false;
+
+        const uint32_t n = cpl.payload_bytes();
+        const uint32_t remaining = cpl.remaining_bytes();
+        if ((remaining > req_bytes) || (n > remaining)) return false;
+
+        const uint32_t offset = req_bytes - remaining;
+        memcpy(&slots[tag * req_bytes + offset], payload, n);
+
+        if (remaining == n)
+            done[tag] = true;
+
+        return true;
+    }
+
+    bool ready(uint16_t tag) const { return done[tag]; }
+    const uint8_t *slot(uint16_t tag) const { return &slots[tag * req_bytes]; }
+
+    void retire(uint16_t tag)
+    {
+        pending[tag] = false;
+        done[tag] = false;
+    }
+
+  private:
+    const uint32_t req_bytes;
+    std::vector<uint8_t> slots;
+    std::vector<bool> pending;
+    std::vector<bool> done;
+};
+
+
+//
+// Checksum of read data reported by the AFU. A is the sum of all 64 bit
+// words and B is the sum of A after each 64 byte line.
+//
+struct LineChecksum
+{
+    uint64_t a;
+    uint64_t b;
+
+    LineChecksum() : a(0), b(0) {}
+
+    void add_lines(const uint8_t *data, uint64_t bytes)
+    {
+        for (uint64_t l = 0; l < bytes; l += 64)
+        {
+            uint64_t line_sum = 0;
+            for (uint32_t w = 0; w < 8; w += 1)
+            {
+                uint64_t v;
+                memcpy(&v, data + l + 8 * w, 8);
+                line_sum += v;
+            }
+
+            a += line_sum;
+            b += a;
+        }
+    }
+};
+
+
+//
+// Bytes a TLP occupies on the link with 128b/130b encoding: 4 bytes of
+// framing token and sequence number, the header, the payload and a 4 byte
+// LCRC. DLLP traffic (ACK and flow control updates) is not counted.
+//
+inline uint64_t link_bytes(const Tlp &t)
+{
+    return 4 + t.header_bytes() + t.payload_bytes() + 4;
+}
+
+inline uint64_t link_bytes(const std::vector<Tlp> &tlps)
+{
+    uint64_t n = 0;
+    for (size_t i = 0; i < tlps.size(); i += 1)
+        n += link_bytes(tlps[i]);
+    return n;
+}
+
+} // namespace tlp_model
+
+#endif // __TLP_MODEL_H__
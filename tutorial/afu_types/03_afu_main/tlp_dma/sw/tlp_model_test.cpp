@@ -0,0 +1,225 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Unit tests for tlp_model.h. They need neither OPAE nor hardware:
+//
+//   make test
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "tlp_model.h"
+
+static int errors;
+
+#define CHECK(cond)                                                     \
+    do                                                                  \
+    {                                                                   \
+        if (!(cond))                                                    \
+        {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            errors += 1;                                                \
+        }                                                               \
+    } while (0)
+
+
+static void check_round_trip(const tlp_model::Tlp &t)
+{
+    uint8_t buf[16];
+    const uint32_t len = tlp_model::encode(t, buf);
+    CHECK(len == t.header_bytes());
+
+    tlp_model::Tlp d;
+    CHECK(tlp_model::decode(buf, len, &d));
+    CHECK(d.fmt_type == t.fmt_type);
+    CHECK(d.tc == t.tc);
+    CHECK(d.length_dw == t.length_dw);
+    CHECK(d.requester_id == t.requester_id);
+    CHECK(d.tag == t.tag);
+
+    if (t.is_completion())
+    {
+        CHECK(d.completer_id == t.completer_id);
+        CHECK(d.status == t.status);
+        CHECK(d.byte_count == t.byte_count);
+        CHECK(d.remaining_bytes() == t.remaining_bytes());
+        CHECK(d.lower_addr == t.lower_addr);
+    }
+    else
+    {
+        CHECK(d.first_be == t.first_be);
+        CHECK(d.last_be == t.last_be);
+        CHECK(d.addr == t.addr);
+    }
+
+    // A short buffer is rejected
+    CHECK(!tlp_model::decode(buf, len - 1, &d));
+}
+
+
+static void test_encode_decode()
+{
+    const uint8_t req_types[] = { tlp_model::MRD32, tlp_model::MRD64,
+                                  tlp_model::MWR32, tlp_model::MWR64 };
+    const uint16_t tags[] = { 0, 1, 0xff, 0x100, 0x200, 0x3ff };
+
+    for (uint8_t ft : req_types)
+    {
+        for (uint16_t tag : tags)
+        {
+            tlp_model::Tlp t;
+            t.fmt_type = ft;
+            t.tc = 5;
+            t.length_dw = tag & 0x3ff;
+            t.requester_id = 0x1234;
+            t.tag = tag;
+            t.first_be = 0xf;
+            t.last_be = 0x3;
+            t.addr = t.is_addr64() ? 0x123456789abcdef0 : 0x9abcdef0;
+            check_round_trip(t);
+        }
+    }
+
+    // Completions, including the byte counts at the ends of the range.
+    // 4096 is encoded as 0.
+    const uint32_t byte_counts[] = { 4, 64, 1024, 4092, 4096 };
+    for (uint16_t tag : tags)
+    {
+        for (uint32_t bc : byte_counts)
+        {
+            tlp_model::Tlp c;
+            c.fmt_type = tlp_model::CPLD;
+            c.length_dw = 16;
+            c.completer_id = 0x0100;
+            c.requester_id = 0x4321;
+            c.tag = tag;
+            c.status = 0;
+            c.byte_count = bc & 0xfff;
+            c.lower_addr = 0x40;
+            CHECK(c.remaining_bytes() == bc);
+            check_round_trip(c);
+        }
+    }
+
+    // Unknown types are rejected
+    uint8_t buf[16] = { 0x04 };
+    tlp_model::Tlp d;
+    CHECK(!tlp_model::decode(buf, sizeof(buf), &d));
+}
+
+
+//
+// Requests below 4GB use the 3DW header, including one that ends exactly
+// at 4GB. Requests at or above 4GB use the 4DW header.
+//
+static void test_addr_format()
+{
+    const struct
+    {
+        uint64_t addr;
+        bool addr64;
+    } cases[] = {
+        { 0x0, false },
+        { 0x12345000, false },
+        { 0xfffff000, false },
+        { 0x100000000, true },
+        { 0x123456789000, true },
+    };
+
+    for (const auto &c : cases)
+    {
+        for (bool is_write : { false, true })
+        {
+            std::vector<tlp_model::Tlp> tlps =
+                tlp_model::split_requests(is_write, c.addr, 4096, 512);
+            CHECK(tlps.size() == 8);
+            for (const tlp_model::Tlp &t : tlps)
+            {
+                CHECK(t.is_addr64() == c.addr64);
+                CHECK(t.is_write() == is_write);
+                CHECK(t.header_bytes() == (c.addr64 ? 16u : 12u));
+                check_round_trip(t);
+            }
+        }
+    }
+}
+
+
+//
+// Split reads of req_bytes into completions, pass them through an encode
+// and decode and reassemble them, interleaving the tags.
+//
+static void test_reassembly(uint32_t req_bytes, uint32_t rcb, uint32_t max_cpl_bytes)
+{
+    const uint16_t num_tags = 4;
+    std::vector<uint8_t> src(num_tags * req_bytes);
+    for (size_t i = 0; i < src.size(); i += 1)
+        src[i] = (i * 7 + (i >> 8)) & 0xff;
+
+    tlp_model::Reassembler reasm(num_tags, req_bytes);
+    std::vector<std::vector<tlp_model::Tlp>> cpls(num_tags);
+    for (uint16_t tag = 0; tag < num_tags; tag += 1)
+    {
+        std::vector<tlp_model::Tlp> rds =
+            tlp_model::split_requests(false, tag * req_bytes, req_bytes, req_bytes);
+        CHECK(rds.size() == 1);
+        rds[0].tag = tag;
+        reasm.issue(tag);
+        cpls[tag] = tlp_model::completions(rds[0], rcb, max_cpl_bytes);
+    }
+
+    // Round-robin across tags, each tag's completions in order
+    bool more = true;
+    for (size_t i = 0; more; i += 1)
+    {
+        more = false;
+        for (uint16_t tag = 0; tag < num_tags; tag += 1)
+        {
+            if (i >= cpls[tag].size()) continue;
+            more = true;
+
+            uint8_t buf[16];
+            tlp_model::Tlp c;
+            CHECK(tlp_model::decode(buf, tlp_model::encode(cpls[tag][i], buf), &c));
+            const uint32_t offset = tag * req_bytes + req_bytes - c.remaining_bytes();
+            CHECK(reasm.complete(c, &src[offset]));
+            CHECK(reasm.ready(tag) == (i + 1 == cpls[tag].size()));
+        }
+    }
+
+    for (uint16_t tag = 0; tag < num_tags; tag += 1)
+    {
+        CHECK(reasm.ready(tag));
+        CHECK(memcmp(reasm.slot(tag), &src[tag * req_bytes], req_bytes) == 0);
+
+        // Nothing more is accepted for a finished tag
+        CHECK(!reasm.complete(cpls[tag].back(), &src[0]));
+        reasm.retire(tag);
+    }
+}
+
+
+int main()
+{
+    test_encode_decode();
+    test_addr_format();
+
+    test_reassembly(512, 64, 64);
+    test_reassembly(512, 64, 256);
+    // A full page: the first completion's byte count is encoded as 0
+    test_reassembly(4096, 64, 256);
+    test_reassembly(4096, 128, 512);
+
+    if (errors)
+    {
+        printf("FAILED: %d errors\n", errors);
+        return 1;
+    }
+
+    printf("PASSED\n");
+    return 0;
+}